@@ -0,0 +1,202 @@
+/* KallistiOS ##version##
+
+   kmg/kmg2.h
+   Copyright (C) 2026 KallistiOS Team
+*/
+
+/** \file    kmg/kmg2.h
+    \brief   KMG version 2 texture loader.
+    \ingroup kmg2
+
+    KMG version 2 keeps the texture data of a KMG exactly as it goes into
+    texture memory, but can store it as a single LZ4 block and describes
+    where everything is with a section table: the VQ codebook (if any) and
+    every mipmap level get their own entry, so nothing has to work out the
+    PowerVR's mipmap layout rules to find a level.
+
+    The file starts with a 64 byte header whose first seven fields are the
+    same as in a version 1 KMG, followed by the section table and then the
+    stored data, which starts on a 32 byte boundary. All values are stored
+    little-endian.
+
+    Compressed files record how much slack the decompressor needs to run in
+    place. kmg2_to_img() reads the compressed data into the end of the
+    texture buffer itself and decompresses it forward from there, so loading
+    takes no more memory than the texture does.
+
+    Everything but kmg2_to_img() works on memory buffers and builds for the
+    host as well (see Makefile.nonkos), so the tools that write KMGs can check
+    their own output. The writer they share is in kmg/kmg2write.h.
+
+    \author KallistiOS Team
+*/
+
+#ifndef __KMG_KMG2_H
+#define __KMG_KMG2_H
+
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stdint.h>
+#include <stddef.h>
+
+/** \defgroup kmg2  KMG Textures
+    \brief          Compressed KMG texture files
+    \ingroup        video
+*/
+
+/** \brief   File magic, "KMG\0" (the same as version 1).
+    \ingroup kmg2 */
+#define KMG2_MAGIC          0x00474d4b
+
+/** \brief   Version number of the files described here.
+    \ingroup kmg2 */
+#define KMG2_VERSION        2
+
+/** \brief   Size of the fixed header, in bytes.
+    \ingroup kmg2 */
+#define KMG2_HDR_SIZE       64
+
+/** \brief   Size of one section table entry, in bytes.
+    \ingroup kmg2 */
+#define KMG2_SECTION_SIZE   12
+
+/** \brief   Maximum number of sections in a file.
+    \ingroup kmg2 */
+#define KMG2_MAX_SECTIONS   16
+
+/** \brief   Header flag: the stored data is one LZ4 block.
+    \ingroup kmg2 */
+#define KMG2_FLAG_LZ4       0x0001
+
+/** \defgroup kmg2_sects    Section Types
+    \brief                  Types of the section table entries
+    \ingroup                kmg2
+
+    @{
+*/
+#define KMG2_SECT_CODEBOOK  1   /**< \brief VQ codebook */
+#define KMG2_SECT_LEVEL     2   /**< \brief Texels or indices of one level */
+/** @} */
+
+/** \brief   One section table entry.
+    \ingroup kmg2
+
+    Offsets are into the decompressed texture data. The level of a
+    KMG2_SECT_LEVEL section is the base 2 logarithm of its width, so the 1x1
+    mipmap is level 0.
+*/
+typedef struct kmg2_section {
+    uint16_t type;          /**< \brief Section type, see \ref kmg2_sects */
+    uint16_t level;         /**< \brief Mipmap level */
+    uint32_t offset;        /**< \brief Offset in the texture data */
+    uint32_t size;          /**< \brief Size in bytes */
+} kmg2_section_t;
+
+/** \brief   Decoded file header and section table.
+    \ingroup kmg2
+*/
+typedef struct kmg2_header {
+    uint32_t magic;         /**< \brief KMG2_MAGIC */
+    uint32_t version;       /**< \brief 1 or KMG2_VERSION */
+    uint32_t platform;      /**< \brief Platform, as in version 1 */
+    uint32_t format;        /**< \brief Texture format, as in version 1 */
+    uint32_t width;         /**< \brief Width in pixels */
+    uint32_t height;        /**< \brief Height in pixels */
+    uint32_t byte_count;    /**< \brief Size of the texture data */
+    uint32_t flags;         /**< \brief KMG2_FLAG_* */
+    uint32_t stored_size;   /**< \brief Size of the data as stored */
+    uint32_t data_offset;   /**< \brief Offset of the data in the file */
+    uint32_t margin;        /**< \brief Extra bytes in-place decoding needs */
+    uint32_t section_count; /**< \brief Entries used in sections */
+    kmg2_section_t sections[KMG2_MAX_SECTIONS]; /**< \brief Section table */
+} kmg2_header_t;
+
+/** \brief   Decode the fixed part of a header.
+    \ingroup kmg2
+
+    Version 1 files are accepted too. They come out as a header with no
+    sections and the texture data stored as is right after the header.
+
+    \param  buf             The first bytes of the file.
+    \param  size            Bytes available at buf (at least KMG2_HDR_SIZE).
+    \param  hdr             Where to store the header.
+    \retval 0               On success.
+    \retval -1              If this is not a KMG file this code can read.
+*/
+int kmg2_parse_header(const uint8_t *buf, size_t size, kmg2_header_t *hdr);
+
+/** \brief   Decode and check the section table.
+    \ingroup kmg2
+
+    \param  buf             The first bytes of the file.
+    \param  size            Bytes available at buf (at least hdr->data_offset).
+    \param  hdr             The header from kmg2_parse_header(), which gets the
+                            section table filled in.
+    \retval 0               On success.
+    \retval -1              If the table is damaged.
+*/
+int kmg2_parse_sections(const uint8_t *buf, size_t size, kmg2_header_t *hdr);
+
+/** \brief   Look up a section.
+    \ingroup kmg2
+
+    \param  hdr             The header with its section table.
+    \param  type            The section type.
+    \param  level           The level, for KMG2_SECT_LEVEL.
+    \return                 The section, or NULL if there is none.
+*/
+const kmg2_section_t *kmg2_find_section(const kmg2_header_t *hdr, int type,
+                                        int level);
+
+/** \brief   Decompress one LZ4 block.
+    \ingroup kmg2
+
+    This is safe on damaged input: it never reads or writes outside of the
+    given buffers. The source may sit at the end of the destination buffer
+    as long as it starts at least the file's margin past dstlen.
+
+    \param  src             The compressed block.
+    \param  srclen          Size of the compressed block.
+    \param  dst             Where to decompress to.
+    \param  dstlen          Exact size of the decompressed data.
+    \retval 0               On success.
+    \retval -1              If the block is damaged or the wrong size.
+*/
+int kmg2_lz4_decode(const uint8_t *src, size_t srclen, uint8_t *dst,
+                    size_t dstlen);
+
+/** \brief   Turn the stored data of a file into texture data.
+    \ingroup kmg2
+
+    \param  hdr             The file header.
+    \param  data            The hdr->stored_size bytes of stored data.
+    \param  dst             Where to put the hdr->byte_count bytes of texture
+                            data. This may be the same as data for files
+                            that are not compressed.
+    \retval 0               On success.
+    \retval -1              If the data is damaged.
+*/
+int kmg2_decode(const kmg2_header_t *hdr, const uint8_t *data, void *dst);
+
+#ifdef _arch_dreamcast
+#include <kos/img.h>
+
+/** \brief   Load a KMG file from the VFS.
+    \ingroup kmg2
+
+    This loads version 1 and version 2 files. The texture data is put in a
+    32-byte aligned buffer in rv->data, which the caller frees, and can go
+    straight to pvr_txr_load_kimg().
+
+    \param  fn              The file to load.
+    \param  rv              The image to fill in.
+    \retval 0               On success.
+    \retval -1              On a read error, a bad file or out of memory.
+*/
+int kmg2_to_img(const char *fn, kos_img_t *rv);
+#endif
+
+__END_DECLS
+
+#endif  /* __KMG_KMG2_H */
@@ -0,0 +1,77 @@
+/* KallistiOS ##version##
+
+   kmg/kmg2write.h
+   Copyright (C) 2026 KallistiOS Team
+*/
+
+/** \file    kmg/kmg2write.h
+    \brief   KMG version 2 writer.
+    \ingroup kmg2
+
+    This is the other half of kmg/kmg2.h, for the tools that make KMG files
+    (kmgenc and vqenc). It is only built for the host, by Makefile.nonkos or
+    by the tools themselves, and is not part of the KOS library.
+
+    \author KallistiOS Team
+*/
+
+#ifndef __KMG_KMG2WRITE_H
+#define __KMG_KMG2WRITE_H
+
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stdio.h>
+#include <kmg/kmg2.h>
+
+/** \brief   Worst case size of an LZ4 block for len bytes of input.
+    \ingroup kmg2 */
+#define KMG2_LZ4_BOUND(len) ((len) + (len) / 255 + 16)
+
+/** \brief   Compress data as one LZ4 block.
+    \ingroup kmg2
+
+    \param  src             The data to compress.
+    \param  len             Size of the data.
+    \param  dst             Where to write the block; at least
+                            KMG2_LZ4_BOUND(len) bytes.
+    \param  margin          Set to how far past len the block has to start
+                            in a shared buffer to be decoded in place.
+    \return                 The compressed size, or -1 if out of memory.
+*/
+int kmg2_lz4_compress(const unsigned char *src, int len, unsigned char *dst,
+                      int *margin);
+
+/** \brief   Add a section to a header's section table.
+    \ingroup kmg2
+
+    \param  hdr             The header.
+    \param  type            Section type, see \ref kmg2_sects.
+    \param  level           Mipmap level.
+    \param  offset          Offset in the texture data.
+    \param  size            Size in bytes.
+*/
+void kmg2_add_section(kmg2_header_t *hdr, int type, int level, int offset,
+                      int size);
+
+/** \brief   Write a version 2 KMG.
+    \ingroup kmg2
+
+    platform, format, width, height, byte_count and the section table of hdr
+    must be filled in; the rest is worked out here. The result is decoded
+    again with kmg2_decode() and compared against data before it is written.
+
+    \param  fp              The file to write to.
+    \param  hdr             The header.
+    \param  data            The texture data.
+    \param  compress        Non-zero to compress the data, if that makes it
+                            smaller.
+    \retval 0               On success.
+    \retval -1              On a write error, or if the file didn't decode.
+*/
+int kmg2_write(FILE *fp, kmg2_header_t *hdr, const unsigned char *data,
+               int compress);
+
+__END_DECLS
+
+#endif  /* __KMG_KMG2WRITE_H */
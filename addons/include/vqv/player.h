@@ -0,0 +1,99 @@
+/* KallistiOS ##version##
+
+   vqv/player.h
+   Copyright (C) 2026 KallistiOS Team
+*/
+
+/** \file    vqv/player.h
+    \brief   VQ video playback into PVR texture memory.
+    \ingroup vqv
+
+    The player streams a VQV file (see vqv/vqv.h) from any VFS path, one
+    chunk at a time, and uploads each decoded frame into one of two VQ
+    textures in PVR memory. While one texture is being drawn, the next frame
+    goes into the other, so the caller just binds vqv_player_texture() after
+    every vqv_player_next() call.
+
+    Index data is sent to texture memory by DMA straight out of the chunk
+    buffer; the codebook is only uploaded to a texture when it changed since
+    that texture was last written.
+
+    \author KallistiOS Team
+*/
+
+#ifndef __VQV_PLAYER_H
+#define __VQV_PLAYER_H
+
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <dc/pvr.h>
+#include <vqv/vqv.h>
+
+/** \brief   Opaque VQ video player.
+    \ingroup vqv */
+typedef struct vqv_player vqv_player_t;
+
+/** \brief   Open a VQV file for playback.
+    \ingroup vqv
+
+    This allocates the chunk buffer and both textures.
+
+    \param  fn              The file to play.
+    \return                 The new player, or NULL on failure (bad file or
+                            out of main or texture memory).
+*/
+vqv_player_t *vqv_player_open(const char *fn);
+
+/** \brief   Close a player and free its textures.
+    \ingroup vqv
+
+    \param  p               The player to close.
+*/
+void vqv_player_close(vqv_player_t *p);
+
+/** \brief   Get the stream header of a player.
+    \ingroup vqv
+
+    \param  p               The player.
+    \return                 The stream header.
+*/
+const vqv_header_t *vqv_player_header(vqv_player_t *p);
+
+/** \brief   Read, decode and upload the next frame.
+    \ingroup vqv
+
+    \param  p               The player.
+    \return                 The frame number of the uploaded frame, or -1 at
+                            the end of the stream or on a read error.
+*/
+int vqv_player_next(vqv_player_t *p);
+
+/** \brief   Go back to the first frame.
+    \ingroup vqv
+
+    \param  p               The player.
+    \retval 0               On success.
+    \retval -1              If the file could not be seeked.
+*/
+int vqv_player_rewind(vqv_player_t *p);
+
+/** \brief   Get the texture holding the most recently uploaded frame.
+    \ingroup vqv
+
+    \param  p               The player.
+    \return                 The texture, or NULL before the first frame.
+*/
+pvr_ptr_t vqv_player_texture(vqv_player_t *p);
+
+/** \brief   Get the PVR texture format of the frames.
+    \ingroup vqv
+
+    \param  p               The player.
+    \return                 PVR_TXRFMT_* flags for pvr_poly_cxt_txr().
+*/
+int vqv_player_txrfmt(vqv_player_t *p);
+
+__END_DECLS
+
+#endif  /* __VQV_PLAYER_H */
@@ -0,0 +1,218 @@
+/* KallistiOS ##version##
+
+   vqv/vqv.h
+   Copyright (C) 2026 KallistiOS Team
+*/
+
+/** \file    vqv/vqv.h
+    \brief   VQ compressed video container.
+    \ingroup vqv
+
+    This file describes the VQV container, a simple full-motion video format
+    made of PowerVR VQ texture frames. Every frame of a VQV stream is a
+    twiddled, square VQ texture that shares one 256 entry codebook with the
+    frames around it. Key frames carry the whole codebook, and the frames in
+    between only carry the codebook entries that changed (if any) along with
+    the new index data, so decoding a frame is nothing more than patching a
+    2KB codebook and copying index bytes to texture memory.
+
+    A stream starts with one sector holding the header, followed by one chunk
+    per frame. Chunks start on a sector boundary and are padded out to a whole
+    number of sectors, so a player can stream them off of a CD with plain
+    sector-sized reads. All values are stored little-endian.
+
+    The functions here only deal with memory buffers and are built for the
+    host as well (see Makefile.nonkos), so that encoders can check their output.
+    The Dreamcast player on top of them is in vqv/player.h.
+
+    \author KallistiOS Team
+*/
+
+#ifndef __VQV_VQV_H
+#define __VQV_VQV_H
+
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stdint.h>
+#include <stddef.h>
+
+/** \defgroup vqv   VQ Video
+    \brief          Streamable VQ compressed full-motion video
+    \ingroup        video
+*/
+
+/** \brief   Stream header magic, "VQV1".
+    \ingroup vqv */
+#define VQV_MAGIC           0x31565156
+
+/** \brief   Chunk header magic, "VQVC".
+    \ingroup vqv */
+#define VQV_CHUNK_MAGIC     0x43565156
+
+/** \brief   Current container version.
+    \ingroup vqv */
+#define VQV_VERSION         1
+
+/** \brief   Alignment and padding unit of the header and chunks.
+    \ingroup vqv */
+#define VQV_SECTOR          2048
+
+/** \brief   Number of codebook entries.
+    \ingroup vqv */
+#define VQV_CODES           256
+
+/** \brief   Size of the codebook in texture memory, in bytes.
+    \ingroup vqv */
+#define VQV_CODEBOOK_SIZE   (VQV_CODES * 4 * 2)
+
+/** \brief   Size of a chunk header, in bytes.
+    \ingroup vqv */
+#define VQV_CHUNK_HDR_SIZE  32
+
+/** \brief   Size of one codebook update record, in bytes.
+    \ingroup vqv */
+#define VQV_UPDATE_SIZE     10
+
+/** \defgroup vqv_fmts  Pixel Formats
+    \brief              Texel formats of the codebook entries
+    \ingroup            vqv
+
+    These match the KMG Dreamcast format values.
+
+    @{
+*/
+#define VQV_FMT_RGB565      1   /**< \brief 16-bit RGB565 */
+#define VQV_FMT_ARGB4444    2   /**< \brief 16-bit ARGB4444 */
+#define VQV_FMT_ARGB1555    3   /**< \brief 16-bit ARGB1555 */
+/** @} */
+
+/** \brief   Chunk flag: the chunk holds a full codebook.
+    \ingroup vqv */
+#define VQV_CHUNK_KEY       0x0001
+
+/** \brief   Stream header, as decoded by vqv_parse_header().
+    \ingroup vqv
+
+    On disk, the fields are stored in this order as little-endian values
+    starting at offset 0 of the first sector.
+*/
+typedef struct vqv_header {
+    uint32_t magic;         /**< \brief VQV_MAGIC */
+    uint32_t version;       /**< \brief VQV_VERSION */
+    uint32_t format;        /**< \brief Texel format, see \ref vqv_fmts */
+    uint32_t width;         /**< \brief Frame width in pixels */
+    uint32_t height;        /**< \brief Frame height in pixels */
+    uint32_t frame_count;   /**< \brief Number of frames in the stream */
+    uint32_t fps_num;       /**< \brief Frame rate numerator */
+    uint32_t fps_den;       /**< \brief Frame rate denominator */
+    uint32_t max_chunk;     /**< \brief Size of the largest chunk, in bytes */
+    uint32_t key_interval;  /**< \brief Maximum frames between key frames */
+} vqv_header_t;
+
+/** \brief   Chunk header, as decoded by vqv_parse_chunk().
+    \ingroup vqv
+
+    A chunk header is followed by either a full codebook (for key chunks) or
+    updates records of VQV_UPDATE_SIZE bytes: a 16-bit entry number followed
+    by the entry's four texels. The index data starts at index_offset, which
+    is always a multiple of 32 so it can be DMAed straight out of the chunk.
+*/
+typedef struct vqv_chunk {
+    uint32_t magic;         /**< \brief VQV_CHUNK_MAGIC */
+    uint32_t size;          /**< \brief Whole chunk size, a multiple of VQV_SECTOR */
+    uint32_t frame;         /**< \brief Frame number */
+    uint16_t flags;         /**< \brief VQV_CHUNK_KEY or 0 */
+    uint16_t updates;       /**< \brief Codebook entries carried by the chunk */
+    uint32_t index_offset;  /**< \brief Offset of the index data in the chunk */
+    uint32_t index_size;    /**< \brief Size of the index data, in bytes */
+} vqv_chunk_t;
+
+/** \brief   Decoder state.
+    \ingroup vqv
+
+    The codebook is kept in the same layout as in a VQ texture, so it can be
+    copied to texture memory as is. It is 32-byte aligned for DMA.
+*/
+typedef struct vqv_state {
+    /** \brief Current codebook, in texture layout */
+    uint16_t codebook[VQV_CODES * 4] __attribute__((aligned(32)));
+    vqv_header_t hdr;       /**< \brief Stream header */
+    uint32_t frame;         /**< \brief Last decoded frame */
+    uint32_t cb_version;    /**< \brief Bumped on every codebook change */
+    const uint8_t *indices; /**< \brief Index data of the last frame */
+    uint32_t index_size;    /**< \brief Size of the index data */
+    int have_key;           /**< \brief Non-zero once a key chunk was seen */
+} vqv_state_t;
+
+/** \brief   Decode and validate a stream header.
+    \ingroup vqv
+
+    \param  buf             The first bytes of the stream.
+    \param  size            Bytes available at buf (at least 40).
+    \param  hdr             Where to store the decoded header.
+    \retval 0               On success.
+    \retval -1              If the header is not a valid VQV header.
+*/
+int vqv_parse_header(const uint8_t *buf, size_t size, vqv_header_t *hdr);
+
+/** \brief   Encode a stream header into its on-disk form.
+    \ingroup vqv
+
+    \param  hdr             The header to encode.
+    \param  buf             Where to write it; VQV_SECTOR bytes, which are all
+                            written (the unused tail is zeroed).
+*/
+void vqv_write_header(const vqv_header_t *hdr, uint8_t *buf);
+
+/** \brief   Decode and validate a chunk header.
+    \ingroup vqv
+
+    This only needs the first VQV_CHUNK_HDR_SIZE bytes of the chunk, so a
+    streaming reader can find out how much more to read after the first
+    sector.
+
+    \param  hdr             The stream header.
+    \param  buf             The start of the chunk.
+    \param  chunk           Where to store the decoded chunk header.
+    \retval 0               On success.
+    \retval -1              If the chunk header is not valid for the stream.
+*/
+int vqv_parse_chunk(const vqv_header_t *hdr, const uint8_t *buf,
+                    vqv_chunk_t *chunk);
+
+/** \brief   Encode a chunk header into its on-disk form.
+    \ingroup vqv
+
+    \param  chunk           The chunk header to encode.
+    \param  buf             Where to write its VQV_CHUNK_HDR_SIZE bytes.
+*/
+void vqv_write_chunk(const vqv_chunk_t *chunk, uint8_t *buf);
+
+/** \brief   Set up a decoder for a stream.
+    \ingroup vqv
+
+    \param  st              The decoder state to set up.
+    \param  hdr             The stream header.
+*/
+void vqv_init(vqv_state_t *st, const vqv_header_t *hdr);
+
+/** \brief   Decode one whole chunk.
+    \ingroup vqv
+
+    This applies the codebook carried by the chunk to the decoder state and
+    points st->indices at the chunk's index data, so the chunk buffer must
+    stay around for as long as the indices are used.
+
+    \param  st              The decoder state.
+    \param  buf             The whole chunk.
+    \param  size            Bytes available at buf.
+    \retval 0               On success.
+    \retval -1              If the chunk is damaged, or is a delta chunk and
+                            no key chunk was decoded yet.
+*/
+int vqv_decode_chunk(vqv_state_t *st, const uint8_t *buf, size_t size);
+
+__END_DECLS
+
+#endif  /* __VQV_VQV_H */
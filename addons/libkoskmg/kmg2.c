@@ -0,0 +1,184 @@
+/* KallistiOS ##version##
+
+   kmg2.c
+   Copyright (C) 2026 KallistiOS Team
+*/
+
+/* KMG header parsing and LZ4 decoding. Nothing in here touches the VFS, so it
+   builds for the host too (see Makefile.nonkos). */
+
+#include <string.h>
+#include <kmg/kmg2.h>
+
+static uint16_t get16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+int kmg2_parse_header(const uint8_t *buf, size_t size, kmg2_header_t *hdr) {
+    if(size < KMG2_HDR_SIZE)
+        return -1;
+
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->magic = get32(buf + 0);
+    hdr->version = get32(buf + 4);
+    hdr->platform = get32(buf + 8);
+    hdr->format = get32(buf + 12);
+    hdr->width = get32(buf + 16);
+    hdr->height = get32(buf + 20);
+    hdr->byte_count = get32(buf + 24);
+
+    if(hdr->magic != KMG2_MAGIC || !hdr->byte_count)
+        return -1;
+
+    if(hdr->version == 1) {
+        hdr->stored_size = hdr->byte_count;
+        hdr->data_offset = KMG2_HDR_SIZE;
+        return 0;
+    }
+
+    if(hdr->version != KMG2_VERSION)
+        return -1;
+
+    hdr->flags = get32(buf + 28);
+    hdr->stored_size = get32(buf + 32);
+    hdr->data_offset = get32(buf + 36);
+    hdr->margin = get32(buf + 40);
+    hdr->section_count = get32(buf + 44);
+
+    if(hdr->flags & ~KMG2_FLAG_LZ4)
+        return -1;
+
+    if(hdr->section_count > KMG2_MAX_SECTIONS || hdr->data_offset % 32 ||
+       hdr->data_offset < KMG2_HDR_SIZE +
+       hdr->section_count * KMG2_SECTION_SIZE)
+        return -1;
+
+    if(!(hdr->flags & KMG2_FLAG_LZ4) && hdr->stored_size != hdr->byte_count)
+        return -1;
+
+    return 0;
+}
+
+int kmg2_parse_sections(const uint8_t *buf, size_t size, kmg2_header_t *hdr) {
+    const uint8_t *p = buf + KMG2_HDR_SIZE;
+    kmg2_section_t *s;
+    uint32_t i;
+
+    if(size < hdr->data_offset)
+        return -1;
+
+    for(i = 0, s = hdr->sections; i < hdr->section_count;
+        i++, s++, p += KMG2_SECTION_SIZE) {
+        s->type = get16(p);
+        s->level = get16(p + 2);
+        s->offset = get32(p + 4);
+        s->size = get32(p + 8);
+
+        if(s->offset > hdr->byte_count || s->size > hdr->byte_count - s->offset)
+            return -1;
+    }
+
+    return 0;
+}
+
+const kmg2_section_t *kmg2_find_section(const kmg2_header_t *hdr, int type,
+                                        int level) {
+    uint32_t i;
+
+    for(i = 0; i < hdr->section_count; i++) {
+        if(hdr->sections[i].type == type &&
+           (type != KMG2_SECT_LEVEL || hdr->sections[i].level == level))
+            return hdr->sections + i;
+    }
+
+    return NULL;
+}
+
+/* read an LZ4 length extension; returns -1 if it runs off the input */
+static int get_length(const uint8_t **src, const uint8_t *end, size_t *len) {
+    uint8_t b;
+
+    do {
+        if(*src >= end)
+            return -1;
+
+        b = *(*src)++;
+        *len += b;
+    } while(b == 255);
+
+    return 0;
+}
+
+int kmg2_lz4_decode(const uint8_t *src, size_t srclen, uint8_t *dst,
+                    size_t dstlen) {
+    const uint8_t *send = src + srclen;
+    uint8_t *d = dst, *dend = dst + dstlen;
+    size_t len, offset;
+    uint8_t token;
+
+    for(;;) {
+        if(src >= send)
+            return -1;
+
+        token = *src++;
+        len = token >> 4;
+
+        if(len == 15 && get_length(&src, send, &len) < 0)
+            return -1;
+
+        if(len > (size_t)(send - src) || len > (size_t)(dend - d))
+            return -1;
+
+        /* the source can be behind us in the same buffer when decoding in
+           place, so this has to be a memmove */
+        memmove(d, src, len);
+        d += len;
+        src += len;
+
+        /* the last sequence has no match */
+        if(src == send)
+            break;
+
+        if(send - src < 2)
+            return -1;
+
+        offset = get16(src);
+        src += 2;
+
+        if(!offset || offset > (size_t)(d - dst))
+            return -1;
+
+        len = token & 15;
+
+        if(len == 15 && get_length(&src, send, &len) < 0)
+            return -1;
+
+        len += 4;
+
+        if(len > (size_t)(dend - d))
+            return -1;
+
+        /* matches may overlap themselves, so copy a byte at a time */
+        while(len--) {
+            *d = d[-(ptrdiff_t)offset];
+            d++;
+        }
+    }
+
+    return d == dend ? 0 : -1;
+}
+
+int kmg2_decode(const kmg2_header_t *hdr, const uint8_t *data, void *dst) {
+    if(hdr->flags & KMG2_FLAG_LZ4)
+        return kmg2_lz4_decode(data, hdr->stored_size, (uint8_t *)dst,
+                               hdr->byte_count);
+
+    if(data != dst)
+        memcpy(dst, data, hdr->byte_count);
+
+    return 0;
+}
@@ -0,0 +1,106 @@
+/* KallistiOS ##version##
+
+   kmg2_img.c
+   Copyright (C) 2026 KallistiOS Team
+*/
+
+#include <malloc.h>
+#include <string.h>
+#include <kos/fs.h>
+#include <kos/dbglog.h>
+#include <dc/pvr.h>
+#include <kmg/kmg2.h>
+
+/* Map the KMG Dreamcast format onto the KOS image format; this is the same
+   mapping kos-ports' libkmg uses for version 1 files. */
+static uint32_t img_format(uint32_t format) {
+    uint32_t fmt, dfmt = 0;
+
+    switch(format & 0xff) {
+        case 0x03:
+            fmt = KOS_IMG_FMT_RGB565;
+            break;
+        case 0x04:
+            fmt = KOS_IMG_FMT_ARGB4444;
+            break;
+        case 0x05:
+            fmt = KOS_IMG_FMT_ARGB1555;
+            break;
+        default:
+            return KOS_IMG_FMT_NONE;
+    }
+
+    if(format & 0x0100)
+        dfmt |= PVR_TXRLOAD_FMT_VQ;
+
+    if(format & 0x0200)
+        dfmt |= PVR_TXRLOAD_FMT_TWIDDLED;
+
+    return KOS_IMG_FMT(fmt, dfmt);
+}
+
+int kmg2_to_img(const char *fn, kos_img_t *rv) {
+    kmg2_header_t hdr;
+    uint8_t head[KMG2_HDR_SIZE + KMG2_MAX_SECTIONS * KMG2_SECTION_SIZE + 32];
+    uint8_t *data = NULL, *src;
+    size_t size;
+    file_t fd;
+
+    if((fd = fs_open(fn, O_RDONLY)) == FILEHND_INVALID) {
+        dbglog(DBG_ERROR, "kmg2_to_img: can't open %s\n", fn);
+        return -1;
+    }
+
+    if(fs_read(fd, head, KMG2_HDR_SIZE) != KMG2_HDR_SIZE ||
+       kmg2_parse_header(head, KMG2_HDR_SIZE, &hdr) < 0 ||
+       hdr.data_offset > sizeof(head))
+        goto bad;
+
+    if(hdr.data_offset > KMG2_HDR_SIZE &&
+       fs_read(fd, head + KMG2_HDR_SIZE, hdr.data_offset - KMG2_HDR_SIZE) !=
+       (ssize_t)(hdr.data_offset - KMG2_HDR_SIZE))
+        goto bad;
+
+    if(kmg2_parse_sections(head, hdr.data_offset, &hdr) < 0 ||
+       img_format(hdr.format) == KOS_IMG_FMT_NONE)
+        goto bad;
+
+    /* compressed data goes at the end of the texture buffer, and is
+       decompressed forward over itself */
+    size = hdr.byte_count;
+
+    if(hdr.flags & KMG2_FLAG_LZ4) {
+        size += hdr.margin;
+
+        if(hdr.stored_size > size)
+            goto bad;
+    }
+
+    if(!(data = (uint8_t *)memalign(32, size))) {
+        dbglog(DBG_ERROR, "kmg2_to_img: out of memory for %s\n", fn);
+        fs_close(fd);
+        return -1;
+    }
+
+    src = data + size - hdr.stored_size;
+
+    if(fs_read(fd, src, hdr.stored_size) != (ssize_t)hdr.stored_size ||
+       kmg2_decode(&hdr, src, data) < 0)
+        goto bad;
+
+    fs_close(fd);
+
+    rv->data = data;
+    rv->w = hdr.width;
+    rv->h = hdr.height;
+    rv->fmt = img_format(hdr.format);
+    rv->byte_count = hdr.byte_count;
+
+    return 0;
+
+bad:
+    dbglog(DBG_ERROR, "kmg2_to_img: %s is not a valid KMG\n", fn);
+    free(data);
+    fs_close(fd);
+    return -1;
+}
@@ -0,0 +1,255 @@
+/* KallistiOS ##version##
+
+   kmg2write.c
+   Copyright (C) 2026 KallistiOS Team
+*/
+
+/* Version 2 KMG writer and LZ4 block compressor, for the tools that make KMG
+   files. It's only built for the host (see Makefile.nonkos), and checks every
+   file it writes with the decoder in kmg2.c. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <kmg/kmg2write.h>
+
+#define MIN_MATCH       4
+#define LAST_LITERALS   5       /* the block always ends with literals */
+#define MATCH_LIMIT     12      /* no match starts this close to the end */
+#define MAX_OFFSET      65535
+#define HASH_BITS       16
+#define MAX_CHAIN       256     /* candidates tried for each position */
+
+static unsigned int hash4(const unsigned char *p) {
+    unsigned int v = p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+
+    return (v * 2654435761U) >> (32 - HASH_BITS);
+}
+
+static unsigned char *put_length(unsigned char *op, int len) {
+    while(len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+
+    *op++ = len;
+    return op;
+}
+
+/* emit literals lit[0..nlit) followed by a match, or no match if mlen is 0 */
+static unsigned char *put_sequence(unsigned char *op, const unsigned char *lit,
+                                   int nlit, int offset, int mlen) {
+    unsigned char *token = op++;
+
+    *token = (nlit >= 15 ? 15 : nlit) << 4;
+
+    if(nlit >= 15)
+        op = put_length(op, nlit - 15);
+
+    memcpy(op, lit, nlit);
+    op += nlit;
+
+    if(mlen) {
+        *op++ = offset & 0xff;
+        *op++ = offset >> 8;
+        mlen -= MIN_MATCH;
+        *token |= mlen >= 15 ? 15 : mlen;
+
+        if(mlen >= 15)
+            op = put_length(op, mlen - 15);
+    }
+
+    return op;
+}
+
+int kmg2_lz4_compress(const unsigned char *src, int len, unsigned char *dst,
+                      int *margin) {
+    int *head, *prev;
+    int ip, anchor, cand, chain, best_len, best_off, l, limit, ahead;
+    unsigned char *op = dst;
+    unsigned int h;
+
+    head = (int *)malloc(sizeof(int) << HASH_BITS);
+    prev = (int *)malloc(sizeof(int) * (len + 1));
+
+    if(head == NULL || prev == NULL) {
+        free(head);
+        free(prev);
+        return -1;
+    }
+
+    memset(head, 0xff, sizeof(int) << HASH_BITS);
+
+    /* how far the decoder's output gets ahead of its input; in place, the
+       input has to start at least that far up the buffer */
+    ahead = 0;
+    anchor = ip = 0;
+    limit = len - MATCH_LIMIT;
+
+    while(ip < limit) {
+        h = hash4(src + ip);
+        best_len = 0;
+        best_off = 0;
+
+        for(cand = head[h], chain = MAX_CHAIN; cand >= 0 &&
+            ip - cand <= MAX_OFFSET && chain > 0; cand = prev[cand], chain--) {
+            if(src[cand + best_len] != src[ip + best_len])
+                continue;
+
+            for(l = 0; ip + l < len - LAST_LITERALS &&
+                src[cand + l] == src[ip + l]; l++)
+                ;
+
+            if(l > best_len) {
+                best_len = l;
+                best_off = ip - cand;
+            }
+        }
+
+        prev[ip] = head[h];
+        head[h] = ip;
+
+        if(best_len < MIN_MATCH) {
+            ip++;
+            continue;
+        }
+
+        op = put_sequence(op, src + anchor, ip - anchor, best_off, best_len);
+
+        /* index the positions inside the match too */
+        for(l = 1; l < best_len && ip + l < limit; l++) {
+            h = hash4(src + ip + l);
+            prev[ip + l] = head[h];
+            head[h] = ip + l;
+        }
+
+        ip += best_len;
+        anchor = ip;
+
+        if(ip - (op - dst) > ahead)
+            ahead = ip - (op - dst);
+    }
+
+    op = put_sequence(op, src + anchor, len - anchor, 0, 0);
+
+    free(head);
+    free(prev);
+
+    l = op - dst;
+    *margin = ahead > len - l ? ahead - (len - l) : 0;
+    return l;
+}
+
+static void put32(unsigned char *p, unsigned int v) {
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = v >> 24;
+}
+
+void kmg2_add_section(kmg2_header_t *hdr, int type, int level, int offset,
+                      int size) {
+    kmg2_section_t *s = &hdr->sections[hdr->section_count++];
+
+    s->type = type;
+    s->level = level;
+    s->offset = offset;
+    s->size = size;
+}
+
+/* decode the file image in buf like the loader does, stored data in place */
+static int check(const unsigned char *buf, int size, const unsigned char *data) {
+    kmg2_header_t hdr;
+    unsigned char *tmp;
+    int rv = -1;
+
+    if(kmg2_parse_header(buf, size, &hdr) < 0 ||
+       kmg2_parse_sections(buf, size, &hdr) < 0 ||
+       hdr.data_offset + hdr.stored_size != (unsigned int)size)
+        return -1;
+
+    if((tmp = (unsigned char *)malloc(hdr.byte_count + hdr.margin)) == NULL)
+        return -1;
+
+    memcpy(tmp + hdr.byte_count + hdr.margin - hdr.stored_size,
+           buf + hdr.data_offset, hdr.stored_size);
+
+    if(kmg2_decode(&hdr, tmp + hdr.byte_count + hdr.margin - hdr.stored_size,
+                   tmp) == 0 && !memcmp(tmp, data, hdr.byte_count))
+        rv = 0;
+
+    free(tmp);
+    return rv;
+}
+
+int kmg2_write(FILE *fp, kmg2_header_t *hdr, const unsigned char *data,
+               int compress) {
+    unsigned char *buf, *p;
+    int margin = 0, stored, i, rv = -1;
+
+    hdr->magic = KMG2_MAGIC;
+    hdr->version = KMG2_VERSION;
+    hdr->data_offset = (KMG2_HDR_SIZE + hdr->section_count *
+                        KMG2_SECTION_SIZE + 31) & ~31;
+
+    buf = (unsigned char *)calloc(1, hdr->data_offset +
+                                  KMG2_LZ4_BOUND(hdr->byte_count));
+
+    if(buf == NULL)
+        return -1;
+
+    hdr->flags = 0;
+    stored = hdr->byte_count;
+
+    if(compress) {
+        stored = kmg2_lz4_compress(data, hdr->byte_count,
+                                   buf + hdr->data_offset, &margin);
+
+        if(stored > 0 && stored < (int)hdr->byte_count)
+            hdr->flags = KMG2_FLAG_LZ4;
+        else
+            stored = hdr->byte_count;
+    }
+
+    if(!(hdr->flags & KMG2_FLAG_LZ4)) {
+        memcpy(buf + hdr->data_offset, data, hdr->byte_count);
+        margin = 0;
+    }
+
+    hdr->stored_size = stored;
+    hdr->margin = margin;
+
+    put32(buf + 0, hdr->magic);
+    put32(buf + 4, hdr->version);
+    put32(buf + 8, hdr->platform);
+    put32(buf + 12, hdr->format);
+    put32(buf + 16, hdr->width);
+    put32(buf + 20, hdr->height);
+    put32(buf + 24, hdr->byte_count);
+    put32(buf + 28, hdr->flags);
+    put32(buf + 32, hdr->stored_size);
+    put32(buf + 36, hdr->data_offset);
+    put32(buf + 40, hdr->margin);
+    put32(buf + 44, hdr->section_count);
+
+    for(i = 0, p = buf + KMG2_HDR_SIZE; i < (int)hdr->section_count;
+        i++, p += KMG2_SECTION_SIZE) {
+        p[0] = hdr->sections[i].type & 0xff;
+        p[1] = hdr->sections[i].type >> 8;
+        p[2] = hdr->sections[i].level & 0xff;
+        p[3] = hdr->sections[i].level >> 8;
+        put32(p + 4, hdr->sections[i].offset);
+        put32(p + 8, hdr->sections[i].size);
+    }
+
+    if(check(buf, hdr->data_offset + stored, data) < 0) {
+        fprintf(stderr, "FATAL: KMG doesn't decode back to its input\n");
+        goto out;
+    }
+
+    if(fwrite(buf, hdr->data_offset + stored, 1, fp) == 1)
+        rv = 0;
+
+out:
+    free(buf);
+    return rv;
+}
@@ -0,0 +1,179 @@
+/* KallistiOS ##version##
+
+   player.c
+   Copyright (C) 2026 KallistiOS Team
+*/
+
+#include <malloc.h>
+#include <string.h>
+#include <arch/cache.h>
+#include <kos/fs.h>
+#include <kos/dbglog.h>
+#include <dc/pvr.h>
+#include <vqv/player.h>
+
+/* Streams VQV chunks from a file and uploads them into two textures in
+   turns. The chunk buffer is reused for every frame, which is fine since the
+   indices are copied to texture memory before the next read. */
+
+struct vqv_player {
+    file_t fd;
+    vqv_state_t st;
+
+    uint8_t *chunk;
+    uint32_t next_frame;
+
+    /* two VQ textures, the codebook version each one holds, and which one
+       was written last (-1 before the first frame) */
+    pvr_ptr_t tex[2];
+    uint32_t tex_cb[2];
+    int cur;
+};
+
+vqv_player_t *vqv_player_open(const char *fn) {
+    vqv_player_t *p;
+    vqv_header_t hdr;
+    uint8_t *sector;
+    size_t tsize;
+
+    if(!(p = (vqv_player_t *)memalign(32, sizeof(vqv_player_t))))
+        return NULL;
+
+    memset(p, 0, sizeof(*p));
+    p->cur = -1;
+
+    if((p->fd = fs_open(fn, O_RDONLY)) == FILEHND_INVALID) {
+        free(p);
+        return NULL;
+    }
+
+    if(!(sector = (uint8_t *)malloc(VQV_SECTOR)))
+        goto fail;
+
+    if(fs_read(p->fd, sector, VQV_SECTOR) != VQV_SECTOR ||
+       vqv_parse_header(sector, VQV_SECTOR, &hdr) < 0) {
+        dbglog(DBG_ERROR, "vqv_player_open: %s is not a VQV file\n", fn);
+        free(sector);
+        goto fail;
+    }
+
+    free(sector);
+    vqv_init(&p->st, &hdr);
+
+    if(!(p->chunk = (uint8_t *)memalign(32, hdr.max_chunk)))
+        goto fail;
+
+    tsize = VQV_CODEBOOK_SIZE + hdr.width * hdr.height / 4;
+
+    if(!(p->tex[0] = pvr_mem_malloc(tsize)) ||
+       !(p->tex[1] = pvr_mem_malloc(tsize)))
+        goto fail;
+
+    return p;
+
+fail:
+    vqv_player_close(p);
+    return NULL;
+}
+
+void vqv_player_close(vqv_player_t *p) {
+    if(p->tex[0])
+        pvr_mem_free(p->tex[0]);
+
+    if(p->tex[1])
+        pvr_mem_free(p->tex[1]);
+
+    if(p->fd != FILEHND_INVALID)
+        fs_close(p->fd);
+
+    free(p->chunk);
+    free(p);
+}
+
+const vqv_header_t *vqv_player_header(vqv_player_t *p) {
+    return &p->st.hdr;
+}
+
+static int read_chunk(vqv_player_t *p) {
+    vqv_chunk_t chunk;
+
+    if(fs_read(p->fd, p->chunk, VQV_SECTOR) != VQV_SECTOR)
+        return -1;
+
+    if(vqv_parse_chunk(&p->st.hdr, p->chunk, &chunk) < 0)
+        return -1;
+
+    if(chunk.size > VQV_SECTOR &&
+       fs_read(p->fd, p->chunk + VQV_SECTOR, chunk.size - VQV_SECTOR) !=
+       (ssize_t)(chunk.size - VQV_SECTOR))
+        return -1;
+
+    return vqv_decode_chunk(&p->st, p->chunk, chunk.size);
+}
+
+static void upload(vqv_player_t *p, int t) {
+    uint8_t *dst = (uint8_t *)p->tex[t];
+
+    if(p->tex_cb[t] != p->st.cb_version) {
+        pvr_txr_load(p->st.codebook, dst, VQV_CODEBOOK_SIZE);
+        p->tex_cb[t] = p->st.cb_version;
+    }
+
+    /* DMA needs whole 32 byte blocks; only the tiniest frames miss out */
+    if(!(p->st.index_size & 31)) {
+        dcache_flush_range((uintptr_t)p->st.indices, p->st.index_size);
+
+        if(pvr_txr_load_dma((void *)p->st.indices, dst + VQV_CODEBOOK_SIZE,
+                            p->st.index_size, 1, NULL, NULL) == 0)
+            return;
+    }
+
+    pvr_txr_load((void *)p->st.indices, dst + VQV_CODEBOOK_SIZE,
+                 p->st.index_size);
+}
+
+int vqv_player_next(vqv_player_t *p) {
+    int t;
+
+    if(p->next_frame >= p->st.hdr.frame_count)
+        return -1;
+
+    if(read_chunk(p) < 0) {
+        dbglog(DBG_ERROR, "vqv_player_next: bad chunk for frame %lu\n",
+               (unsigned long)p->next_frame);
+        return -1;
+    }
+
+    t = p->cur < 0 ? 0 : !p->cur;
+    upload(p, t);
+    p->cur = t;
+    p->next_frame++;
+
+    return (int)p->st.frame;
+}
+
+int vqv_player_rewind(vqv_player_t *p) {
+    if(fs_seek(p->fd, VQV_SECTOR, SEEK_SET) != VQV_SECTOR)
+        return -1;
+
+    p->next_frame = 0;
+    p->st.have_key = 0;
+    return 0;
+}
+
+pvr_ptr_t vqv_player_texture(vqv_player_t *p) {
+    return p->cur < 0 ? NULL : p->tex[p->cur];
+}
+
+int vqv_player_txrfmt(vqv_player_t *p) {
+    int fmt = PVR_TXRFMT_VQ_ENABLE | PVR_TXRFMT_TWIDDLED;
+
+    switch(p->st.hdr.format) {
+        case VQV_FMT_ARGB4444:
+            return fmt | PVR_TXRFMT_ARGB4444;
+        case VQV_FMT_ARGB1555:
+            return fmt | PVR_TXRFMT_ARGB1555;
+        default:
+            return fmt | PVR_TXRFMT_RGB565;
+    }
+}
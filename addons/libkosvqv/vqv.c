@@ -0,0 +1,190 @@
+/* KallistiOS ##version##
+
+   vqv.c
+   Copyright (C) 2026 KallistiOS Team
+*/
+
+/* VQV container parsing and decoding. Nothing in here touches the hardware
+   or the VFS, so it builds for the host too (see Makefile.nonkos). */
+
+#include <string.h>
+#include <vqv/vqv.h>
+
+static uint16_t get16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = v >> 24;
+}
+
+static int valid_size(uint32_t x) {
+    return x >= 8 && x <= 1024 && !(x & (x - 1));
+}
+
+int vqv_parse_header(const uint8_t *buf, size_t size, vqv_header_t *hdr) {
+    if(size < 40)
+        return -1;
+
+    hdr->magic = get32(buf + 0);
+    hdr->version = get32(buf + 4);
+    hdr->format = get32(buf + 8);
+    hdr->width = get32(buf + 12);
+    hdr->height = get32(buf + 16);
+    hdr->frame_count = get32(buf + 20);
+    hdr->fps_num = get32(buf + 24);
+    hdr->fps_den = get32(buf + 28);
+    hdr->max_chunk = get32(buf + 32);
+    hdr->key_interval = get32(buf + 36);
+
+    if(hdr->magic != VQV_MAGIC || hdr->version != VQV_VERSION)
+        return -1;
+
+    if(hdr->format < VQV_FMT_RGB565 || hdr->format > VQV_FMT_ARGB1555)
+        return -1;
+
+    /* VQ frames are twiddled, so they have to be square */
+    if(!valid_size(hdr->width) || hdr->height != hdr->width)
+        return -1;
+
+    if(!hdr->fps_num || !hdr->fps_den)
+        return -1;
+
+    if(hdr->max_chunk % VQV_SECTOR || hdr->max_chunk < VQV_SECTOR)
+        return -1;
+
+    return 0;
+}
+
+void vqv_write_header(const vqv_header_t *hdr, uint8_t *buf) {
+    memset(buf, 0, VQV_SECTOR);
+    put32(buf + 0, VQV_MAGIC);
+    put32(buf + 4, VQV_VERSION);
+    put32(buf + 8, hdr->format);
+    put32(buf + 12, hdr->width);
+    put32(buf + 16, hdr->height);
+    put32(buf + 20, hdr->frame_count);
+    put32(buf + 24, hdr->fps_num);
+    put32(buf + 28, hdr->fps_den);
+    put32(buf + 32, hdr->max_chunk);
+    put32(buf + 36, hdr->key_interval);
+}
+
+int vqv_parse_chunk(const vqv_header_t *hdr, const uint8_t *buf,
+                    vqv_chunk_t *chunk) {
+    uint32_t payload;
+
+    chunk->magic = get32(buf + 0);
+    chunk->size = get32(buf + 4);
+    chunk->frame = get32(buf + 8);
+    chunk->flags = get16(buf + 12);
+    chunk->updates = get16(buf + 14);
+    chunk->index_offset = get32(buf + 16);
+    chunk->index_size = get32(buf + 20);
+
+    if(chunk->magic != VQV_CHUNK_MAGIC)
+        return -1;
+
+    if(chunk->size % VQV_SECTOR || chunk->size > hdr->max_chunk)
+        return -1;
+
+    if(chunk->flags & VQV_CHUNK_KEY) {
+        if(chunk->updates != VQV_CODES)
+            return -1;
+
+        payload = VQV_CODEBOOK_SIZE;
+    }
+    else {
+        if(chunk->updates > VQV_CODES)
+            return -1;
+
+        payload = chunk->updates * VQV_UPDATE_SIZE;
+    }
+
+    if(chunk->index_offset % 32 ||
+       chunk->index_offset < VQV_CHUNK_HDR_SIZE + payload)
+        return -1;
+
+    if(chunk->index_size != hdr->width * hdr->height / 4 ||
+       chunk->index_offset > chunk->size ||
+       chunk->index_size > chunk->size - chunk->index_offset)
+        return -1;
+
+    return 0;
+}
+
+void vqv_write_chunk(const vqv_chunk_t *chunk, uint8_t *buf) {
+    memset(buf, 0, VQV_CHUNK_HDR_SIZE);
+    put32(buf + 0, VQV_CHUNK_MAGIC);
+    put32(buf + 4, chunk->size);
+    put32(buf + 8, chunk->frame);
+    put16(buf + 12, chunk->flags);
+    put16(buf + 14, chunk->updates);
+    put32(buf + 16, chunk->index_offset);
+    put32(buf + 20, chunk->index_size);
+}
+
+void vqv_init(vqv_state_t *st, const vqv_header_t *hdr) {
+    memset(st, 0, sizeof(*st));
+    st->hdr = *hdr;
+}
+
+int vqv_decode_chunk(vqv_state_t *st, const uint8_t *buf, size_t size) {
+    vqv_chunk_t chunk;
+    const uint8_t *p;
+    uint16_t entry;
+    int i, j;
+
+    if(size < VQV_CHUNK_HDR_SIZE || vqv_parse_chunk(&st->hdr, buf, &chunk) < 0)
+        return -1;
+
+    if(size < chunk.size)
+        return -1;
+
+    p = buf + VQV_CHUNK_HDR_SIZE;
+
+    if(chunk.flags & VQV_CHUNK_KEY) {
+        for(i = 0; i < VQV_CODES * 4; i++)
+            st->codebook[i] = get16(p + i * 2);
+
+        st->have_key = 1;
+        st->cb_version++;
+    }
+    else {
+        if(!st->have_key)
+            return -1;
+
+        /* check everything first so a bad chunk leaves the codebook alone */
+        for(i = 0; i < chunk.updates; i++) {
+            if(get16(p + i * VQV_UPDATE_SIZE) >= VQV_CODES)
+                return -1;
+        }
+
+        for(i = 0; i < chunk.updates; i++, p += VQV_UPDATE_SIZE) {
+            entry = get16(p);
+
+            for(j = 0; j < 4; j++)
+                st->codebook[entry * 4 + j] = get16(p + 2 + j * 2);
+        }
+
+        if(chunk.updates)
+            st->cb_version++;
+    }
+
+    st->frame = chunk.frame;
+    st->indices = buf + chunk.index_offset;
+    st->index_size = chunk.index_size;
+    return 0;
+}
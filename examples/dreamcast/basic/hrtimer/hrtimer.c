@@ -0,0 +1,162 @@
+/* KallistiOS ##version##
+
+   hrtimer.c
+   Copyright (C) 2026 KallistiOS Team
+
+*/
+
+/* This program shows how close to on time high-resolution timers go off.
+   It runs, one after another:
+
+   - a periodic timer every 1ms, called in the timer interrupt;
+   - a periodic timer every 10ms, called from the deferred timer thread,
+     while another thread keeps the CPU busy;
+   - a run of one-shot timers with odd delays, each started from the last
+     one's function;
+   - thd_sleep(1) for comparison.
+
+   For each it prints how late, in microseconds, the calls were on average
+   and at worst. */
+
+#include <stdio.h>
+#include <string.h>
+#include <kos/hrtimer.h>
+#include <kos/thread.h>
+#include <kos/sem.h>
+#include <arch/timer.h>
+
+#define ROUNDS      200
+
+typedef struct {
+    uint64_t due;
+    uint32_t period;
+    uint64_t total, worst;
+    int count;
+    semaphore_t done;
+} stats_t;
+
+static volatile int busy_stop;
+
+static void record(stats_t *st, uint64_t now) {
+    uint64_t late = now > st->due ? now - st->due : 0;
+
+    st->total += late;
+
+    if(late > st->worst)
+        st->worst = late;
+
+    ++st->count;
+}
+
+static void print_stats(const char *name, stats_t *st) {
+    printf("%-28s  %8lu  %8lu\n", name,
+           (unsigned long)(st->total / st->count),
+           (unsigned long)st->worst);
+}
+
+/* Periodic timers: each call should be a period after the last was due */
+static void periodic(hrtimer_t *timer) {
+    stats_t *st = (stats_t *)timer->data;
+
+    record(st, timer_us_gettime64());
+    st->due += st->period;
+
+    if(st->count == ROUNDS) {
+        hrtimer_cancel(timer);
+        sem_signal(&st->done);
+    }
+}
+
+/* One-shot timers: start the next one with a different delay each time */
+static void oneshot(hrtimer_t *timer) {
+    stats_t *st = (stats_t *)timer->data;
+    uint64_t now = timer_us_gettime64();
+    uint32_t delay = 137 + (st->count * 211) % 3000;
+
+    record(st, now);
+
+    if(st->count == ROUNDS) {
+        sem_signal(&st->done);
+        return;
+    }
+
+    st->due = now + delay;
+    hrtimer_start_abs(timer, st->due, 0);
+}
+
+static void *busy_thd(void *param) {
+    (void)param;
+
+    while(!busy_stop)
+        ;
+
+    return NULL;
+}
+
+static void run_periodic(const char *name, int flags, uint32_t period) {
+    stats_t st = { 0 };
+    hrtimer_t timer;
+    kthread_t *busy = NULL;
+
+    sem_init(&st.done, 0);
+
+    if(hrtimer_init(&timer, periodic, &st, flags) < 0) {
+        printf("hrtimer_init failed\n");
+        return;
+    }
+
+    if(flags == HRTIMER_DEFERRED) {
+        busy_stop = 0;
+        busy = thd_create(0, busy_thd, NULL);
+    }
+
+    st.period = period;
+    st.due = timer_us_gettime64() + period;
+    hrtimer_start_abs(&timer, st.due, period);
+    sem_wait(&st.done);
+
+    if(busy) {
+        busy_stop = 1;
+        thd_join(busy, NULL);
+    }
+
+    print_stats(name, &st);
+    sem_destroy(&st.done);
+}
+
+int main(int argc, char **argv) {
+    stats_t st = { 0 };
+    hrtimer_t timer;
+    uint64_t start;
+    int i;
+
+    (void)argc;
+    (void)argv;
+
+    printf("High-resolution timer test\n\n");
+    printf("%-28s  %8s  %8s\n", "", "avg late", "max late");
+
+    run_periodic("periodic 1ms, irq", HRTIMER_IRQ, 1000);
+    run_periodic("periodic 10ms, deferred", HRTIMER_DEFERRED, 10000);
+
+    sem_init(&st.done, 0);
+    hrtimer_init(&timer, oneshot, &st, HRTIMER_IRQ);
+    st.due = timer_us_gettime64() + 500;
+    hrtimer_start_abs(&timer, st.due, 0);
+    sem_wait(&st.done);
+    print_stats("one-shot, irq", &st);
+    sem_destroy(&st.done);
+
+    memset(&st, 0, sizeof(st));
+
+    for(i = 0; i < ROUNDS; i++) {
+        start = timer_us_gettime64();
+        st.due = start + 1000;
+        thd_sleep(1);
+        record(&st, timer_us_gettime64());
+    }
+
+    print_stats("thd_sleep(1)", &st);
+
+    return 0;
+}
@@ -0,0 +1,144 @@
+/* KallistiOS ##version##
+
+   condbench.c
+   Copyright (C) 2026 KallistiOS Team
+
+*/
+
+/* This program counts the context switches it takes to get a message from a
+   producer to a set of consumers through a condition variable. The producer
+   queues messages with the mutex held, wakes the consumers with cond_signal()
+   (one message) or cond_broadcast() (one message per consumer), and then
+   passes the CPU on before unlocking, as it would if it were pre-empted in
+   the middle of a longer critical section.
+
+   Without wait morphing, each consumer woken while the producer still holds
+   the mutex runs only to block again on the mutex, then has to be woken a
+   second time. With it, woken consumers are moved straight onto the mutex
+   and only run once they hold it. Run this on kernels with and without it
+   to compare the switches per message. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <kos/thread.h>
+#include <kos/mutex.h>
+#include <kos/cond.h>
+#include <arch/timer.h>
+
+#define MESSAGES    2000
+
+static const int counts[] = { 1, 4, 16 };
+#define NUM_COUNTS (sizeof(counts) / sizeof(counts[0]))
+
+static mutex_t lock = MUTEX_INITIALIZER;
+static condvar_t ready = COND_INITIALIZER;
+static condvar_t drained = COND_INITIALIZER;
+static int queued, stop;
+
+static void *consumer(void *param) {
+    (void)param;
+
+    mutex_lock(&lock);
+
+    for(;;) {
+        while(!queued && !stop)
+            cond_wait(&ready, &lock);
+
+        if(!queued)
+            break;
+
+        if(!--queued)
+            cond_signal(&drained);
+    }
+
+    mutex_unlock(&lock);
+    return NULL;
+}
+
+static uint32_t switches(kthread_t **thds, int count) {
+    kthread_acct_t acct;
+    uint32_t total;
+    int i;
+
+    thd_get_acct(thd_current, &acct);
+    total = acct.vol_switches + acct.invol_switches;
+
+    for(i = 0; i < count; i++) {
+        thd_get_acct(thds[i], &acct);
+        total += acct.vol_switches + acct.invol_switches;
+    }
+
+    return total;
+}
+
+static void bench(int count, int broadcast) {
+    kthread_t **thds = malloc(count * sizeof(kthread_t *));
+    int batch = broadcast ? count : 1;
+    uint32_t before, after;
+    uint64_t start, end;
+    int i, sent;
+
+    queued = stop = 0;
+
+    for(i = 0; i < count; i++)
+        thds[i] = thd_create(0, consumer, NULL);
+
+    /* Let them all get to their waits */
+    thd_sleep(10);
+
+    before = switches(thds, count);
+    start = timer_ns_gettime64();
+
+    for(sent = 0; sent < MESSAGES; sent += batch) {
+        mutex_lock(&lock);
+        queued += batch;
+
+        if(broadcast)
+            cond_broadcast(&ready);
+        else
+            cond_signal(&ready);
+
+        thd_pass();
+
+        while(queued)
+            cond_wait(&drained, &lock);
+
+        mutex_unlock(&lock);
+    }
+
+    end = timer_ns_gettime64();
+    after = switches(thds, count);
+
+    mutex_lock(&lock);
+    stop = 1;
+    cond_broadcast(&ready);
+    mutex_unlock(&lock);
+
+    for(i = 0; i < count; i++)
+        thd_join(thds[i], NULL);
+
+    free(thds);
+
+    printf("%9s  %9d  %15.2f  %13.0f\n", broadcast ? "broadcast" : "signal",
+           count, (double)(after - before) / sent,
+           (double)(end - start) / sent);
+}
+
+int main(int argc, char **argv) {
+    unsigned int i;
+
+    (void)argc;
+    (void)argv;
+
+    printf("Condition variable benchmark\n");
+    printf("%9s  %9s  %15s  %13s\n", "mode", "consumers", "switches/msg",
+           "ns/msg");
+
+    for(i = 0; i < NUM_COUNTS; i++) {
+        bench(counts[i], 0);
+        bench(counts[i], 1);
+    }
+
+    printf("Done.\n");
+    return 0;
+}
@@ -0,0 +1,134 @@
+/* KallistiOS ##version##
+
+   edf.c
+   Copyright (C) 2026 KallistiOS Team
+
+*/
+
+/* This program runs two deadline threads standing in for an audio refill
+   every 10ms and a video decode every 16.6ms, alongside a busy thread at
+   a high priority. The deadline threads should make every deadline in
+   spite of it. Every so often the video thread takes longer than
+   its budget, so it's throttled until its next period and shows up with
+   overruns and misses, while the audio thread carries on unaffected. */
+
+#include <stdio.h>
+#include <errno.h>
+#include <kos/thread.h>
+#include <arch/timer.h>
+
+#define RUN_TIME    3000
+
+static volatile int done;
+static volatile int overrun_count;
+static int audio_jobs, video_jobs;
+static kthread_edf_t audio_edf, video_edf;
+
+/* Burn CPU time for us microseconds */
+static void work(unsigned int us) {
+    uint64_t end = timer_us_gettime64() + us;
+
+    while(timer_us_gettime64() < end)
+        ;
+}
+
+static void overrun(kthread_t *thd) {
+    (void)thd;
+    ++overrun_count;
+}
+
+static void *audio_thd(void *param) {
+    (void)param;
+
+    /* Every 10ms, 2ms of work, done by the end of the period */
+    if(thd_set_edf(thd_get_current(), 10000, 2000, 0) < 0) {
+        printf("audio: thd_set_edf failed, errno %d\n", errno);
+        return NULL;
+    }
+
+    while(!done) {
+        work(1500);
+        ++audio_jobs;
+        thd_edf_wait();
+    }
+
+    audio_edf = thd_get_current()->edf;
+
+    return NULL;
+}
+
+static void *video_thd(void *param) {
+    (void)param;
+
+    /* Every 16.6ms, 6ms of work, done within 12ms */
+    if(thd_set_edf(thd_get_current(), 16600, 6000, 12000) < 0) {
+        printf("video: thd_set_edf failed, errno %d\n", errno);
+        return NULL;
+    }
+
+    while(!done) {
+        /* Every tenth frame is a hard one */
+        work(video_jobs % 10 == 9 ? 9000 : 4000);
+        ++video_jobs;
+        thd_edf_wait();
+    }
+
+    video_edf = thd_get_current()->edf;
+
+    return NULL;
+}
+
+static void *busy_thd(void *param) {
+    (void)param;
+
+    while(!done)
+        ;
+
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    kthread_attr_t attr = { 0, 0, NULL, 2, NULL };
+    kthread_t *audio, *video, *busy;
+
+    (void)argc;
+    (void)argv;
+
+    printf("Deadline scheduling test\n");
+
+    /* Stay above the busy thread, so we can stop it */
+    thd_set_prio(thd_get_current(), 1);
+    thd_edf_set_overrun_handler(overrun);
+
+    attr.label = "audio";
+    audio = thd_create_ex(&attr, audio_thd, NULL);
+    attr.label = "video";
+    video = thd_create_ex(&attr, video_thd, NULL);
+    attr.label = "busy";
+    busy = thd_create_ex(&attr, busy_thd, NULL);
+
+    thd_sleep(100);
+
+    /* Asking for more than the CPU has left should be turned down */
+    if(thd_set_edf(busy, 10000, 5000, 0) == 0 || errno != EBUSY)
+        printf("admission control didn't refuse too much work\n");
+    else
+        printf("admission control refused too much work, as it should\n");
+
+    thd_sleep(RUN_TIME);
+    done = 1;
+
+    thd_join(busy, NULL);
+    thd_join(audio, NULL);
+    thd_join(video, NULL);
+
+    printf("audio: %d jobs, %lu overruns, %lu misses\n", audio_jobs,
+           (unsigned long)audio_edf.overruns,
+           (unsigned long)audio_edf.misses);
+    printf("video: %d jobs, %lu overruns, %lu misses\n", video_jobs,
+           (unsigned long)video_edf.overruns,
+           (unsigned long)video_edf.misses);
+    printf("overrun handler called %d times\n", overrun_count);
+
+    return 0;
+}
@@ -0,0 +1,232 @@
+/* KallistiOS ##version##
+
+   fiberbench.c
+   Copyright (C) 2026 KallistiOS Team
+
+*/
+
+/* This program compares switching between fibers with switching between
+   threads. It times:
+
+   - fiber ping-pong: the main thread switching to a fiber that yields
+     straight back, so each round is two fiber switches;
+   - thread ping-pong: two threads taking turns through a pair of
+     semaphores, which is two trips through the thread scheduler a round;
+   - scheduler: lots of fibers in one fiber scheduler, each yielding a
+     number of times before finishing, including creating and freeing
+     them all.
+
+   It also checks that a thread can be preempted while it's running a fiber,
+   whose stack is somewhere else entirely, without tripping the scheduler's
+   stack underrun check. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <kos/thread.h>
+#include <kos/fiber.h>
+#include <kos/sem.h>
+#include <arch/timer.h>
+
+#define ROUNDS      10000
+#define FIBERS      1000
+#define YIELDS      10
+#define HOST_STACK  16384
+
+static semaphore_t ping, pong;
+static int total;
+static volatile int other_ran;
+
+static void *pingpong_fiber(void *param) {
+    (void)param;
+
+    for(;;)
+        fiber_yield();
+
+    return NULL;
+}
+
+static void *pingpong_thd(void *param) {
+    int i;
+
+    (void)param;
+
+    for(i = 0; i < ROUNDS; i++) {
+        sem_wait(&ping);
+        sem_signal(&pong);
+    }
+
+    return NULL;
+}
+
+static void *counter_fiber(void *param) {
+    int i;
+
+    (void)param;
+
+    for(i = 0; i < YIELDS; i++) {
+        ++total;
+        fiber_yield();
+    }
+
+    return NULL;
+}
+
+/* Let the other thread go, then spin until it has had a turn. It has the
+   same priority, so it only gets one by the scheduler preempting this
+   thread, with the fiber's stack in use. */
+static void *spin_fiber(void *param) {
+    (void)param;
+
+    sem_signal(&ping);
+
+    while(!other_ran)
+        ;
+
+    return NULL;
+}
+
+static void *host_thd(void *param) {
+    fiber_switch((fiber_t *)param);
+    return NULL;
+}
+
+static void *other_thd(void *param) {
+    (void)param;
+
+    sem_wait(&ping);
+    other_ran = 1;
+
+    return NULL;
+}
+
+static int test_preempt(void) {
+    kthread_attr_t attr = { 0 };
+    kthread_t *host, *other;
+    fiber_t *fiber;
+    void *stack;
+    int below;
+
+    /* The host thread's stack is allocated after the fiber's, so it's most
+       likely further up the heap, with the fiber's stack below it. */
+    fiber = fiber_create(0, spin_fiber, NULL, 0);
+    stack = malloc(HOST_STACK);
+
+    if(!fiber || !stack) {
+        printf("preempt: out of memory\n");
+
+        if(fiber)
+            fiber_destroy(fiber);
+
+        free(stack);
+        return 0;
+    }
+
+    below = (uintptr_t)fiber < (uintptr_t)stack;
+    other_ran = 0;
+    sem_init(&ping, 0);
+
+    attr.stack_ptr = stack;
+    attr.stack_size = HOST_STACK;
+    attr.prio = PRIO_DEFAULT;
+    attr.label = "fiber host";
+    host = thd_create_ex(&attr, host_thd, fiber);
+    other = thd_create(0, other_thd, NULL);
+
+    thd_join(host, NULL);
+    thd_join(other, NULL);
+
+    printf("preempt: fiber stack %s the thread's, %s\n",
+           below ? "below" : "above", other_ran ? "ok" : "other thread starved");
+
+    sem_destroy(&ping);
+    fiber_destroy(fiber);
+    free(stack);
+
+    return other_ran;
+}
+
+static double bench_fiber(void) {
+    fiber_t *fiber;
+    uint64_t start, end;
+    int i;
+
+    fiber = fiber_create(0, pingpong_fiber, NULL, 0);
+    start = timer_ns_gettime64();
+
+    for(i = 0; i < ROUNDS; i++)
+        fiber_switch(fiber);
+
+    end = timer_ns_gettime64();
+    fiber_destroy(fiber);
+
+    return (double)(end - start) / (ROUNDS * 2);
+}
+
+static double bench_thread(void) {
+    kthread_t *thd;
+    uint64_t start, end;
+    int i;
+
+    sem_init(&ping, 0);
+    sem_init(&pong, 0);
+    thd = thd_create(0, pingpong_thd, NULL);
+
+    start = timer_ns_gettime64();
+
+    for(i = 0; i < ROUNDS; i++) {
+        sem_signal(&ping);
+        sem_wait(&pong);
+    }
+
+    end = timer_ns_gettime64();
+
+    thd_join(thd, NULL);
+    sem_destroy(&ping);
+    sem_destroy(&pong);
+
+    return (double)(end - start) / (ROUNDS * 2);
+}
+
+static double bench_sched(void) {
+    fiber_sched_t sched;
+    uint64_t start, end;
+    int i;
+
+    total = 0;
+    fiber_sched_init(&sched);
+
+    start = timer_ns_gettime64();
+
+    for(i = 0; i < FIBERS; i++)
+        fiber_sched_add(&sched, fiber_create(1, counter_fiber, NULL, 1024));
+
+    fiber_sched_run(&sched);
+
+    end = timer_ns_gettime64();
+
+    if(total != FIBERS * YIELDS)
+        printf("scheduler: expected %d yields, got %d\n", FIBERS * YIELDS,
+               total);
+
+    return (double)(end - start) / (FIBERS * (YIELDS + 1));
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+
+    printf("Fiber benchmark\n");
+    printf("fiber switch:  %8.0f ns\n", bench_fiber());
+    printf("thread switch: %8.0f ns\n", bench_thread());
+    printf("scheduler, %d fibers: %8.0f ns per switch\n", FIBERS,
+           bench_sched());
+
+    if(!test_preempt()) {
+        printf("FAIL: preempt\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("Done.\n");
+    return 0;
+}
@@ -0,0 +1,328 @@
+/* KallistiOS ##version##
+
+   pi_test.c
+   Copyright (C) 2026 KallistiOS Team
+
+*/
+
+/* This program tests priority inheritance in the mutexes. Each test sets up
+   the classic priority inversion: a low priority thread holds a lock that a
+   high priority thread needs, while a medium priority thread hogs the CPU.
+   Without priority inheritance the low priority thread never gets to run to
+   release the lock, so the high priority thread waits as long as the hog
+   runs. With it, the lock holder runs at the waiter's priority and the wait
+   is only as long as the holder needs the lock for.
+
+   The tests are:
+   - inversion: the basic case above;
+   - chain: the holder is itself waiting on a second mutex held by the low
+     priority thread, which must be boosted through it;
+   - timeout: a high priority thread gives up waiting, and the holder must
+     drop back to its own priority;
+   - set_prio: the holder's priority is changed while it's boosted, which
+     must only take effect once it lets go;
+   - exit: the holder exits without unlocking, and the waiter must be told
+     so (EOWNERDEAD) rather than handed the lock or left waiting. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include <kos/thread.h>
+#include <kos/mutex.h>
+#include <kos/sem.h>
+
+#include <arch/arch.h>
+#include <arch/timer.h>
+
+#define PRIO_LOW    20
+#define PRIO_MED    15
+#define PRIO_HIGH   5
+
+/* How much CPU time the low priority thread needs while it holds the lock,
+   and how long the hog runs for. */
+#define WORK_MS     50
+#define HOG_MS      500
+
+static mutex_t lock_a = MUTEX_INITIALIZER;
+static mutex_t lock_b = MUTEX_INITIALIZER;
+static semaphore_t ready;
+static kthread_t *low_thd;
+
+static volatile int hog_stop;
+static prio_t low_best_prio;
+static uint64_t high_wait;
+static int high_rv, high_errno;
+
+static kthread_t *spawn(prio_t prio, void *(*routine)(void *), void *param) {
+    kthread_attr_t attr = { 0 };
+
+    attr.prio = prio;
+    return thd_create_ex(&attr, routine, param);
+}
+
+/* Burn CPU time, noting the best priority we get to run at */
+static void work(int ms) {
+    kthread_acct_t acct;
+    uint64_t end;
+
+    thd_get_acct(thd_current, &acct);
+    end = acct.cpu_time + ms * 1000000ULL;
+
+    do {
+        if(thd_current->prio < low_best_prio)
+            low_best_prio = thd_current->prio;
+
+        thd_get_acct(thd_current, &acct);
+    } while(acct.cpu_time < end);
+}
+
+static void *hog(void *param) {
+    uint64_t end = timer_ms_gettime64() + HOG_MS;
+
+    (void)param;
+
+    while(!hog_stop && timer_ms_gettime64() < end)
+        ;
+
+    return NULL;
+}
+
+/* Low priority: take lock A, let main know and do some work with it */
+static void *low(void *param) {
+    int timed = (int)(intptr_t)param;
+
+    mutex_lock(&lock_a);
+    sem_signal(&ready);
+
+    if(timed) {
+        /* Hold on until the high priority thread has given up */
+        thd_sleep(100);
+    }
+    else {
+        work(WORK_MS);
+    }
+
+    mutex_unlock(&lock_a);
+    return NULL;
+}
+
+/* Low priority, for the exit test: take lock A and exit holding it */
+static void *low_exit(void *param) {
+    (void)param;
+
+    mutex_lock(&lock_a);
+    sem_signal(&ready);
+    thd_sleep(50);
+
+    return NULL;
+}
+
+/* Medium priority, for the chain test: take lock B, then wait for A */
+static void *middle(void *param) {
+    (void)param;
+
+    mutex_lock(&lock_b);
+    sem_signal(&ready);
+    mutex_lock(&lock_a);
+    mutex_unlock(&lock_a);
+    mutex_unlock(&lock_b);
+
+    return NULL;
+}
+
+/* High priority: wait for the given lock and time how long it takes */
+static void *high(void *param) {
+    mutex_t *m = (mutex_t *)param;
+    uint64_t start;
+
+    thd_sleep(10);
+
+    start = timer_ms_gettime64();
+    high_rv = mutex_lock_timed(m, 2000);
+    high_errno = high_rv ? errno : 0;
+    high_wait = timer_ms_gettime64() - start;
+
+    if(!high_rv)
+        mutex_unlock(m);
+
+    return NULL;
+}
+
+/* High priority, giving up after a short while */
+static void *high_timeout(void *param) {
+    (void)param;
+
+    thd_sleep(10);
+    high_rv = mutex_lock_timed(&lock_a, 20);
+
+    /* Now we've gone, the holder should be back to its own priority */
+    if(low_thd->prio != PRIO_LOW) {
+        printf("holder still at priority %d after timeout\n", low_thd->prio);
+        high_rv = 0;
+    }
+
+    return NULL;
+}
+
+static void reset(void) {
+    hog_stop = 0;
+    low_best_prio = PRIO_MAX;
+    high_wait = 0;
+    high_rv = -1;
+    high_errno = 0;
+}
+
+static int test_inversion(void) {
+    kthread_t *h, *m;
+
+    reset();
+    low_thd = spawn(PRIO_LOW, low, (void *)0);
+    sem_wait(&ready);
+
+    m = spawn(PRIO_MED, hog, NULL);
+    h = spawn(PRIO_HIGH, high, &lock_a);
+
+    thd_join(h, NULL);
+    hog_stop = 1;
+    thd_join(m, NULL);
+    thd_join(low_thd, NULL);
+
+    printf("inversion: waited %lu ms, holder ran at %d\n",
+           (uint32_t)high_wait, low_best_prio);
+
+    return !high_rv && high_wait < HOG_MS / 2 && low_best_prio == PRIO_HIGH;
+}
+
+static int test_chain(void) {
+    kthread_t *h, *m, *mid;
+
+    reset();
+    low_thd = spawn(PRIO_LOW, low, (void *)0);
+    sem_wait(&ready);
+    mid = spawn(PRIO_MED - 1, middle, NULL);
+    sem_wait(&ready);
+
+    m = spawn(PRIO_MED, hog, NULL);
+    h = spawn(PRIO_HIGH, high, &lock_b);
+
+    thd_join(h, NULL);
+    hog_stop = 1;
+    thd_join(m, NULL);
+    thd_join(mid, NULL);
+    thd_join(low_thd, NULL);
+
+    printf("chain: waited %lu ms, holder ran at %d\n",
+           (uint32_t)high_wait, low_best_prio);
+
+    return !high_rv && high_wait < HOG_MS / 2 && low_best_prio == PRIO_HIGH;
+}
+
+static int test_timeout(void) {
+    kthread_t *h;
+
+    reset();
+    low_thd = spawn(PRIO_LOW, low, (void *)1);
+    sem_wait(&ready);
+
+    h = spawn(PRIO_HIGH, high_timeout, NULL);
+    thd_join(h, NULL);
+    thd_join(low_thd, NULL);
+
+    printf("timeout: lock %s\n", high_rv ? "timed out" : "not timed out");
+
+    return high_rv == -1;
+}
+
+static int test_set_prio(void) {
+    kthread_t *h;
+    int ok;
+
+    reset();
+    low_thd = spawn(PRIO_LOW, low, (void *)1);
+    sem_wait(&ready);
+
+    h = spawn(PRIO_HIGH, high, &lock_a);
+
+    /* Wait for it to block on the lock, then lower the holder */
+    thd_sleep(30);
+    thd_set_prio(low_thd, PRIO_LOW + 5);
+    ok = low_thd->prio == PRIO_HIGH;
+
+    printf("set_prio: holder at %d while boosted", low_thd->prio);
+
+    thd_join(h, NULL);
+    printf(", %d after\n", low_thd->prio);
+    ok = ok && low_thd->prio == PRIO_LOW + 5 && !high_rv;
+
+    thd_join(low_thd, NULL);
+
+    return ok;
+}
+
+static int test_exit(void) {
+    kthread_t *h;
+
+    reset();
+    low_thd = spawn(PRIO_LOW, low_exit, NULL);
+    sem_wait(&ready);
+
+    /* It should hear that the holder died as soon as it exits, before it's
+       joined, and not be given the lock */
+    h = spawn(PRIO_HIGH, high, &lock_a);
+    thd_join(h, NULL);
+
+    printf("exit: lock %s after %lu ms\n", high_errno == EOWNERDEAD ?
+           "owner dead" : high_rv ? "failed" : "handed on",
+           (uint32_t)high_wait);
+
+    thd_join(low_thd, NULL);
+
+    return high_rv == -1 && high_errno == EOWNERDEAD && high_wait < 1000 &&
+           !mutex_is_locked(&lock_a);
+}
+
+int main(int argc, char **argv) {
+    int failed = 0;
+
+    (void)argc;
+    (void)argv;
+
+    printf("KallistiOS priority inheritance test\n");
+    sem_init(&ready, 0);
+
+    if(!test_inversion()) {
+        printf("FAIL: inversion\n");
+        ++failed;
+    }
+
+    if(!test_chain()) {
+        printf("FAIL: chain\n");
+        ++failed;
+    }
+
+    if(!test_timeout()) {
+        printf("FAIL: timeout\n");
+        ++failed;
+    }
+
+    if(!test_set_prio()) {
+        printf("FAIL: set_prio\n");
+        ++failed;
+    }
+
+    if(!test_exit()) {
+        printf("FAIL: exit\n");
+        ++failed;
+    }
+
+    sem_destroy(&ready);
+
+    if(failed) {
+        printf("%d test(s) failed\n", failed);
+        return EXIT_FAILURE;
+    }
+
+    printf("Priority inheritance tests completed successfully!\n");
+    return 0;
+}
@@ -0,0 +1,157 @@
+/* KallistiOS ##version##
+
+   schedbench.c
+   Copyright (C) 2026 KallistiOS Team
+
+*/
+
+/* This program measures how the scheduler holds up as the number of threads
+   grows. For each thread count it times:
+
+   - yield: that many threads of the same priority passing the CPU round
+     between them with thd_pass(), giving the cost of one context switch;
+   - wakeup: a high priority thread blocked on a semaphore being signalled
+     from the main thread, with that many lower priority threads ready to
+     run, giving the time from sem_signal() to the woken thread running.
+
+   With a scheduler that walks the run queue both of these grow with the
+   thread count; they should stay flat. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <kos/thread.h>
+#include <kos/sem.h>
+#include <arch/timer.h>
+
+#define YIELDS      2000
+#define WAKEUPS     2000
+
+static const int counts[] = { 2, 8, 16, 32, 64, 128 };
+#define NUM_COUNTS (sizeof(counts) / sizeof(counts[0]))
+
+static semaphore_t start_sem, wake_sem, done_sem;
+static volatile int stop_filler;
+static volatile uint64_t signal_time;
+static uint64_t wake_total;
+
+static void *yield_thd(void *param) {
+    int i;
+
+    (void)param;
+    sem_wait(&start_sem);
+
+    for(i = 0; i < YIELDS; i++)
+        thd_pass();
+
+    return NULL;
+}
+
+static void *filler_thd(void *param) {
+    (void)param;
+
+    while(!stop_filler)
+        thd_pass();
+
+    return NULL;
+}
+
+static void *waiter_thd(void *param) {
+    int i;
+
+    (void)param;
+
+    for(i = 0; i < WAKEUPS; i++) {
+        sem_wait(&wake_sem);
+        wake_total += timer_ns_gettime64() - signal_time;
+        sem_signal(&done_sem);
+    }
+
+    return NULL;
+}
+
+static double bench_yield(int count) {
+    kthread_attr_t attr = { 0 };
+    kthread_t **thds = malloc(count * sizeof(kthread_t *));
+    uint64_t start, end;
+    int i;
+
+    /* Run below the main thread, so they all start together */
+    attr.prio = PRIO_DEFAULT + 1;
+    sem_init(&start_sem, 0);
+
+    for(i = 0; i < count; i++)
+        thds[i] = thd_create_ex(&attr, yield_thd, NULL);
+
+    for(i = 0; i < count; i++)
+        sem_signal(&start_sem);
+
+    start = timer_ns_gettime64();
+
+    for(i = 0; i < count; i++)
+        thd_join(thds[i], NULL);
+
+    end = timer_ns_gettime64();
+
+    sem_destroy(&start_sem);
+    free(thds);
+
+    return (double)(end - start) / ((double)count * YIELDS);
+}
+
+static double bench_wakeup(int count) {
+    kthread_attr_t attr = { 0 };
+    kthread_t **thds = malloc(count * sizeof(kthread_t *));
+    kthread_t *waiter;
+    int i;
+
+    sem_init(&wake_sem, 0);
+    sem_init(&done_sem, 0);
+    stop_filler = 0;
+    wake_total = 0;
+
+    attr.prio = PRIO_DEFAULT + 1;
+
+    for(i = 0; i < count; i++)
+        thds[i] = thd_create_ex(&attr, filler_thd, NULL);
+
+    attr.prio = PRIO_DEFAULT - 1;
+    waiter = thd_create_ex(&attr, waiter_thd, NULL);
+
+    for(i = 0; i < WAKEUPS; i++) {
+        signal_time = timer_ns_gettime64();
+        sem_signal(&wake_sem);
+        sem_wait(&done_sem);
+    }
+
+    thd_join(waiter, NULL);
+    stop_filler = 1;
+
+    for(i = 0; i < count; i++)
+        thd_join(thds[i], NULL);
+
+    sem_destroy(&wake_sem);
+    sem_destroy(&done_sem);
+    free(thds);
+
+    return (double)wake_total / WAKEUPS;
+}
+
+int main(int argc, char **argv) {
+    unsigned int i;
+
+    (void)argc;
+    (void)argv;
+
+    printf("Scheduler benchmark\n");
+    printf("threads    yield (ns)   wakeup (ns)\n");
+
+    for(i = 0; i < NUM_COUNTS; i++) {
+        double yield = bench_yield(counts[i]);
+        double wakeup = bench_wakeup(counts[i]);
+
+        printf("%7d  %12.0f  %12.0f\n", counts[i], yield, wakeup);
+    }
+
+    printf("Done.\n");
+    return 0;
+}
@@ -0,0 +1,85 @@
+/* KallistiOS ##version##
+
+   spawnbench.c
+   Copyright (C) 2026 KallistiOS Team
+
+*/
+
+/* This program measures how long it takes to create a short-lived thread,
+   as a job system starting one worker per request would, with and without
+   the thread pool. Each round creates a batch of joinable threads that do
+   almost nothing, then joins them all, which hands their stacks and thread
+   structures back to the pool for the next batch.
+
+   Threads are created with a couple of different stack sizes in turn, so
+   that the stacks have to come out of the right bucket. With the pool off,
+   every thread costs a memalign() and a malloc() on the way in and the
+   frees on the way out; with it, only the first batch should. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <kos/thread.h>
+#include <arch/timer.h>
+
+#define ROUNDS      200
+#define BATCH       4
+
+static const size_t limits[] = { 0, THD_POOL_DEFAULT, 16 };
+#define NUM_LIMITS (sizeof(limits) / sizeof(limits[0]))
+
+static const size_t stacks[] = { 8192, 16384 };
+#define NUM_STACKS (sizeof(stacks) / sizeof(stacks[0]))
+
+static volatile int counter;
+
+static void *worker(void *param) {
+    (void)param;
+
+    ++counter;
+    return NULL;
+}
+
+static void bench(size_t limit) {
+    kthread_attr_t attr = { 0 };
+    kthread_t *thds[BATCH];
+    uint64_t start, end;
+    int i, j;
+
+    thd_pool_set_limit(limit);
+    counter = 0;
+
+    start = timer_ns_gettime64();
+
+    for(i = 0; i < ROUNDS; i++) {
+        attr.stack_size = stacks[i % NUM_STACKS];
+
+        for(j = 0; j < BATCH; j++)
+            thds[j] = thd_create_ex(&attr, worker, NULL);
+
+        for(j = 0; j < BATCH; j++)
+            thd_join(thds[j], NULL);
+    }
+
+    end = timer_ns_gettime64();
+
+    printf("%10u  %15.0f\n", (unsigned int)limit,
+           (double)(end - start) / counter);
+}
+
+int main(int argc, char **argv) {
+    unsigned int i;
+
+    (void)argc;
+    (void)argv;
+
+    printf("Thread spawn benchmark\n");
+    printf("%10s  %15s\n", "pool limit", "ns/thread");
+
+    for(i = 0; i < NUM_LIMITS; i++)
+        bench(limits[i]);
+
+    thd_pool_set_limit(THD_POOL_DEFAULT);
+
+    printf("Done.\n");
+    return 0;
+}
@@ -0,0 +1,162 @@
+/* KallistiOS ##version##
+
+   timerbench.c
+   Copyright (C) 2026 KallistiOS Team
+
+*/
+
+/* This program measures the cost of timed waits as the number of sleeping
+   threads grows. For each sleeper count it starts that many threads blocked
+   in sem_wait_timed() with long timeouts, then times:
+
+   - wait/signal: a high priority thread doing a timed wait on a semaphore
+     that the main thread signals straight away, so that every round trip
+     puts the thread on the timeout queue and takes it back off again;
+   - sleep: the main thread calling thd_sleep(1), giving how late it wakes
+     up with all the sleepers queued.
+
+   The waiter's timeout is later than any of the sleepers', which is the
+   worst case for a sorted list. With a heap the cost should barely move.
+
+   Everything is run once with the periodic tick and once in tickless mode,
+   where sleeps should come back within a millisecond of being due instead
+   of on the next tick. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <kos/thread.h>
+#include <kos/sem.h>
+#include <arch/timer.h>
+
+#define ROUNDS      2000
+#define SLEEPS      50
+
+#define SLEEPER_STACK   4096
+
+static const int counts[] = { 0, 50, 100, 200, 500 };
+#define NUM_COUNTS (sizeof(counts) / sizeof(counts[0]))
+
+static semaphore_t idle_sem, wake_sem, done_sem;
+static volatile int stop_sleepers;
+
+static void *sleeper_thd(void *param) {
+    int timeout = 30000 + (int)(intptr_t)param;
+
+    while(!stop_sleepers)
+        sem_wait_timed(&idle_sem, timeout);
+
+    return NULL;
+}
+
+static void *waiter_thd(void *param) {
+    int i;
+
+    (void)param;
+
+    for(i = 0; i < ROUNDS; i++) {
+        sem_wait_timed(&wake_sem, 60000);
+        sem_signal(&done_sem);
+    }
+
+    return NULL;
+}
+
+static double bench_wait(void) {
+    kthread_attr_t attr = { 0 };
+    kthread_t *waiter;
+    uint64_t start, end;
+    int i;
+
+    sem_init(&wake_sem, 0);
+    sem_init(&done_sem, 0);
+
+    attr.prio = PRIO_DEFAULT - 1;
+    waiter = thd_create_ex(&attr, waiter_thd, NULL);
+
+    start = timer_ns_gettime64();
+
+    for(i = 0; i < ROUNDS; i++) {
+        sem_signal(&wake_sem);
+        sem_wait(&done_sem);
+    }
+
+    end = timer_ns_gettime64();
+
+    thd_join(waiter, NULL);
+    sem_destroy(&wake_sem);
+    sem_destroy(&done_sem);
+
+    return (double)(end - start) / ROUNDS;
+}
+
+static double bench_sleep(void) {
+    uint64_t start, end;
+    int i;
+
+    start = timer_ns_gettime64();
+
+    for(i = 0; i < SLEEPS; i++)
+        thd_sleep(1);
+
+    end = timer_ns_gettime64();
+
+    /* How far past the requested millisecond we woke, on average */
+    return (double)(end - start) / SLEEPS - 1000000.0;
+}
+
+static void run_bench(void) {
+    kthread_attr_t attr = { 0 };
+    kthread_t **thds;
+    unsigned int i;
+    int j;
+
+    printf("sleepers  wait/signal (ns)  sleep late (ns)\n");
+
+    attr.stack_size = SLEEPER_STACK;
+
+    for(i = 0; i < NUM_COUNTS; i++) {
+        double wait, sleep;
+
+        thds = malloc((counts[i] + 1) * sizeof(kthread_t *));
+        sem_init(&idle_sem, 0);
+        stop_sleepers = 0;
+
+        for(j = 0; j < counts[i]; j++)
+            thds[j] = thd_create_ex(&attr, sleeper_thd, (void *)(intptr_t)j);
+
+        /* Let them all get to their waits */
+        thd_sleep(10);
+
+        wait = bench_wait();
+        sleep = bench_sleep();
+
+        printf("%8d  %16.0f  %15.0f\n", counts[i], wait, sleep);
+
+        stop_sleepers = 1;
+
+        for(j = 0; j < counts[i]; j++)
+            sem_signal(&idle_sem);
+
+        for(j = 0; j < counts[i]; j++)
+            thd_join(thds[j], NULL);
+
+        sem_destroy(&idle_sem);
+        free(thds);
+    }
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+
+    printf("Timed wait benchmark, periodic tick\n");
+    run_bench();
+
+    printf("Timed wait benchmark, tickless\n");
+    thd_set_tickless(1);
+    run_bench();
+    thd_set_tickless(0);
+
+    printf("Done.\n");
+    return 0;
+}
@@ -0,0 +1,71 @@
+/* KallistiOS ##version##
+
+   tlsbench.c
+   Copyright (C) 2026 KallistiOS Team
+
+*/
+
+/* This program times pthread_getspecific() and pthread_setspecific() as the
+   number of keys in use grows. The key looked up is always the one created
+   first, which is the last one a thread comes to if its values are kept in
+   a list in the order they were set. With the values kept in an array
+   indexed by key, the times shouldn't change with the number of keys. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <arch/timer.h>
+
+#define ROUNDS      100000
+
+static const int counts[] = { 1, 8, 32, 128 };
+#define NUM_COUNTS (sizeof(counts) / sizeof(counts[0]))
+
+static pthread_key_t keys[128];
+static int created;
+
+static void bench(int count) {
+    uint64_t start, mid, end;
+    void * volatile value;
+    int i;
+
+    /* Make up the keys, and give this thread a value for each */
+    for(; created < count; created++) {
+        pthread_key_create(&keys[created], NULL);
+        pthread_setspecific(keys[created], &keys[created]);
+    }
+
+    start = timer_ns_gettime64();
+
+    for(i = 0; i < ROUNDS; i++)
+        value = pthread_getspecific(keys[0]);
+
+    mid = timer_ns_gettime64();
+
+    for(i = 0; i < ROUNDS; i++)
+        pthread_setspecific(keys[0], (void *)value);
+
+    end = timer_ns_gettime64();
+
+    printf("%4d  %15.1f  %15.1f\n", count, (double)(mid - start) / ROUNDS,
+           (double)(end - mid) / ROUNDS);
+}
+
+int main(int argc, char **argv) {
+    unsigned int i;
+
+    (void)argc;
+    (void)argv;
+
+    printf("Thread-specific data benchmark\n");
+    printf("%4s  %15s  %15s\n", "keys", "get (ns)", "set (ns)");
+
+    for(i = 0; i < NUM_COUNTS; i++)
+        bench(counts[i]);
+
+    for(i = 0; i < (unsigned int)created; i++)
+        pthread_key_delete(keys[i]);
+
+    printf("Done.\n");
+    return 0;
+}
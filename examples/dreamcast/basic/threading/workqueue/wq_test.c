@@ -0,0 +1,205 @@
+/* KallistiOS ##version##
+
+   wq_test.c
+   Copyright (C) 2026 KallistiOS Team
+
+*/
+
+/* This program tests the work queues. The tests are:
+   - priority: work queued while the only worker is busy runs lowest
+     priority number first, and in order within a priority;
+   - delayed: delayed work doesn't run before it's due, and runs in order of
+     when it's due rather than when it was queued;
+   - cancel: cancelled work never runs, and queueing work twice only runs it
+     once;
+   - periodic: work that queues itself again keeps running until it's told
+     to stop, and work_wait() waits for the last run. */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <kos/thread.h>
+#include <kos/workqueue.h>
+#include <kos/sem.h>
+
+#include <arch/timer.h>
+
+static workqueue_t *wq;
+static semaphore_t gate;
+
+static int order[8];
+static int ran;
+static uint64_t ran_at[8];
+
+static void record(work_t *work) {
+    order[ran] = (int)(intptr_t)work->data;
+    ran_at[ran] = timer_ms_gettime64();
+    ++ran;
+}
+
+/* Holds up the worker until the gate is opened */
+static void blocker(work_t *work) {
+    (void)work;
+    sem_wait(&gate);
+}
+
+static int test_priority(void) {
+    static const int prios[] = { 5, 1, 3, 1, 5 };
+    static const int expect[] = { 1, 3, 2, 0, 4 };
+    work_t block, works[5];
+    int i, ok = 1;
+
+    ran = 0;
+    work_init(&block, blocker, NULL, 0);
+    work_queue(wq, &block);
+
+    for(i = 0; i < 5; i++) {
+        work_init(&works[i], record, (void *)(intptr_t)i, prios[i]);
+        work_queue(wq, &works[i]);
+    }
+
+    sem_signal(&gate);
+    workqueue_flush(wq);
+
+    printf("priority:");
+
+    for(i = 0; i < ran; i++) {
+        printf(" %d", order[i]);
+        ok = ok && order[i] == expect[i];
+    }
+
+    printf("\n");
+
+    return ok && ran == 5;
+}
+
+static int test_delayed(void) {
+    work_t works[3];
+    uint64_t start;
+    int i;
+
+    ran = 0;
+    start = timer_ms_gettime64();
+
+    for(i = 0; i < 3; i++)
+        work_init(&works[i], record, (void *)(intptr_t)i, 0);
+
+    work_queue_delayed(wq, &works[0], 60);
+    work_queue_delayed(wq, &works[1], 20);
+    work_queue_delayed(wq, &works[2], 40);
+
+    for(i = 0; i < 3; i++)
+        work_wait(&works[i]);
+
+    printf("delayed: %d at %lu ms, %d at %lu ms, %d at %lu ms\n",
+           order[0], (uint32_t)(ran_at[0] - start),
+           order[1], (uint32_t)(ran_at[1] - start),
+           order[2], (uint32_t)(ran_at[2] - start));
+
+    return ran == 3 && order[0] == 1 && order[1] == 2 && order[2] == 0 &&
+           ran_at[0] - start >= 20;
+}
+
+static int test_cancel(void) {
+    work_t block, a, b;
+
+    ran = 0;
+    work_init(&block, blocker, NULL, 0);
+    work_init(&a, record, (void *)0, 0);
+    work_init(&b, record, (void *)1, 0);
+
+    work_queue(wq, &block);
+    work_queue(wq, &a);
+
+    if(work_queue(wq, &a) != 1 || work_queue_delayed(wq, &a, 10) != 1)
+        return 0;
+
+    work_queue_delayed(wq, &b, 10);
+
+    if(work_cancel(&a) != 1 || work_cancel(&b) != 1 || work_cancel(&b) != 0)
+        return 0;
+
+    sem_signal(&gate);
+    workqueue_flush(wq);
+    thd_sleep(30);
+
+    printf("cancel: %d ran\n", ran);
+
+    return ran == 0;
+}
+
+static volatile int ticks, stop_ticks;
+
+static void ticker(work_t *work) {
+    ++ticks;
+
+    if(!stop_ticks)
+        work_queue_delayed(wq, work, 10);
+}
+
+static int test_periodic(void) {
+    work_t tick;
+    int seen;
+
+    ticks = stop_ticks = 0;
+    work_init(&tick, ticker, NULL, 0);
+    work_queue(wq, &tick);
+
+    thd_sleep(105);
+    stop_ticks = 1;
+    work_cancel(&tick);
+    work_wait(&tick);
+
+    seen = ticks;
+    thd_sleep(30);
+
+    printf("periodic: %d ticks, %d after stopping\n", seen, ticks - seen);
+
+    return seen >= 5 && ticks == seen;
+}
+
+int main(int argc, char **argv) {
+    int failed = 0;
+
+    (void)argc;
+    (void)argv;
+
+    printf("KallistiOS work queue test\n");
+    sem_init(&gate, 0);
+
+    if(!(wq = workqueue_create(1, NULL))) {
+        printf("workqueue_create failed\n");
+        return EXIT_FAILURE;
+    }
+
+    if(!test_priority()) {
+        printf("FAIL: priority\n");
+        ++failed;
+    }
+
+    if(!test_delayed()) {
+        printf("FAIL: delayed\n");
+        ++failed;
+    }
+
+    if(!test_cancel()) {
+        printf("FAIL: cancel\n");
+        ++failed;
+    }
+
+    if(!test_periodic()) {
+        printf("FAIL: periodic\n");
+        ++failed;
+    }
+
+    workqueue_destroy(wq);
+    sem_destroy(&gate);
+
+    if(failed) {
+        printf("%d test(s) failed\n", failed);
+        return EXIT_FAILURE;
+    }
+
+    printf("Work queue tests completed successfully!\n");
+    return 0;
+}
@@ -56,6 +56,8 @@ __BEGIN_DECLS
 #include <kos/elf.h>
 #include <kos/fs_socket.h>
 #include <kos/string.h>
+#include <kos/arena.h>
+#include <kos/heap.h>
 #include <kos/init.h>
 
 #include <arch/arch.h>
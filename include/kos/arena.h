@@ -0,0 +1,222 @@
+/* KallistiOS ##version##
+
+   include/kos/arena.h
+   Copyright (C) 2026 KallistiOS Team
+
+*/
+
+/** \file    kos/arena.h
+    \brief   Arena (bump) allocators.
+    \ingroup system_allocator
+
+    An arena hands out memory from a block by moving a pointer along it, and
+    gets it all back at once by moving the pointer back again. Allocating is
+    just a few instructions, nothing is ever freed on its own, and nothing is
+    left behind in the main heap to fragment it. That suits memory that's
+    only needed for a while and all goes away together, like scratch space
+    for building a display list, strings decoded for one frame or temporary
+    vertex arrays.
+
+    An arena starts out with one block, which can be memory the caller
+    already has, or can come from malloc(). When an allocation doesn't fit,
+    the arena can get more blocks from malloc() and chain them on, or fail if
+    it's been set up not to grow. arena_mark() and arena_rewind() give back
+    everything allocated since a given point, for nesting temporary
+    allocations, and arena_reset() gives back everything. Blocks picked up
+    along the way are kept for next time rather than freed, so an arena that
+    is reset every frame settles down to not calling malloc() at all.
+
+    Each thread can also have a frame arena, for memory that's only needed
+    until the end of the frame. It's reset by pvr_scene_finish(), when called
+    from the thread it belongs to, so everything allocated from it while
+    building a scene is given back once the scene has been submitted.
+
+    Arenas aren't safe to use from more than one thread at once, other than
+    frame arenas, which each belong to a single thread anyway.
+*/
+
+#ifndef __KOS_ARENA_H
+#define __KOS_ARENA_H
+
+#include <kos/cdefs.h>
+
+__BEGIN_DECLS
+
+#include <stddef.h>
+
+/** \brief  Default alignment of arena allocations. */
+#define ARENA_ALIGN         8
+
+/** \brief  Size of the blocks frame arenas use. */
+#define ARENA_FRAME_SIZE    (64 * 1024)
+
+/** \brief  Arena structure.
+
+    Set one of these up with arena_init() or get one from arena_create().
+    All members of this structure should be considered to be private.
+
+    \headerfile kos/arena.h
+*/
+typedef struct arena {
+    /** \cond */
+    struct arena_block *block;  /* Block being allocated from */
+    struct arena_block *spare;  /* Growth blocks given back, for reuse */
+    char *ptr;                  /* Free space in the current block */
+    char *end;
+    size_t grow;                /* Size of growth blocks, or 0 to not grow */
+    int flags;
+    /** \endcond */
+} arena_t;
+
+/** \brief  A point in an arena to rewind to.
+
+    Get one of these from arena_mark(). All members of this structure should
+    be considered to be private.
+
+    \headerfile kos/arena.h
+*/
+typedef struct arena_mark {
+    /** \cond */
+    struct arena_block *block;
+    char *ptr;
+    /** \endcond */
+} arena_mark_t;
+
+/** \brief  Set up an arena in a block of memory.
+
+    This sets up an arena that allocates from the given block, which has to
+    stay around for as long as the arena does. A little of the block is used
+    to keep track of it.
+
+    \param  arena           The arena to set up.
+    \param  block           The memory to allocate from.
+    \param  size            The size of the block, in bytes.
+    \param  grow            The size of the blocks to get from malloc() when
+                            the arena runs out of space, or 0 to just fail.
+
+    \retval 0               On success.
+    \retval -1              If the block is too small to use (errno will be
+                            set to EINVAL).
+*/
+int arena_init(arena_t *arena, void *block, size_t size, size_t grow);
+
+/** \brief  Create an arena.
+
+    This allocates an arena and its first block with malloc().
+
+    \param  size            The size of the first block, in bytes.
+    \param  grow            The size of the blocks to get from malloc() when
+                            the arena runs out of space, or 0 to just fail.
+
+    \return                 The new arena, or NULL on failure (errno will be
+                            set to ENOMEM).
+*/
+arena_t *arena_create(size_t size, size_t grow);
+
+/** \brief  Destroy an arena.
+
+    This frees all the blocks the arena got from malloc(), and the arena
+    itself if it came from arena_create(). A block given to arena_init() is
+    left alone. Everything allocated from the arena is gone after this.
+
+    \param  arena           The arena to destroy.
+*/
+void arena_destroy(arena_t *arena);
+
+/** \brief  Allocate from an arena.
+
+    The memory is aligned to ARENA_ALIGN bytes.
+
+    \param  arena           The arena to allocate from.
+    \param  size            The number of bytes to allocate.
+
+    \return                 The memory, or NULL if the arena is out of space
+                            and can't grow (errno will be set to ENOMEM).
+*/
+void *arena_alloc(arena_t *arena, size_t size);
+
+/** \brief  Allocate aligned memory from an arena.
+
+    \param  arena           The arena to allocate from.
+    \param  size            The number of bytes to allocate.
+    \param  align           The alignment, which must be a power of two.
+
+    \return                 The memory, or NULL on failure (errno will be set
+                            as appropriate).
+
+    \par    Error Conditions:
+    \em     EINVAL - align isn't a power of two \n
+    \em     ENOMEM - the arena is out of space and can't grow
+*/
+void *arena_alloc_aligned(arena_t *arena, size_t size, size_t align);
+
+/** \brief  Remember the current point in an arena.
+
+    \param  arena           The arena.
+    \return                 A mark for arena_rewind().
+*/
+arena_mark_t arena_mark(arena_t *arena);
+
+/** \brief  Rewind an arena to a mark.
+
+    This gives back everything allocated from the arena since the mark was
+    taken. The mark, and any taken before it, can be used again afterwards,
+    but any taken after it can't.
+
+    \param  arena           The arena.
+    \param  mark            The mark to rewind to, from arena_mark().
+*/
+void arena_rewind(arena_t *arena, arena_mark_t mark);
+
+/** \brief  Reset an arena.
+
+    This gives back everything allocated from the arena. Growth blocks are
+    kept to be used again.
+
+    \param  arena           The arena to reset.
+*/
+void arena_reset(arena_t *arena);
+
+/** \brief  Free an arena's spare blocks.
+
+    This frees the growth blocks an arena has been given back by
+    arena_rewind() and arena_reset(), to return the memory to the heap.
+
+    \param  arena           The arena to trim.
+*/
+void arena_trim(arena_t *arena);
+
+/** \brief  Get the current thread's frame arena.
+
+    The frame arena is created the first time a thread asks for it, and
+    freed when the thread exits. It grows as needed, in blocks of
+    ARENA_FRAME_SIZE bytes.
+
+    \return                 The frame arena, or NULL on failure (errno will be
+                            set as appropriate).
+*/
+arena_t *arena_frame(void);
+
+/** \brief  Allocate from the current thread's frame arena.
+
+    The memory is aligned to ARENA_ALIGN bytes, and stays around until the
+    frame arena is next reset.
+
+    \param  size            The number of bytes to allocate.
+
+    \return                 The memory, or NULL on failure (errno will be set
+                            as appropriate).
+*/
+void *arena_frame_alloc(size_t size);
+
+/** \brief  Reset the current thread's frame arena.
+
+    This gives back everything allocated from the current thread's frame
+    arena, if it has one. pvr_scene_finish() calls this, so only threads that
+    don't submit scenes need to call it themselves.
+*/
+void arena_frame_reset(void);
+
+__END_DECLS
+
+#endif /* __KOS_ARENA_H */
@@ -39,6 +39,12 @@
     function, and thus you will end up deadlocking if you use a recursive mutex
     that has been locked more than once.
 
+    A thread that is signaled while the mutex is held isn't actually woken up,
+    since all it could do is block again on the mutex. Instead it's moved
+    straight to the mutex's queue, and runs once the mutex is handed to it.
+    This saves a context switch per waiter, which adds up quickly with
+    cond_broadcast().
+
     \author Megan Potter
 */
 
@@ -123,7 +129,9 @@ int cond_destroy(condvar_t *cv);
     \em     EPERM - called inside an interrupt \n
     \em     EINVAL - the condvar was not initialized \n
     \em     EINVAL - the mutex is not initialized or not locked \n
-    \em     ENOTRECOVERABLE - the condvar was destroyed while waiting
+    \em     ENOTRECOVERABLE - the condvar was destroyed while waiting \n
+    \em     EOWNERDEAD - signalled, but the mutex's holder exited without
+                         unlocking it, see kos/mutex.h
 */
 int cond_wait(condvar_t *cv, mutex_t * m);
 
@@ -149,7 +157,9 @@ int cond_wait(condvar_t *cv, mutex_t * m);
     \em     ETIMEDOUT - timed out \n
     \em     EINVAL - the condvar was not initialized \n
     \em     EINVAL - the mutex is not initialized or not locked \n
-    \em     ENOTRECOVERABLE - the condvar was destroyed while waiting
+    \em     ENOTRECOVERABLE - the condvar was destroyed while waiting \n
+    \em     EOWNERDEAD - signalled, but the mutex's holder exited without
+                         unlocking it, see kos/mutex.h
 */
 int cond_wait_timed(condvar_t *cv, mutex_t * m, int timeout);
 
@@ -0,0 +1,205 @@
+/* KallistiOS ##version##
+
+   include/kos/fiber.h
+   Copyright (C) 2026 KallistiOS Team
+
+*/
+
+/** \file    kos/fiber.h
+    \brief   Cooperative fibers.
+    \ingroup kthreads
+
+    Fibers are lightweight coroutines that run inside a kernel thread. Each
+    has its own stack, but switching between them is just a function call
+    that saves the registers a call has to preserve and swaps stacks, with
+    no trip through the thread scheduler, so it only takes a few tens of
+    cycles. The kernel doesn't know about them: a fiber only stops running
+    when it switches to another fiber, yields, or finishes, and if it blocks
+    the thread, every fiber on the thread waits with it.
+
+    Fibers are asymmetric, like Lua's coroutines. fiber_switch() runs a
+    fiber until it calls fiber_yield() or finishes, at which point the
+    switch returns. The thread itself counts as a fiber for this, so it can
+    switch to fibers without having been created as one.
+
+    For running lots of fibers, a fiber scheduler keeps a queue of them and
+    runs each one in turn until it yields, round robin, until they've all
+    finished. Fibers in a scheduler should only be run by it.
+
+    A fiber must only ever be run on the thread that first switched to it.
+*/
+
+#ifndef __KOS_FIBER_H
+#define __KOS_FIBER_H
+
+#include <kos/cdefs.h>
+
+__BEGIN_DECLS
+
+#include <stddef.h>
+#include <sys/queue.h>
+
+/** \brief  Default fiber stack size. */
+#define FIBER_STACK_SIZE    4096
+
+/** \brief  Fiber structure.
+
+    This is private to the fiber code; use fiber_create() to get one.
+
+    \headerfile kos/fiber.h
+*/
+typedef struct fiber fiber_t;
+
+/** \brief  Fiber scheduler structure.
+
+    All members of this structure should be considered to be private.
+
+    \headerfile kos/fiber.h
+*/
+typedef struct fiber_sched {
+    /** \cond */
+    TAILQ_HEAD(fiber_queue, fiber) ready;
+    /** \endcond */
+} fiber_sched_t;
+
+/** \brief  Create a new fiber.
+
+    This sets up a fiber to run the given routine, but doesn't run it; use
+    fiber_switch() or a fiber scheduler for that. When the routine returns,
+    the fiber finishes, just as if it had called fiber_exit().
+
+    \param  detach          Non-zero to free the fiber as soon as it
+                            finishes, rather than when it's joined.
+    \param  routine         The function to run in the fiber.
+    \param  param           The parameter to pass to routine.
+    \param  stack_size      The size of stack to give the fiber, or 0 for
+                            FIBER_STACK_SIZE.
+
+    \return                 The new fiber, or NULL on failure (errno will be
+                            set as appropriate).
+
+    \par    Error Conditions:
+    \em     ENOMEM - out of memory
+*/
+fiber_t *fiber_create(int detach, void *(*routine)(void *param), void *param,
+                      size_t stack_size);
+
+/** \brief  Switch to a fiber.
+
+    This runs the fiber until it yields or finishes, and then returns. If it
+    switches to other fibers in turn, they come back to it when they yield.
+
+    \param  fiber           The fiber to switch to.
+
+    \retval 0               On success.
+    \retval -1              On error, errno will be set as appropriate.
+
+    \par    Error Conditions:
+    \em     EINVAL - the fiber has finished \n
+    \em     EBUSY - the fiber is already running, either because it's the
+                    current fiber or one waiting for the current fiber to
+                    yield, or because it belongs to a scheduler
+*/
+int fiber_switch(fiber_t *fiber);
+
+/** \brief  Yield the current fiber.
+
+    This goes back to whatever switched to the current fiber, which will
+    switch back to it later on to carry on from here. If the thread isn't
+    running a fiber, this does nothing.
+*/
+void fiber_yield(void);
+
+/** \brief  Finish the current fiber.
+
+    This finishes the current fiber, with the given return value for
+    fiber_join(), and goes back to whatever switched to it. It doesn't
+    return. If the thread isn't running a fiber, this does nothing.
+
+    \param  rv              The fiber's return value.
+*/
+void fiber_exit(void *rv);
+
+/** \brief  Wait for a fiber to finish.
+
+    This runs the fiber until it finishes, and then frees it. If it belongs
+    to a scheduler, it can only be joined by another fiber in the same
+    scheduler, which yields until it's done.
+
+    \param  fiber           The fiber to join.
+    \param  value_ptr       Where to put the fiber's return value, or NULL.
+
+    \retval 0               On success.
+    \retval -1              On error, errno will be set as appropriate.
+
+    \par    Error Conditions:
+    \em     EINVAL - the fiber is detached, or belongs to a scheduler the
+                     caller isn't running in \n
+    \em     EBUSY - the fiber is waiting for the caller to yield
+*/
+int fiber_join(fiber_t *fiber, void **value_ptr);
+
+/** \brief  Free a fiber that isn't running.
+
+    This frees a fiber that has finished or has never been run. A fiber that
+    has been run part way can be freed too, but anything on its stack is
+    lost without being cleaned up.
+
+    \param  fiber           The fiber to free.
+
+    \retval 0               On success.
+    \retval -1              If the fiber is running or waiting to run in a
+                            scheduler (errno will be set to EBUSY).
+*/
+int fiber_destroy(fiber_t *fiber);
+
+/** \brief  Get the current fiber.
+
+    \return                 The fiber running on the current thread, or NULL
+                            if there isn't one.
+*/
+fiber_t *fiber_self(void);
+
+/** \brief  Initialize a fiber scheduler.
+
+    \param  sched           The scheduler to set up.
+*/
+void fiber_sched_init(fiber_sched_t *sched);
+
+/** \brief  Add a fiber to a scheduler.
+
+    This puts the fiber on the end of the scheduler's queue. It can be called
+    from fibers running in the scheduler to start new ones.
+
+    \param  sched           The scheduler to add to.
+    \param  fiber           The fiber to add, which must not be running.
+
+    \retval 0               On success.
+    \retval -1              On error, errno will be set as appropriate.
+
+    \par    Error Conditions:
+    \em     EINVAL - the fiber has finished \n
+    \em     EBUSY - the fiber is running or already belongs to a scheduler
+*/
+int fiber_sched_add(fiber_sched_t *sched, fiber_t *fiber);
+
+/** \brief  Run a fiber scheduler.
+
+    This runs each fiber in the scheduler in turn until it yields, over and
+    over, until they've all finished. Detached fibers are freed as they
+    finish; joinable ones are left to be joined.
+
+    \param  sched           The scheduler to run.
+*/
+void fiber_sched_run(fiber_sched_t *sched);
+
+/** \cond */
+/* Architecture-specific context switching, in thdswitch.s */
+void fiber_context_switch(void **save_sp, void *new_sp);
+void *fiber_create_context(void *stack_top, void (*routine)(void *),
+                           void *param);
+/** \endcond */
+
+__END_DECLS
+
+#endif /* __KOS_FIBER_H */
@@ -125,6 +125,48 @@ void genwait_wake_one_err(void *obj, int err);
 */
 int genwait_wake_thd(void *obj, kthread_t *thd, int err);
 
+/** \brief  Move a sleeping thread from one object to another.
+
+    This function takes a thread sleeping on one object and has it sleep on
+    another instead, without waking it up. Any timeout on the wait is
+    cancelled. Interrupts must be disabled.
+
+    \param  obj             The object the thread is sleeping on
+    \param  thd             The thread to move
+    \param  newobj          The object to sleep on instead
+    \param  mesg            A message to show in the status
+    \return                 1 if the thread was moved, 0 if it wasn't
+                            sleeping on obj
+*/
+int genwait_move(void *obj, kthread_t *thd, void *newobj, const char *mesg);
+
+/** \brief  Find the highest priority thread sleeping on an object.
+
+    This function looks through the threads sleeping on the specified object
+    for the one with the highest priority, picking the one that has been
+    waiting longest if there's a tie. Interrupts must be disabled.
+
+    \param  obj             The object to look at
+    \return                 The thread found, or NULL if nothing is sleeping
+                            on the object
+*/
+kthread_t *genwait_top_waiter(void *obj);
+
+/** \brief  Wake every thread sleeping on an object, or pass them on.
+
+    This goes through the threads sleeping on the specified object in a
+    single pass over its sleep queue, the highest priority one first and then
+    the rest in the order they went to sleep, and calls func on each. If func
+    returns 0, the thread is woken up with a return value of 0. Otherwise
+    func must have taken it off the object itself, say with genwait_move().
+    Interrupts must be disabled.
+
+    \param  obj             The object to wake threads that are sleeping on it
+    \param  func            Called on each thread sleeping on the object
+    \return                 The number of threads found
+*/
+int genwait_wake_all_fn(void *obj, int (*func)(void *obj, kthread_t *thd));
+
 /** \brief  Look for timed out genwait_wait() calls.
 
     There should be no reason you need to call this function, it is called
@@ -0,0 +1,142 @@
+/* KallistiOS ##version##
+
+   include/kos/heap.h
+   Copyright (C) 2026 KallistiOS Team
+
+*/
+
+/** \file    kos/heap.h
+    \brief   Separate heaps.
+    \ingroup system_allocator
+
+    Everything normally allocates from the one main heap, so a subsystem that
+    leaks or allocates in big bursts can fragment or use up memory for
+    everything else. A separate heap is a region of memory set aside for one
+    use, managed by the same allocator as the main heap but independently of
+    it: whatever happens in it stays in it, and the rest of the system never
+    sees it run out. When the whole heap is finished with, there's no need to
+    free what's in it one block at a time; the region can just be reused.
+
+    The region can come from anywhere, including malloc() or a static array.
+    The heap grows into it as needed, so a heap only uses as much of its
+    region as it has had to.
+
+    A block allocated from a separate heap can be freed or reallocated with
+    the usual free() and realloc() as well as with kos_heap_free() and
+    kos_heap_realloc(); it always goes back to the heap it came from. Passing
+    NULL as the heap to any of these functions means the main heap, so code
+    that keeps a heap pointer that may not be set can use it as is.
+
+    The network stack and sound driver can be given heaps of their own, with
+    net_heap and snd_heap.
+*/
+
+#ifndef __KOS_HEAP_H
+#define __KOS_HEAP_H
+
+#include <kos/cdefs.h>
+
+__BEGIN_DECLS
+
+#include <stddef.h>
+#include <malloc.h>
+
+/** \brief  Heap structure.
+
+    This is private to the allocator; use kos_heap_create() to get one.
+
+    \headerfile kos/heap.h
+*/
+typedef struct kos_heap kos_heap_t;
+
+/** \brief  Create a heap in a region of memory.
+
+    This sets up a new heap to allocate from the given region, which has to
+    stay around until the heap is destroyed. A little of the region is used
+    to keep track of the heap, and the allocator grows into it a page at a
+    time, so any part of a page left over at the end goes unused.
+
+    \param  base            The start of the region.
+    \param  size            The size of the region, in bytes.
+
+    \return                 The new heap, or NULL if the region is too small
+                            to use (errno will be set to EINVAL).
+*/
+kos_heap_t *kos_heap_create(void *base, size_t size);
+
+/** \brief  Destroy a heap.
+
+    This forgets about a heap, and everything allocated from it, at once.
+    Nothing allocated from it may be used or freed afterwards, and its region
+    can be reused for anything.
+
+    \param  heap            The heap to destroy.
+*/
+void kos_heap_destroy(kos_heap_t *heap);
+
+/** \brief  Allocate from a heap.
+
+    \param  heap            The heap to allocate from, or NULL for the main
+                            heap.
+    \param  size            The number of bytes to allocate.
+
+    \return                 The memory, or NULL if the heap is out of space.
+*/
+void *kos_heap_malloc(kos_heap_t *heap, size_t size);
+
+/** \brief  Allocate zeroed memory for an array from a heap.
+
+    \param  heap            The heap to allocate from, or NULL for the main
+                            heap.
+    \param  nmemb           The number of elements.
+    \param  size            The size of each element.
+
+    \return                 The memory, or NULL if the heap is out of space.
+*/
+void *kos_heap_calloc(kos_heap_t *heap, size_t nmemb, size_t size);
+
+/** \brief  Allocate aligned memory from a heap.
+
+    \param  heap            The heap to allocate from, or NULL for the main
+                            heap.
+    \param  alignment       The alignment, which must be a power of two.
+    \param  size            The number of bytes to allocate.
+
+    \return                 The memory, or NULL if the heap is out of space.
+*/
+void *kos_heap_memalign(kos_heap_t *heap, size_t alignment, size_t size);
+
+/** \brief  Resize a block.
+
+    A block stays in the heap it came from, whichever heap is given. The heap
+    is only used when ptr is NULL, to allocate a new block from.
+
+    \param  heap            The heap to allocate from if ptr is NULL, or
+                            NULL for the main heap.
+    \param  ptr             The block to resize, or NULL.
+    \param  size            The new size, in bytes.
+
+    \return                 The resized block, or NULL if there wasn't room.
+*/
+void *kos_heap_realloc(kos_heap_t *heap, void *ptr, size_t size);
+
+/** \brief  Free a block.
+
+    The block goes back to the heap it came from, which should be the one
+    given.
+
+    \param  heap            The heap the block came from.
+    \param  ptr             The block to free, or NULL.
+*/
+void kos_heap_free(kos_heap_t *heap, void *ptr);
+
+/** \brief  Get statistics for a heap.
+
+    \param  heap            The heap, or NULL for the main heap.
+    \return                 The heap's statistics, as for mallinfo().
+*/
+struct mallinfo kos_heap_mallinfo(kos_heap_t *heap);
+
+__END_DECLS
+
+#endif /* __KOS_HEAP_H */
@@ -0,0 +1,181 @@
+/* KallistiOS ##version##
+
+   include/kos/hrtimer.h
+   Copyright (C) 2026 KallistiOS Team
+
+*/
+
+/** \file    kos/hrtimer.h
+    \brief   High-resolution timers.
+    \ingroup timing
+
+    High-resolution timers call a function at a given time, to the
+    microsecond, either once or periodically. They're for things that need to
+    happen at an exact time rather than on the next scheduler tick, like
+    refilling an audio buffer, polling input or retransmitting a packet,
+    without a thread having to poll for it.
+
+    Any number of timers can be running at once. They're kept in a heap
+    ordered by when they're next due, and the secondary timer (TMU1) is set
+    to go off for whichever one is first. Drivers that need TMU1 for
+    themselves for a while (the modem, and SD cards on the serial port) claim
+    it with timer_secondary_claim(), which holds timers off until they give it
+    back; anything that fell due in the meantime goes off then.
+
+    A timer's function is called one of two ways, chosen when the timer is
+    set up:
+    - Straight from the timer interrupt, with HRTIMER_IRQ. This is as close
+      to on time as it gets, but the function has to stick to what's safe in
+      an interrupt, and should be quick about it, as everything else waits
+      while it runs.
+    - From a kernel thread, with HRTIMER_DEFERRED. The function can block
+      and take its time, but it runs once the scheduler gets to the thread,
+      which it does as soon as it's next woken up. The thread runs at a high
+      priority, and runs the functions one at a time, in the order they
+      came due.
+
+    Timers belong to whoever sets them up, and must stay around until they've
+    been cancelled or have finished.
+*/
+
+#ifndef __KOS_HRTIMER_H
+#define __KOS_HRTIMER_H
+
+#include <kos/cdefs.h>
+
+__BEGIN_DECLS
+
+#include <stdint.h>
+#include <kos/pheap.h>
+#include <kos/workqueue.h>
+
+/** \name   Timer flags
+    \brief  How a timer's function is called.
+    @{
+*/
+#define HRTIMER_IRQ         0   /**< \brief Call it in the timer interrupt */
+#define HRTIMER_DEFERRED    1   /**< \brief Call it from a kernel thread */
+/** @} */
+
+/** \brief  High-resolution timer structure.
+
+    Set one of these up with hrtimer_init() before starting it. All members
+    of this structure other than data and overruns should be considered to be
+    private.
+
+    \headerfile kos/hrtimer.h
+*/
+typedef struct hrtimer {
+    /** \cond */
+    pheap_node_t node;          /* Timer heap node */
+    uint64_t when;              /* When it's next due, in us since boot */
+    uint32_t period;            /* Period in us, or 0 for a one-shot timer */
+    int flags;                  /* HRTIMER_IRQ or HRTIMER_DEFERRED */
+    int queued;                 /* Whether it's in the heap */
+    work_t work;                /* Work item for deferred timers */
+    /** \endcond */
+
+    /** \brief  The function to call. */
+    void (*func)(struct hrtimer *timer);
+
+    /** \brief  Data for the function, not touched by the timer code. */
+    void *data;
+
+    /** \brief  How many times a periodic timer couldn't be called on time.
+
+        This counts periods that had gone by completely before the timer
+        could be looked at, and, for deferred timers, ones that came due while
+        the function still hadn't been called for the last one.
+    */
+    uint32_t overruns;
+} hrtimer_t;
+
+/** \brief  Set up a high-resolution timer.
+
+    This must be called before a timer is started, and not while it's
+    running. The first deferred timer set up starts the kernel thread that
+    runs them, so this isn't safe to call inside an interrupt for those.
+
+    \param  timer           The timer to set up.
+    \param  func            The function to call when it goes off.
+    \param  data            Data for the function, in timer->data.
+    \param  flags           HRTIMER_IRQ or HRTIMER_DEFERRED.
+
+    \retval 0               On success.
+    \retval -1              On error, errno will be set as appropriate.
+
+    \par    Error Conditions:
+    \em     EINVAL - flags isn't valid \n
+    \em     ENOMEM - couldn't start the thread for deferred timers
+*/
+int hrtimer_init(hrtimer_t *timer, void (*func)(hrtimer_t *timer), void *data,
+                 int flags);
+
+/** \brief  Start a timer after a delay.
+
+    This sets the timer to go off after the given delay, and then, if it's
+    periodic, every period after that. Periodic timers are kept to their
+    schedule: each time is worked out from the last one it was due, not from
+    when its function was called. If the timer is already running, it's
+    started again from now. This is safe to call inside an interrupt,
+    including from the timer's own function.
+
+    \param  timer           The timer to start.
+    \param  delay           How long until it goes off, in microseconds.
+    \param  period          Its period in microseconds, or 0 for it to only
+                            go off once.
+
+    \retval 0               If the timer was started.
+    \retval 1               If it was already running, and has been started
+                            again.
+*/
+int hrtimer_start(hrtimer_t *timer, uint64_t delay, uint32_t period);
+
+/** \brief  Start a timer at a given time.
+
+    This works like hrtimer_start(), but takes the time the timer should go
+    off at, as returned by timer_us_gettime64(). A time that's already gone by
+    makes the timer go off as soon as possible.
+
+    \param  timer           The timer to start.
+    \param  when            When it goes off, in microseconds since boot.
+    \param  period          Its period in microseconds, or 0 for it to only
+                            go off once.
+
+    \retval 0               If the timer was started.
+    \retval 1               If it was already running, and has been started
+                            again.
+*/
+int hrtimer_start_abs(hrtimer_t *timer, uint64_t when, uint32_t period);
+
+/** \brief  Stop a timer.
+
+    This stops the timer from going off again. If a deferred timer's function
+    is waiting to be called, that's cancelled too, and when called from a
+    thread other than the one running deferred timers, this also waits for
+    its function to return if it's running. This is safe to call inside an
+    interrupt, including from the timer's own function, but then doesn't
+    wait.
+
+    \param  timer           The timer to stop.
+
+    \retval 1               If the timer was running.
+    \retval 0               If it wasn't.
+*/
+int hrtimer_cancel(hrtimer_t *timer);
+
+/** \brief  Is a timer running?
+
+    \param  timer           The timer to check.
+    \return                 Non-zero if the timer is going to go off.
+*/
+int hrtimer_pending(const hrtimer_t *timer);
+
+/** \cond */
+int hrtimer_sys_init(void);
+void hrtimer_sys_shutdown(void);
+/** \endcond */
+
+__END_DECLS
+
+#endif /* __KOS_HRTIMER_H */
@@ -138,6 +138,7 @@ extern void * __kos_romdisk;
 #define INIT_QUIET       0x00000010  /**< \brief Disable dbgio */
 #define INIT_EXPORT      0x00000020  /**< \brief Export kernel symbols */
 #define INIT_FS_ROMDISK  0x00000040  /**< \brief Enable support for romdisks */
+#define INIT_THD_TICKLESS 0x00000080 /**< \brief Tickless scheduling */
 /** @} */
 
 __END_DECLS
@@ -45,6 +45,20 @@
     There is a fourth type of mutex defined (MUTEX_TYPE_DEFAULT), which maps to
     the MUTEX_TYPE_NORMAL type. This is simply for alignment with POSIX.
 
+    All types of mutex use priority inheritance: while a thread is blocked on
+    a mutex, the thread holding it runs at the blocked thread's priority if
+    that is higher than its own, and so on down the chain if the holder is
+    itself blocked on another mutex. This stops a low priority thread holding
+    a lock from holding up a high priority one for as long as any medium
+    priority threads want to run. When a mutex is unlocked, it is handed
+    straight to the highest priority thread waiting for it.
+
+    A thread that exits, or is destroyed, while it still holds a mutex is a
+    bug in that thread, and whatever the mutex protects may have been left
+    half updated. So the mutex isn't handed on: a warning naming the thread
+    and the mutex is logged, the mutex is left unlocked, and every thread
+    waiting for it at the time fails with EOWNERDEAD instead of getting it.
+
     \author Lawrence Sebald
     \see    kos/sem.h
 */
@@ -70,6 +84,7 @@ typedef struct kos_mutex {
     int dynamic;
     kthread_t *holder;
     int count;
+    struct kos_mutex *next_held;
 } mutex_t;
 
 /** \name  Mutex types
@@ -90,13 +105,13 @@ typedef struct kos_mutex {
 /** @} */
 
 /** \brief  Initializer for a transient mutex. */
-#define MUTEX_INITIALIZER               { MUTEX_TYPE_NORMAL, 0, NULL, 0 }
+#define MUTEX_INITIALIZER               { MUTEX_TYPE_NORMAL, 0, NULL, 0, NULL }
 
 /** \brief  Initializer for a transient error-checking mutex. */
-#define ERRORCHECK_MUTEX_INITIALIZER    { MUTEX_TYPE_ERRORCHECK, 0, NULL, 0 }
+#define ERRORCHECK_MUTEX_INITIALIZER    { MUTEX_TYPE_ERRORCHECK, 0, NULL, 0, NULL }
 
 /** \brief  Initializer for a transient recursive mutex. */
-#define RECURSIVE_MUTEX_INITIALIZER     { MUTEX_TYPE_RECURSIVE, 0, NULL, 0 }
+#define RECURSIVE_MUTEX_INITIALIZER     { MUTEX_TYPE_RECURSIVE, 0, NULL, 0, NULL }
 
 /** \brief  Allocate a new mutex.
 
@@ -137,7 +152,8 @@ int mutex_init(mutex_t *m, int mtype);
     threads waiting on the mutex are taken care of before destroying the mutex.
 
     This function can be called on statically initialized as well as dynamically
-    initialized mutexes.
+    initialized mutexes. A locked mutex is left alone, even one that came from
+    mutex_create(), so it can be destroyed again once it has been unlocked.
 
     \retval 0               On success
     \retval -1              On error, errno will be set as appropriate
@@ -163,7 +179,9 @@ int mutex_destroy(mutex_t *m);
     \em     EPERM - called inside an interrupt \n
     \em     EINVAL - the mutex has not been initialized properly \n
     \em     EAGAIN - lock has been acquired too many times (recursive) \n
-    \em     EDEADLK - would deadlock (error-checking)
+    \em     EDEADLK - would deadlock (error-checking) \n
+    \em     EOWNERDEAD - the holder exited or was destroyed while still holding
+                         the mutex
 */
 int mutex_lock(mutex_t *m);
 
@@ -186,7 +204,9 @@ int mutex_lock(mutex_t *m);
     \em     EINVAL - the timeout value was invalid (less than 0) \n
     \em     ETIMEDOUT - the timeout expired \n
     \em     EAGAIN - lock has been acquired too many times (recursive) \n
-    \em     EDEADLK - would deadlock (error-checking)
+    \em     EDEADLK - would deadlock (error-checking) \n
+    \em     EOWNERDEAD - the holder exited or was destroyed while still holding
+                         the mutex
 */
 int mutex_lock_timed(mutex_t *m, int timeout);
 
@@ -255,6 +275,23 @@ int mutex_unlock(mutex_t *m);
 */
 int mutex_unlock_as_thread(mutex_t *m, kthread_t *thd);
 
+/** \cond */
+/* Work out the priority a thread should run at from its own and those of the
+   threads waiting on mutexes it holds, and pass any change on to the holder
+   of the mutex it's waiting for. Interrupts must be disabled. */
+void mutex_pi_update(kthread_t *thd);
+
+/* Unlock every mutex a thread holds, for a thread that's exiting or being
+   destroyed, with a warning for each. Threads waiting for them aren't given
+   them, but fail with EOWNERDEAD. Interrupts must be disabled. */
+void mutex_release_all(kthread_t *thd);
+
+/* Have a thread sleeping on obj wait for the mutex instead, or give it the
+   mutex if it's free. Returns 0 if the thread should just be woken. Used by
+   the condition variables; interrupts must be disabled. */
+int mutex_wait_morph(mutex_t *m, void *obj, kthread_t *thd);
+/** \endcond */
+
 __END_DECLS
 
 #endif  /* __KOS_MUTEX_H */
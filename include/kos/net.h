@@ -26,6 +26,7 @@ __BEGIN_DECLS
 #include <arch/types.h>
 #include <sys/queue.h>
 #include <netinet/in.h>
+#include <kos/heap.h>
 
 /* All functions in this header return < 0 on failure, and 0 on success. */
 
@@ -996,6 +997,17 @@ int net_init(uint32 ip);
 */
 void net_shutdown(void);
 
+/** \brief   Heap for the network stack.
+    \ingroup networking_drivers
+
+    If this is set, the network stack allocates its sockets, packet queues,
+    ARP and neighbor entries and so on from this heap rather than the main
+    one, so that however much traffic comes in, it can only use up the heap
+    it's been given. Set it before net_init(), and leave it alone until after
+    net_shutdown(). NULL, the default, means the main heap.
+*/
+extern kos_heap_t *net_heap;
+
 __END_DECLS
 
 #endif  /* __KOS_NET_H */
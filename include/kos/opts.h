@@ -50,6 +50,13 @@ __BEGIN_DECLS
    sometimes catches corrupted blocks. Recommended during debugging phases. */
 /* #define MALLOC_DEBUG 1 */
 
+/* Enable this define to put a small object allocator in front of malloc,
+   serving requests of up to 512 bytes from slabs of same-sized objects. It's
+   faster for some workloads but currently uses more memory than plain
+   dlmalloc (see utils/mallocbench), so it's off by default. It's always off
+   with KM_DBG. */
+/* #define MALLOC_SLAB 1 */
+
 /* Enable this define if you want costly malloc debugging (buffer sentinel
    checking, block leak checking, etc). Recommended during debugging phases, but
    you should probably take it out before you start your final testing. */
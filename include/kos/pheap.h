@@ -0,0 +1,109 @@
+/* KallistiOS ##version##
+
+   include/kos/pheap.h
+   Copyright (C) 2026 KallistiOS Team
+
+*/
+
+/** \file    kos/pheap.h
+    \brief   Intrusive pairing heaps.
+    \ingroup kthreads
+
+    This is the priority queue the kernel keeps timed events in: genwait's
+    queue of threads with a timeout, and the high-resolution timers. Like the
+    lists in sys/queue.h, a node is embedded in whatever is being queued, so
+    nothing has to be allocated to queue it (which matters with interrupts
+    disabled). Inserting is constant time, and removing any node is
+    O(log n) amortized.
+
+    The heap doesn't do any locking of its own.
+*/
+
+#ifndef __KOS_PHEAP_H
+#define __KOS_PHEAP_H
+
+#include <kos/cdefs.h>
+
+__BEGIN_DECLS
+
+#include <stddef.h>
+
+/** \brief  Pairing heap node.
+
+    Embed one of these in the structure to be queued. The members should be
+    considered to be private.
+
+    \headerfile kos/pheap.h
+*/
+typedef struct pheap_node {
+    /** \cond */
+    struct pheap_node *child;   /* First child */
+    struct pheap_node *next;    /* Next sibling */
+    struct pheap_node *prev;    /* Previous sibling, or parent */
+    /** \endcond */
+} pheap_node_t;
+
+/** \brief  Pairing heap ordering function.
+
+    \param  a               The first node.
+    \param  b               The second node.
+    \return                 Non-zero if a goes before b.
+*/
+typedef int (*pheap_less_t)(const pheap_node_t *a, const pheap_node_t *b);
+
+/** \brief  Pairing heap structure.
+
+    \headerfile kos/pheap.h
+*/
+typedef struct pheap {
+    /** \brief  The first node, or NULL if the heap is empty. */
+    pheap_node_t *root;
+
+    /** \brief  How the nodes are ordered. */
+    pheap_less_t less;
+} pheap_t;
+
+/** \brief  Initializer for a pheap_t.
+
+    \param  less            The ordering function.
+*/
+#define PHEAP_INITIALIZER(less) { NULL, (less) }
+
+/** \brief  Get the structure a node is embedded in.
+
+    \param  node            The node.
+    \param  type            The type of the structure.
+    \param  field           The name of the node in the structure.
+*/
+#define PHEAP_ENTRY(node, type, field) \
+    ((type *)((char *)(node) - offsetof(type, field)))
+
+/** \brief  Get the first node in a heap.
+
+    \param  heap            The heap.
+    \return                 The node that goes first, or NULL if the heap is
+                            empty.
+*/
+static inline pheap_node_t *pheap_first(const pheap_t *heap) {
+    return heap->root;
+}
+
+/** \brief  Add a node to a heap.
+
+    Nodes that tie are not kept in any particular order.
+
+    \param  heap            The heap.
+    \param  node            The node, which must not be on a heap already.
+*/
+void pheap_insert(pheap_t *heap, pheap_node_t *node);
+
+/** \brief  Remove a node from a heap.
+
+    \param  heap            The heap.
+    \param  node            The node, which must be on this heap.
+*/
+void pheap_remove(pheap_t *heap, pheap_node_t *node);
+
+__END_DECLS
+
+#endif  /* __KOS_PHEAP_H */
@@ -34,6 +34,7 @@ __BEGIN_DECLS
 
 #include <kos/cdefs.h>
 #include <kos/tls.h>
+#include <kos/pheap.h>
 #include <arch/irq.h>
 #include <sys/queue.h>
 #include <sys/reent.h>
@@ -112,6 +113,64 @@ typedef struct tcbhead {
     uintptr_t pointer_guard; /**< \brief Pointer guard (unused) */
 } tcbhead_t;
 
+/* \cond */
+struct kos_mutex;
+struct fiber;
+/* \endcond */
+
+/** \brief   Scheduler accounting for one thread.
+
+    The scheduler keeps these up to date as it switches threads; use
+    thd_get_acct() to read them, which also counts the time the thread has
+    spent in its current state. All times are in nanoseconds, as returned by
+    timer_ns_gettime64().
+
+    \headerfile kos/thread.h
+*/
+typedef struct kthread_acct {
+    uint64_t cpu_time;          /**< \brief Time spent running */
+    uint64_t ready_time;        /**< \brief Time spent waiting for the CPU */
+    uint64_t blocked_time;      /**< \brief Time spent blocked */
+    uint64_t last_run;          /**< \brief When the thread last started running */
+    uint32_t vol_switches;      /**< \brief Switches away from the thread
+                                             because it blocked, yielded or
+                                             exited */
+    uint32_t invol_switches;    /**< \brief Switches away from the thread
+                                             because it was pre-empted */
+
+    /* \cond */
+    uint64_t since;             /* Start of the interval not yet counted */
+    uint64_t woken;             /* When it was made ready, if it blocked */
+    /* \endcond */
+} kthread_acct_t;
+
+/** \brief   Deadline scheduling parameters and statistics.
+
+    A thread with a non-zero period is scheduled by earliest deadline first,
+    ahead of every thread scheduled by priority. Each period, it may use up
+    to budget microseconds of CPU time, and should be done by deadline
+    microseconds after the period started. Use thd_set_edf() to set these
+    up, rather than changing them here.
+
+    \headerfile kos/thread.h
+*/
+typedef struct kthread_edf {
+    uint32_t period;            /**< \brief Period in microseconds, or 0 */
+    uint32_t budget;            /**< \brief CPU time allowed each period */
+    uint32_t deadline;          /**< \brief Deadline, from the period start */
+    uint32_t overruns;          /**< \brief Periods the budget ran out in */
+    uint32_t misses;            /**< \brief Jobs that finished late */
+
+    /* \cond */
+    uint64_t period_start;      /* Start of the current period, in ns */
+    uint64_t abs_deadline;      /* Deadline of the current period */
+    uint64_t job_deadline;      /* Deadline of the job being run */
+    uint64_t used;              /* CPU time used this period */
+    uint64_t run_start;         /* When it last started running */
+    int throttled;              /* Out of budget until the next period */
+    /* \endcond */
+} kthread_edf_t;
+
 /** \brief   Structure describing one running thread.
 
     Each thread has one of these structures assigned to it, which holds all the
@@ -130,15 +189,23 @@ typedef __attribute__((aligned(32))) struct kthread {
     /** \brief  Run/Wait queue handle. Once again, not a function. */
     TAILQ_ENTRY(kthread) thdq;
 
-    /** \brief  Timer queue handle (if applicable). Also not a function. */
-    TAILQ_ENTRY(kthread) timerq;
+    /** \brief  Timer queue handle (if applicable). Also not a function.
+
+        The timer queue is a pairing heap; see kos/pheap.h. */
+    pheap_node_t timerq;
 
     /** \brief  Kernel thread id. */
     tid_t tid;
 
-    /** \brief  Static priority: 0..PRIO_MAX (higher means lower priority). */
+    /** \brief  Current priority: 0..PRIO_MAX (higher means lower priority).
+                This is base_prio, unless the thread holds a mutex that a
+                higher priority thread is waiting for, in which case it is
+                raised to match. */
     prio_t prio;
 
+    /** \brief  Static priority, as set with thd_set_prio(). */
+    prio_t base_prio;
+
     /** \brief  Thread flags.
         \see    thd_flags   */
     uint32_t flags;
@@ -170,6 +237,29 @@ typedef __attribute__((aligned(32))) struct kthread {
         enough for something like 2 million years of wait time. ;) */
     uint64_t wait_timeout;
 
+    /** \brief  Scheduler accounting.
+        \see    thd_get_acct    */
+    kthread_acct_t acct;
+
+    /** \brief  Deadline scheduling.
+        \see    thd_set_edf */
+    kthread_edf_t edf;
+
+    /** \brief  Mutexes held by the thread, for priority inheritance. */
+    struct kos_mutex *mutex_held;
+
+    /** \brief  Mutex the thread is blocked on, if any. */
+    struct kos_mutex *mutex_wait;
+
+    /** \brief  Mutex to take back when woken from a condition variable.
+        This is cleared if the mutex is handed over when the thread is
+        signalled. */
+    struct kos_mutex *cond_mutex;
+
+    /** \brief  Fiber running on the thread, if any.
+        \see    kos/fiber.h */
+    struct fiber *fiber;
+
     /** \brief  Thread label.
         This value is used when printing out a user-readable process listing. */
     char label[KTHREAD_LABEL_SIZE];
@@ -190,9 +280,12 @@ typedef __attribute__((aligned(32))) struct kthread {
     /** \brief  Our reent struct for newlib. */
     struct _reent thd_reent;
 
-    /** \brief  OS-level thread-local storage.
+    /** \brief  OS-level thread-local storage, indexed by key.
         \see    kos/tls.h   */
-    struct kthread_tls_kv_list tls_list;
+    void **tls_data;
+
+    /** \brief  Number of entries in tls_data. */
+    size_t tls_size;
 
     /** \brief Compiler-level thread-local storage. */
     tcbhead_t* tcbhead;
@@ -214,6 +307,7 @@ typedef __attribute__((aligned(32))) struct kthread {
 #define THD_USER        1       /**< \brief Thread runs in user mode */
 #define THD_QUEUED      2       /**< \brief Thread is in the run queue */
 #define THD_DETACHED    4       /**< \brief Thread is detached */
+#define THD_OWN_STACK   8       /**< \brief Thread's stack was allocated by KOS */
 /** @} */
 
 /** \name     Thread states
@@ -347,6 +441,19 @@ void thd_add_to_runnable(kthread_t *t, int front_of_line);
 */
 int thd_remove_from_runnable(kthread_t *thd);
 
+/** \brief       Change the priority the scheduler uses for a thread.
+    \relatesalso kthread_t
+
+    This function sets a thread's current priority without touching the one
+    set with thd_set_prio(), moving it within the run queue if it's there.
+    It's used by the mutexes for priority inheritance. Generally, you will not
+    have to do this manually. Interrupts must be disabled.
+
+    \param  thd             The thread to change the priority of.
+    \param  prio            The priority it should run at.
+*/
+void thd_apply_prio(kthread_t *thd, prio_t prio);
+
 /** \brief       Create a new thread.
     \relatesalso kthread_t
 
@@ -436,7 +543,9 @@ void thd_schedule(int front_of_line, uint64_t now);
 
     This function promotes the given thread to be the next one that will be
     swapped in by the scheduler. This function is only callable inside an
-    interrupt context (it simply returns otherwise).
+    interrupt context (it simply returns otherwise). It also does nothing for
+    a thread that isn't ready to run, or a deadline thread that has used up
+    its budget for the current period.
 */
 void thd_schedule_next(kthread_t *thd);
 
@@ -591,6 +700,113 @@ int thd_set_mode(int mode) __deprecated;
 */
 int thd_get_mode(void) __deprecated;
 
+/** \brief   Enable or disable tickless scheduling.
+
+    By default, the scheduler is run HZ times per second whatever the threads
+    are doing. In tickless mode, the primary timer is instead set for the end
+    of the current thread's timeslice or the earliest timed wait, whichever
+    comes first, and is not run at all while every thread is blocked with
+    nothing to time out. This saves interrupts when the system is idle, and
+    lets timed waits end on the millisecond they're due rather than on the
+    next tick.
+
+    Tickless mode can also be turned on at startup with INIT_THD_TICKLESS.
+
+    \param  enable          Non-zero to enable tickless mode, zero to go back
+                            to a periodic tick.
+    \return                 The old setting, or -1 if threads aren't running.
+*/
+int thd_set_tickless(int enable);
+
+/** \brief   Put a thread in the deadline scheduling class.
+
+    This schedules the thread by earliest deadline first among the threads
+    that have been given a period, and ahead of all threads scheduled by
+    priority. Its first period starts now. It's expected to call
+    thd_edf_wait() when it's done its work for each period.
+
+    The thread's budget is enforced: once it has used that much CPU time in a
+    period, it's not run again until the next one, the overrun is counted in
+    kthread_edf_t::overruns, and the overrun handler is called. A job that
+    calls thd_edf_wait() after its deadline is counted as a miss.
+
+    So that the deadlines can all be met, the total of budget / deadline over
+    all deadline threads can't go over 1. Budgets are enforced to the
+    resolution of the primary timer, a millisecond.
+
+    \param  thd             The thread to change.
+    \param  period          The thread's period in microseconds, or 0 to go
+                            back to being scheduled by priority.
+    \param  budget          The CPU time it may use each period, in
+                            microseconds.
+    \param  deadline        When its work is due, in microseconds from the
+                            start of each period, or 0 for the end of the
+                            period.
+
+    \retval 0               On success.
+    \retval -1              On error, errno will be set as appropriate.
+
+    \par    Error Conditions:
+    \em     EINVAL - the budget is 0 or more than the deadline, or the
+                     deadline is more than the period \n
+    \em     EBUSY - the deadline threads would need more than all of the
+                    CPU between them
+*/
+int thd_set_edf(kthread_t *thd, uint32_t period, uint32_t budget,
+                uint32_t deadline);
+
+/** \brief   Finish this period's work.
+
+    This is called by a deadline thread when it's finished its work for the
+    current period. It sleeps until the next period starts, when its budget
+    is replenished. If the next period has already started, it returns
+    straight away. It does nothing in a thread that isn't a deadline thread.
+*/
+void thd_edf_wait(void);
+
+/** \brief   Budget overrun handler type.
+
+    \param  thd             The deadline thread that ran out of budget.
+*/
+typedef void (*thd_edf_handler_t)(kthread_t *thd);
+
+/** \brief   Set a handler for budget overruns.
+
+    The handler is called from the scheduler, inside an interrupt, each time
+    a deadline thread runs out of budget in a period.
+
+    \param  handler         The function to call, or NULL for none.
+    \return                 The old handler.
+*/
+thd_edf_handler_t thd_edf_set_overrun_handler(thd_edf_handler_t handler);
+
+/** \brief   Default size of the thread pool.
+
+    This is how many stacks and how many thread structures are kept for reuse
+    by default.
+
+    \see thd_pool_set_limit
+*/
+#define THD_POOL_DEFAULT    4
+
+/** \brief   Set the high-water mark of the thread pool.
+
+    When a thread is reaped, its stack and thread structure are kept back to
+    be handed out to the next thread created, rather than freed. This saves
+    the allocations and the heap fragmentation when threads are created and
+    exit often. Stacks are only reused for threads asking for the same stack
+    size, and stacks passed in with kthread_attr_t::stack_ptr are never
+    pooled.
+
+    At most limit stacks and limit thread structures are kept; anything over
+    that is freed, including whatever is already in the pool when the limit
+    is lowered. Setting it to 0 turns the pool off and empties it.
+
+    \param  limit           The most stacks and thread structures to keep.
+    \return                 The old limit.
+*/
+size_t thd_pool_set_limit(size_t limit);
+
 /** \brief       Wait for a thread to exit.
     \relatesalso kthread_t
 
@@ -658,6 +874,96 @@ int thd_pslist(int (*pf)(const char *fmt, ...));
 */
 int thd_pslist_queue(int (*pf)(const char *fmt, ...));
 
+/** \brief       Retrieve a thread's scheduler accounting.
+    \relatesalso kthread_t
+
+    This function copies out the accounting for the given thread, including
+    the time it has been in its current state so far.
+
+    \param  thd             The thread to look at.
+    \param  acct            Where to put the accounting.
+
+    \retval 0               On success.
+    \retval -1              If thd is NULL.
+*/
+int thd_get_acct(kthread_t *thd, kthread_acct_t *acct);
+
+/** \brief   Print scheduler accounting for all threads.
+
+    This prints the CPU time of each thread, with its share of the time since
+    the threads started, along with the rest of the accounting in
+    kthread_acct_t.
+
+    \param  pf              The printf-like function to print with.
+
+    \retval 0               On success.
+
+    \sa thd_pslist
+*/
+int thd_pslist_acct(int (*pf)(const char *fmt, ...));
+
+/** \name     Context switch reasons
+    \brief    thd_trace_event_t::reason values
+
+    @{
+*/
+#define THD_SWITCH_PREEMPT  0   /**< \brief Timeslice over or IRQ wakeup */
+#define THD_SWITCH_YIELD    1   /**< \brief Thread passed the CPU on */
+#define THD_SWITCH_BLOCK    2   /**< \brief Thread blocked */
+#define THD_SWITCH_EXIT     3   /**< \brief Thread exited */
+/** @} */
+
+/** \brief   One context switch, as recorded by the scheduler trace.
+
+    \headerfile kos/thread.h
+*/
+typedef struct thd_trace_event {
+    uint64_t time;      /**< \brief When it happened (timer_ns_gettime64) */
+    tid_t from;         /**< \brief Thread switched away from */
+    tid_t to;           /**< \brief Thread switched to */
+    int reason;         /**< \brief Why, one of the THD_SWITCH values */
+} thd_trace_event_t;
+
+/** \brief   Start or stop recording context switches.
+
+    This sets up a ring buffer that the scheduler records each context switch
+    in. Once it's full, the oldest events are overwritten. Starting the trace
+    again throws away anything recorded so far.
+
+    \param  entries         The number of events to keep, or 0 to stop
+                            tracing and free the buffer.
+
+    \retval 0               On success.
+    \retval -1              If the buffer couldn't be allocated.
+*/
+int thd_trace_enable(size_t entries);
+
+/** \brief   Take events out of the context switch trace.
+
+    This copies up to count of the oldest events recorded and removes them
+    from the trace, so it can be called regularly to stream the trace out.
+
+    \param  events          Where to put the events.
+    \param  count           The most events to copy.
+
+    \return                 The number of events copied.
+*/
+size_t thd_trace_read(thd_trace_event_t *events, size_t count);
+
+/** \brief   Print and empty the context switch trace.
+
+    This prints everything in the trace, oldest first, as one line per event,
+    along with the number of events that were overwritten before they could
+    be read. Pass dbgio_printf to send it to the host.
+
+    \param  pf              The printf-like function to print with.
+
+    \retval 0               On success.
+
+    \sa thd_trace_read
+*/
+int thd_trace_dump(int (*pf)(const char *fmt, ...));
+
 /** \brief   Initialize the threading system.
 
     This is normally done for you by default when KOS starts. This will also
@@ -0,0 +1,207 @@
+/* KallistiOS ##version##
+
+   include/kos/workqueue.h
+   Copyright (C) 2026 KallistiOS Team
+
+*/
+
+/** \file    kos/workqueue.h
+    \brief   Work queues.
+    \ingroup kthreads
+
+    A work queue is a fixed set of worker threads that run work items handed
+    to them by the rest of the system, so that background jobs don't each
+    need a thread (and a stack) of their own sitting idle most of the time.
+
+    A work item is a function to call and a pointer to pass it, along with a
+    priority: when there's more work queued than workers to run it, lower
+    numbers are run first, just like thread priorities. Work can be queued to
+    run as soon as a worker is free, or after a delay, and can be cancelled
+    any time until a worker picks it up. A work item is only ever on one
+    queue once; queueing it again while it's still waiting does nothing, but
+    it can be queued again once it's started running, including from its own
+    function, to make it run periodically.
+
+    Work items belong to whoever queues them, and must stay around until
+    they've been run, cancelled or waited for. A work function is free to
+    free its own work item, though, as the worker doesn't touch it again
+    after calling it.
+*/
+
+#ifndef __KOS_WORKQUEUE_H
+#define __KOS_WORKQUEUE_H
+
+#include <kos/cdefs.h>
+
+__BEGIN_DECLS
+
+#include <stdint.h>
+#include <sys/queue.h>
+#include <kos/thread.h>
+
+/** \brief  Work queue structure.
+
+    This is private to the work queue code; use workqueue_create() to get
+    one.
+
+    \headerfile kos/workqueue.h
+*/
+typedef struct workqueue workqueue_t;
+
+/** \brief  Work item structure.
+
+    Set one of these up with work_init() before queueing it. All members of
+    this structure other than data should be considered to be private.
+
+    \headerfile kos/workqueue.h
+*/
+typedef struct work {
+    /** \cond */
+    TAILQ_ENTRY(work) entry;    /* Pending or delayed list entry */
+    workqueue_t *wq;            /* Queue it was last put on */
+    int state;                  /* Whether it's waiting, and on what list */
+    int prio;                   /* Priority, lower runs first */
+    uint64_t when;              /* When delayed work is due, in ms */
+    /** \endcond */
+
+    /** \brief  The function to run. */
+    void (*func)(struct work *work);
+
+    /** \brief  Data for the function, not touched by the work queue. */
+    void *data;
+} work_t;
+
+/** \brief  Create a work queue.
+
+    This starts up a set of worker threads to run work items. They're
+    created with the attributes given, so the stack size, priority and label
+    can all be chosen (each worker's label is the given one, or "[workqueue]"
+    if there isn't one). The workers must be joinable, so create_detached is
+    ignored, as is stack_ptr.
+
+    \param  workers         The number of worker threads to start.
+    \param  attr            Attributes for the workers, or NULL for the
+                            defaults.
+
+    \return                 The new work queue, or NULL on failure (errno
+                            will be set as appropriate).
+
+    \par    Error Conditions:
+    \em     EINVAL - workers is less than 1 \n
+    \em     ENOMEM - out of memory
+*/
+workqueue_t *workqueue_create(int workers, const kthread_attr_t *attr);
+
+/** \brief  Destroy a work queue.
+
+    This stops the workers, waiting for any work they're running to finish
+    first. Anything still queued is dropped without being run, as though it
+    was cancelled. Nothing may be waiting on the work queue or its work when
+    it's destroyed, and it mustn't be destroyed from one of its own workers.
+
+    \param  wq              The work queue to destroy.
+*/
+void workqueue_destroy(workqueue_t *wq);
+
+/** \brief  Wait for all the work on a work queue to be done.
+
+    This blocks until nothing is left queued to run on the work queue and
+    none of its workers are busy. Delayed work that isn't due yet isn't
+    waited for. This must not be called from one of the work queue's own
+    workers, and is not safe to call inside an interrupt.
+
+    \param  wq              The work queue to wait on.
+
+    \retval 0               On success.
+    \retval -1              On error, errno will be set as appropriate.
+
+    \par    Error Conditions:
+    \em     EPERM - called inside an interrupt \n
+    \em     EDEADLK - called from one of the queue's own workers
+*/
+int workqueue_flush(workqueue_t *wq);
+
+/** \brief  Is the current thread one of a work queue's workers?
+
+    \param  wq              The work queue to check.
+    \return                 Non-zero if the caller is a worker of wq.
+*/
+int workqueue_is_worker(workqueue_t *wq);
+
+/** \brief  Set up a work item.
+
+    \param  work            The work item to set up.
+    \param  func            The function to run.
+    \param  data            Data for the function, in work->data.
+    \param  prio            The work item's priority. Lower numbers run
+                            first.
+*/
+void work_init(work_t *work, void (*func)(work_t *work), void *data, int prio);
+
+/** \brief  Queue work to run as soon as possible.
+
+    This puts the work item on the work queue, ahead of anything with a
+    higher priority number and behind anything else already waiting. This
+    is safe to call inside an interrupt.
+
+    \param  wq              The work queue to run the work on.
+    \param  work            The work item to queue.
+
+    \retval 0               If the work was queued.
+    \retval 1               If it was already queued, either to run now or
+                            after a delay, and has been left alone.
+*/
+int work_queue(workqueue_t *wq, work_t *work);
+
+/** \brief  Queue work to run after a delay.
+
+    This queues the work item to be run once the delay is up. It's then run
+    in priority order with any other work waiting at the time. This is safe
+    to call inside an interrupt.
+
+    \param  wq              The work queue to run the work on.
+    \param  work            The work item to queue.
+    \param  delay           How long to wait before running it, in
+                            milliseconds.
+
+    \retval 0               If the work was queued.
+    \retval 1               If it was already queued, and has been left
+                            alone.
+*/
+int work_queue_delayed(workqueue_t *wq, work_t *work, unsigned int delay);
+
+/** \brief  Cancel queued work.
+
+    This takes the work item off its queue if it hasn't started running yet.
+    It doesn't wait for it if it's already running; use work_wait() for that.
+    Work that queues itself again from its own function will carry on doing
+    so, and has to be told to stop some other way. This is safe to call
+    inside an interrupt.
+
+    \param  work            The work item to cancel.
+
+    \retval 1               If the work was taken off its queue.
+    \retval 0               If it wasn't queued.
+*/
+int work_cancel(work_t *work);
+
+/** \brief  Wait for work to be done.
+
+    This blocks until the work item is neither queued to run nor running.
+    Delayed work is waited for too. It's not safe to call inside an
+    interrupt.
+
+    \param  work            The work item to wait for.
+
+    \retval 0               On success.
+    \retval -1              On error, errno will be set as appropriate.
+
+    \par    Error Conditions:
+    \em     EPERM - called inside an interrupt \n
+    \em     EDEADLK - called from the work item's own function
+*/
+int work_wait(work_t *work);
+
+__END_DECLS
+
+#endif /* __KOS_WORKQUEUE_H */
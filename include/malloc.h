@@ -222,6 +222,37 @@ int  mallopt(int, int);
 */
 void malloc_stats(void);
 
+/** \brief  Statistics for one size class of the small object allocator.
+
+    When KOS is built with MALLOC_SLAB (see kos/opts.h), requests of up to
+    512 bytes are rounded up to one of a set of size classes and served from
+    slabs, pages of objects of that size, rather than from the main heap.
+    This describes one of those classes.
+
+    \see    malloc_slab_info
+*/
+struct malloc_slab_info {
+    size_t size;            /**< \brief Object size */
+    size_t slabs;           /**< \brief Slabs the class has */
+    size_t inuse;           /**< \brief Objects allocated */
+    size_t free;            /**< \brief Objects free in its slabs */
+    unsigned long allocs;   /**< \brief Total objects allocated */
+    unsigned long frees;    /**< \brief Total objects freed */
+};
+
+/** \brief  Get statistics for the small object allocator.
+
+    This fills in statistics for each of the small object allocator's size
+    classes, smallest first. The space the slabs take up is also counted as
+    in use by mallinfo() and malloc_stats().
+
+    \param  info            Where to put the statistics.
+    \param  count           The number of entries info has room for.
+    \return                 The number of entries filled in, which is 0 if the
+                            small object allocator is disabled.
+*/
+int malloc_slab_info(struct malloc_slab_info *info, int count);
+
 /** \brief  Determine if it is safe to call malloc() in an IRQ context.
 
     This function checks the value of the internal spinlock that is used for
@@ -190,7 +190,12 @@ static uint32 iso_733(const uint8 *from) {
 /* Low-level block caching routines. This implements a simple queue-based
    LRU/MRU caching system. Whenever a block is requested, it will be placed
    on the MRU end of the queue. As more blocks are loaded than can fit in
-   the cache, blocks are deleted from the LRU end. */
+   the cache, blocks are deleted from the LRU end.
+
+   The size of the caches and the replacement policy are variables so that
+   utils/isotest, which builds this file on the host, can replay traces
+   against other configurations. The kernel itself always uses the
+   defaults. */
 
 /* Holds the data for one cache block, and a pointer to the next one.
    As sectors are read from the disc, they are added to the front of
@@ -201,10 +206,24 @@ typedef struct {
     uint8   data[2048];     /* Sector data */
 } cache_block_t;
 
+/* Hit and miss counts for one cache */
+typedef struct {
+    uint32  hits;
+    uint32  misses;
+} cache_stats_t;
+
+/* Replacement policies */
+#define CACHE_LRU   0   /* Hits and new blocks go to the MRU end */
+#define CACHE_FIFO  1   /* Only new blocks go to the MRU end */
+#define CACHE_LIP   2   /* New blocks stay at the LRU end until they hit */
+
 /* List of cache blocks (ordered least recently used to most recently) */
 #define NUM_CACHE_BLOCKS 16
-static cache_block_t *icache[NUM_CACHE_BLOCKS];     /* inode cache */
-static cache_block_t *dcache[NUM_CACHE_BLOCKS];     /* data cache */
+static int cache_blocks = NUM_CACHE_BLOCKS;
+static int cache_policy = CACHE_LRU;
+static cache_block_t **icache;      /* inode cache */
+static cache_block_t **dcache;      /* data cache */
+static cache_stats_t istats, dstats;
 
 /* Cache modification mutex */
 static mutex_t cache_mutex;
@@ -215,7 +234,7 @@ static void bclear_cache(cache_block_t **cache) {
 
     mutex_lock(&cache_mutex);
 
-    for(i = 0; i < NUM_CACHE_BLOCKS; i++)
+    for(i = 0; i < cache_blocks; i++)
         cache[i]->sector = (uint32)-1;
 
     mutex_unlock(&cache_mutex);
@@ -227,47 +246,57 @@ static void bgrad_cache(cache_block_t **cache, int block) {
     cache_block_t   *tmp;
 
     /* Don't try it with the end block */
-    if(block < 0 || block >= (NUM_CACHE_BLOCKS - 1)) return;
+    if(block < 0 || block >= (cache_blocks - 1)) return;
 
     /* Make a copy and scoot everything down */
     tmp = cache[block];
 
-    for(i = block; i < (NUM_CACHE_BLOCKS - 1); i++)
+    for(i = block; i < (cache_blocks - 1); i++)
         cache[i] = cache[i + 1];
 
-    cache[NUM_CACHE_BLOCKS - 1] = tmp;
+    cache[cache_blocks - 1] = tmp;
 }
 
 /* Pulls the requested sector into a cache block and returns the cache
    block index. Note that the sector in question may already be in the
    cache, in which case it just returns the containing block. */
 static void iso_break_all(void);
-static int bread_cache(cache_block_t **cache, uint32 sector) {
+static int bread_cache(cache_block_t **cache, cache_stats_t *stats,
+                       uint32 sector) {
     int i, j, rv;
 
     rv = -1;
     mutex_lock(&cache_mutex);
 
     /* Look for a pre-existing cache block */
-    for(i = NUM_CACHE_BLOCKS - 1; i >= 0; i--) {
+    for(i = cache_blocks - 1; i >= 0; i--) {
         if(cache[i]->sector == sector) {
-            bgrad_cache(cache, i);
-            rv = NUM_CACHE_BLOCKS - 1;
+            stats->hits++;
+
+            if(cache_policy == CACHE_FIFO) {
+                rv = i;
+            }
+            else {
+                bgrad_cache(cache, i);
+                rv = cache_blocks - 1;
+            }
+
             goto bread_exit;
         }
     }
 
     /* If not, look for an open cache slot; if we find one, use it */
-    for(i = 0; i < NUM_CACHE_BLOCKS; i++) {
+    for(i = 0; i < cache_blocks; i++) {
         if(cache[i]->sector == (uint32)-1) break;
     }
 
     /* If we didn't find one, kick an LRU block out of cache */
-    if(i >= NUM_CACHE_BLOCKS) {
+    if(i >= cache_blocks) {
         i = 0;
     }
 
     /* Load the requested block */
+    stats->misses++;
     j = cdrom_read_sectors(cache[i]->data, sector + 150, 1);
 
     if(j < 0) {
@@ -283,9 +312,15 @@ static int bread_cache(cache_block_t **cache, uint32 sector) {
 
     cache[i]->sector = sector;
 
-    /* Move it to the most-recently-used position */
-    bgrad_cache(cache, i);
-    rv = NUM_CACHE_BLOCKS - 1;
+    /* Move it to the most-recently-used position, unless it has to earn
+       its place there */
+    if(cache_policy == CACHE_LIP) {
+        rv = i;
+    }
+    else {
+        bgrad_cache(cache, i);
+        rv = cache_blocks - 1;
+    }
 
     /* Return the new cache block index */
 bread_exit:
@@ -295,12 +330,12 @@ bread_exit:
 
 /* read data block */
 static int bdread(uint32 sector) {
-    return bread_cache(dcache, sector);
+    return bread_cache(dcache, &dstats, sector);
 }
 
 /* read inode block */
 static int biread(uint32 sector) {
-    return bread_cache(icache, sector);
+    return bread_cache(icache, &istats, sector);
 }
 
 /* Clear both caches */
@@ -1066,7 +1101,10 @@ int fs_iso9660_init(void) {
     mutex_init(&fh_mutex, MUTEX_TYPE_NORMAL);
 
     /* Allocate cache block space */
-    for(i = 0; i < NUM_CACHE_BLOCKS; i++) {
+    icache = malloc(cache_blocks * sizeof(cache_block_t *));
+    dcache = malloc(cache_blocks * sizeof(cache_block_t *));
+
+    for(i = 0; i < cache_blocks; i++) {
         icache[i] = malloc(sizeof(cache_block_t));
         icache[i]->sector = -1;
         dcache[i] = malloc(sizeof(cache_block_t));
@@ -1091,11 +1129,14 @@ int fs_iso9660_shutdown(void) {
     vblank_handler_remove(iso_vblank_hnd);
 
     /* Dealloc cache block space */
-    for(i = 0; i < NUM_CACHE_BLOCKS; i++) {
+    for(i = 0; i < cache_blocks; i++) {
         free(icache[i]);
         free(dcache[i]);
     }
 
+    free(icache);
+    free(dcache);
+
     /* Free muteces */
     mutex_destroy(&cache_mutex);
     mutex_destroy(&fh_mutex);
@@ -742,9 +742,10 @@ void modemIntResetControlCode(void) {
     modemCallbackCode = NULL;
 }
 
-/* Timeout timer interrupt code. It uses TMU1 and can be setup to either set
-   a flag to a non zero value, call a function, or both when a timer interrupt
-   is generated until it's stopped. */
+/* Timeout timer interrupt code. It uses TMU1, claimed from the secondary
+   timer between setup and shutdown, and can be setup to either set a flag to
+   a non zero value, call a function, or both when a timer interrupt is
+   generated until it's stopped. */
 
 static void modemIntrTimeoutCallback(irq_t source, irq_context_t *context) {
     (void)source;
@@ -763,6 +764,9 @@ void modemIntSetupTimeoutTimer(int bps, unsigned char *callbackFlag,
     modemTimeoutCallbackCode = callbackCode;
 
     /* Setup TMU1 so it can act as a timeout indicator */
+    if(!(modemInternalFlags & MODEM_INTERNAL_FLAG_TIMER_HANDLER_SET))
+        timer_secondary_claim();
+
     timer_stop(TMU1);
 
     /* Make sure the timeout variable is reset */
@@ -799,8 +803,9 @@ void modemIntShutdownTimeoutTimer(void) {
     /* Stop the timer if it's still running */
     modemIntResetTimeoutTimer();
 
+    /* Hand TMU1 back, which puts its usual handler back too */
     if(modemInternalFlags & MODEM_INTERNAL_FLAG_TIMER_HANDLER_SET) {
-        irq_set_handler(EXC_TMU1_TUNI1, NULL);
+        timer_secondary_release();
         modemInternalFlags &= ~MODEM_INTERNAL_FLAG_TIMER_HANDLER_SET;
     }
 }
@@ -1012,7 +1012,7 @@ static int bba_if_start(netif_t *self) {
     sem_init(&bba_rx_sema, 0);
     sem_init(&bba_rx_sema2, 1);
     bba_rx_thread = thd_create(0, bba_rx_threadfunc, 0);
-    bba_rx_thread->prio = 1;
+    thd_set_prio(bba_rx_thread, 1);
     thd_set_label(bba_rx_thread, "BBA-rx-thd");
 
     /* We need something like this to get DHCP to work (since it doesn't
@@ -9,6 +9,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <kos/thread.h>
+#include <kos/arena.h>
 #include <dc/pvr.h>
 #include <dc/sq.h>
 #include "pvr_internal.h"
@@ -313,6 +314,9 @@ int pvr_scene_finish(void) {
         }
     }
 
+    /* Anything this thread needed just for building the scene can go now */
+    arena_frame_reset();
+
     /* Ok, now it's just a matter of waiting for the interrupt... */
     return 0;
 }
@@ -120,7 +120,8 @@ uint8 scif_spi_rw_byte(uint8 b) {
     return rv;
 }
 
-/* Very accurate 1.5usec delay... */
+/* Very accurate 1.5usec delay... This uses TMU1, which the caller has to
+   have claimed from the secondary timer. */
 static void slow_rw_delay(void) {
     timer_prime(TMU1, 2000000, 0);
     timer_clear(TMU1);
@@ -141,6 +142,8 @@ uint8 scif_spi_slow_rw_byte(uint8 b) {
     uint16 tmp = scsptr2 & ~PTR2_CTSDT & ~PTR2_SPB2DT;
     uint8 bit;
 
+    timer_secondary_claim();
+
     for(i = 7; i >= 0; --i) {
         SCSPTR2 = tmp | (bit = (b >> i) & 0x01);
         slow_rw_delay();
@@ -149,6 +152,8 @@ uint8 scif_spi_slow_rw_byte(uint8 b) {
         slow_rw_delay();
     }
 
+    timer_secondary_release();
+
     return rv;
 }
 
@@ -334,8 +334,9 @@ uint64_t timer_ns_gettime64(void);
     sleeping, used by the KOS, C, C++, and POSIX threading APIs.
 
     \warning
-    This API and its underlying functionality are using \ref TMU1, so any
-    direct manipulation of it will interfere with the API's proper functioning.
+    This API and its underlying functionality are using \ref TMU1, which it
+    claims from the secondary timer while it runs; see
+    timer_secondary_claim().
 */
 
 /** \brief  Spin-loop sleep function.
@@ -397,6 +398,94 @@ timer_primary_callback_t timer_primary_set_callback(timer_primary_callback_t cal
 */
 void timer_primary_wakeup(uint32_t millis);
 
+/** \brief   Cancel any primary timer wakeup.
+    \ingroup tmu_primary
+
+    This function stops the primary timer, so the callback won't be called
+    until another wakeup is requested with timer_primary_wakeup().
+*/
+void timer_primary_stop(void);
+
+/** \defgroup tmu_secondary Secondary Timer
+    \brief                  One-shot microsecond timer used by the kernel.
+    \ingroup                timers
+
+    This API provides a callback notification mechanism that can be hooked into
+    the secondary timer (TMU1), at microsecond resolution. It is used by the
+    KOS kernel for high-resolution timers; see kos/hrtimer.h.
+
+    \warning
+    This API and its underlying functionality are using \ref TMU1, so any
+    other code that programs TMU1 itself (or installs its own handler for its
+    interrupt) must call timer_secondary_claim() first and
+    timer_secondary_release() when it's done. timer_spin_sleep() does this
+    too.
+*/
+
+/** \brief   Secondary timer callback type.
+    \ingroup tmu_secondary
+
+    This is the type of function which may be passed to
+    timer_secondary_set_callback() as the function that gets invoked
+    upon interrupt.
+*/
+typedef void (*timer_secondary_callback_t)(irq_context_t *);
+
+/** \brief   Set the secondary timer callback.
+    \ingroup tmu_secondary
+
+    \warning
+    Generally, you should not do this, as high-resolution timers rely on the
+    secondary timer to work.
+
+    \param  callback        The new timer callback (set to NULL to disable).
+    \return                 The old timer callback.
+*/
+timer_secondary_callback_t timer_secondary_set_callback(timer_secondary_callback_t callback);
+
+/** \brief   Request a secondary timer wakeup.
+    \ingroup tmu_secondary
+
+    This function will call the secondary timer callback in the number of
+    microseconds specified. Only one wakeup can be scheduled at a time; any
+    subsequently scheduled wakeup replaces an existing one. The longest wait
+    the timer can do is a little under 6 minutes, so longer ones are cut short
+    to that.
+
+    \param  micros          The number of microseconds to schedule for.
+*/
+void timer_secondary_wakeup(uint32_t micros);
+
+/** \brief   Cancel any secondary timer wakeup.
+    \ingroup tmu_secondary
+*/
+void timer_secondary_stop(void);
+
+/** \brief   Take TMU1 over from the secondary timer.
+    \ingroup tmu_secondary
+
+    This function stops the secondary timer so that the caller can program
+    \ref TMU1 directly, with the regular timer functions, and set its own
+    handler for EXC_TMU1_TUNI1 if it needs one. Until the matching call to
+    timer_secondary_release(), secondary timer wakeups are only recorded, so
+    high-resolution timers are held off; keep the claim as short as possible.
+
+    Claims nest, and TMU1 only goes back to the secondary timer once every
+    claim has been released.
+*/
+void timer_secondary_claim(void);
+
+/** \brief   Give TMU1 back to the secondary timer.
+    \ingroup tmu_secondary
+
+    This function undoes a call to timer_secondary_claim(). Once the last
+    claim is released, TMU1 is stopped, the secondary timer's interrupt
+    handler is put back, and any wakeup that was requested is set up again
+    for the time it was due. If that time has already gone by, the callback
+    is called straight away.
+*/
+void timer_secondary_release(void);
+
 /** \cond */
 /* Init function */
 int timer_init(void);
@@ -27,6 +27,7 @@ __BEGIN_DECLS
 
 #include <arch/types.h>
 #include <stdint.h>
+#include <kos/heap.h>
 
 /** \defgroup audio_driver  Driver
     \brief                  Low-level driver for SPU and audio management
@@ -98,6 +99,16 @@ void snd_mem_shutdown(void);
 */
 int snd_init(void);
 
+/** \brief  Heap for the sound system.
+
+    If this is set, the sound system allocates its stream buffers, sound
+    effect data and SPU RAM bookkeeping from this heap rather than the main
+    one, so that loading sounds can't run the rest of the program out of
+    memory. Set it before snd_init(), and leave it alone until after
+    snd_shutdown(). NULL, the default, means the main heap.
+*/
+extern kos_heap_t *snd_heap;
+
 /** \brief  Shut down the sound system.
 
     This function shuts down the whole sound system, freeing memory and
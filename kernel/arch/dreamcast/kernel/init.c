@@ -161,6 +161,11 @@ int  __weak arch_auto_init(void) {
 
     thd_init();
 
+    if(__kos_init_flags & INIT_THD_TICKLESS)
+        thd_set_tickless(1);
+
+    hrtimer_sys_init();     /* High-resolution timers */
+
     nmmgr_init();
 
     fs_init();          /* VFS */
@@ -214,6 +219,8 @@ void  __weak arch_auto_shutdown(void) {
     KOS_INIT_FLAG_CALL(net_shutdown);
 #endif
 
+    hrtimer_sys_shutdown();
+
     irq_disable();
     snd_shutdown();
     timer_shutdown();
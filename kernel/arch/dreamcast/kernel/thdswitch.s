@@ -129,3 +129,104 @@ ifraddr:
 	.long	_irq_force_return
 tcnaddr:
 	.long	_thd_choose_new
+
+
+	.globl		_fiber_context_switch
+	.globl		_fiber_create_context
+
+! Switch from one fiber to another. Fibers switch voluntarily, so unlike
+! _thd_block_now, this only has to save what the calling convention says
+! a function call preserves: R8-R15, PR, MACH, MACL, FPSCR and FR12-FR15.
+! These are pushed on the current stack, and the stack pointer is all that
+! needs to be kept anywhere else. The frame is, from the top down:
+!
+!   PR, R14-R8, MACH, MACL, FPSCR, FR15-FR12
+!
+! and _fiber_create_context below must build the same thing.
+!
+! R4 = where to save the current stack pointer
+! R5 = stack pointer of the fiber to switch to
+!
+! Returns when something switches back to us.
+!
+_fiber_context_switch:
+	sts.l		pr,@-r15
+	mov.l		r14,@-r15
+	mov.l		r13,@-r15
+	mov.l		r12,@-r15
+	mov.l		r11,@-r15
+	mov.l		r10,@-r15
+	mov.l		r9,@-r15
+	mov.l		r8,@-r15
+	sts.l		mach,@-r15
+	sts.l		macl,@-r15
+	sts.l		fpscr,@-r15
+	mov		#0,r0
+	lds		r0,fpscr	! First bank, 32-bit I/O
+	fmov.s		fr15,@-r15
+	fmov.s		fr14,@-r15
+	fmov.s		fr13,@-r15
+	fmov.s		fr12,@-r15
+
+	! Swap stacks
+	mov.l		r15,@r4
+	mov		r5,r15
+
+	fmov.s		@r15+,fr12
+	fmov.s		@r15+,fr13
+	fmov.s		@r15+,fr14
+	fmov.s		@r15+,fr15
+	lds.l		@r15+,fpscr
+	lds.l		@r15+,macl
+	lds.l		@r15+,mach
+	mov.l		@r15+,r8
+	mov.l		@r15+,r9
+	mov.l		@r15+,r10
+	mov.l		@r15+,r11
+	mov.l		@r15+,r12
+	mov.l		@r15+,r13
+	mov.l		@r15+,r14
+	lds.l		@r15+,pr
+	rts
+	nop
+
+! Build the frame for a new fiber, so that switching to it the first time
+! "returns" into the trampoline below, which calls the routine with its
+! argument. The routine must never return. FPSCR is copied from the caller.
+!
+! R4 = top of the new fiber's stack
+! R5 = routine to run
+! R6 = argument for the routine
+!
+! Returns the new fiber's stack pointer.
+!
+_fiber_create_context:
+	mov		#-8,r0
+	and		r0,r4		! Align the stack top
+	mov.l		trampaddr,r0
+	mov.l		r0,@-r4		! PR
+	mov		#0,r0
+	mov.l		r0,@-r4		! R14
+	mov.l		r0,@-r4		! R13
+	mov.l		r0,@-r4		! R12
+	mov.l		r0,@-r4		! R11
+	mov.l		r0,@-r4		! R10
+	mov.l		r6,@-r4		! R9: argument
+	mov.l		r5,@-r4		! R8: routine
+	mov.l		r0,@-r4		! MACH
+	mov.l		r0,@-r4		! MACL
+	sts.l		fpscr,@-r4	! FPSCR
+	mov.l		r0,@-r4		! FR15
+	mov.l		r0,@-r4		! FR14
+	mov.l		r0,@-r4		! FR13
+	mov.l		r0,@-r4		! FR12
+	rts
+	mov		r4,r0
+
+fiber_trampoline:
+	jmp		@r8
+	mov		r9,r4
+
+	.balign	4
+trampaddr:
+	.long	fiber_trampoline
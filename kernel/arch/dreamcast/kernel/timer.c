@@ -153,9 +153,16 @@ int timer_clear(int which) {
     return !!(value & UNF);
 }
 
+/* Secondary timer state. Anything else that drives TMU1 itself, like
+   timer_spin_sleep() below, claims it first; see timer_secondary_claim(). */
+static timer_secondary_callback_t ts_callback;
+static volatile int ts_armed, ts_claimed;
+static uint64_t ts_due;
+
 /* Spin-loop kernel sleep func: uses the secondary timer in the
    SH-4 to very accurately delay even when interrupts are disabled */
 void timer_spin_sleep(int ms) {
+    timer_secondary_claim();
     timer_prime(TMU1, 1000, 0);
     timer_clear(TMU1);
     timer_start(TMU1);
@@ -168,7 +175,7 @@ void timer_spin_sleep(int ms) {
         ms--;
     }
 
-    timer_stop(TMU1);
+    timer_secondary_release();
 }
 
 /* Enable timer interrupts; needs to move to irq.c sometime. */
@@ -417,6 +424,104 @@ void timer_primary_wakeup(uint32_t millis) {
     }
 }
 
+void timer_primary_stop(void) {
+    timer_stop(TMU0);
+    timer_disable_ints(TMU0);
+    tp_ms_remaining = 0;
+}
+
+/* Secondary kernel timer. This is a one-shot timer in microseconds; at the
+   fastest clock, TMU1 can count down for nearly six minutes, so unlike the
+   primary timer it doesn't need to count off seconds to do long waits. */
+
+/* IRQ handler for the secondary timer interrupt. */
+static void ts_handler(irq_t src, irq_context_t *cxt) {
+    (void)src;
+
+    timer_stop(TMU1);
+    timer_clear(TMU1);
+    ts_armed = 0;
+
+    /* The callback may schedule another wakeup, of course */
+    if(ts_callback)
+        ts_callback(cxt);
+}
+
+timer_secondary_callback_t timer_secondary_set_callback(timer_secondary_callback_t cb) {
+    timer_secondary_callback_t cbold = ts_callback;
+    ts_callback = cb;
+    return cbold;
+}
+
+/* Set TMU1 to go off in the given number of microseconds. */
+static void ts_arm(uint32_t micros) {
+    uint64_t cd = (uint64_t)(TIMER_PCK / TDIV(TIMER_TPSC)) * micros / 1000000;
+
+    if(cd == 0)
+        cd = 1;
+    else if(cd > UINT32_MAX)
+        cd = UINT32_MAX;
+
+    timer_stop(TMU1);
+    timer_prime_apply(TMU1, (uint32_t)cd, 1);
+    timer_clear(TMU1);
+    timer_start(TMU1);
+}
+
+void timer_secondary_wakeup(uint32_t micros) {
+    ts_armed = 1;
+    ts_due = timer_us_gettime64() + micros;
+
+    /* Someone else has the timer at the moment; it'll be set up again when
+       they're done with it. */
+    if(!ts_claimed)
+        ts_arm(micros);
+}
+
+void timer_secondary_stop(void) {
+    ts_armed = 0;
+
+    if(!ts_claimed)
+        timer_stop(TMU1);
+}
+
+void timer_secondary_claim(void) {
+    int old = irq_disable();
+
+    if(!ts_claimed++)
+        timer_stop(TMU1);
+
+    irq_restore(old);
+}
+
+void timer_secondary_release(void) {
+    uint64_t now;
+    int old = irq_disable();
+
+    assert(ts_claimed > 0);
+
+    if(!--ts_claimed) {
+        timer_stop(TMU1);
+        timer_clear(TMU1);
+        irq_set_handler(EXC_TMU1_TUNI1, ts_handler);
+
+        /* Pick up any wakeup from where it would have been, or straight
+           away if it's gone by in the meantime. */
+        if(ts_armed) {
+            now = timer_us_gettime64();
+
+            if(ts_due <= now)
+                ts_arm(0);
+            else if(ts_due - now > UINT32_MAX)
+                ts_arm(UINT32_MAX);
+            else
+                ts_arm((uint32_t)(ts_due - now));
+        }
+    }
+
+    irq_restore(old);
+}
+
 /* Init */
 int timer_init(void) {
     /* Disable all timers */
@@ -428,6 +533,12 @@ int timer_init(void) {
     /* Setup the primary timer stuff */
     timer_primary_init();
 
+    /* And get the secondary timer ready for wakeups */
+    ts_callback = NULL;
+    ts_armed = 0;
+    ts_claimed = 0;
+    irq_set_handler(EXC_TMU1_TUNI1, ts_handler);
+
     return 0;
 }
 
@@ -436,6 +547,9 @@ void timer_shutdown(void) {
     /* Shutdown primary timer stuff */
     timer_primary_shutdown();
 
+    timer_secondary_stop();
+    irq_set_handler(EXC_TMU1_TUNI1, NULL);
+
     /* Disable all timers */
     TIMER8(TSTR) = 0;
     timer_disable_ints(TMU0);
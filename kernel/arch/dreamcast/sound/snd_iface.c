@@ -22,6 +22,9 @@
 /* Are we initted? */
 static int initted = 0;
 
+/* Heap to allocate from, or NULL for the main heap */
+kos_heap_t *snd_heap = NULL;
+
 /* This will come from a separately linked object file */
 extern uint8_t snd_stream_drv[];
 extern uint8_t snd_stream_drv_end[];
@@ -88,7 +88,7 @@ int snd_mem_init(uint32 reserve) {
     /* Make sure our tailq is initted */
     TAILQ_INIT(&pool);
 
-    blk = (snd_block_t *)malloc(sizeof(snd_block_t));
+    blk = (snd_block_t *)kos_heap_malloc(snd_heap, sizeof(snd_block_t));
     memset(blk, 0, sizeof(snd_block_t));
     blk->addr = reserve;
     blk->size = 2 * 1024 * 1024 - reserve;
@@ -189,7 +189,7 @@ uint32 snd_mem_malloc(size_t size) {
     }
 
     /* Nope: break it up into two chunks */
-    e = (snd_block_t*)malloc(sizeof(snd_block_t));
+    e = (snd_block_t*)kos_heap_malloc(snd_heap, sizeof(snd_block_t));
     memset(e, 0, sizeof(snd_block_t));
     e->addr = best->addr + size;
     e->size = best->size - size;
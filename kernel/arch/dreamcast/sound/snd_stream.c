@@ -153,7 +153,7 @@ void snd_stream_filter_add(snd_stream_hnd_t hnd, snd_stream_filter_t filtfunc, v
 
     CHECK_HND(hnd);
 
-    f = malloc(sizeof(filter_t));
+    f = kos_heap_malloc(snd_heap, sizeof(filter_t));
     f->func = filtfunc;
     f->data = obj;
     TAILQ_INSERT_TAIL(&streams[hnd].filters, f, lent);
@@ -364,7 +364,7 @@ void snd_stream_prefill(snd_stream_hnd_t hnd) {
 int snd_stream_init(void) {
     /* Create stereo separation buffers */
     if(!sep_buffer[0]) {
-        sep_buffer[0] = memalign(32, SND_STREAM_BUFFER_MAX);
+        sep_buffer[0] = kos_heap_memalign(snd_heap, 32, SND_STREAM_BUFFER_MAX);
         sep_buffer[1] = sep_buffer[0] + (SND_STREAM_BUFFER_MAX / 8);
     }
 
@@ -14,6 +14,10 @@ To create a romdisk image, you will need the program "genromfs". This program wa
 for Linux but ought to compile under Cygwin. The source for this utility can be found
 on sunsite.unc.edu in /pub/Linux/system/recovery/, or as a package under Debian "genromfs".
 
+The genromfs in utils/genromfs can also put a hash index of each directory in the
+data of its "." entry (-i), which is used here for lookups when it's present, and
+turns files with identical contents into hard links, which are followed here.
+
 */
 
 #include <arch/types.h>
@@ -24,6 +28,7 @@ on sunsite.unc.edu in /pub/Linux/system/recovery/, or as a package under Debian
 #include <malloc.h>
 #include <string.h>
 #include <strings.h>
+#include <ctype.h>
 #include <stdio.h>
 #include <assert.h>
 #include <errno.h>
@@ -49,6 +54,19 @@ typedef struct {
     char    filename[16];       /* File name (zero-terminated) */
 } romdisk_file_t;
 
+/* Directory index written by genromfs -i as the data of a directory's "."
+   entry, covering the whole directory; also big-endian. It's followed by a
+   table of nbuckets + 1 offsets into the entries, and then two words per entry: the hash of its name and
+   the offset of its file header. */
+typedef struct {
+    uint32  magic;          /* Should be ROMDISK_INDEX_MAGIC */
+    uint32  nbuckets;       /* Number of hash buckets (a power of two) */
+    uint32  nentries;       /* Number of entries */
+    uint32  reserved;
+} romdisk_index_t;
+
+#define ROMDISK_INDEX_MAGIC 0x4b494458  /* "KIDX" */
+
 
 /* Util function to reverse the byte order of a uint32 */
 static uint32 ntohl_32(const void *data) {
@@ -94,48 +112,99 @@ static struct {
 /* Mutex for file handles */
 static mutex_t fh_mutex;
 
+/* Hash of a name for the directory index: 32-bit FNV-1a over the name folded
+   to lower case, since lookups ignore case. */
+static uint32 romdisk_hash(const char *fn, size_t fnlen) {
+    uint32 h = 0x811c9dc5;
+
+    while(fnlen--) {
+        h ^= (uint8)tolower((uint8)*fn++);
+        h *= 0x01000193;
+    }
+
+    return h;
+}
+
+/* Check whether the entry at the given offset has the right type, following
+   it if it's a hard link. Returns the offset of the entry to use, or 0. */
+static uint32 romdisk_check_type(rd_image_t * mnt, uint32 i, int dir) {
+    const romdisk_file_t    *fhdr = (const romdisk_file_t *)(mnt->image + i);
+    uint32                  type = ntohl_32(&fhdr->next_header) & 0x0f;
+
+    if((type & 7) == 0) {
+        i = ntohl_32(&fhdr->spec_info);
+        fhdr = (const romdisk_file_t *)(mnt->image + i);
+        type = ntohl_32(&fhdr->next_header) & 0x0f;
+    }
+
+    if((type & 3) != (dir ? 1 : 2))
+        return 0;
+
+    return i;
+}
+
+/* Return the index of the directory whose listing starts at the given offset,
+   or NULL if it doesn't have one. */
+static const romdisk_index_t *romdisk_get_index(rd_image_t * mnt, uint32 offset) {
+    const romdisk_file_t    *fhdr = (const romdisk_file_t *)(mnt->image + offset);
+    const romdisk_index_t   *idx;
+
+    if(strcmp(fhdr->filename, ".") || ntohl_32(&fhdr->size) < sizeof(romdisk_index_t))
+        return NULL;
+
+    idx = (const romdisk_index_t *)(mnt->image + offset + sizeof(romdisk_file_t));
+
+    if(ntohl_32(&idx->magic) != ROMDISK_INDEX_MAGIC)
+        return NULL;
+
+    return idx;
+}
+
 /* Given a filename and a starting romdisk directory listing (byte offset),
    search for the entry in the directory and return the byte offset to its
-   entry. */
+   entry. Hard links are followed, so the offset may be somewhere else. */
 static uint32 romdisk_find_object(rd_image_t * mnt, const char *fn, size_t fnlen, int dir, uint32 offset) {
-    uint32          i, ni, type;
+    uint32          i, ni, h, nb, e, found;
     const romdisk_file_t    *fhdr;
+    const romdisk_index_t   *idx;
+    const uint8             *start, *ents;
+
+    /* If the directory has an index, only look at the entries in the name's
+       bucket with the same hash */
+    if((idx = romdisk_get_index(mnt, offset))) {
+        h = romdisk_hash(fn, fnlen);
+        nb = ntohl_32(&idx->nbuckets);
+        start = (const uint8 *)(idx + 1) + (h & (nb - 1)) * 4;
+        ents = (const uint8 *)(idx + 1) + (nb + 1) * 4;
+
+        for(e = ntohl_32(start); e < ntohl_32(start + 4); e++) {
+            if(ntohl_32(ents + e * 8) != h)
+                continue;
+
+            i = ntohl_32(ents + e * 8 + 4);
+            fhdr = (const romdisk_file_t *)(mnt->image + i);
+
+            if((strlen(fhdr->filename) == fnlen) && (!strncasecmp(fhdr->filename, fn, fnlen))) {
+                if((found = romdisk_check_type(mnt, i, dir)))
+                    return found;
+            }
+        }
+
+        return 0;
+    }
 
     i = offset;
 
     do {
-        /* Locate the entry, next pointer, and type info */
+        /* Locate the entry and next pointer */
         fhdr = (const romdisk_file_t *)(mnt->image + i);
-        ni = ntohl_32(&fhdr->next_header);
-        type = ni & 0x0f;
-        ni = ni & 0xfffffff0;
-
-        /* Check the type */
-        if(!dir) {
-            if((type & 3) != 2) {
-                i = ni;
-
-                if(!i)
-                    break;
-                else
-                    continue;
-            }
-        }
-        else {
-            if((type & 3) != 1) {
-                i = ni;
-
-                if(!i)
-                    break;
-                else
-                    continue;
-            }
-        }
+        ni = ntohl_32(&fhdr->next_header) & 0xfffffff0;
 
-        /* Check filename */
+        /* Check filename, then the type */
         if((strlen(fhdr->filename) == fnlen) && (!strncasecmp(fhdr->filename, fn, fnlen))) {
             /* Match: return this index */
-            return i;
+            if((found = romdisk_check_type(mnt, i, dir)))
+                return found;
         }
 
         i = ni;
@@ -232,10 +301,26 @@ static void * romdisk_open(vfs_handler_t * vfs, const char *fn, int mode) {
 
     /* Fill the fd structure */
     fhdr = (const romdisk_file_t *)(mnt->image + filehdr);
-    fh[fd].index = filehdr + sizeof(romdisk_file_t) + (strlen(fhdr->filename) / 16) * 16;
-    fh[fd].dir = (mode & O_DIR) ? 1 : 0;
+
+    if(mode & O_DIR) {
+        /* A directory's listing starts at its spec info. For the root and
+           paths ending in a slash we get the "." entry of the directory
+           instead, and list from the entry after it. */
+        if(filehdr == mnt->files || (ntohl_32(&fhdr->next_header) & 7) != 1)
+            fh[fd].index = ntohl_32(&fhdr->next_header) & 0xfffffff0;
+        else
+            fh[fd].index = ntohl_32(&fhdr->spec_info);
+
+        fh[fd].dir = 1;
+        fh[fd].size = 0;
+    }
+    else {
+        fh[fd].index = filehdr + sizeof(romdisk_file_t) + (strlen(fhdr->filename) / 16) * 16;
+        fh[fd].dir = 0;
+        fh[fd].size = ntohl_32(&fhdr->size);
+    }
+
     fh[fd].ptr = 0;
-    fh[fd].size = ntohl_32(&fhdr->size);
     fh[fd].mnt = mnt;
 
     return (void *)fd;
@@ -350,7 +435,7 @@ static size_t romdisk_total(void * h) {
 
 /* Read a directory entry */
 static dirent_t *romdisk_readdir(void * h) {
-    romdisk_file_t *fhdr;
+    const romdisk_file_t *fhdr, *thdr;
     int type;
     file_t fd = (file_t)h;
 
@@ -365,7 +450,7 @@ static dirent_t *romdisk_readdir(void * h) {
         return NULL;
 
     /* Get the current file header */
-    fhdr = (romdisk_file_t *)(fh[fd].mnt->image + fh[fd].index + fh[fd].ptr);
+    fhdr = (const romdisk_file_t *)(fh[fd].mnt->image + fh[fd].index + fh[fd].ptr);
 
     /* Update the pointer */
     fh[fd].ptr = ntohl_32(&fhdr->next_header);
@@ -381,13 +466,22 @@ static dirent_t *romdisk_readdir(void * h) {
     strcpy(fh[fd].dirent.name, fhdr->filename);
     fh[fd].dirent.time = 0;
 
+    /* Hard links ("." and "..", and merged files) look like what they
+       point at */
+    thdr = fhdr;
+
+    if((type & 7) == 0) {
+        thdr = (const romdisk_file_t *)(fh[fd].mnt->image + ntohl_32(&fhdr->spec_info));
+        type = ntohl_32(&thdr->next_header) & 0x0f;
+    }
+
     if((type & 3) == 1) {
         fh[fd].dirent.attr = O_DIR;
         fh[fd].dirent.size = -1;
     }
     else {
         fh[fd].dirent.attr = 0;
-        fh[fd].dirent.size = ntohl_32(&fhdr->size);
+        fh[fd].dirent.size = ntohl_32(&thdr->size);
     }
 
     return &fh[fd].dirent;
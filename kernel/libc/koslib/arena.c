@@ -0,0 +1,241 @@
+/* KallistiOS ##version##
+
+   arena.c
+   Copyright (C) 2026 KallistiOS Team
+*/
+
+/* Arena (bump) allocators */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include <kos/arena.h>
+#include <kos/tls.h>
+#include <kos/once.h>
+
+/* Each block starts with one of these, and is allocated from after it. The
+   blocks are chained newest first, so rewinding just pops them off. */
+typedef struct arena_block {
+    struct arena_block *next;   /* The block before this one */
+    char *end;                  /* End of the block */
+} arena_block_t;
+
+#define BLOCK_HDR   ((sizeof(arena_block_t) + ARENA_ALIGN - 1) & \
+                     ~(ARENA_ALIGN - 1))
+
+#define BLOCK_DATA(b)   ((char *)(b) + BLOCK_HDR)
+
+/* The arena came from arena_create(), with its first block after it */
+#define ARENA_CREATED   1
+
+#define ARENA_SIZE  ((sizeof(arena_t) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+int arena_init(arena_t *arena, void *block, size_t size, size_t grow) {
+    uintptr_t start = ((uintptr_t)block + ARENA_ALIGN - 1) &
+                      ~(uintptr_t)(ARENA_ALIGN - 1);
+    arena_block_t *b = (arena_block_t *)start;
+
+    if(!block || size < start - (uintptr_t)block + BLOCK_HDR) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    b->next = NULL;
+    b->end = (char *)block + size;
+
+    arena->block = b;
+    arena->spare = NULL;
+    arena->ptr = BLOCK_DATA(b);
+    arena->end = b->end;
+    arena->grow = grow;
+    arena->flags = 0;
+
+    return 0;
+}
+
+arena_t *arena_create(size_t size, size_t grow) {
+    arena_t *arena;
+
+    if(size > SIZE_MAX - ARENA_SIZE - BLOCK_HDR ||
+       !(arena = (arena_t *)malloc(ARENA_SIZE + BLOCK_HDR + size))) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    arena_init(arena, (char *)arena + ARENA_SIZE, BLOCK_HDR + size, grow);
+    arena->flags = ARENA_CREATED;
+
+    return arena;
+}
+
+void arena_destroy(arena_t *arena) {
+    arena_reset(arena);
+    arena_trim(arena);
+
+    if(arena->flags & ARENA_CREATED)
+        free(arena);
+}
+
+/* Take the current block off the chain. Growth blocks of the usual size are
+   kept for reuse; ones made bigger for a large allocation are freed. */
+static void arena_pop(arena_t *arena) {
+    arena_block_t *b = arena->block;
+
+    arena->block = b->next;
+
+    if((size_t)(b->end - BLOCK_DATA(b)) == arena->grow) {
+        b->next = arena->spare;
+        arena->spare = b;
+    }
+    else {
+        free(b);
+    }
+}
+
+/* Move on to a new block with room for size bytes at the given alignment,
+   and allocate from it. */
+static void *arena_grow(arena_t *arena, size_t size, size_t align) {
+    arena_block_t *b;
+    size_t need = size + align - 1;
+    uintptr_t p;
+
+    if(!arena->grow || need < size) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    if(need <= arena->grow && arena->spare) {
+        b = arena->spare;
+        arena->spare = b->next;
+    }
+    else {
+        if(need < arena->grow)
+            need = arena->grow;
+
+        if(need > SIZE_MAX - BLOCK_HDR ||
+           !(b = (arena_block_t *)malloc(BLOCK_HDR + need))) {
+            errno = ENOMEM;
+            return NULL;
+        }
+
+        b->end = BLOCK_DATA(b) + need;
+    }
+
+    b->next = arena->block;
+    arena->block = b;
+
+    p = ((uintptr_t)BLOCK_DATA(b) + align - 1) & ~(uintptr_t)(align - 1);
+    arena->ptr = (char *)p + size;
+    arena->end = b->end;
+
+    return (void *)p;
+}
+
+void *arena_alloc_aligned(arena_t *arena, size_t size, size_t align) {
+    uintptr_t p;
+
+    if(!align || (align & (align - 1))) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    p = ((uintptr_t)arena->ptr + align - 1) & ~(uintptr_t)(align - 1);
+
+    if(p > (uintptr_t)arena->end || size > (uintptr_t)arena->end - p)
+        return arena_grow(arena, size, align);
+
+    arena->ptr = (char *)p + size;
+
+    return (void *)p;
+}
+
+void *arena_alloc(arena_t *arena, size_t size) {
+    return arena_alloc_aligned(arena, size, ARENA_ALIGN);
+}
+
+arena_mark_t arena_mark(arena_t *arena) {
+    arena_mark_t mark;
+
+    mark.block = arena->block;
+    mark.ptr = arena->ptr;
+
+    return mark;
+}
+
+void arena_rewind(arena_t *arena, arena_mark_t mark) {
+    while(arena->block != mark.block)
+        arena_pop(arena);
+
+    arena->ptr = mark.ptr;
+    arena->end = arena->block->end;
+}
+
+void arena_reset(arena_t *arena) {
+    while(arena->block->next)
+        arena_pop(arena);
+
+    arena->ptr = BLOCK_DATA(arena->block);
+    arena->end = arena->block->end;
+}
+
+void arena_trim(arena_t *arena) {
+    arena_block_t *b;
+
+    while((b = arena->spare)) {
+        arena->spare = b->next;
+        free(b);
+    }
+}
+
+/* Frame arenas, one per thread, kept in thread-specific data */
+static kthread_key_t frame_key;
+static kthread_once_t frame_once = KTHREAD_ONCE_INIT;
+static int frame_ready;
+
+static void frame_free(void *arena) {
+    arena_destroy((arena_t *)arena);
+}
+
+static void frame_init(void) {
+    if(!kthread_key_create(&frame_key, frame_free))
+        frame_ready = 1;
+}
+
+arena_t *arena_frame(void) {
+    arena_t *arena;
+
+    if(kthread_once(&frame_once, frame_init) < 0)
+        return NULL;
+
+    if(!frame_ready) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    if((arena = (arena_t *)kthread_getspecific(frame_key)))
+        return arena;
+
+    if(!(arena = arena_create(ARENA_FRAME_SIZE, ARENA_FRAME_SIZE)))
+        return NULL;
+
+    if(kthread_setspecific(frame_key, arena) < 0) {
+        arena_destroy(arena);
+        return NULL;
+    }
+
+    return arena;
+}
+
+void *arena_frame_alloc(size_t size) {
+    arena_t *arena = arena_frame();
+
+    return arena ? arena_alloc(arena, size) : NULL;
+}
+
+void arena_frame_reset(void) {
+    arena_t *arena;
+
+    if(frame_ready && (arena = (arena_t *)kthread_getspecific(frame_key)))
+        arena_reset(arena);
+}
@@ -24,6 +24,7 @@
 #include <arch/arch.h>
 
 #include <kos/opts.h>
+#include <kos/heap.h>
 
 #undef DEBUG
 
@@ -1643,6 +1644,598 @@ static pthread_mutex_t mALLOC_MUTEx = PTHREAD_MUTEX_INITIALIZER;
 /********************************************************************************************************/
 /*** Begin KOS Code ***/
 
+/************************** Heaps **************************/
+
+/* Besides the main heap, there can be any number of separate heaps made
+   with kos_heap_create(). Each has its own malloc_state, kept at the start
+   of its region, and grows into the rest of the region rather than calling
+   sbrk(). The internal routines work on whichever heap heap_cur points to,
+   or the main heap if it's NULL; the public functions set it with the lock
+   held. A block is given back to the heap it came from whatever frees it,
+   by looking its address up in the list of heaps. */
+
+struct kos_heap {
+    struct kos_heap     *next;      /* List of heaps */
+    struct malloc_state *state;     /* Its malloc_state, after this */
+    char                *start;     /* The part of the region it grows into */
+    char                *brk;
+    char                *end;
+};
+
+static kos_heap_t *heap_list;
+static kos_heap_t *heap_cur;
+
+/* Defined after struct malloc_state is */
+static size_t heap_state_size(void);
+
+/* The main heap's MORECORE, before it's replaced with heap_morecore() */
+static Void_t* main_morecore(ptrdiff_t incr) {
+    return (Void_t*)MORECORE(incr);
+}
+
+/* sbrk() for the current heap */
+static Void_t* heap_morecore(ptrdiff_t incr) {
+    kos_heap_t *h = heap_cur;
+    char *old;
+
+    if(!h)
+        return main_morecore(incr);
+
+    if(incr > 0 ? incr > h->end - h->brk : -incr > h->brk - h->start)
+        return (Void_t*)(MORECORE_FAILURE);
+
+    old = h->brk;
+    h->brk += incr;
+
+    return old;
+}
+
+#undef MORECORE
+#define MORECORE heap_morecore
+
+/* Which separate heap a block came from, if any */
+static kos_heap_t *heap_find(Void_t* m) {
+    kos_heap_t *h;
+
+    for(h = heap_list; h; h = h->next) {
+        if((char *)m >= h->start && (char *)m < h->end)
+            return h;
+    }
+
+    return NULL;
+}
+
+/************************** Small Objects **************************/
+
+/* Small requests (up to SLAB_MAX bytes) don't go to dlmalloc at all, but to
+   a slab allocator in front of it. Each request is rounded up to one of a
+   handful of size classes, and each class hands out objects from slabs:
+   pages with a small header, carved into objects of that size as they're
+   needed. Freed objects are linked through their first word, so allocating
+   and freeing are just list operations, and objects of the same size are
+   kept together instead of splitting up the heap. A slab that ends up with
+   nothing allocated from it stops being a slab, and its page can go to any
+   class.
+
+   free() has to be able to tell a slab object from a dlmalloc block, so
+   there's a bitmap with a bit for each page of the heap, set for the pages
+   that belong to slab groups.
+
+   This is only built with MALLOC_SLAB (see kos/opts.h). The debugging
+   wrappers need every block to come from dlmalloc, so there are no slabs
+   with KM_DBG. */
+
+#if defined(MALLOC_SLAB) && defined(KM_DBG)
+#undef MALLOC_SLAB
+#endif
+
+#ifdef MALLOC_SLAB
+
+#define SLAB_SIZE       PAGESIZE
+#define SLAB_MAX        512
+
+/* The part of the address space slabs can be in: the heap, which runs from
+   the end of the program to the top of RAM. */
+#ifndef SLAB_HEAP_START
+extern unsigned long end;
+#define SLAB_HEAP_START ((unsigned long)&end)
+#define SLAB_HEAP_END   ((unsigned long)_arch_mem_top)
+#endif
+
+/* The most heap the bitmap can cover (enough for 32MB of RAM) */
+#ifndef SLAB_HEAP_SPAN
+#define SLAB_HEAP_SPAN  (32 * 1024 * 1024)
+#endif
+
+/* Slabs come from dlmalloc a group of pages at a time, so there's only one
+   lot of alignment slop for each group rather than each page. Pages that
+   aren't being used as slabs go on a list to be picked up by any class, and
+   a group goes back to dlmalloc when none of its pages are in use, apart
+   from one that's kept spare so that a heap at the edge doesn't keep
+   getting a new group and giving it back. */
+#define SLAB_GROUP      8
+
+typedef struct slab {
+    struct slab     *next;      /* Class's list of slabs with free objects,
+                                   or the list of unused pages */
+    struct slab     *prev;
+    void            *free;      /* Free objects in this slab */
+    struct slab     *group;     /* First page of the slab's group */
+    unsigned short  inuse;      /* Objects allocated from it */
+    unsigned short  carved;     /* Objects it's been carved into so far */
+    unsigned short  cls;        /* Size class */
+    unsigned short  pages;      /* In a group's first page: pages in the */
+    unsigned short  unused;     /* group, and how many aren't slabs */
+} slab_t;
+
+#define SLAB_HDR    ((sizeof(slab_t) + MALLOC_ALIGN_MASK) & ~MALLOC_ALIGN_MASK)
+
+typedef struct slab_class {
+    slab_t          *partial;   /* Slabs with free objects */
+    unsigned short  size;       /* Object size */
+    unsigned short  per_slab;   /* Objects per slab */
+    unsigned long   slabs;      /* Slabs in the class */
+    unsigned long   allocs;     /* Total allocations and frees, the */
+    unsigned long   frees;      /* difference being what's in use */
+} slab_class_t;
+
+static const unsigned short slab_sizes[] = {
+    8, 16, 24, 32, 48, 64, 80, 96, 128, 160, 192, 256, 320, 384, 448, 512
+};
+
+#define SLAB_CLASSES    (sizeof(slab_sizes) / sizeof(slab_sizes[0]))
+
+static slab_class_t slab_classes[SLAB_CLASSES];
+
+/* Size class for each size, in steps of 8 bytes */
+static unsigned char slab_lookup[SLAB_MAX / 8 + 1];
+static int slab_inited;
+
+/* Pages that aren't slabs, how many pages all the groups have, and how many
+   groups have no slabs at all */
+static slab_t *slab_pages;
+static unsigned long slab_page_count;
+static unsigned long slab_spare_groups;
+
+static unsigned long slab_map[SLAB_HEAP_SPAN / SLAB_SIZE / 32];
+static unsigned long slab_base;
+
+static void slab_init(void) {
+    unsigned int i, c = 0;
+
+    for(i = 0; i < SLAB_CLASSES; i++) {
+        slab_classes[i].size = slab_sizes[i];
+        slab_classes[i].per_slab = (SLAB_SIZE - SLAB_HDR) / slab_sizes[i];
+    }
+
+    for(i = 0; i <= SLAB_MAX / 8; i++) {
+        while(slab_sizes[c] < i * 8)
+            c++;
+
+        slab_lookup[i] = c;
+    }
+
+    slab_base = SLAB_HEAP_START & ~(SLAB_SIZE - 1);
+    slab_inited = 1;
+}
+
+/* Is this the address of a slab object? */
+static int slab_is_slab(Void_t* m) {
+    unsigned long page = ((unsigned long)m - slab_base) / SLAB_SIZE;
+
+    if((unsigned long)m < slab_base || page >= SLAB_HEAP_SPAN / SLAB_SIZE)
+        return 0;
+
+    return (slab_map[page / 32] >> (page % 32)) & 1;
+}
+
+static void slab_mark(slab_t *s, int set) {
+    unsigned long page = ((unsigned long)s - slab_base) / SLAB_SIZE;
+
+    if(set)
+        slab_map[page / 32] |= 1UL << (page % 32);
+    else
+        slab_map[page / 32] &= ~(1UL << (page % 32));
+}
+
+static void slab_push(slab_t **list, slab_t *s) {
+    s->prev = NULL;
+    s->next = *list;
+
+    if(*list)
+        (*list)->prev = s;
+
+    *list = s;
+}
+
+static void slab_unlink(slab_t **list, slab_t *s) {
+    if(s->prev)
+        s->prev->next = s->next;
+    else
+        *list = s->next;
+
+    if(s->next)
+        s->next->prev = s->prev;
+
+    s->next = s->prev = NULL;
+}
+
+/* Get a new group of pages from dlmalloc, falling back on a single page if
+   there isn't room for a whole group. */
+static int slab_group_new(void) {
+    unsigned long addr;
+    unsigned int i, n = SLAB_GROUP;
+    slab_t *g, *s;
+
+    if(!(g = (slab_t *)mEMALIGn(SLAB_SIZE, SLAB_SIZE * n))) {
+        n = 1;
+
+        if(!(g = (slab_t *)mEMALIGn(SLAB_SIZE, SLAB_SIZE)))
+            return -1;
+    }
+
+    /* It has to be somewhere the bitmap covers */
+    addr = (unsigned long)g;
+
+    if(addr < slab_base || addr - slab_base + n * SLAB_SIZE > SLAB_HEAP_SPAN ||
+       addr + n * SLAB_SIZE > SLAB_HEAP_END) {
+        fREe(g);
+        return -1;
+    }
+
+    g->pages = g->unused = n;
+    slab_page_count += n;
+    ++slab_spare_groups;
+
+    for(i = 0; i < n; i++) {
+        s = (slab_t *)(addr + i * SLAB_SIZE);
+        s->group = g;
+        slab_mark(s, 1);
+        slab_push(&slab_pages, s);
+    }
+
+    return 0;
+}
+
+/* Put a page that's no longer a slab back on the list, freeing its group if
+   that was the last one in use. */
+static void slab_page_free(slab_t *s) {
+    slab_t *g = s->group;
+    unsigned int i;
+
+    slab_push(&slab_pages, s);
+
+    if(++g->unused < g->pages)
+        return;
+
+    if(!slab_spare_groups) {
+        ++slab_spare_groups;
+        return;
+    }
+
+    for(i = 0; i < g->pages; i++) {
+        s = (slab_t *)((unsigned long)g + i * SLAB_SIZE);
+        slab_unlink(&slab_pages, s);
+        slab_mark(s, 0);
+    }
+
+    slab_page_count -= g->pages;
+    fREe(g);
+}
+
+/* Make a new slab for a class. */
+static slab_t *slab_new(unsigned int cls) {
+    slab_class_t *c = &slab_classes[cls];
+    slab_t *s;
+
+    if(!slab_pages && slab_group_new() < 0)
+        return NULL;
+
+    s = slab_pages;
+    slab_unlink(&slab_pages, s);
+
+    if(s->group->unused-- == s->group->pages)
+        --slab_spare_groups;
+
+    s->cls = cls;
+    s->inuse = 0;
+    s->carved = 0;
+    s->free = NULL;
+
+    slab_push(&c->partial, s);
+    ++c->slabs;
+
+    return s;
+}
+
+/* Allocate a small object, or return NULL to have dlmalloc do it. */
+static Void_t* slab_alloc(size_t bytes) {
+    slab_class_t *c;
+    slab_t *s;
+    void *obj;
+
+    if(!slab_inited)
+        slab_init();
+
+    c = &slab_classes[slab_lookup[(bytes + 7) / 8]];
+
+    if(!(s = c->partial) && !(s = slab_new(c - slab_classes)))
+        return NULL;
+
+    /* Reuse a freed object if there is one, otherwise carve a new one */
+    if((obj = s->free))
+        s->free = *(void **)obj;
+    else
+        obj = (char *)s + SLAB_HDR + s->carved++ * c->size;
+
+    /* A full slab comes off the list until something in it is freed */
+    if(++s->inuse == c->per_slab)
+        slab_unlink(&c->partial, s);
+
+    ++c->allocs;
+
+    return obj;
+}
+
+/* Free a slab object. */
+static void slab_free(Void_t* m) {
+    slab_t *s = (slab_t *)((unsigned long)m & ~(SLAB_SIZE - 1));
+    slab_class_t *c = &slab_classes[s->cls];
+
+    if(s->inuse == c->per_slab)
+        slab_push(&c->partial, s);
+
+    *(void **)m = s->free;
+    s->free = m;
+    ++c->frees;
+
+    if(!--s->inuse) {
+        slab_unlink(&c->partial, s);
+        --c->slabs;
+        slab_page_free(s);
+    }
+}
+
+static size_t slab_usable(Void_t* m) {
+    slab_t *s = (slab_t *)((unsigned long)m & ~(SLAB_SIZE - 1));
+
+    return slab_classes[s->cls].size;
+}
+
+/* realloc() for when slabs are in use. Small blocks start off as slab
+   objects; after that, a block only moves between slabs and dlmalloc when
+   it grows out of its slab. */
+static Void_t* slab_realloc(Void_t* m, size_t bytes) {
+    Void_t* n = NULL;
+    size_t size;
+
+    if(!m || !slab_is_slab(m)) {
+        if(!m && bytes <= SLAB_MAX && (n = slab_alloc(bytes)))
+            return n;
+
+        return rEALLOc(m, bytes);
+    }
+
+    size = slab_usable(m);
+
+    if(bytes <= size)
+        return m;
+
+    if(bytes <= SLAB_MAX)
+        n = slab_alloc(bytes);
+
+    if(!n)
+        n = mALLOc(bytes);
+
+    if(n) {
+        memcpy(n, m, size);
+        slab_free(m);
+    }
+
+    return n;
+}
+
+static void slab_stats(void) {
+    unsigned int i;
+    slab_class_t *c;
+
+    dbglog(DBG_CRITICAL, "slab size  slabs  in use   free\n");
+
+    for(i = 0; i < SLAB_CLASSES; i++) {
+        c = &slab_classes[i];
+
+        if(!c->slabs)
+            continue;
+
+        dbglog(DBG_CRITICAL, "%9u  %5lu  %6lu  %5lu\n", c->size, c->slabs,
+               c->allocs - c->frees,
+               c->slabs * c->per_slab - (c->allocs - c->frees));
+    }
+
+    dbglog(DBG_CRITICAL, "%lu pages in slab groups\n", slab_page_count);
+}
+
+#endif  /* MALLOC_SLAB */
+
+int malloc_slab_info(struct malloc_slab_info *info, int count) {
+#ifdef MALLOC_SLAB
+    int i;
+    slab_class_t *c;
+
+    if(MALLOC_PREACTION != 0) {
+        return 0;
+    }
+
+    if(!slab_inited)
+        slab_init();
+
+    for(i = 0; i < count && i < (int)SLAB_CLASSES; i++) {
+        c = &slab_classes[i];
+        info[i].size = c->size;
+        info[i].slabs = c->slabs;
+        info[i].inuse = c->allocs - c->frees;
+        info[i].free = c->slabs * c->per_slab - info[i].inuse;
+        info[i].allocs = c->allocs;
+        info[i].frees = c->frees;
+    }
+
+    if(MALLOC_POSTACTION != 0) {
+    }
+
+    return i;
+#else
+    (void)info;
+    (void)count;
+    return 0;
+#endif
+}
+
+#define HEAP_HDR    ((sizeof(kos_heap_t) + MALLOC_ALIGN_MASK) & ~MALLOC_ALIGN_MASK)
+
+kos_heap_t *kos_heap_create(void *base, size_t size) {
+    unsigned long start = ((unsigned long)base + MALLOC_ALIGN_MASK) &
+                          ~MALLOC_ALIGN_MASK;
+    size_t state = (heap_state_size() + MALLOC_ALIGN_MASK) & ~MALLOC_ALIGN_MASK;
+    kos_heap_t *h = (kos_heap_t *)start;
+
+    /* There has to be room for the allocator to take at least a page */
+    if(!base || size < start - (unsigned long)base + HEAP_HDR + state +
+       PAGESIZE) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    h->state = (struct malloc_state *)(start + HEAP_HDR);
+    memset(h->state, 0, heap_state_size());
+    h->start = h->brk = (char *)h->state + state;
+    h->end = (char *)base + size;
+
+    if(MALLOC_PREACTION != 0) {
+        return NULL;
+    }
+
+    h->next = heap_list;
+    heap_list = h;
+
+    if(MALLOC_POSTACTION != 0) {
+    }
+
+    return h;
+}
+
+void kos_heap_destroy(kos_heap_t *heap) {
+    kos_heap_t **hp;
+
+    if(MALLOC_PREACTION != 0) {
+        return;
+    }
+
+    for(hp = &heap_list; *hp; hp = &(*hp)->next) {
+        if(*hp == heap) {
+            *hp = heap->next;
+            break;
+        }
+    }
+
+    if(MALLOC_POSTACTION != 0) {
+    }
+}
+
+void *kos_heap_malloc(kos_heap_t *heap, size_t bytes) {
+    Void_t* m;
+
+    if(!heap)
+        return public_mALLOc(bytes);
+
+    if(MALLOC_PREACTION != 0) {
+        return 0;
+    }
+
+    heap_cur = heap;
+    m = mALLOc(bytes);
+    heap_cur = NULL;
+
+    if(MALLOC_POSTACTION != 0) {
+    }
+
+    return m;
+}
+
+void *kos_heap_calloc(kos_heap_t *heap, size_t n, size_t elem_size) {
+    Void_t* m;
+
+    if(!heap)
+        return public_cALLOc(n, elem_size);
+
+    if(MALLOC_PREACTION != 0) {
+        return 0;
+    }
+
+    heap_cur = heap;
+    m = cALLOc(n, elem_size);
+    heap_cur = NULL;
+
+    if(MALLOC_POSTACTION != 0) {
+    }
+
+    return m;
+}
+
+void *kos_heap_memalign(kos_heap_t *heap, size_t alignment, size_t bytes) {
+    Void_t* m;
+
+    if(!heap)
+        return public_mEMALIGn(alignment, bytes);
+
+    if(MALLOC_PREACTION != 0) {
+        return 0;
+    }
+
+    heap_cur = heap;
+    m = mEMALIGn(alignment, bytes);
+    heap_cur = NULL;
+
+    if(MALLOC_POSTACTION != 0) {
+    }
+
+    return m;
+}
+
+/* Blocks always go back to the heap they came from, so these only need the
+   heap for allocating a new block. */
+void *kos_heap_realloc(kos_heap_t *heap, void *m, size_t bytes) {
+    if(!m)
+        return kos_heap_malloc(heap, bytes);
+
+    return public_rEALLOc(m, bytes);
+}
+
+void kos_heap_free(kos_heap_t *heap, void *m) {
+    (void)heap;
+    public_fREe(m);
+}
+
+struct mallinfo kos_heap_mallinfo(kos_heap_t *heap) {
+    struct mallinfo m;
+
+    if(!heap)
+        return public_mALLINFo();
+
+    if(MALLOC_PREACTION != 0) {
+        struct mallinfo nm = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+        return nm;
+    }
+
+    heap_cur = heap;
+    m = mALLINFo();
+    heap_cur = NULL;
+
+    if(MALLOC_POSTACTION != 0) {
+    }
+
+    return m;
+}
+
 
 /************************** Debug Stuff **************************/
 
@@ -1723,6 +2316,14 @@ Void_t* public_mALLOc(size_t bytes) {
            ctl->thread, ctl->addr, ctl->size, (uint32)m);
 #endif
 
+#elif defined(MALLOC_SLAB)
+    m = NULL;
+
+    if(bytes <= SLAB_MAX)
+        m = slab_alloc(bytes);
+
+    if(!m)
+        m = mALLOc(bytes);
 #else
     m = mALLOc(bytes);
 #endif
@@ -1748,6 +2349,17 @@ void public_fREe(Void_t* m) {
         return;
     }
 
+    /* Blocks from separate heaps go back to them */
+    if(heap_list && (heap_cur = heap_find(m))) {
+        fREe(m);
+        heap_cur = NULL;
+
+        if(MALLOC_POSTACTION != 0) {
+        }
+
+        return;
+    }
+
 #ifdef KM_DBG
 
 #ifdef KM_DBG_VERBOSE
@@ -1800,6 +2412,13 @@ void public_fREe(Void_t* m) {
         fREe(ctl);
     }
 
+#elif defined(MALLOC_SLAB)
+
+    if(slab_is_slab(m))
+        slab_free(m);
+    else
+        fREe(m);
+
 #else
     fREe(m);
 #endif
@@ -1906,6 +2525,17 @@ Void_t* public_rEALLOc(Void_t* m, size_t bytes) {
         return 0;
     }
 
+    /* Blocks from separate heaps stay in them */
+    if(m && heap_list && (heap_cur = heap_find(m))) {
+        m = rEALLOc(m, bytes);
+        heap_cur = NULL;
+
+        if(MALLOC_POSTACTION != 0) {
+        }
+
+        return m;
+    }
+
 #ifdef KM_DBG
 
 #ifdef KM_DBG_VERBOSE
@@ -2016,6 +2646,8 @@ Void_t* public_rEALLOc(Void_t* m, size_t bytes) {
             m = NULL;
     }
 
+#elif defined(MALLOC_SLAB)
+    m = slab_realloc(m, bytes);
 #else
     m = rEALLOc(m, bytes);
 #endif
@@ -2149,6 +2781,16 @@ Void_t* public_cALLOc(size_t n, size_t elem_size) {
            ctl->thread, ctl->addr, ctl->size, (uint32)m);
 #endif
 
+#elif defined(MALLOC_SLAB)
+    m = NULL;
+
+    if(!elem_size || n <= SLAB_MAX / elem_size) {
+        if((m = slab_alloc(n * elem_size)))
+            memset(m, 0, n * elem_size);
+    }
+
+    if(!m)
+        m = cALLOc(n, elem_size);
 #else
     m = cALLOc(n, elem_size);
 #endif
@@ -2203,7 +2845,16 @@ size_t public_mUSABLe(Void_t* m) {
         return 0;
     }
 
-    result = mUSABLe(m);
+    if(m && heap_list && (heap_cur = heap_find(m))) {
+        result = mUSABLe(m);
+        heap_cur = NULL;
+    }
+#ifdef MALLOC_SLAB
+    else if(m && slab_is_slab(m))
+        result = slab_usable(m);
+#endif
+    else
+        result = mUSABLe(m);
 
     if(MALLOC_POSTACTION != 0) {
     }
@@ -2223,6 +2874,10 @@ void public_mSTATs(void) {
 
     mSTATs();
 
+#ifdef MALLOC_SLAB
+    slab_stats();
+#endif
+
 #ifdef KM_DBG
 
     if(!LIST_EMPTY(&block_list)) {
@@ -3143,14 +3798,19 @@ typedef struct malloc_state *mstate;
 static struct malloc_state av_;  /* never directly referenced */
 
 /*
-   All uses of av_ are via get_malloc_state().
+   All uses of av_ are via get_malloc_state(), which gives the state of the
+   current separate heap instead if there is one.
    At most one "call" to get_malloc_state is made per invocation of
    the public versions of malloc and free, but other routines
    that in turn invoke malloc and/or free may call more then once.
    Also, it is called in check* routines if DEBUG is set.
 */
 
-#define get_malloc_state() (&(av_))
+#define get_malloc_state() (heap_cur ? heap_cur->state : &(av_))
+
+static size_t heap_state_size(void) {
+    return sizeof(struct malloc_state);
+}
 
 /*
   Initialize a malloc_state struct.
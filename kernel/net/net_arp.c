@@ -140,7 +140,7 @@ int net_arp_insert(netif_t *nif, const uint8 mac[6], const uint8 ip[4],
     }
 
     /* It's not there, add an entry */
-    cur = (netarp_t *)malloc(sizeof(netarp_t));
+    cur = (netarp_t *)kos_heap_malloc(net_heap, sizeof(netarp_t));
 
     if(cur == NULL)
         return -1;
@@ -189,7 +189,7 @@ int net_arp_lookup(netif_t *nif, const uint8 ip_in[4], uint8 mac_out[6],
     }
 
     /* It's not there... Add an incomplete ARP entry */
-    cur = (netarp_t *)malloc(sizeof(netarp_t));
+    cur = (netarp_t *)kos_heap_malloc(net_heap, sizeof(netarp_t));
 
     if(cur == NULL)
         return -3;
@@ -200,10 +200,10 @@ int net_arp_lookup(netif_t *nif, const uint8 ip_in[4], uint8 mac_out[6],
 
     /* Copy our packet if we have one to copy. */
     if(pkt && data && data_size) {
-        cur->data = (uint8 *)malloc(data_size);
+        cur->data = (uint8 *)kos_heap_malloc(net_heap, data_size);
 
         if(cur->data) {
-            cur->pkt = (ip_hdr_t *)malloc(sizeof(ip_hdr_t));
+            cur->pkt = (ip_hdr_t *)kos_heap_malloc(net_heap, sizeof(ip_hdr_t));
 
             if(!cur->pkt) {
                 free(cur->data);
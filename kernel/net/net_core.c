@@ -41,6 +41,9 @@ static int net_initted = 0;
 /* Default net device */
 netif_t *net_default_dev = NULL;
 
+/* Heap to allocate from, or NULL for the main heap */
+kos_heap_t *net_heap = NULL;
+
 /**************************************************************************/
 /* Driver list management
    Note that this stuff might be used before net_core is actually
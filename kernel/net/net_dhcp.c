@@ -247,7 +247,8 @@ int net_dhcp_request(uint32 required_address) {
                                    0, required_address);
 
     /* Add to our packet queue */
-    qpkt = (struct dhcp_pkt_out *)malloc(sizeof(struct dhcp_pkt_out));
+    qpkt = (struct dhcp_pkt_out *)kos_heap_malloc(net_heap,
+                                                  sizeof(struct dhcp_pkt_out));
 
     if(!qpkt) {
         mutex_unlock(&dhcp_lock);
@@ -256,7 +257,7 @@ int net_dhcp_request(uint32 required_address) {
 
     pkt_len = sizeof(dhcp_pkt_t) + optlen;
 
-    qpkt->buf = (uint8 *)malloc(pkt_len);
+    qpkt->buf = (uint8 *)kos_heap_malloc(net_heap, pkt_len);
 
     if(!qpkt->buf) {
         free(qpkt);
@@ -321,13 +322,14 @@ static void net_dhcp_send_request(dhcp_pkt_t *pkt, int pktlen, dhcp_pkt_t *pkt2,
                                    serverid, ntohl(pkt->yiaddr));
 
     /* Add to our packet queue */
-    qpkt = (struct dhcp_pkt_out *)malloc(sizeof(struct dhcp_pkt_out));
+    qpkt = (struct dhcp_pkt_out *)kos_heap_malloc(net_heap,
+                                                  sizeof(struct dhcp_pkt_out));
 
     if(!qpkt) {
         return;
     }
 
-    qpkt->buf = (uint8 *)malloc(sizeof(dhcp_pkt_t) + optlen);
+    qpkt->buf = (uint8 *)kos_heap_malloc(net_heap, sizeof(dhcp_pkt_t) + optlen);
 
     if(!qpkt->buf) {
         free(qpkt);
@@ -374,13 +376,14 @@ static void net_dhcp_renew(void) {
                                    0, ntohl(req->ciaddr));
 
     /* Add to our packet queue */
-    qpkt = (struct dhcp_pkt_out *)malloc(sizeof(struct dhcp_pkt_out));
+    qpkt = (struct dhcp_pkt_out *)kos_heap_malloc(net_heap,
+                                                  sizeof(struct dhcp_pkt_out));
 
     if(!qpkt) {
         return;
     }
 
-    qpkt->buf = (uint8 *)malloc(sizeof(dhcp_pkt_t) + optlen);
+    qpkt->buf = (uint8 *)kos_heap_malloc(net_heap, sizeof(dhcp_pkt_t) + optlen);
 
     if(!qpkt->buf) {
         free(qpkt);
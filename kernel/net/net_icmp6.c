@@ -227,8 +227,9 @@ static void net_icmp6_input_134(netif_t *net, ipv6_hdr_t *ip, icmp6_hdr_t *icmp,
 
                 /* TODO: Handle preferred/valid lifetimes properly */
                 /* Add the new address to our list */
-                tmp = realloc(net->ip6_addrs, (net->ip6_addr_count + 1) *
-                              sizeof(struct in6_addr));
+                tmp = kos_heap_realloc(net_heap, net->ip6_addrs,
+                                       (net->ip6_addr_count + 1) *
+                                       sizeof(struct in6_addr));
 
                 if(!tmp) {
                     break;
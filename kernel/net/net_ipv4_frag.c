@@ -142,7 +142,7 @@ static int frag_import(netif_t *src, const ip_hdr_t *hdr, const uint8 *data,
 
     /* Reallocate space for the data buffer, if needed. */
     if(end > frag->cur_length) {
-        tmp = realloc(frag->data, end);
+        tmp = kos_heap_realloc(net_heap, frag->data, end);
 
         if(!tmp) {
             errno = ENOMEM;
@@ -279,7 +279,7 @@ int net_ipv4_reassemble(netif_t *src, const ip_hdr_t *hdr, const uint8 *data,
     }
 
     /* We don't have a fragment with that identifier, so make one. */
-    f = (struct ip_frag *)malloc(sizeof(struct ip_frag));
+    f = (struct ip_frag *)kos_heap_malloc(net_heap, sizeof(struct ip_frag));
 
     if(!f) {
         errno = ENOMEM;
@@ -47,7 +47,7 @@ static void multicast_commit(void) {
 int net_multicast_add(const uint8 mac[6]) {
     mc_entry_t *ent;
 
-    ent = (mc_entry_t *)malloc(sizeof(mc_entry_t));
+    ent = (mc_entry_t *)kos_heap_malloc(net_heap, sizeof(mc_entry_t));
 
     if(!ent) {
         return -1;
@@ -114,7 +114,7 @@ int net_ndp_insert(netif_t *net, const uint8 mac[6], const struct in6_addr *ip,
     }
 
     /* No entry exists yet, so create one */
-    if(!(i = (ndp_entry_t *)malloc(sizeof(ndp_entry_t)))) {
+    if(!(i = (ndp_entry_t *)kos_heap_malloc(net_heap, sizeof(ndp_entry_t)))) {
         return -1;
     }
 
@@ -181,7 +181,7 @@ int net_ndp_lookup(netif_t *net, const struct in6_addr *ip, uint8 mac_out[6],
     }
 
     /* Its not there, add an incomplete entry and solicit the info */
-    if(!(i = (ndp_entry_t *)malloc(sizeof(ndp_entry_t)))) {
+    if(!(i = (ndp_entry_t *)kos_heap_malloc(net_heap, sizeof(ndp_entry_t)))) {
         return -1;
     }
 
@@ -192,10 +192,11 @@ int net_ndp_lookup(netif_t *net, const struct in6_addr *ip, uint8 mac_out[6],
 
     /* Copy our packet if we have one to copy. */
     if(pkt && data && data_size) {
-        i->data = (uint8 *)malloc(data_size);
+        i->data = (uint8 *)kos_heap_malloc(net_heap, data_size);
 
         if(i->data) {
-            i->pkt = (ipv6_hdr_t *)malloc(sizeof(ipv6_hdr_t));
+            i->pkt = (ipv6_hdr_t *)kos_heap_malloc(net_heap,
+                                                   sizeof(ipv6_hdr_t));
 
             if(!i->pkt) {
                 free(i->data);
@@ -260,7 +260,8 @@ static int net_tcp_socket(net_socket_t *hnd, int domain, int type, int proto) {
     (void)type;
     (void)proto;
 
-    if(!(sock = (struct tcp_sock *)malloc(sizeof(struct tcp_sock)))) {
+    if(!(sock = (struct tcp_sock *)kos_heap_malloc(net_heap,
+                                                   sizeof(struct tcp_sock)))) {
         errno = ENOMEM;
         return -1;
     }
@@ -549,7 +550,8 @@ static int net_tcp_accept(net_socket_t *hnd, struct sockaddr *addr,
         sock->listen.head = 0;
 
     /* Allocate the memory we will need... */
-    if(!(sock2 = (struct tcp_sock *)malloc(sizeof(struct tcp_sock)))) {
+    if(!(sock2 = (struct tcp_sock *)kos_heap_malloc(net_heap,
+                                                    sizeof(struct tcp_sock)))) {
         mutex_unlock(&sock->mutex);
         errno = ENOMEM;
         return -1;
@@ -564,7 +566,8 @@ static int net_tcp_accept(net_socket_t *hnd, struct sockaddr *addr,
         return -1;
     }
 
-    if(!(sock2->data.rcvbuf = (uint8_t *)malloc(sock->rcvbuf_sz))) {
+    if(!(sock2->data.rcvbuf = (uint8_t *)kos_heap_malloc(net_heap,
+                                                         sock->rcvbuf_sz))) {
         errno = ENOMEM;
         mutex_unlock(&sock->mutex);
         mutex_destroy(&sock2->mutex);
@@ -572,7 +575,8 @@ static int net_tcp_accept(net_socket_t *hnd, struct sockaddr *addr,
         return -1;
     }
 
-    if(!(sock2->data.sndbuf = (uint8_t *)malloc(sock->sndbuf_sz))) {
+    if(!(sock2->data.sndbuf = (uint8_t *)kos_heap_malloc(net_heap,
+                                                         sock->sndbuf_sz))) {
         errno = ENOMEM;
         mutex_unlock(&sock->mutex);
         free(sock2->data.rcvbuf);
@@ -1090,14 +1094,16 @@ static int net_tcp_connect(net_socket_t *hnd, const struct sockaddr *addr,
        includes setting up all the data we need for that). */
     sock->remote_addr = realaddr6;
 
-    if(!(sock->data.rcvbuf = (uint8_t *)malloc(sock->rcvbuf_sz))) {
+    if(!(sock->data.rcvbuf = (uint8_t *)kos_heap_malloc(net_heap,
+                                                        sock->rcvbuf_sz))) {
         errno = ENOBUFS;
         mutex_unlock(&sock->mutex);
         rwsem_write_unlock(&tcp_sem);
         return -1;
     }
 
-    if(!(sock->data.sndbuf = (uint8_t *)malloc(sock->sndbuf_sz))) {
+    if(!(sock->data.sndbuf = (uint8_t *)kos_heap_malloc(net_heap,
+                                                        sock->sndbuf_sz))) {
         errno = ENOBUFS;
         mutex_unlock(&sock->mutex);
         rwsem_write_unlock(&tcp_sem);
@@ -1226,7 +1232,8 @@ static int net_tcp_listen(net_socket_t *hnd, int backlog) {
     }
 
     /* Allocate the queue and set up everything */
-    sock->listen.queue = (struct lsock *)malloc(sizeof(struct lsock) * backlog);
+    sock->listen.queue = (struct lsock *)kos_heap_malloc(net_heap,
+        sizeof(struct lsock) * backlog);
 
     if(!sock->listen.queue) {
         mutex_unlock(&sock->mutex);
@@ -1830,7 +1837,8 @@ static int net_tcp_setsockopt(net_socket_t *hnd, int level, int option_name,
                     else if(tmp > 65535)
                         tmp = 65535;
 
-                    new_ptr = realloc(sock->data.rcvbuf, tmp);
+                    new_ptr = kos_heap_realloc(net_heap, sock->data.rcvbuf,
+                                               tmp);
                     if(!new_ptr)
                         goto ret_nomem;
 
@@ -1849,7 +1857,8 @@ static int net_tcp_setsockopt(net_socket_t *hnd, int level, int option_name,
                     else if(tmp > 65535)
                         tmp = 65535;
 
-                    new_ptr = realloc(sock->data.sndbuf, tmp);
+                    new_ptr = kos_heap_realloc(net_heap, sock->data.sndbuf,
+                                               tmp);
                     if(!new_ptr) {
                         goto ret_nomem;
                     }
@@ -10,48 +10,50 @@
 #include <stdlib.h>
 
 #include <kos/thread.h>
-#include <arch/timer.h>
+#include <kos/workqueue.h>
+#include <kos/net.h>
+#include <arch/irq.h>
 #include "net_thd.h"
 
+/* Each callback is a delayed work item on a work queue with one worker,
+   which queues itself again every time it's run. */
 struct thd_cb {
     TAILQ_ENTRY(thd_cb) thds;
+    work_t work;
 
     int cbid;
     void (*cb)(void *);
     void *data;
     uint64 timeout;
-    uint64 nextrun;
+
+    /* Set once it's been deleted: 1 if whoever deleted it is freeing it, 2 if
+       it deleted itself and has to be freed once it returns. */
+    int dead;
 };
 
 TAILQ_HEAD(thd_cb_queue, thd_cb);
 
 static struct thd_cb_queue cbs;
-static kthread_t *thd;
-static int done = 0;
+static workqueue_t *wq;
+static struct thd_cb *running;
 static int cbid_top;
 
-static void *net_thd_thd(void *data) {
-    struct thd_cb *cb;
-    uint64 now;
-
-    (void)data;
+static void net_thd_run(work_t *work) {
+    struct thd_cb *cb = (struct thd_cb *)work->data;
+    int old;
 
-    while(!done) {
-        now = timer_ms_gettime64();
+    running = cb;
+    cb->cb(cb->data);
 
-        /* Run any callbacks that need to be run now. */
-        TAILQ_FOREACH(cb, &cbs, thds) {
-            if(now >= cb->nextrun) {
-                cb->cb(cb->data);
-                cb->nextrun = now + cb->timeout;
-            }
-        }
+    old = irq_disable();
+    running = NULL;
 
-        /* Go to sleep til we need to be run again. */
-        thd_sleep(50);
-    }
+    if(!cb->dead)
+        work_queue_delayed(wq, &cb->work, (unsigned int)cb->timeout);
+    else if(cb->dead == 2)
+        free(cb);
 
-    return NULL;
+    irq_restore(old);
 }
 
 int net_thd_add_callback(void (*cb)(void *), void *data, uint64 timeout) {
@@ -59,7 +61,7 @@ int net_thd_add_callback(void (*cb)(void *), void *data, uint64 timeout) {
     struct thd_cb *newcb;
 
     /* Allocate space for the new callback and set it up. */
-    newcb = (struct thd_cb *)malloc(sizeof(struct thd_cb));
+    newcb = (struct thd_cb *)kos_heap_malloc(net_heap, sizeof(struct thd_cb));
 
     if(!newcb) {
         errno = ENOMEM;
@@ -70,11 +72,16 @@ int net_thd_add_callback(void (*cb)(void *), void *data, uint64 timeout) {
     newcb->cb = cb;
     newcb->data = data;
     newcb->timeout = timeout;
-    newcb->nextrun = timer_ms_gettime64() + timeout;
+    newcb->dead = 0;
+    work_init(&newcb->work, net_thd_run, newcb, 0);
 
-    /* Disable interrupts, insert, and re-enable interrupts */
+    /* Disable interrupts, insert, queue it up, and re-enable interrupts */
     old = irq_disable();
     TAILQ_INSERT_TAIL(&cbs, newcb, thds);
+
+    if(wq)
+        work_queue_delayed(wq, &newcb->work, (unsigned int)timeout);
+
     irq_restore(old);
 
     return newcb->cbid;
@@ -90,43 +97,56 @@ int net_thd_del_callback(int cbid) {
 
     /* See if we can find the callback requested. */
     TAILQ_FOREACH(cb, &cbs, thds) {
-        if(cb->cbid == cbid) {
-            TAILQ_REMOVE(&cbs, cb, thds);
-            free(cb);
-            irq_restore(old);
-            return 0;
-        }
+        if(cb->cbid == cbid)
+            break;
     }
 
     /* We didn't find it, punt. */
+    if(!cb) {
+        irq_restore(old);
+        return -1;
+    }
+
+    TAILQ_REMOVE(&cbs, cb, thds);
+    work_cancel(&cb->work);
+
+    /* If it's deleting itself, it'll be freed once it returns. Otherwise,
+       make sure it's not running before freeing it. */
+    if(cb == running && net_thd_is_current()) {
+        cb->dead = 2;
+        irq_restore(old);
+        return 0;
+    }
+
+    cb->dead = 1;
     irq_restore(old);
-    return -1;
+
+    work_wait(&cb->work);
+    free(cb);
+
+    return 0;
 }
 
 int net_thd_is_current(void) {
-    return thd_current == thd;
+    return wq && workqueue_is_worker(wq);
 }
 
 void net_thd_kill(void) {
-    /* Do things gracefully, if we can... Otherwise, punt. */
-    done = 1;
-
-    if(!irq_inside_int()) {
-        thd_join(thd, NULL);
-    }
-    else {
-        thd_destroy(thd);
+    if(wq) {
+        workqueue_destroy(wq);
+        wq = NULL;
     }
-
-    thd = NULL;
 }
 
 int net_thd_init(void) {
+    kthread_attr_t attr = { 0, 0, NULL, 0, "[net_thd]" };
+
     TAILQ_INIT(&cbs);
-    done = 0;
     cbid_top = 1;
+    running = NULL;
 
-    thd = thd_create(0, &net_thd_thd, NULL);
+    if(!(wq = workqueue_create(1, &attr)))
+        return -1;
 
     return 0;
 }
@@ -135,7 +155,7 @@ void net_thd_shutdown(void) {
     struct thd_cb *c, *n;
 
     /* Kill the thread. */
-    if(thd) {
+    if(wq) {
         net_thd_kill();
     }
 
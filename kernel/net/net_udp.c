@@ -588,7 +588,8 @@ static int net_udp_socket(net_socket_t *hnd, int domain, int type, int proto) {
     (void)type;
     (void)proto;
 
-    udpsock = (struct udp_sock *)malloc(sizeof(struct udp_sock));
+    udpsock = (struct udp_sock *)kos_heap_malloc(net_heap,
+                                                 sizeof(struct udp_sock));
 
     if(udpsock == NULL) {
         errno = ENOMEM;
@@ -1212,7 +1213,8 @@ static int net_udp_input4(netif_t *src, const ip_hdr_t *ip, const uint8 *data,
             return 0;
         }
 
-        if(!(pkt = (struct udp_pkt *)malloc(sizeof(struct udp_pkt)))) {
+        if(!(pkt = (struct udp_pkt *)kos_heap_malloc(net_heap,
+                                                     sizeof(struct udp_pkt)))) {
             mutex_unlock(&udp_mutex);
             return -1;
         }
@@ -1221,7 +1223,7 @@ static int net_udp_input4(netif_t *src, const ip_hdr_t *ip, const uint8 *data,
 
         pkt->datasize = size - sizeof(udp_hdr_t);
 
-        if(!(pkt->data = (uint8 *)malloc(pkt->datasize))) {
+        if(!(pkt->data = (uint8 *)kos_heap_malloc(net_heap, pkt->datasize))) {
             free(pkt);
             mutex_unlock(&udp_mutex);
             return -1;
@@ -1350,7 +1352,8 @@ static int net_udp_input6(netif_t *src, const ipv6_hdr_t *ip, const uint8 *data,
             return 0;
         }
 
-        if(!(pkt = (struct udp_pkt *)malloc(sizeof(struct udp_pkt)))) {
+        if(!(pkt = (struct udp_pkt *)kos_heap_malloc(net_heap,
+                                                     sizeof(struct udp_pkt)))) {
             mutex_unlock(&udp_mutex);
             return -1;
         }
@@ -1359,7 +1362,7 @@ static int net_udp_input6(netif_t *src, const ipv6_hdr_t *ip, const uint8 *data,
 
         pkt->datasize = size - sizeof(udp_hdr_t);
 
-        if(!(pkt->data = (uint8 *)malloc(pkt->datasize))) {
+        if(!(pkt->data = (uint8 *)kos_heap_malloc(net_heap, pkt->datasize))) {
             free(pkt);
             mutex_unlock(&udp_mutex);
             return -1;
@@ -21,6 +21,22 @@
 
 /**************************************/
 
+/* Wake up a thread waiting on a condvar. Rather than have it wake up only to
+   block again on the mutex it has to take back, move it straight onto the
+   mutex's queue if the mutex is held, or give it the mutex if it isn't
+   (wait morphing). Either way it won't run until it holds the mutex.
+   Returns 0 if the thread should just be woken instead. */
+static int cond_morph(void *cv, kthread_t *thd) {
+    mutex_t *m = thd->cond_mutex;
+
+    if(m && mutex_wait_morph(m, cv, thd)) {
+        thd->cond_mutex = NULL;
+        return 1;
+    }
+
+    return 0;
+}
+
 /* Allocate a new condvar */
 condvar_t *cond_create(void) {
     condvar_t *cv;
@@ -76,6 +92,7 @@ int cond_wait_timed(condvar_t *cv, mutex_t *m, int timeout) {
     }
 
     /* First of all, release the associated mutex */
+    thd_current->cond_mutex = m;
     mutex_unlock(m);
 
     /* Now block us until we're signaled */
@@ -85,8 +102,12 @@ int cond_wait_timed(condvar_t *cv, mutex_t *m, int timeout) {
     if(rv < 0 && errno == EAGAIN)
         errno = ETIMEDOUT;
 
-    /* Re-lock our mutex */
-    mutex_lock(m);
+    /* Re-lock our mutex, unless it was handed to us when we were signaled.
+       If we were waiting for it and its holder died, we still need it. */
+    if(thd_current->cond_mutex || (rv < 0 && errno == EOWNERDEAD)) {
+        thd_current->cond_mutex = NULL;
+        mutex_lock(m);
+    }
 
     /* Ok, ready to return */
     irq_restore(old);
@@ -100,11 +121,13 @@ int cond_wait(condvar_t *cv, mutex_t *m) {
 
 int cond_signal(condvar_t *cv) {
     int old, rv = 0;
+    kthread_t *thd;
 
     old = irq_disable();
 
     /* Wake one thread who's waiting, if any */
-    genwait_wake_one(cv);
+    if((thd = genwait_top_waiter(cv)) && !cond_morph(cv, thd))
+        genwait_wake_thd(cv, thd, 0);
 
     irq_restore(old);
 
@@ -116,8 +139,8 @@ int cond_broadcast(condvar_t *cv) {
 
     old = irq_disable();
 
-    /* Wake all threads who are waiting */
-    genwait_wake_all(cv);
+    /* Wake all threads who are waiting, in one pass over the sleep queue */
+    genwait_wake_all_fn(cv, cond_morph);
 
     irq_restore(old);
 
@@ -0,0 +1,236 @@
+/* KallistiOS ##version##
+
+   fiber.c
+   Copyright (C) 2026 KallistiOS Team
+*/
+
+/* Cooperative fibers, switched between without the thread scheduler */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include <kos/fiber.h>
+#include <kos/thread.h>
+
+#define FIBER_READY     0   /* Not started, or yielded */
+#define FIBER_RUNNING   1   /* Running, or waiting for one it switched to */
+#define FIBER_FINISHED  2
+
+/* Each fiber is allocated in one block with its stack, which sits below the
+   fiber structure and grows down away from it. */
+struct fiber {
+    /* Saved stack pointer, while it's not running. This holds everything
+       else the fiber needs to carry on. */
+    void *sp;
+
+    void *stack;
+    void *(*routine)(void *param);
+    void *param;
+    void *rv;
+
+    int state;
+    int detached;
+
+    /* What switched to it, and so where it goes back to when it yields */
+    fiber_t *caller;
+
+    /* The scheduler it belongs to, and its place in the ready queue */
+    fiber_sched_t *sched;
+    TAILQ_ENTRY(fiber) entry;
+};
+
+static void fiber_free(fiber_t *fiber) {
+    free(fiber->stack);
+}
+
+/* Fiber execution wrapper; this is where a new fiber starts. */
+static void fiber_entry(void *param) {
+    fiber_t *fiber = (fiber_t *)param;
+
+    fiber_exit(fiber->routine(fiber->param));
+}
+
+/* Switch from the current fiber to another. The other has to be where the
+   current one goes back to, or have the current one as its caller. */
+static void fiber_swap(fiber_t *from, fiber_t *to) {
+    thd_current->fiber = to;
+    to->state = FIBER_RUNNING;
+    fiber_context_switch(&from->sp, to->sp);
+}
+
+/* Run a fiber until it yields or finishes. If the thread isn't running a
+   fiber, it gets one on its stack for as long as it needs one to come back
+   to. */
+static void fiber_run(fiber_t *fiber) {
+    fiber_t root, *self = thd_current->fiber;
+
+    if(!self) {
+        memset(&root, 0, sizeof(root));
+        root.state = FIBER_RUNNING;
+        self = &root;
+    }
+
+    fiber->caller = self;
+    fiber_swap(self, fiber);
+
+    if(self == &root)
+        thd_current->fiber = NULL;
+}
+
+fiber_t *fiber_create(int detach, void *(*routine)(void *param), void *param,
+                      size_t stack_size) {
+    fiber_t *fiber;
+    uint8_t *stack;
+
+    if(!stack_size)
+        stack_size = FIBER_STACK_SIZE;
+
+    stack_size = (stack_size + 7) & ~7;
+
+    if(!(stack = (uint8_t *)malloc(stack_size + sizeof(fiber_t)))) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    fiber = (fiber_t *)(stack + stack_size);
+    memset(fiber, 0, sizeof(fiber_t));
+
+    fiber->stack = stack;
+    fiber->routine = routine;
+    fiber->param = param;
+    fiber->detached = detach;
+    fiber->state = FIBER_READY;
+    fiber->sp = fiber_create_context(fiber, fiber_entry, fiber);
+
+    return fiber;
+}
+
+int fiber_switch(fiber_t *fiber) {
+    if(fiber->state == FIBER_FINISHED) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if(fiber->state == FIBER_RUNNING || fiber->sched) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    fiber_run(fiber);
+
+    if(fiber->state == FIBER_FINISHED && fiber->detached)
+        fiber_free(fiber);
+
+    return 0;
+}
+
+void fiber_yield(void) {
+    fiber_t *self = thd_current->fiber;
+
+    if(!self)
+        return;
+
+    self->state = FIBER_READY;
+    fiber_swap(self, self->caller);
+}
+
+void fiber_exit(void *rv) {
+    fiber_t *self = thd_current->fiber;
+
+    if(!self)
+        return;
+
+    /* Whatever we go back to frees us if need be, so this is the last
+       anything runs on our stack. */
+    self->rv = rv;
+    self->state = FIBER_FINISHED;
+    fiber_swap(self, self->caller);
+
+    /* Never reached */
+    abort();
+}
+
+int fiber_join(fiber_t *fiber, void **value_ptr) {
+    fiber_t *self = thd_current->fiber;
+
+    if(fiber->detached) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    while(fiber->state != FIBER_FINISHED) {
+        /* One in a scheduler gets run by the scheduler, so all we can do is
+           let it get on with it. */
+        if(fiber->sched) {
+            if(!self || self->sched != fiber->sched) {
+                errno = EINVAL;
+                return -1;
+            }
+
+            fiber_yield();
+        }
+        else if(fiber_switch(fiber) < 0) {
+            return -1;
+        }
+    }
+
+    if(value_ptr)
+        *value_ptr = fiber->rv;
+
+    fiber_free(fiber);
+
+    return 0;
+}
+
+int fiber_destroy(fiber_t *fiber) {
+    if(fiber->state == FIBER_RUNNING ||
+       (fiber->sched && fiber->state != FIBER_FINISHED)) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    fiber_free(fiber);
+
+    return 0;
+}
+
+fiber_t *fiber_self(void) {
+    return thd_current->fiber;
+}
+
+void fiber_sched_init(fiber_sched_t *sched) {
+    TAILQ_INIT(&sched->ready);
+}
+
+int fiber_sched_add(fiber_sched_t *sched, fiber_t *fiber) {
+    if(fiber->state == FIBER_FINISHED) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if(fiber->state == FIBER_RUNNING || fiber->sched) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    fiber->sched = sched;
+    TAILQ_INSERT_TAIL(&sched->ready, fiber, entry);
+
+    return 0;
+}
+
+void fiber_sched_run(fiber_sched_t *sched) {
+    fiber_t *fiber;
+
+    while((fiber = TAILQ_FIRST(&sched->ready))) {
+        TAILQ_REMOVE(&sched->ready, fiber, entry);
+        fiber_run(fiber);
+
+        if(fiber->state != FIBER_FINISHED)
+            TAILQ_INSERT_TAIL(&sched->ready, fiber, entry);
+        else if(fiber->detached)
+            fiber_free(fiber);
+    }
+}
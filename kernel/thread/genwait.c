@@ -35,36 +35,34 @@ static TAILQ_HEAD(slpquehead, kthread) slpque[TABLESIZE];
    ready to run at a later time will be placed here. Note that this doesn't
    deal with pre-emptive timeslice context switching, only things that are
    specifically blocked for a timed event (thd_sleep, genwait_wait, etc).
-   This queue is sorted by remaining time (smallest at the front). */
-static struct ktqueue timer_queue;
 
-/* Internal function to insert a thread on the timer queue. Maintains
-   sorting order by wait time. */
-static void tq_insert(kthread_t * thd) {
-    kthread_t * t;
+   This is a pairing heap ordered by wait time (smallest at the root), linked
+   through the timerq nodes of the threads themselves so nothing has to be
+   allocated with interrupts disabled, and so the number of sleepers doesn't
+   slow down every thd_sleep or timed wait like a sorted list does. */
+static int tq_less(const pheap_node_t *a, const pheap_node_t *b) {
+    return PHEAP_ENTRY(a, kthread_t, timerq)->wait_timeout <
+           PHEAP_ENTRY(b, kthread_t, timerq)->wait_timeout;
+}
 
-    /* Search for its place; note that new threads will be placed at
-       the end of a group with the same timeout. */
-    TAILQ_FOREACH(t, &timer_queue, timerq) {
-        if(thd->wait_timeout < t->wait_timeout) {
-            TAILQ_INSERT_BEFORE(t, thd, timerq);
-            return;
-        }
-    }
+static pheap_t timer_queue = PHEAP_INITIALIZER(tq_less);
 
-    /* Couldn't find anything scheduled later, put this at the end. */
-    TAILQ_INSERT_TAIL(&timer_queue, thd, timerq);
+/* Internal function to insert a thread on the timer queue. */
+static void tq_insert(kthread_t * thd) {
+    pheap_insert(&timer_queue, &thd->timerq);
 }
 
 /* Internal function to remove a thread from the timer queue. */
 static void tq_remove(kthread_t * thd) {
-    TAILQ_REMOVE(&timer_queue, thd, timerq);
+    pheap_remove(&timer_queue, &thd->timerq);
 }
 
 /* Returns the top thread on the timer queue (next event). If nothing is
    queued, we'll return NULL. */
 static kthread_t * tq_next(void) {
-    return TAILQ_FIRST(&timer_queue);
+    pheap_node_t *n = pheap_first(&timer_queue);
+
+    return n ? PHEAP_ENTRY(n, kthread_t, timerq) : NULL;
 }
 
 int genwait_wait(void * obj, const char * mesg, int timeout, void (*callback)(void *)) {
@@ -123,12 +121,78 @@ static void genwait_unqueue(kthread_t * thd) {
         thd->wait_timeout = 0;
         thd->wait_callback = NULL;
 
-        /* Make it runnable again */
+        /* Make it runnable again, noting when for the accounting */
         thd->state = STATE_READY;
+        thd->acct.woken = timer_ns_gettime64();
         thd_add_to_runnable(thd, 0);
     }
 }
 
+int genwait_move(void *obj, kthread_t *thd, void *newobj, const char *mesg) {
+    if(thd->state != STATE_WAIT || thd->wait_obj != obj)
+        return 0;
+
+    TAILQ_REMOVE(&slpque[LOOKUP(obj)], thd, thdq);
+
+    /* It's waiting for something else now, so the old timeout is gone */
+    if(thd->wait_timeout)
+        tq_remove(thd);
+
+    thd->wait_obj = newobj;
+    thd->wait_msg = mesg;
+    thd->wait_timeout = 0;
+    thd->wait_callback = NULL;
+    TAILQ_INSERT_TAIL(&slpque[LOOKUP(newobj)], thd, thdq);
+
+    return 1;
+}
+
+kthread_t *genwait_top_waiter(void *obj) {
+    kthread_t *t, *top = NULL;
+
+    TAILQ_FOREACH(t, &slpque[LOOKUP(obj)], thdq) {
+        if(t->wait_obj == obj && (!top || t->prio < top->prio))
+            top = t;
+    }
+
+    return top;
+}
+
+/* Let func deal with a thread sleeping on obj, or wake it if func doesn't. */
+static void genwait_wake_fn(void *obj, kthread_t *thd,
+                            int (*func)(void *obj, kthread_t *thd)) {
+    if(!func(obj, thd)) {
+        genwait_unqueue(thd);
+        CONTEXT_RET(thd->context) = 0;
+    }
+}
+
+int genwait_wake_all_fn(void *obj, int (*func)(void *obj, kthread_t *thd)) {
+    struct slpquehead *qp = &slpque[LOOKUP(obj)];
+    kthread_t *t, *nt;
+    int cnt;
+
+    /* The most important thread goes first... */
+    if(!(t = genwait_top_waiter(obj)))
+        return 0;
+
+    genwait_wake_fn(obj, t, func);
+
+    /* ...then the rest in the order they went to sleep. Whatever func did
+       with the first, it isn't sleeping on obj now, so it's skipped. Any
+       thread func moves to the end of this same queue is skipped too. */
+    for(cnt = 1, t = TAILQ_FIRST(qp); t != NULL; t = nt) {
+        nt = TAILQ_NEXT(t, thdq);
+
+        if(t->wait_obj == obj) {
+            genwait_wake_fn(obj, t, func);
+            ++cnt;
+        }
+    }
+
+    return cnt;
+}
+
 int genwait_wake_cnt(void * obj, int cntmax, int err) {
     kthread_t       * t, * nt;
     struct slpquehead   * qp;
@@ -277,7 +341,7 @@ int genwait_init(void) {
     for(i = 0; i < TABLESIZE; i++)
         TAILQ_INIT(&slpque[i]);
 
-    TAILQ_INIT(&timer_queue);
+    timer_queue.root = NULL;
     return 0;
 }
 
@@ -0,0 +1,232 @@
+/* KallistiOS ##version##
+
+   hrtimer.c
+   Copyright (C) 2026 KallistiOS Team
+*/
+
+/* High-resolution timers, multiplexed onto the secondary timer */
+
+#include <errno.h>
+
+#include <kos/hrtimer.h>
+#include <kos/mutex.h>
+#include <arch/irq.h>
+#include <arch/timer.h>
+
+/* Running timers, in a pairing heap ordered by when they're due (soonest at
+   the root), just like genwait's timeout queue. The secondary timer is kept
+   set for the root. Everything here is protected by disabling interrupts. */
+static int hq_less(const pheap_node_t *a, const pheap_node_t *b) {
+    return PHEAP_ENTRY(a, hrtimer_t, node)->when <
+           PHEAP_ENTRY(b, hrtimer_t, node)->when;
+}
+
+static pheap_t hr_heap = PHEAP_INITIALIZER(hq_less);
+
+/* Set while the interrupt handler is calling timers, which reprograms the
+   secondary timer itself when it's done. */
+static int hr_dispatching;
+
+/* Work queue for deferred timers, started by the first one set up. */
+static workqueue_t *hr_wq;
+static mutex_t hr_wq_lock = MUTEX_INITIALIZER;
+
+/* The first timer due, or NULL if none are running. */
+static hrtimer_t *hq_first(void) {
+    pheap_node_t *n = pheap_first(&hr_heap);
+
+    return n ? PHEAP_ENTRY(n, hrtimer_t, node) : NULL;
+}
+
+static void hq_insert(hrtimer_t *timer) {
+    pheap_insert(&hr_heap, &timer->node);
+    timer->queued = 1;
+}
+
+static void hq_remove(hrtimer_t *timer) {
+    pheap_remove(&hr_heap, &timer->node);
+    timer->queued = 0;
+}
+
+/* Set the secondary timer for the first timer due. */
+static void hr_program(uint64_t now) {
+    hrtimer_t *first = hq_first();
+
+    if(!first)
+        timer_secondary_stop();
+    else if(first->when <= now)
+        timer_secondary_wakeup(1);
+    else if(first->when - now > UINT32_MAX)
+        timer_secondary_wakeup(UINT32_MAX);
+    else
+        timer_secondary_wakeup((uint32_t)(first->when - now));
+}
+
+/* Secondary timer callback: call everything that's due. */
+static void hr_irq(irq_context_t *context) {
+    uint64_t now = timer_us_gettime64(), missed;
+    hrtimer_t *timer;
+
+    (void)context;
+
+    hr_dispatching = 1;
+
+    while((timer = hq_first()) && timer->when <= now) {
+        hq_remove(timer);
+
+        /* Periodic timers go straight back in for their next time, skipping
+           any that have gone by already. */
+        if(timer->period) {
+            timer->when += timer->period;
+
+            if(timer->when <= now) {
+                missed = (now - timer->when) / timer->period + 1;
+                timer->when += missed * timer->period;
+                timer->overruns += (uint32_t)missed;
+            }
+
+            hq_insert(timer);
+        }
+
+        if(timer->flags & HRTIMER_DEFERRED) {
+            if(work_queue(hr_wq, &timer->work))
+                ++timer->overruns;
+        }
+        else {
+            timer->func(timer);
+        }
+    }
+
+    hr_dispatching = 0;
+
+    /* The functions may have taken a while, so look at the time again */
+    hr_program(timer_us_gettime64());
+}
+
+/* Work function for deferred timers. */
+static void hr_work(work_t *work) {
+    hrtimer_t *timer = (hrtimer_t *)work->data;
+
+    timer->func(timer);
+}
+
+int hrtimer_init(hrtimer_t *timer, void (*func)(hrtimer_t *timer), void *data,
+                 int flags) {
+    kthread_attr_t attr = { 0, 0, NULL, 1, "[hrtimer]" };
+
+    if(flags != HRTIMER_IRQ && flags != HRTIMER_DEFERRED) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if(flags == HRTIMER_DEFERRED) {
+        mutex_lock(&hr_wq_lock);
+
+        if(!hr_wq)
+            hr_wq = workqueue_create(1, &attr);
+
+        mutex_unlock(&hr_wq_lock);
+
+        if(!hr_wq)
+            return -1;
+    }
+
+    timer->when = 0;
+    timer->period = 0;
+    timer->flags = flags;
+    timer->queued = 0;
+    timer->func = func;
+    timer->data = data;
+    timer->overruns = 0;
+    work_init(&timer->work, hr_work, timer, 0);
+
+    return 0;
+}
+
+int hrtimer_start_abs(hrtimer_t *timer, uint64_t when, uint32_t period) {
+    int old, rv = 0;
+
+    old = irq_disable();
+
+    if(timer->queued) {
+        hq_remove(timer);
+        rv = 1;
+    }
+
+    timer->when = when;
+    timer->period = period;
+    hq_insert(timer);
+
+    /* If it's the first due now, the secondary timer needs bringing
+       forward. */
+    if(hq_first() == timer && !hr_dispatching)
+        hr_program(timer_us_gettime64());
+
+    irq_restore(old);
+
+    return rv;
+}
+
+int hrtimer_start(hrtimer_t *timer, uint64_t delay, uint32_t period) {
+    return hrtimer_start_abs(timer, timer_us_gettime64() + delay, period);
+}
+
+int hrtimer_cancel(hrtimer_t *timer) {
+    int old, rv = 0, first;
+
+    old = irq_disable();
+
+    if(timer->queued) {
+        first = hq_first() == timer;
+        hq_remove(timer);
+        rv = 1;
+
+        /* No point waking up for it any more */
+        if(first && !hr_dispatching)
+            hr_program(timer_us_gettime64());
+    }
+
+    if(timer->flags & HRTIMER_DEFERRED)
+        rv |= work_cancel(&timer->work);
+
+    irq_restore(old);
+
+    /* Let a deferred function that's already been called finish */
+    if((timer->flags & HRTIMER_DEFERRED) && !irq_inside_int() &&
+       !workqueue_is_worker(hr_wq))
+        work_wait(&timer->work);
+
+    return rv;
+}
+
+int hrtimer_pending(const hrtimer_t *timer) {
+    return timer->queued;
+}
+
+int hrtimer_sys_init(void) {
+    hr_heap.root = NULL;
+    hr_dispatching = 0;
+    timer_secondary_set_callback(hr_irq);
+
+    return 0;
+}
+
+void hrtimer_sys_shutdown(void) {
+    hrtimer_t *timer;
+    int old;
+
+    old = irq_disable();
+    timer_secondary_set_callback(NULL);
+    timer_secondary_stop();
+
+    /* Anything still running won't go off now */
+    while((timer = hq_first()))
+        hq_remove(timer);
+
+    irq_restore(old);
+
+    if(hr_wq) {
+        workqueue_destroy(hr_wq);
+        hr_wq = NULL;
+    }
+}
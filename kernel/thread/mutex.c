@@ -15,6 +15,167 @@
 
 #include <arch/irq.h>
 
+/* mutex_trylock() and mutex_unlock() use this as the holder inside an IRQ */
+#define IRQ_HOLDER  ((kthread_t *)0xFFFFFFFF)
+
+/* How far down a chain of mutexes to pass a priority boost on. This only
+   stops a deadlock going round in circles forever. */
+#define PI_MAX_DEPTH    16
+
+/* The thread holding a mutex, or NULL if it isn't a real thread */
+static inline kthread_t *mutex_owner(mutex_t *m) {
+    return m->holder == IRQ_HOLDER ? NULL : m->holder;
+}
+
+/* Add a mutex to a thread's list of those it holds */
+static void mutex_held_add(mutex_t *m, kthread_t *thd) {
+    if(thd && thd != IRQ_HOLDER) {
+        m->next_held = thd->mutex_held;
+        thd->mutex_held = m;
+    }
+}
+
+/* Take a mutex off a thread's list of those it holds */
+static void mutex_held_remove(mutex_t *m, kthread_t *thd) {
+    mutex_t **i;
+
+    for(i = &thd->mutex_held; *i; i = &(*i)->next_held) {
+        if(*i == m) {
+            *i = m->next_held;
+            break;
+        }
+    }
+
+    m->next_held = NULL;
+}
+
+/* The priority a thread should be running at: its own, or that of the most
+   important thread waiting for a mutex it holds, whichever is higher. */
+static prio_t mutex_pi_prio(kthread_t *thd) {
+    prio_t prio = thd->base_prio;
+    kthread_t *w;
+    mutex_t *m;
+
+    for(m = thd->mutex_held; m; m = m->next_held) {
+        if((w = genwait_top_waiter(m)) && w->prio < prio)
+            prio = w->prio;
+    }
+
+    return prio;
+}
+
+void mutex_pi_update(kthread_t *thd) {
+    prio_t prio;
+    int depth;
+
+    for(depth = 0; thd && depth < PI_MAX_DEPTH; ++depth) {
+        prio = mutex_pi_prio(thd);
+
+        if(prio == thd->prio)
+            break;
+
+        thd_apply_prio(thd, prio);
+
+        /* If it's waiting on a mutex, its holder may need to change too */
+        if(!thd->mutex_wait)
+            break;
+
+        thd = mutex_owner(thd->mutex_wait);
+    }
+}
+
+/* Lend a priority to the holder of a mutex, and to the holder of whatever
+   that thread is waiting for, and so on. */
+static void mutex_pi_boost(mutex_t *m, prio_t prio) {
+    kthread_t *thd;
+    int depth;
+
+    for(depth = 0; depth < PI_MAX_DEPTH; ++depth) {
+        thd = mutex_owner(m);
+
+        if(!thd || thd->prio <= prio)
+            break;
+
+        thd_apply_prio(thd, prio);
+
+        if(!(m = thd->mutex_wait))
+            break;
+    }
+}
+
+/* Let go of a mutex, handing it straight over to the most important thread
+   waiting for it, if any. The old holder drops any priority it was lent for
+   it. Interrupts must be disabled. */
+static void mutex_release(mutex_t *m) {
+    kthread_t *owner = mutex_owner(m);
+    kthread_t *next = genwait_top_waiter(m);
+
+    if(owner)
+        mutex_held_remove(m, owner);
+
+    if(next) {
+        m->holder = next;
+        m->count = 1;
+        next->mutex_wait = NULL;
+        mutex_held_add(m, next);
+        genwait_wake_thd(m, next, 0);
+
+        /* It may now have to stand in for the rest of the waiters */
+        mutex_pi_update(next);
+    }
+    else {
+        m->holder = NULL;
+        m->count = 0;
+    }
+
+    if(owner)
+        mutex_pi_update(owner);
+}
+
+void mutex_release_all(kthread_t *thd) {
+    mutex_t *m;
+    kthread_t *w;
+
+    while((m = thd->mutex_held)) {
+        dbglog(DBG_WARNING, "thread %d (%s) ended holding mutex %p\n",
+               thd->tid, thd->label, (void *)m);
+
+        /* Nobody gets it: whatever it protects may be half done. It's left
+           unlocked, so it doesn't point at a thread that's gone, and anything
+           waiting for it is told the holder died. */
+        mutex_held_remove(m, thd);
+        m->holder = NULL;
+        m->count = 0;
+
+        while((w = genwait_top_waiter(m))) {
+            w->mutex_wait = NULL;
+            genwait_wake_thd(m, w, EOWNERDEAD);
+        }
+    }
+}
+
+int mutex_wait_morph(mutex_t *m, void *obj, kthread_t *thd) {
+    /* A recursive mutex it still holds; it'll just lock it again */
+    if(m->count && m->holder == thd)
+        return 0;
+
+    if(!m->count) {
+        m->count = 1;
+        m->holder = thd;
+        mutex_held_add(m, thd);
+        genwait_wake_thd(obj, thd, 0);
+        return 1;
+    }
+
+    if(!genwait_move(obj, thd, m, "mutex_lock"))
+        return 0;
+
+    thd->mutex_wait = m;
+    mutex_pi_boost(m, thd->prio);
+
+    return 1;
+}
+
 mutex_t *mutex_create(void) {
     mutex_t *rv;
 
@@ -30,6 +191,7 @@ mutex_t *mutex_create(void) {
     rv->dynamic = 1;
     rv->holder = NULL;
     rv->count = 0;
+    rv->next_held = NULL;
 
     return rv;
 }
@@ -46,6 +208,7 @@ int mutex_init(mutex_t *m, int mtype) {
     m->dynamic = 0;
     m->holder = NULL;
     m->count = 0;
+    m->next_held = NULL;
 
     return 0;
 }
@@ -69,8 +232,9 @@ int mutex_destroy(mutex_t *m) {
         m->type = -1;
     }
 
-    /* If the mutex was created with the deprecated mutex_create(), free it. */
-    if(m->dynamic) {
+    /* If the mutex was created with the deprecated mutex_create(), free it,
+       unless it's busy: its holder and any waiters still point at it. */
+    if(m->dynamic && !m->count) {
         free(m);
     }
 
@@ -108,6 +272,7 @@ int mutex_lock_timed(mutex_t *m, int timeout) {
     else if(!m->count) {
         m->count = 1;
         m->holder = thd_current;
+        mutex_held_add(m, thd_current);
     }
     else if(m->type == MUTEX_TYPE_RECURSIVE && m->holder == thd_current) {
         if(m->count == INT_MAX) {
@@ -123,14 +288,25 @@ int mutex_lock_timed(mutex_t *m, int timeout) {
         rv = -1;
     }
     else {
-        if(!(rv = genwait_wait(m, timeout ? "mutex_lock_timed" : "mutex_lock",
-                               timeout, NULL))) {
-            m->holder = thd_current;
-            m->count = 1;
-        }
-        else {
-            errno = ETIMEDOUT;
+        /* Lend the holder our priority while we wait */
+        thd_current->mutex_wait = m;
+        mutex_pi_boost(m, thd_current->prio);
+
+        /* If we're woken up, mutex_release() has already made us the
+           holder. */
+        rv = genwait_wait(m, timeout ? "mutex_lock_timed" : "mutex_lock",
+                          timeout, NULL);
+        thd_current->mutex_wait = NULL;
+
+        if(rv) {
+            /* Timed out, unless the holder died (errno is set for that) */
+            if(errno == EAGAIN)
+                errno = ETIMEDOUT;
+
             rv = -1;
+
+            /* Take back the priority we lent */
+            mutex_pi_update(mutex_owner(m));
         }
     }
 
@@ -151,7 +327,7 @@ int mutex_trylock(mutex_t *m) {
     /* If we're inside of an interrupt, pick a special value for the thread that
        would otherwise be impossible... */
     if(irq_inside_int())
-        thd = (kthread_t *)0xFFFFFFFF;
+        thd = IRQ_HOLDER;
 
     if(m->type < MUTEX_TYPE_NORMAL || m->type > MUTEX_TYPE_RECURSIVE) {
         errno = EINVAL;
@@ -163,7 +339,10 @@ int mutex_trylock(mutex_t *m) {
         rv = -1;
     }
     else {
-        m->holder = thd;
+        if(!m->count) {
+            m->holder = thd;
+            mutex_held_add(m, thd);
+        }
 
         switch(m->type) {
             case MUTEX_TYPE_NORMAL:
@@ -195,16 +374,14 @@ int mutex_trylock(mutex_t *m) {
 }
 
 static int mutex_unlock_common(mutex_t *m, kthread_t *thd) {
-    int old, rv = 0, wakeup = 0;
+    int old, rv = 0, release = 0;
 
     old = irq_disable();
 
     switch(m->type) {
         case MUTEX_TYPE_NORMAL:
         case MUTEX_TYPE_OLDNORMAL:
-            m->count = 0;
-            m->holder = NULL;
-            wakeup = 1;
+            release = 1;
             break;
 
         case MUTEX_TYPE_ERRORCHECK:
@@ -213,9 +390,7 @@ static int mutex_unlock_common(mutex_t *m, kthread_t *thd) {
                 rv = -1;
             }
             else {
-                m->count = 0;
-                m->holder = NULL;
-                wakeup = 1;
+                release = 1;
             }
             break;
 
@@ -225,8 +400,7 @@ static int mutex_unlock_common(mutex_t *m, kthread_t *thd) {
                 rv = -1;
             }
             else if(!--m->count) {
-                m->holder = NULL;
-                wakeup = 1;
+                release = 1;
             }
             break;
 
@@ -235,9 +409,9 @@ static int mutex_unlock_common(mutex_t *m, kthread_t *thd) {
             rv = -1;
     }
 
-    /* If we need to wake up a thread, do so. */
-    if(wakeup)
-        genwait_wake_one(m);
+    /* If we need to hand it on to another thread, do so. */
+    if(release)
+        mutex_release(m);
 
     irq_restore(old);
     return rv;
@@ -249,7 +423,7 @@ int mutex_unlock(mutex_t *m) {
     /* If we're inside of an interrupt, use the special value for the thread
        from mutex_trylock(). */
     if(irq_inside_int())
-        thd = (kthread_t *)0xFFFFFFFF;
+        thd = IRQ_HOLDER;
 
     return mutex_unlock_common(m, thd);
 }
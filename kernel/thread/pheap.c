@@ -0,0 +1,102 @@
+/* KallistiOS ##version##
+
+   pheap.c
+   Copyright (C) 2026 KallistiOS Team
+*/
+
+/* Pairing heaps, shared by genwait's timeout queue and the high-resolution
+   timers. */
+
+#include <kos/pheap.h>
+
+/* Join two heaps (either may be empty), returning the new root. On a tie,
+   the first heap stays on top. */
+static pheap_node_t *pheap_meld(pheap_less_t less, pheap_node_t *a,
+                                pheap_node_t *b) {
+    pheap_node_t *t;
+
+    if(!a)
+        return b;
+
+    if(!b)
+        return a;
+
+    if(less(b, a)) {
+        t = a;
+        a = b;
+        b = t;
+    }
+
+    /* b becomes the first child of a */
+    b->prev = a;
+    b->next = a->child;
+
+    if(a->child)
+        a->child->prev = b;
+
+    a->child = b;
+
+    return a;
+}
+
+/* Join a list of sibling heaps into one: meld them in pairs from the left,
+   then meld the pairs together from the right. */
+static pheap_node_t *pheap_merge_pairs(pheap_less_t less,
+                                       pheap_node_t *first) {
+    pheap_node_t *a, *b, *pairs = NULL, *root = NULL;
+
+    while(first) {
+        a = first;
+        b = a->next;
+        first = b ? b->next : NULL;
+
+        a->next = a->prev = NULL;
+
+        if(b) {
+            b->next = b->prev = NULL;
+            a = pheap_meld(less, a, b);
+        }
+
+        /* Keep the pairs on a list through their (now unused) next links */
+        a->next = pairs;
+        pairs = a;
+    }
+
+    while(pairs) {
+        a = pairs;
+        pairs = a->next;
+        a->next = NULL;
+        root = pheap_meld(less, root, a);
+    }
+
+    return root;
+}
+
+void pheap_insert(pheap_t *heap, pheap_node_t *node) {
+    node->child = node->next = node->prev = NULL;
+    heap->root = pheap_meld(heap->less, heap->root, node);
+}
+
+void pheap_remove(pheap_t *heap, pheap_node_t *node) {
+    pheap_node_t *sub;
+
+    if(node == heap->root) {
+        heap->root = pheap_merge_pairs(heap->less, node->child);
+    }
+    else {
+        /* Unlink it from its parent or siblings... */
+        if(node->prev->child == node)
+            node->prev->child = node->next;
+        else
+            node->prev->next = node->next;
+
+        if(node->next)
+            node->next->prev = node->prev;
+
+        /* ...and put its children back */
+        sub = pheap_merge_pairs(heap->less, node->child);
+        heap->root = pheap_meld(heap->less, heap->root, sub);
+    }
+
+    node->child = node->next = node->prev = NULL;
+}
@@ -13,9 +13,11 @@
 #include <stdlib.h>
 #include <reent.h>
 #include <errno.h>
+#include <stdint.h>
 #include <kos/thread.h>
 #include <kos/dbgio.h>
 #include <kos/sem.h>
+#include <kos/mutex.h>
 #include <kos/rwsem.h>
 #include <kos/cond.h>
 #include <kos/genwait.h>
@@ -54,13 +56,51 @@ static inline size_t align_to(size_t address, size_t alignment) {
 static struct ktlist thd_list;
 
 /* Run queue. This is more like on a standard time sharing system than the
-   previous versions. The top element of this priority queue should be the
-   thread that is ready to run next. When a thread is scheduled, it will be
-   removed from this queue. When it's de-scheduled, it will be re-inserted
-   by its priority value at the end of its priority group. Note that right
-   now this condition is being broken because sleeping threads are on the
-   same queue. We deal with those in thd_switch below. */
-static struct ktqueue run_queue;
+   previous versions. Ready threads are kept in one list per priority, with
+   a bit set in run_bitmap for each list that isn't empty and a bit set in
+   run_summary for each word of run_bitmap that isn't zero, so the thread to
+   run next is found with two find-first-set operations whatever the number
+   of threads. When a thread is scheduled, it will be removed from its list.
+   When it's de-scheduled, it will be re-inserted at the end of its list.
+
+   Priorities go all the way up to PRIO_MAX, but having a list for each of
+   them would cost far more memory than it's worth. The last list instead
+   holds every thread from RUNQ_LEVELS - 1 upwards, kept in priority order;
+   normally that's only the idle thread. */
+#define RUNQ_LEVELS 256
+static struct ktqueue run_queue[RUNQ_LEVELS];
+static uint32_t run_bitmap[RUNQ_LEVELS / 32];
+static uint32_t run_summary;
+
+static inline int runq_level(prio_t prio) {
+    return prio < RUNQ_LEVELS - 1 ? prio : RUNQ_LEVELS - 1;
+}
+
+/* The first thread on the run queue, or NULL if there isn't one. */
+static inline kthread_t *runq_first(void) {
+    int word;
+
+    if(!run_summary)
+        return NULL;
+
+    word = __builtin_ctz(run_summary);
+    return TAILQ_FIRST(&run_queue[(word << 5) |
+                                  __builtin_ctz(run_bitmap[word])]);
+}
+
+/* Deadline threads. These are kept off the run queue: a thread that's ready
+   to run and has budget left for its period is on edf_ready, in order of
+   deadline, and one that's waiting for its next period to start, because
+   it's used its budget up or called thd_edf_wait(), is on edf_release, in
+   order of when that is. Either way it's flagged THD_QUEUED, and everything
+   on edf_ready runs ahead of the run queue. edf_density is the total of
+   budget / deadline over all of them, in 16.16 fixed point, and edf_running
+   is the one on the CPU, if there is one, for charging its time to it. */
+static struct ktqueue edf_ready, edf_release;
+static int edf_count;
+static uint32_t edf_density;
+static kthread_t *edf_running;
+static thd_edf_handler_t edf_overrun_hnd;
 
 /* The currently executing thread. This thread should not be on any queues. */
 kthread_t *thd_current = NULL;
@@ -77,6 +117,30 @@ static uint32_t thd_count = 0;
 /* The idle task */
 static kthread_t *thd_idle_thd = NULL;
 
+/* Tickless mode. Rather than waking up HZ times a second, the primary timer
+   is programmed for the next thing that actually needs doing: the end of the
+   current thread's timeslice, or the earliest genwait timeout. While only
+   the idle thread can run there's no timeslice to end, so the timer is left
+   off unless something is sleeping. */
+static int thd_tickless = 0;
+
+/* When the current thread's timeslice runs out, in tickless mode. */
+static uint64_t thd_slice_end;
+
+/* When the next tick is due, in periodic mode. Deadline threads may need the
+   timer to go off in between. */
+static uint64_t thd_tick_next;
+
+/* When the threads started, for working out each one's share of the CPU. */
+static uint64_t thd_start_time;
+
+/* Context switch trace. This is a ring buffer of trace_size events, with the
+   oldest of the trace_count held at trace_head. It's only there if someone
+   has called thd_trace_enable(). */
+static thd_trace_event_t *trace_buf;
+static size_t trace_size, trace_head, trace_count;
+static uint32_t trace_lost;
+
 /*****************************************************************************/
 /* Debug */
 
@@ -114,6 +178,22 @@ int thd_each(int (*cb)(kthread_t *thd, void *user_data), void *data) {
     return 0;
 }
 
+/* Print one line of thd_pslist() or thd_pslist_queue() */
+static void thd_ps_thread(int (*pf)(const char *fmt, ...), kthread_t *cur) {
+    pf("%08lx\t", CONTEXT_PC(cur->context));
+    pf("%d\t", cur->tid);
+
+    if(cur->prio == PRIO_MAX)
+        pf("MAX\t");
+    else
+        pf("%d\t", cur->prio);
+
+    pf("%08lx\t", cur->flags);
+    pf("%ld\t\t", (uint32_t)cur->wait_timeout);
+    pf("%10s", thd_state_to_str(cur));
+    pf("%s\n", cur->label);
+}
+
 int thd_pslist(int (*pf)(const char *fmt, ...)) {
     kthread_t *cur;
 
@@ -121,18 +201,7 @@ int thd_pslist(int (*pf)(const char *fmt, ...)) {
     pf("addr\t\ttid\tprio\tflags\twait_timeout\tstate     name\n");
 
     LIST_FOREACH(cur, &thd_list, t_list) {
-        pf("%08lx\t", CONTEXT_PC(cur->context));
-        pf("%d\t", cur->tid);
-
-        if(cur->prio == PRIO_MAX)
-            pf("MAX\t");
-        else
-            pf("%d\t", cur->prio);
-
-        pf("%08lx\t", cur->flags);
-        pf("%ld\t\t", (uint32_t)cur->wait_timeout);
-        pf("%10s", thd_state_to_str(cur));
-        pf("%s\n", cur->label);
+        thd_ps_thread(pf, cur);
     }
     pf("--end of list--\n");
 
@@ -141,23 +210,185 @@ int thd_pslist(int (*pf)(const char *fmt, ...)) {
 
 int thd_pslist_queue(int (*pf)(const char *fmt, ...)) {
     kthread_t *cur;
+    int i;
 
     pf("Queued threads:\n");
     pf("addr\t\ttid\tprio\tflags\twait_timeout\tstate     name\n");
-    TAILQ_FOREACH(cur, &run_queue, thdq) {
-        pf("%08lx\t", CONTEXT_PC(cur->context));
-        pf("%d\t", cur->tid);
 
-        if(cur->prio == PRIO_MAX)
-            pf("MAX\t");
-        else
-            pf("%d\t", cur->prio);
+    /* Deadline threads that can run come first, as they do when scheduling */
+    TAILQ_FOREACH(cur, &edf_ready, thdq) {
+        thd_ps_thread(pf, cur);
+    }
+
+    for(i = 0; i < RUNQ_LEVELS; i++) {
+        TAILQ_FOREACH(cur, &run_queue[i], thdq) {
+            thd_ps_thread(pf, cur);
+        }
+    }
+
+    if(!TAILQ_EMPTY(&edf_release)) {
+        pf("Deadline threads waiting for their next period:\n");
+
+        TAILQ_FOREACH(cur, &edf_release, thdq) {
+            thd_ps_thread(pf, cur);
+        }
+    }
+
+    return 0;
+}
+
+int thd_get_acct(kthread_t *thd, kthread_acct_t *acct) {
+    uint64_t now;
+    int old;
+
+    if(thd == NULL)
+        return -1;
+
+    old = irq_disable();
+    now = timer_ns_gettime64();
+    *acct = thd->acct;
+
+    /* Count whatever the thread has been doing since it last switched */
+    if(thd == thd_current) {
+        acct->cpu_time += now - acct->since;
+    }
+    else if(thd->state == STATE_READY) {
+        if(acct->woken) {
+            acct->blocked_time += acct->woken - acct->since;
+            acct->ready_time += now - acct->woken;
+        }
+        else {
+            acct->ready_time += now - acct->since;
+        }
+    }
+    else {
+        acct->blocked_time += now - acct->since;
+    }
+
+    acct->since = now;
+    irq_restore(old);
+
+    return 0;
+}
+
+int thd_pslist_acct(int (*pf)(const char *fmt, ...)) {
+    kthread_t *cur;
+    kthread_acct_t acct;
+    uint64_t total = timer_ns_gettime64() - thd_start_time;
+
+    if(!total)
+        total = 1;
+
+    pf("Thread accounting (times in ms):\n");
+    pf("tid\tcpu\tcpu%%\tready\tblocked\tvol\tinvol\tlast run\tname\n");
+
+    LIST_FOREACH(cur, &thd_list, t_list) {
+        thd_get_acct(cur, &acct);
 
-        pf("%08lx\t", cur->flags);
-        pf("%ld\t\t", (uint32_t)cur->wait_timeout);
-        pf("%10s", thd_state_to_str(cur));
+        pf("%d\t", cur->tid);
+        pf("%lu\t", (uint32_t)(acct.cpu_time / 1000000));
+        pf("%lu.%lu\t", (uint32_t)(acct.cpu_time * 100 / total),
+           (uint32_t)(acct.cpu_time * 1000 / total % 10));
+        pf("%lu\t", (uint32_t)(acct.ready_time / 1000000));
+        pf("%lu\t", (uint32_t)(acct.blocked_time / 1000000));
+        pf("%lu\t%lu\t", acct.vol_switches, acct.invol_switches);
+        pf("%lu\t\t", (uint32_t)(acct.last_run / 1000000));
         pf("%s\n", cur->label);
     }
+    pf("--end of list--\n");
+
+    return 0;
+}
+
+/*****************************************************************************/
+/* Context switch trace */
+
+int thd_trace_enable(size_t entries) {
+    thd_trace_event_t *buf = NULL, *oldbuf;
+    int old;
+
+    if(entries) {
+        buf = (thd_trace_event_t *)malloc(entries * sizeof(thd_trace_event_t));
+
+        if(!buf)
+            return -1;
+    }
+
+    old = irq_disable();
+    oldbuf = trace_buf;
+    trace_buf = buf;
+    trace_size = entries;
+    trace_head = trace_count = 0;
+    trace_lost = 0;
+    irq_restore(old);
+
+    free(oldbuf);
+
+    return 0;
+}
+
+/* Record a context switch; assumes ints are disabled. */
+static void thd_trace_add(uint64_t now, kthread_t *from, kthread_t *to,
+                          int reason) {
+    thd_trace_event_t *ev;
+
+    if(trace_count == trace_size) {
+        /* Full up, so lose the oldest */
+        trace_head = (trace_head + 1) % trace_size;
+        --trace_count;
+        ++trace_lost;
+    }
+
+    ev = &trace_buf[(trace_head + trace_count) % trace_size];
+    ev->time = now;
+    ev->from = from ? from->tid : 0;
+    ev->to = to->tid;
+    ev->reason = reason;
+    ++trace_count;
+}
+
+size_t thd_trace_read(thd_trace_event_t *events, size_t count) {
+    size_t i;
+    int old;
+
+    old = irq_disable();
+
+    for(i = 0; i < count && trace_count; i++) {
+        events[i] = trace_buf[trace_head];
+        trace_head = (trace_head + 1) % trace_size;
+        --trace_count;
+    }
+
+    irq_restore(old);
+
+    return i;
+}
+
+int thd_trace_dump(int (*pf)(const char *fmt, ...)) {
+    static const char *reasons[] = { "preempt", "yield", "block", "exit" };
+    thd_trace_event_t ev[16];
+    uint32_t lost;
+    size_t i, n;
+    int old;
+
+    old = irq_disable();
+    lost = trace_lost;
+    trace_lost = 0;
+    irq_restore(old);
+
+    pf("Context switches (%lu lost):\n", lost);
+    pf("time (s)\tfrom\tto\treason\n");
+
+    /* Printing may well cause more switches, so take a few at a time */
+    while((n = thd_trace_read(ev, sizeof(ev) / sizeof(ev[0]))) > 0) {
+        for(i = 0; i < n; i++) {
+            pf("%lu.%06lu\t%d\t%d\t%s\n",
+               (uint32_t)(ev[i].time / 1000000000),
+               (uint32_t)(ev[i].time / 1000 % 1000000),
+               ev[i].from, ev[i].to, reasons[ev[i].reason]);
+        }
+    }
+    pf("--end of trace--\n");
 
     return 0;
 }
@@ -205,7 +436,12 @@ static void *thd_idle_task(void *param) {
     (void)param;
 
     for(;;) {
-        arch_sleep();   /* We can safely enter sleep mode here */
+        /* In tickless mode there's no tick coming to switch away from us
+           when an IRQ wakes a thread up, so do it ourselves. */
+        if(thd_tickless && (runq_first() || !TAILQ_EMPTY(&edf_ready)))
+            thd_pass();
+        else
+            arch_sleep();   /* We can safely enter sleep mode here */
     }
 
     /* Never reached */
@@ -261,6 +497,10 @@ void thd_exit(void *rv) {
     /* Call newlib's thread cleanup function */
     _reclaim_reent(&thd_current->thd_reent);
 
+    /* Unlock any mutexes it forgot to unlock now, failing anything waiting
+       for them, rather than when it's joined or reaped */
+    mutex_release_all(thd_current);
+
     if(thd_current->flags & THD_DETACHED) {
         /* Call Dr. Kevorkian; after this executes we could be killed
            at any time. */
@@ -282,73 +522,362 @@ void thd_exit(void *rv) {
 }
 
 
+/*****************************************************************************/
+/* Stack and thread structure pool */
+
+/* Creating a thread costs a memalign() for its structure and static TLS
+   block and a malloc() for its stack, and reaping it frees them all again.
+   For threads that come and go often, that's slow and chops up the heap, so
+   dead threads' structures (with their TLS blocks still attached) and
+   stacks are kept here to be handed out again, up to pool_limit of each.
+
+   Stacks are kept in buckets of one size each, linked through their first
+   word. A stack of a size that has no bucket, when they're all in use, is
+   just freed. Everything here assumes ints are disabled. */
+#define POOL_BUCKETS    8
+
+static struct {
+    size_t size;
+    void *head;
+} stack_pool[POOL_BUCKETS];
+
+static struct ktlist thd_pool;
+static size_t thd_pool_count, stack_pool_count;
+static size_t pool_limit = THD_POOL_DEFAULT;
+
+/* Take a stack of the given size from the pool, or allocate one. */
+static void *pool_get_stack(size_t size) {
+    void *stack;
+    int i;
+
+    for(i = 0; i < POOL_BUCKETS; i++) {
+        if(stack_pool[i].size == size && stack_pool[i].head) {
+            stack = stack_pool[i].head;
+            stack_pool[i].head = *(void **)stack;
+            --stack_pool_count;
+            return stack;
+        }
+    }
+
+    return malloc(size);
+}
+
+/* Give a stack back to the pool, or free it if there's no room. */
+static void pool_put_stack(void *stack, size_t size) {
+    int i, empty = -1;
+
+    if(stack_pool_count < pool_limit) {
+        for(i = 0; i < POOL_BUCKETS; i++) {
+            if(stack_pool[i].size == size)
+                break;
+
+            if(empty < 0 && !stack_pool[i].head)
+                empty = i;
+        }
+
+        if(i == POOL_BUCKETS)
+            i = empty;
+
+        if(i >= 0) {
+            stack_pool[i].size = size;
+            *(void **)stack = stack_pool[i].head;
+            stack_pool[i].head = stack;
+            ++stack_pool_count;
+            return;
+        }
+    }
+
+    free(stack);
+}
+
+/* Take a thread structure from the pool, or allocate one. It comes back
+   zeroed apart from tcbhead, which is NULL if there's no TLS block yet. */
+static kthread_t *pool_get_thd(void) {
+    kthread_t *thd = LIST_FIRST(&thd_pool);
+    void *tcbhead = NULL;
+
+    if(thd) {
+        LIST_REMOVE(thd, t_list);
+        --thd_pool_count;
+        tcbhead = thd->tcbhead;
+    }
+    else if(!(thd = memalign(32, sizeof(kthread_t)))) {
+        return NULL;
+    }
+
+    memset(thd, 0, sizeof(kthread_t));
+    thd->tcbhead = tcbhead;
+
+    return thd;
+}
+
+/* Give a thread structure back to the pool, or free it. */
+static void pool_put_thd(kthread_t *thd) {
+    if(thd_pool_count < pool_limit) {
+        LIST_INSERT_HEAD(&thd_pool, thd, t_list);
+        ++thd_pool_count;
+    }
+    else {
+        free(thd->tcbhead);
+        free(thd);
+    }
+}
+
+/* Free whatever is in the pool over the given limit. */
+static void pool_trim(size_t limit) {
+    kthread_t *thd;
+    void *stack;
+    int i;
+
+    while(thd_pool_count > limit) {
+        thd = LIST_FIRST(&thd_pool);
+        LIST_REMOVE(thd, t_list);
+        --thd_pool_count;
+        free(thd->tcbhead);
+        free(thd);
+    }
+
+    for(i = 0; i < POOL_BUCKETS && stack_pool_count > limit; i++) {
+        while(stack_pool[i].head && stack_pool_count > limit) {
+            stack = stack_pool[i].head;
+            stack_pool[i].head = *(void **)stack;
+            --stack_pool_count;
+            free(stack);
+        }
+    }
+}
+
+size_t thd_pool_set_limit(size_t limit) {
+    size_t old;
+    int oldirq;
+
+    oldirq = irq_disable();
+    old = pool_limit;
+    pool_limit = limit;
+    pool_trim(limit);
+    irq_restore(oldirq);
+
+    return old;
+}
+
+
 /*****************************************************************************/
 /* Thread creation and deletion */
 
+/* Deadline thread times are kept in nanoseconds, but set in microseconds. */
+#define EDF_NS(us)  ((uint64_t)(us) * 1000)
+
+/* The share of the CPU a deadline thread needs, in 16.16 fixed point. */
+static uint32_t edf_density_of(const kthread_t *t) {
+    return (uint32_t)(((uint64_t)t->edf.budget << 16) / t->edf.deadline);
+}
+
+/* Start a new period for a deadline thread if its current one is over,
+   skipping any it missed completely. */
+static void edf_replenish(kthread_t *t, uint64_t now) {
+    uint64_t period = EDF_NS(t->edf.period);
+
+    if(now < t->edf.period_start + period)
+        return;
+
+    t->edf.period_start += (now - t->edf.period_start) / period * period;
+    t->edf.abs_deadline = t->edf.period_start + EDF_NS(t->edf.deadline);
+    t->edf.used = 0;
+    t->edf.throttled = 0;
+}
+
+/* Charge the running deadline thread for its time on the CPU, and throttle
+   it if it's used up its budget. */
+static void edf_charge(uint64_t now) {
+    kthread_t *t = edf_running;
+
+    if(!t)
+        return;
+
+    t->edf.used += now - t->edf.run_start;
+    t->edf.run_start = now;
+
+    if(!t->edf.throttled && t->edf.used >= EDF_NS(t->edf.budget)) {
+        t->edf.throttled = 1;
+        ++t->edf.overruns;
+
+        if(edf_overrun_hnd)
+            edf_overrun_hnd(t);
+    }
+}
+
+/* Queue a deadline thread on edf_ready, if it can run, or edf_release. */
+static void edf_enqueue(kthread_t *t, int front_of_line) {
+    kthread_t *i;
+
+    edf_replenish(t, timer_ns_gettime64());
+
+    if(t->edf.throttled) {
+        TAILQ_FOREACH(i, &edf_release, thdq) {
+            if(i->edf.period_start + EDF_NS(i->edf.period) >
+               t->edf.period_start + EDF_NS(t->edf.period))
+                break;
+        }
+
+        if(i)
+            TAILQ_INSERT_BEFORE(i, t, thdq);
+        else
+            TAILQ_INSERT_TAIL(&edf_release, t, thdq);
+    }
+    else {
+        TAILQ_FOREACH(i, &edf_ready, thdq) {
+            if(i->edf.abs_deadline > t->edf.abs_deadline ||
+               (front_of_line && i->edf.abs_deadline == t->edf.abs_deadline))
+                break;
+        }
+
+        if(i)
+            TAILQ_INSERT_BEFORE(i, t, thdq);
+        else
+            TAILQ_INSERT_TAIL(&edf_ready, t, thdq);
+    }
+}
+
+/* Move deadline threads whose next period has started over to edf_ready.
+   Ones that were waiting in thd_edf_wait() start a new job. */
+static void edf_release_due(uint64_t now) {
+    kthread_t *t;
+
+    while((t = TAILQ_FIRST(&edf_release)) &&
+          t->edf.period_start + EDF_NS(t->edf.period) <= now) {
+        TAILQ_REMOVE(&edf_release, t, thdq);
+        edf_replenish(t, now);
+
+        if(t->state == STATE_WAIT) {
+            t->state = STATE_READY;
+            t->wait_msg = NULL;
+            t->edf.job_deadline = t->edf.abs_deadline;
+            t->acct.woken = now;
+        }
+
+        edf_enqueue(t, 0);
+    }
+}
+
+/* When the scheduler next has to look at the deadline threads, in ms, or 0
+   if it doesn't: when the running one runs out of budget, or the next
+   period starts for one waiting on edf_release. */
+static uint64_t edf_next_event(void) {
+    uint64_t next = 0, t;
+
+    if(edf_running && !edf_running->edf.throttled)
+        next = edf_running->edf.run_start +
+               EDF_NS(edf_running->edf.budget) - edf_running->edf.used;
+
+    if(!TAILQ_EMPTY(&edf_release)) {
+        t = TAILQ_FIRST(&edf_release)->edf.period_start +
+            EDF_NS(TAILQ_FIRST(&edf_release)->edf.period);
+
+        if(!next || t < next)
+            next = t;
+    }
+
+    return next ? (next + 999999) / 1000000 : 0;
+}
+
 /* Enqueue a process in the runnable queue; adds it right after the
    process group of the same priority (front_of_line==0) or
    right before the process group of the same priority (front_of_line!=0).
    See thd_schedule for why this is helpful. */
 void thd_add_to_runnable(kthread_t *t, int front_of_line) {
+    struct ktqueue *q;
     kthread_t *i;
-    int done;
+    int level;
 
     if(t->flags & THD_QUEUED)
         return;
 
-    done = 0;
+    if(t->edf.period) {
+        edf_enqueue(t, front_of_line);
+        t->flags |= THD_QUEUED;
 
-    if(!front_of_line) {
-        /* Look for a thread of lower priority and insert
-           before it. If there is nothing on the run queue, we'll
-           fall through to the bottom. */
-        TAILQ_FOREACH(i, &run_queue, thdq) {
-            if(i->prio > t->prio) {
-                TAILQ_INSERT_BEFORE(i, t, thdq);
-                done = 1;
-                break;
-            }
-        }
+        if(thd_tickless && thd_current == thd_idle_thd)
+            timer_primary_wakeup(1);
+
+        return;
+    }
+
+    level = runq_level(t->prio);
+    q = &run_queue[level];
+
+    if(level < RUNQ_LEVELS - 1) {
+        if(front_of_line)
+            TAILQ_INSERT_HEAD(q, t, thdq);
+        else
+            TAILQ_INSERT_TAIL(q, t, thdq);
     }
     else {
-        /* Look for a thread of the same or lower priority and
-           insert before it. If there is nothing on the run queue,
-           we'll fall through to the bottom. */
-        TAILQ_FOREACH(i, &run_queue, thdq) {
-            if(i->prio >= t->prio) {
-                TAILQ_INSERT_BEFORE(i, t, thdq);
-                done = 1;
+        /* The last list holds several priorities, so look for a thread of
+           lower priority (or the same or lower, for front_of_line) and
+           insert before it, falling through to the end if there isn't
+           one. */
+        TAILQ_FOREACH(i, q, thdq) {
+            if(i->prio > t->prio || (front_of_line && i->prio == t->prio))
                 break;
-            }
         }
-    }
 
-    /* Didn't find one, put it at the end */
-    if(!done)
-        TAILQ_INSERT_TAIL(&run_queue, t, thdq);
+        if(i)
+            TAILQ_INSERT_BEFORE(i, t, thdq);
+        else
+            TAILQ_INSERT_TAIL(q, t, thdq);
+    }
 
+    run_bitmap[level >> 5] |= 1 << (level & 31);
+    run_summary |= 1 << (level >> 5);
     t->flags |= THD_QUEUED;
+
+    /* If this woke up from an IRQ just as the idle thread was about to go
+       to sleep, nothing may be due to switch to it; make sure something
+       is. thd_schedule() will replace this with the real deadline. */
+    if(thd_tickless && thd_current == thd_idle_thd && t != thd_idle_thd)
+        timer_primary_wakeup(1);
 }
 
 /* Removes a thread from the runnable queue, if it's there. */
 int thd_remove_from_runnable(kthread_t *thd) {
+    int level;
+
     if(!(thd->flags & THD_QUEUED)) return 0;
 
     thd->flags &= ~THD_QUEUED;
-    TAILQ_REMOVE(&run_queue, thd, thdq);
+
+    if(thd->edf.period) {
+        if(thd->edf.throttled)
+            TAILQ_REMOVE(&edf_release, thd, thdq);
+        else
+            TAILQ_REMOVE(&edf_ready, thd, thdq);
+
+        return 0;
+    }
+
+    level = runq_level(thd->prio);
+    TAILQ_REMOVE(&run_queue[level], thd, thdq);
+
+    if(TAILQ_EMPTY(&run_queue[level])) {
+        run_bitmap[level >> 5] &= ~(1 << (level & 31));
+
+        if(!run_bitmap[level >> 5])
+            run_summary &= ~(1 << (level >> 5));
+    }
+
     return 0;
 }
 
 /* Creates and initializes the static TLS segment for a thread,
    composed of a Thread Control Block (TCB), followed by .TDATA,
    followed by .TBSS, very carefully ensuring alignment of each
-   subchunk. 
+   subchunk. If tcbhead is given, it's a block from a pooled thread to
+   initialize again rather than allocating a new one.
 */
-static void *thd_create_tls_data(void) {
+static void *thd_create_tls_data(tcbhead_t *tcbhead) {
     size_t align, tdata_offset, tdata_end, tbss_offset, 
         tbss_end, align_rem, tls_size;
     
-    tcbhead_t *tcbhead;
     void *tdata_segment, *tbss_segment;
 
     /* Cached and typed local copies of TLS segment data for sizes, 
@@ -388,7 +917,9 @@ static void *thd_create_tls_data(void) {
         tls_size += (align - align_rem);
 
     /* Allocate combined chunk with calculated size and alignment.  */
-    tcbhead = memalign(align, tls_size);
+    if(!tcbhead)
+        tcbhead = memalign(align, tls_size);
+
     assert(tcbhead);    
     assert(!((uintptr_t)tcbhead % 8)); 
 
@@ -454,22 +985,22 @@ kthread_t *thd_create_ex(const kthread_attr_t *restrict attr,
     tid = thd_next_free();
 
     if(tid >= 0) {
-        /* Create a new thread structure */
-        nt = memalign(32, sizeof(kthread_t));
+        /* Create a new thread structure, cleared out apart from any TLS
+           block left on it from the pool */
+        nt = pool_get_thd();
 
         if(nt != NULL) {
-            /* Clear out potentially unused stuff */
-            memset(nt, 0, sizeof(kthread_t));
-
             /* Create a new thread stack */
             if(!real_attr.stack_ptr) {
-                nt->stack = (uint32_t*)malloc(real_attr.stack_size);
+                nt->stack = (uint32_t*)pool_get_stack(real_attr.stack_size);
 
                 if(!nt->stack) {
-                    free(nt);
+                    pool_put_thd(nt);
                     irq_restore(oldirq);
                     return NULL;
                 }
+
+                nt->flags = THD_OWN_STACK;
             }
             else {
                 nt->stack = (uint32_t*)real_attr.stack_ptr;
@@ -478,7 +1009,7 @@ kthread_t *thd_create_ex(const kthread_attr_t *restrict attr,
             nt->stack_size = real_attr.stack_size;
 
             /* Create static TLS data */
-            nt->tcbhead = thd_create_tls_data();
+            nt->tcbhead = thd_create_tls_data(nt->tcbhead);
 
             /* Populate the context */
             params[0] = (uint32_t)routine;
@@ -493,8 +1024,10 @@ kthread_t *thd_create_ex(const kthread_attr_t *restrict attr,
             nt->context.gbr = (uint32_t)nt->tcbhead;
             nt->tid = tid;
             nt->prio = real_attr.prio;
-            nt->flags = THD_DEFAULTS;
+            nt->base_prio = real_attr.prio;
             nt->state = STATE_READY;
+            memset(&nt->acct, 0, sizeof(nt->acct));
+            nt->acct.since = timer_ns_gettime64();
 
             if(!real_attr.label) {
                 strcpy(nt->label, "[un-named kernel thread]");
@@ -515,9 +1048,6 @@ kthread_t *thd_create_ex(const kthread_attr_t *restrict attr,
             if(real_attr.create_detached)
                 nt->flags |= THD_DETACHED;
 
-            /* Initialize thread-local storage. */
-            LIST_INIT(&nt->tls_list);
-
             /* Insert it into the thread list */
             LIST_INSERT_HEAD(&thd_list, nt, t_list);
 
@@ -542,7 +1072,6 @@ kthread_t *thd_create(int detach, void *(*routine)(void *), void *param) {
    the execution chain. */
 int thd_destroy(kthread_t *thd) {
     int oldirq = 0;
-    kthread_tls_kv_t *i, *i2;
 
     /* Make sure there are no ints */
     oldirq = irq_disable();
@@ -556,29 +1085,28 @@ int thd_destroy(kthread_t *thd) {
     thd_remove_from_runnable(thd);
     LIST_REMOVE(thd, t_list);
 
-    /* Clean up any thread-local data */
-    LIST_FOREACH(i, &thd->tls_list, kv_list) {
-        if(i->destructor) {
-            i->destructor(i->data);
-        }
+    /* Give back its share of the CPU if it was a deadline thread */
+    if(thd->edf.period) {
+        edf_density -= edf_density_of(thd);
+        --edf_count;
     }
 
-    i = LIST_FIRST(&thd->tls_list);
+    if(edf_running == thd)
+        edf_running = NULL;
 
-    while(i != NULL) {
-        i2 = LIST_NEXT(i, kv_list);
-        free(i);
-        i = i2;
-    }
+    /* Don't leave any mutexes it still holds pointing at it, or anything
+       waiting for them stuck; they're told the holder died */
+    mutex_release_all(thd);
 
-    /* Free its stack */
-    free(thd->stack);
+    /* Clean up any thread-local data */
+    kthread_tls_destroy(thd);
 
-    /* Free static TLS segment */
-    free(thd->tcbhead);
+    /* Give its stack and thread structure (with its static TLS segment)
+       back to the pool */
+    if(thd->flags & THD_OWN_STACK)
+        pool_put_stack(thd->stack, thd->stack_size);
 
-    /* Free the thread */
-    free(thd);
+    pool_put_thd(thd);
 
     /* Remove it from the count */
     --thd_count;
@@ -592,22 +1120,201 @@ int thd_destroy(kthread_t *thd) {
 /*****************************************************************************/
 /* Thread attribute functions */
 
+/* Set the priority a thread is scheduled at */
+void thd_apply_prio(kthread_t *thd, prio_t prio) {
+    /* Move the thread to the right run queue list if it's on one */
+    if(thd->flags & THD_QUEUED) {
+        thd_remove_from_runnable(thd);
+        thd->prio = prio;
+        thd_add_to_runnable(thd, 0);
+    }
+    else {
+        thd->prio = prio;
+    }
+}
+
 /* Set a thread's priority */
 int thd_set_prio(kthread_t *thd, prio_t prio) {
+    int oldirq;
+
     if(thd == NULL)
         return -1;
 
     if((prio < 0) || (prio > PRIO_MAX))
         return -2;
 
-    /* Set the new priority */
-    thd->prio = prio;
+    /* The thread may be running at a higher priority than this while it
+       holds a mutex, so let the mutex code work out what it should be. */
+    oldirq = irq_disable();
+    thd->base_prio = prio;
+    mutex_pi_update(thd);
+    irq_restore(oldirq);
+
     return 0;
 }
 
+/* Put a thread in or out of the deadline scheduling class */
+int thd_set_edf(kthread_t *thd, uint32_t period, uint32_t budget,
+                uint32_t deadline) {
+    uint32_t density = 0, old_density = 0;
+    uint64_t now;
+    int oldirq, queued, waiting;
+
+    if(!thd) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if(period) {
+        if(!deadline)
+            deadline = period;
+
+        if(!budget || budget > deadline || deadline > period) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        density = (uint32_t)(((uint64_t)budget << 16) / deadline);
+    }
+
+    oldirq = irq_disable();
+
+    if(thd->edf.period)
+        old_density = edf_density_of(thd);
+
+    /* Only let in as many as can all make their deadlines */
+    if(edf_density - old_density + density > 0x10000) {
+        irq_restore(oldirq);
+        errno = EBUSY;
+        return -1;
+    }
+
+    /* Take it off whichever queue it's on while it changes class. If it was
+       waiting for its next period, it doesn't any more. */
+    queued = thd->flags & THD_QUEUED;
+    waiting = queued && thd->state == STATE_WAIT;
+    thd_remove_from_runnable(thd);
+
+    if(edf_running == thd)
+        edf_running = NULL;
+
+    edf_density = edf_density - old_density + density;
+    edf_count += !!period - !!thd->edf.period;
+
+    /* The first period starts now */
+    now = timer_ns_gettime64();
+    thd->edf.period = period;
+    thd->edf.budget = budget;
+    thd->edf.deadline = deadline;
+    thd->edf.period_start = now;
+    thd->edf.abs_deadline = now + EDF_NS(deadline);
+    thd->edf.job_deadline = thd->edf.abs_deadline;
+    thd->edf.used = 0;
+    thd->edf.throttled = 0;
+
+    if(waiting) {
+        thd->state = STATE_READY;
+        thd->wait_msg = NULL;
+    }
+
+    if(period && thd == thd_current) {
+        edf_running = thd;
+        thd->edf.run_start = now;
+    }
+
+    if(queued)
+        thd_add_to_runnable(thd, 0);
+
+    /* Have the scheduler take a look at it straight away */
+    if(thd_mode != THD_MODE_NONE)
+        timer_primary_wakeup(1);
+
+    irq_restore(oldirq);
+
+    return 0;
+}
+
+/* Set the function to call when a deadline thread runs out of budget */
+thd_edf_handler_t thd_edf_set_overrun_handler(thd_edf_handler_t handler) {
+    thd_edf_handler_t rv;
+    int oldirq;
+
+    oldirq = irq_disable();
+    rv = edf_overrun_hnd;
+    edf_overrun_hnd = handler;
+    irq_restore(oldirq);
+
+    return rv;
+}
+
 /*****************************************************************************/
 /* Scheduling routines */
 
+/* Program the primary timer for the next thing that needs doing: in
+   tickless mode, the next deadline, and otherwise the next tick. Deadline
+   threads can bring either forward. */
+static void thd_program_timer(uint64_t now) {
+    uint64_t next, edf;
+
+    if(thd_tickless) {
+        next = genwait_next_timeout();
+
+        if(thd_current != thd_idle_thd && (!next || thd_slice_end < next))
+            next = thd_slice_end;
+    }
+    else {
+        next = thd_tick_next;
+    }
+
+    if(edf_count && (edf = edf_next_event()) && (!next || edf < next))
+        next = edf;
+
+    if(!next)
+        timer_primary_stop();
+    else if(next <= now)
+        timer_primary_wakeup(1);
+    else if(next - now > UINT32_MAX)
+        timer_primary_wakeup(UINT32_MAX);
+    else
+        timer_primary_wakeup((uint32_t)(next - now));
+}
+
+/* Account for a switch from old to thd, which may be the same thread, and
+   record it in the trace. Assumes ints are disabled. */
+static void thd_account_switch(kthread_t *old, kthread_t *thd, int reason) {
+    uint64_t now = timer_ns_gettime64();
+
+    if(old) {
+        old->acct.cpu_time += now - old->acct.since;
+        old->acct.since = now;
+    }
+
+    if(thd == old)
+        return;
+
+    /* If it blocked since it last ran, the time up to its wakeup was spent
+       blocked and only the rest waiting for the CPU. */
+    if(thd->acct.woken) {
+        thd->acct.blocked_time += thd->acct.woken - thd->acct.since;
+        thd->acct.since = thd->acct.woken;
+        thd->acct.woken = 0;
+    }
+
+    thd->acct.ready_time += now - thd->acct.since;
+    thd->acct.since = now;
+    thd->acct.last_run = now;
+
+    if(old) {
+        if(reason == THD_SWITCH_PREEMPT)
+            ++old->acct.invol_switches;
+        else
+            ++old->acct.vol_switches;
+    }
+
+    if(trace_buf)
+        thd_trace_add(now, old, thd, reason);
+}
+
 /* Thread scheduler; this function will find a new thread to run when a
    context switch is requested. No work is done in here except to change
    out the thd_current variable contents. Assumed that we are in an
@@ -623,14 +1330,28 @@ int thd_set_prio(kthread_t *thd, prio_t prio) {
    IRQ after doing something like a sem_signal, where you'd ideally like
    to make sure the priorities are all straight before returning, but you
    don't want a full context switch inside the same priority group.
+
+   The voluntary parameter says whether the current thread asked to be
+   switched out, which only matters for the accounting.
+
+   Deadline threads come before all of that: whichever one has the earliest
+   deadline and budget left runs, and keeps running until it's done or out
+   of budget, or one with an earlier deadline is ready.
 */
-void thd_schedule(int front_of_line, uint64_t now) {
-    int dontenq;
-    kthread_t *thd;
+static void thd_do_schedule(int front_of_line, uint64_t now, int voluntary) {
+    int dontenq, reason = THD_SWITCH_PREEMPT;
+    kthread_t *thd, *old = thd_current;
+    uint64_t edf_now = 0;
 
     if(now == 0)
         now = timer_ms_gettime64();
 
+    if(edf_count || edf_running) {
+        edf_now = timer_ns_gettime64();
+        edf_charge(edf_now);
+        edf_running = NULL;
+    }
+
     /* We won't re-enqueue the current thread if it's NULL (i.e., the
        thread blocked itself somewhere) or if it's a zombie (below) */
     dontenq = !thd_current;
@@ -652,15 +1373,27 @@ void thd_schedule(int front_of_line, uint64_t now) {
     /* Look for timed out waits */
     genwait_check_timeouts(now);
 
-    /* Search downwards through the run queue for a runnable thread; if
-       we don't find a normal runnable thread, the idle process will
-       always be there at the bottom. */
-    TAILQ_FOREACH(thd, &run_queue, thdq) {
-        /* Is it runnable? If not, keep going */
-        if(thd->state == STATE_READY)
-            break;
+    /* A deadline thread goes back in deadline order; it only loses the CPU
+       to an earlier deadline. Then see whose periods have started. */
+    if(edf_count) {
+        if(!dontenq && thd_current->edf.period &&
+           thd_current->state == STATE_RUNNING) {
+            thd_current->state = STATE_READY;
+            thd_add_to_runnable(thd_current, 1);
+        }
+
+        edf_release_due(edf_now);
     }
 
+    /* Take the deadline thread with the earliest deadline, if one has budget
+       left, or else the first thread off the run queue. Only ready threads
+       are queued, and if there's no normal runnable thread, the idle process
+       will always be there at the bottom. */
+    thd = TAILQ_FIRST(&edf_ready);
+
+    if(!thd)
+        thd = runq_first();
+
     /* If we didn't already re-enqueue the thread and we are supposed to do so,
        do it now. */
     if(!front_of_line && !dontenq && thd_current->state == STATE_RUNNING) {
@@ -679,6 +1412,18 @@ void thd_schedule(int front_of_line, uint64_t now) {
         arch_panic("couldn't find a runnable thread");
     }
 
+    /* Work out why the old thread is being switched out */
+    if(old && voluntary) {
+        if(old->state == STATE_READY)
+            reason = THD_SWITCH_YIELD;
+        else if(old->state == STATE_WAIT)
+            reason = THD_SWITCH_BLOCK;
+        else
+            reason = THD_SWITCH_EXIT;
+    }
+
+    thd_account_switch(old, thd, reason);
+
     /* We should now have a runnable thread, so remove it from the
        run queue and switch to it. */
     thd_remove_from_runnable(thd);
@@ -687,8 +1432,16 @@ void thd_schedule(int front_of_line, uint64_t now) {
     _impure_ptr = &thd->thd_reent;
     thd->state = STATE_RUNNING;
 
-    /* Make sure the thread hasn't underrun its stack */
-    if(thd_current->stack && thd_current->stack_size) {
+    if(thd->edf.period) {
+        edf_running = thd;
+        thd->edf.run_start = edf_now;
+    }
+
+    /* Make sure the thread hasn't underrun its stack. While it's running a
+       fiber, it may be anywhere on that fiber's own stack, and it can be
+       caught partway through switching between two fibers, so there's no
+       telling which stack it ought to be on. */
+    if(thd_current->stack && thd_current->stack_size && !thd_current->fiber) {
         if(CONTEXT_SP(thd_current->context) < (ptr_t)(thd_current->stack)) {
             thd_pslist(printf);
             thd_pslist_queue(printf);
@@ -697,6 +1450,17 @@ void thd_schedule(int front_of_line, uint64_t now) {
     }
 
     irq_set_context(&thd_current->context);
+
+    /* A new thread, or one that's used its time up, gets a new slice */
+    if(thd_tickless && (thd != old || now >= thd_slice_end))
+        thd_slice_end = now + 1000 / HZ;
+
+    if(thd_tickless || edf_count)
+        thd_program_timer(now);
+}
+
+void thd_schedule(int front_of_line, uint64_t now) {
+    thd_do_schedule(front_of_line, now, 0);
 }
 
 /* Temporary priority boosting function: call this from within an interrupt
@@ -708,10 +1472,17 @@ void thd_schedule_next(kthread_t *thd) {
     if(!irq_inside_int())
         return;
 
-    /* Can't boost a blocked thread */
-    if(thd->state != STATE_READY)
+    /* Can't boost a blocked thread, or a deadline thread that's used up its
+       budget for this period; running it would take time the admission
+       test promised to the others. */
+    if(thd->state != STATE_READY || (thd->edf.period && thd->edf.throttled))
         return;
 
+    if(edf_running) {
+        edf_charge(timer_ns_gettime64());
+        edf_running = NULL;
+    }
+
     /* Unfortunately we have to take care of this here */
     if(thd_current->state == STATE_ZOMBIE) {
         sem_signal(&thd_reap_sem);
@@ -721,11 +1492,26 @@ void thd_schedule_next(kthread_t *thd) {
         thd_add_to_runnable(thd_current, 0);
     }
 
+    thd_account_switch(thd_current, thd, THD_SWITCH_PREEMPT);
     thd_remove_from_runnable(thd);
     thd_current = thd;
     _impure_ptr = &thd->thd_reent;
     thd_current->state = STATE_RUNNING;
     irq_set_context(&thd_current->context);
+
+    if(thd->edf.period) {
+        edf_running = thd;
+        thd->edf.run_start = timer_ns_gettime64();
+    }
+
+    if(thd_tickless || edf_count) {
+        uint64_t now = timer_ms_gettime64();
+
+        if(thd_tickless)
+            thd_slice_end = now + 1000 / HZ;
+
+        thd_program_timer(now);
+    }
 }
 
 /* See kos/thread.h for description */
@@ -735,7 +1521,7 @@ irq_context_t *thd_choose_new(void) {
     //printf("thd_choose_new() woken at %d\n", (uint32_t)now);
 
     /* Do any re-scheduling */
-    thd_schedule(0, now);
+    thd_do_schedule(0, now, 1);
 
     /* Return the new IRQ context back to the caller */
     return &thd_current->context;
@@ -746,17 +1532,57 @@ irq_context_t *thd_choose_new(void) {
 /* Timer function. Check to see if we were woken because of a timeout event
    or because of a preempt. For timeouts, just go take care of it and sleep
    again until our next context switch (if any). For pre-empts, re-schedule
-   threads, swap out contexts, and sleep. */
+   threads, swap out contexts, and sleep. In tickless mode, or while there
+   are deadline threads, thd_schedule() programs the next wakeup itself. */
 static void thd_timer_hnd(irq_context_t *context) {
     /* Get the system time */
     uint64_t now = timer_ms_gettime64();
+    int front_of_line = 0;
 
     (void)context;
 
     //printf("timer woke at %d\n", (uint32_t)now);
 
-    thd_schedule(0, now);
-    timer_primary_wakeup(1000 / HZ);
+    /* Deadline threads can wake us up between ticks; don't take the CPU away
+       from the current thread's priority group for those. */
+    if(!thd_tickless) {
+        if(edf_count && now < thd_tick_next)
+            front_of_line = 1;
+        else
+            thd_tick_next = now + 1000 / HZ;
+    }
+
+    thd_schedule(front_of_line, now);
+
+    if(!thd_tickless && !edf_count)
+        timer_primary_wakeup(1000 / HZ);
+}
+
+/* Switch between periodic and tickless scheduling */
+int thd_set_tickless(int enable) {
+    uint64_t now;
+    int old, rv;
+
+    if(thd_mode == THD_MODE_NONE)
+        return -1;
+
+    old = irq_disable();
+    rv = thd_tickless;
+    thd_tickless = !!enable;
+
+    if(thd_tickless && !rv) {
+        now = timer_ms_gettime64();
+        thd_slice_end = now + 1000 / HZ;
+        thd_program_timer(now);
+    }
+    else if(!thd_tickless && rv) {
+        thd_tick_next = timer_ms_gettime64() + 1000 / HZ;
+        timer_primary_wakeup(1000 / HZ);
+    }
+
+    irq_restore(old);
+
+    return rv;
 }
 
 /*****************************************************************************/
@@ -797,6 +1623,40 @@ void thd_pass(void) {
     thd_block_now(&thd_current->context);
 }
 
+/* Finish a deadline thread's job for this period */
+void thd_edf_wait(void) {
+    kthread_t *me = thd_current;
+    uint64_t now;
+    int old;
+
+    if(irq_inside_int() || !me->edf.period)
+        return;
+
+    old = irq_disable();
+    now = timer_ns_gettime64();
+    edf_charge(now);
+
+    if(now > me->edf.job_deadline)
+        ++me->edf.misses;
+
+    /* If the next period has already started, get on with its job.
+       Otherwise sleep on edf_release until it does. */
+    edf_replenish(me, now);
+
+    if(me->edf.abs_deadline > me->edf.job_deadline) {
+        me->edf.job_deadline = me->edf.abs_deadline;
+    }
+    else {
+        me->edf.throttled = 1;
+        me->state = STATE_WAIT;
+        me->wait_msg = "thd_edf_wait";
+        thd_add_to_runnable(me, 0);
+        thd_block_now(&me->context);
+    }
+
+    irq_restore(old);
+}
+
 /* Wait for a thread to exit */
 int thd_join(kthread_t *thd, void **value_ptr) {
     int old, rv;
@@ -944,7 +1804,6 @@ int thd_get_mode(void) {
 int kthread_key_delete(kthread_key_t key) {
     int old = irq_disable();
     kthread_t *cur;
-    kthread_tls_kv_t *i;
 
     /* Make sure the key is valid. */
     if(key >= kthread_key_next() || key < 1) {
@@ -953,22 +1812,10 @@ int kthread_key_delete(kthread_key_t key) {
         return -1;
     }
 
-    /* Make sure we can actually use free below. */
-    if(!malloc_irq_safe()) {
-        irq_restore(old);
-        errno = EPERM;
-        return -1;
-    }
-
-    /* Go through each thread searching for (and removing) the data. */
+    /* Go through each thread clearing out the data. */
     LIST_FOREACH(cur, &thd_list, t_list) {
-        LIST_FOREACH(i, &cur->tls_list, kv_list) {
-            if(i->key == key) {
-                LIST_REMOVE(i, kv_list);
-                free(i);
-                break;
-            }
-        }
+        if((size_t)key < cur->tls_size)
+            cur->tls_data[key] = NULL;
     }
 
     kthread_key_delete_destructor(key);
@@ -983,6 +1830,7 @@ int kthread_key_delete(kthread_key_t key) {
 /* Init */
 int thd_init(void) {
     kthread_t *kern, *reaper;
+    int i;
 
     /* Make sure we're not already running */
     if(thd_mode != THD_MODE_NONE)
@@ -994,11 +1842,24 @@ int thd_init(void) {
     /* Initialize handle counters */
     tid_highest = 1;
 
+    thd_start_time = timer_ns_gettime64();
+
     /* Initialize the thread list */
     LIST_INIT(&thd_list);
+    LIST_INIT(&thd_pool);
 
     /* Initialize the run queue */
-    TAILQ_INIT(&run_queue);
+    for(i = 0; i < RUNQ_LEVELS; i++)
+        TAILQ_INIT(&run_queue[i]);
+
+    memset(run_bitmap, 0, sizeof(run_bitmap));
+    run_summary = 0;
+
+    TAILQ_INIT(&edf_ready);
+    TAILQ_INIT(&edf_release);
+    edf_count = 0;
+    edf_density = 0;
+    edf_running = NULL;
 
     /* Start off with no "current" thread */
     thd_current = NULL;
@@ -1044,6 +1905,7 @@ int thd_init(void) {
     timer_primary_set_callback(thd_timer_hnd);
 
     /* Schedule our first wakeup */
+    thd_tick_next = timer_ms_gettime64() + 1000 / HZ;
     timer_primary_wakeup(1000 / HZ);
 
     dbglog(DBG_INFO, "thd: pre-emption enabled, HZ=%d\n", HZ);
@@ -1057,19 +1919,30 @@ void thd_shutdown(void) {
 
     /* Remove our pre-emption handler */
     timer_primary_set_callback(NULL);
+    thd_tickless = 0;
 
     /* Kill remaining live threads */
     n1 = LIST_FIRST(&thd_list);
 
     while(n1 != NULL) {
         n2 = LIST_NEXT(n1, t_list);
-        free(n1->stack);
+
+        if(n1->flags & THD_OWN_STACK)
+            free(n1->stack);
+
+        free(n1->tcbhead);
+        free(n1->tls_data);
         free(n1);
         n1 = n2;
     }
 
+    /* Empty the pool */
+    pool_trim(0);
+
     sem_destroy(&thd_reap_sem);
 
+    thd_trace_enable(0);
+
     /* Shutdown thread sync primitives */
     genwait_shutdown();
 
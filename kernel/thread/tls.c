@@ -8,6 +8,7 @@
    1.3.0. */
 
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <errno.h>
 #include <malloc.h>
@@ -20,57 +21,42 @@
 static spinlock_t mutex = SPINLOCK_INITIALIZER;
 static kthread_key_t next_key = 1;
 
-typedef struct kthread_tls_dest {
-    /* List handle */
-    LIST_ENTRY(kthread_tls_dest) dest_list;
+typedef void (*tls_dest_t)(void *);
 
-    /* The key */
-    kthread_key_t key;
+/* Destructors for each key, indexed by the key. This and each thread's data
+   array grow as they need to, and are swapped for the bigger copy with ints
+   disabled, so that thread destruction and key deletion (which run with
+   ints disabled) never see one half way there. */
+static tls_dest_t *dest_table;
+static size_t dest_size;
 
-    /* Destructor for the key */
-    void (*destructor)(void *);
-} kthread_tls_dest_t;
+/* How big to make an array to hold the given index. */
+static size_t tls_grow_size(size_t size, size_t index) {
+    if(!size)
+        size = 8;
 
-LIST_HEAD(kthread_tls_dest_list, kthread_tls_dest);
+    while(size <= index)
+        size <<= 1;
 
-static struct kthread_tls_dest_list dest_list;
+    return size;
+}
 
 /* What is the next key that will be given out? */
 kthread_key_t kthread_key_next(void) {
     return next_key;
 }
 
-typedef void (*destructor)(void *);
-
-/* Get the destructor for a given key. */
-static destructor kthread_key_get_destructor(kthread_key_t key) {
-    kthread_tls_dest_t *i;
-
-    LIST_FOREACH(i, &dest_list, dest_list) {
-        if(i->key == key) {
-            return i->destructor;
-        }
-    }
-
-    return NULL;
-}
-
 /* Delete the destructor for a given key. */
 void kthread_key_delete_destructor(kthread_key_t key) {
-    kthread_tls_dest_t *i;
-
-    LIST_FOREACH(i, &dest_list, dest_list) {
-        if(i->key == key) {
-            LIST_REMOVE(i, dest_list);
-            free(i);
-            return;
-        }
-    }
+    if((size_t)key < dest_size)
+        dest_table[key] = NULL;
 }
 
 /* Create a new TLS key. */
 int kthread_key_create(kthread_key_t *key, void (*destructor)(void *)) {
-    kthread_tls_dest_t *dest;
+    tls_dest_t *table, *old;
+    size_t size;
+    int irq;
 
     if(irq_inside_int() &&
        (spinlock_is_locked(&mutex) || !malloc_irq_safe())) {
@@ -80,21 +66,30 @@ int kthread_key_create(kthread_key_t *key, void (*destructor)(void *)) {
 
     spinlock_lock(&mutex);
 
-    /* Store the destructor if need be. */
-    if(destructor) {
-        dest = (kthread_tls_dest_t *)malloc(sizeof(kthread_tls_dest_t));
+    /* Make room for the destructor if need be. */
+    if((size_t)next_key >= dest_size) {
+        size = tls_grow_size(dest_size, next_key);
+        table = (tls_dest_t *)malloc(size * sizeof(tls_dest_t));
 
-        if(!dest) {
+        if(!table) {
             errno = ENOMEM;
             spinlock_unlock(&mutex);
             return -1;
         }
 
-        dest->key = next_key;
-        dest->destructor = destructor;
-        LIST_INSERT_HEAD(&dest_list, dest, dest_list);
+        memset(table + dest_size, 0, (size - dest_size) * sizeof(tls_dest_t));
+
+        irq = irq_disable();
+        memcpy(table, dest_table, dest_size * sizeof(tls_dest_t));
+        old = dest_table;
+        dest_table = table;
+        dest_size = size;
+        irq_restore(irq);
+
+        free(old);
     }
 
+    dest_table[next_key] = destructor;
     *key = next_key++;
     spinlock_unlock(&mutex);
 
@@ -104,16 +99,12 @@ int kthread_key_create(kthread_key_t *key, void (*destructor)(void *)) {
 /* Get the value stored for a given TLS key. Returns NULL if the key is invalid
    or there is no data there for the current thread. */
 void *kthread_getspecific(kthread_key_t key) {
-    kthread_t *cur = thd_get_current();
-    kthread_tls_kv_t *i;
+    kthread_t *cur = thd_current;
 
-    LIST_FOREACH(i, &cur->tls_list, kv_list) {
-        if(i->key == key) {
-            return i->data;
-        }
-    }
+    if(key < 1 || (size_t)key >= cur->tls_size)
+        return NULL;
 
-    return NULL;
+    return cur->tls_data[key];
 }
 
 /* Set the value for a given TLS key. Returns -1 on failure. errno will be
@@ -121,8 +112,10 @@ void *kthread_getspecific(kthread_key_t key) {
    allocate for storage, or EPERM if run inside an interrupt and the a call is
    in progress already. */
 int kthread_setspecific(kthread_key_t key, const void *value) {
-    kthread_t *cur = thd_get_current();
-    kthread_tls_kv_t *i;
+    kthread_t *cur = thd_current;
+    void **data, **old;
+    size_t size;
+    int irq;
 
     if(irq_inside_int() && spinlock_is_locked(&mutex)) {
         errno = EPERM;
@@ -140,46 +133,60 @@ int kthread_setspecific(kthread_key_t key, const void *value) {
 
     spinlock_unlock(&mutex);
 
-    /* Check if we already have an entry for this key. */
-    LIST_FOREACH(i, &cur->tls_list, kv_list) {
-        if(i->key == key) {
-            i->data = (void *)value;
-            return 0;
+    /* Make room for the key, if we haven't got it yet. */
+    if((size_t)key >= cur->tls_size) {
+        size = tls_grow_size(cur->tls_size, key);
+        data = (void **)malloc(size * sizeof(void *));
+
+        if(!data) {
+            errno = ENOMEM;
+            return -1;
         }
-    }
 
-    /* No entry, create a new one. */
-    i = (kthread_tls_kv_t *)malloc(sizeof(kthread_tls_kv_t));
+        memset(data + cur->tls_size, 0,
+               (size - cur->tls_size) * sizeof(void *));
 
-    if(!i) {
-        errno = ENOMEM;
-        return -1;
+        irq = irq_disable();
+        memcpy(data, cur->tls_data, cur->tls_size * sizeof(void *));
+        old = cur->tls_data;
+        cur->tls_data = data;
+        cur->tls_size = size;
+        irq_restore(irq);
+
+        free(old);
     }
 
-    i->key = key;
-    i->data = (void *)value;
-    i->destructor = kthread_key_get_destructor(key);
-    LIST_INSERT_HEAD(&cur->tls_list, i, kv_list);
+    cur->tls_data[key] = (void *)value;
 
     return 0;
 }
 
-int kthread_tls_init(void) {
-    /* Initialize the destructor list. */
-    LIST_INIT(&dest_list);
+/* Run the destructors for a dying thread's data and free it. */
+void kthread_tls_destroy(kthread_t *thd) {
+    void *value;
+    size_t i;
+
+    for(i = 1; i < thd->tls_size; i++) {
+        value = thd->tls_data[i];
+
+        if(value && i < dest_size && dest_table[i]) {
+            thd->tls_data[i] = NULL;
+            dest_table[i](value);
+        }
+    }
+
+    free(thd->tls_data);
+    thd->tls_data = NULL;
+    thd->tls_size = 0;
+}
 
+int kthread_tls_init(void) {
     return 0;
 }
 
 void kthread_tls_shutdown(void) {
-    kthread_tls_dest_t *n1, *n2;
-
-    /* Tear down the destructor list. */
-    n1 = LIST_FIRST(&dest_list);
-
-    while(n1 != NULL) {
-        n2 = LIST_NEXT(n1, dest_list);
-        free(n1);
-        n1 = n2;
-    }
+    /* Tear down the destructor table. */
+    free(dest_table);
+    dest_table = NULL;
+    dest_size = 0;
 }
@@ -0,0 +1,378 @@
+/* KallistiOS ##version##
+
+   workqueue.c
+   Copyright (C) 2026 KallistiOS Team
+*/
+
+/* Work queues: a fixed set of worker threads running work items */
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+
+#include <kos/workqueue.h>
+#include <kos/genwait.h>
+#include <arch/irq.h>
+#include <arch/timer.h>
+
+/* What list a work item is on, if any */
+#define WORK_IDLE       0
+#define WORK_PENDING    1
+#define WORK_DELAYED    2
+
+TAILQ_HEAD(work_list, work);
+
+struct worker {
+    workqueue_t *wq;
+    kthread_t *thd;
+    work_t *running;
+};
+
+/* Work waiting to run is kept on pending, in priority order, and delayed
+   work on delayed, in order of when it's due. Idle workers sleep on the
+   pending list, with a timeout for the first delayed work if there is any,
+   and anyone waiting for work to finish sleeps on waiters. Everything here
+   is protected by disabling interrupts. */
+struct workqueue {
+    struct work_list pending;
+    struct work_list delayed;
+    int stop;
+    int busy;
+    int waiters;
+    int count;
+    struct worker workers[];
+};
+
+/* Put work on the pending list, behind anything of the same priority. */
+static void work_insert(workqueue_t *wq, work_t *work) {
+    work_t *i;
+
+    TAILQ_FOREACH(i, &wq->pending, entry) {
+        if(i->prio > work->prio)
+            break;
+    }
+
+    if(i)
+        TAILQ_INSERT_BEFORE(i, work, entry);
+    else
+        TAILQ_INSERT_TAIL(&wq->pending, work, entry);
+
+    work->state = WORK_PENDING;
+}
+
+/* Find the worker running the given work, if it's running. */
+static struct worker *work_worker(workqueue_t *wq, work_t *work) {
+    int i;
+
+    for(i = 0; i < wq->count; i++) {
+        if(wq->workers[i].running == work)
+            return &wq->workers[i];
+    }
+
+    return NULL;
+}
+
+static void *workqueue_thd(void *param) {
+    struct worker *self = (struct worker *)param;
+    workqueue_t *wq = self->wq;
+    work_t *work;
+    uint64_t now;
+    int old, timeout;
+
+    old = irq_disable();
+
+    while(!wq->stop) {
+        now = timer_ms_gettime64();
+
+        /* Move any delayed work that's come due over to be run */
+        while((work = TAILQ_FIRST(&wq->delayed)) && work->when <= now) {
+            TAILQ_REMOVE(&wq->delayed, work, entry);
+            work_insert(wq, work);
+        }
+
+        /* If there's nothing to do, sleep until there is or the next delayed
+           work is due. */
+        if(!(work = TAILQ_FIRST(&wq->pending))) {
+            timeout = 0;
+
+            if((work = TAILQ_FIRST(&wq->delayed))) {
+                if(work->when - now > INT_MAX)
+                    timeout = INT_MAX;
+                else
+                    timeout = (int)(work->when - now);
+            }
+
+            genwait_wait(&wq->pending, "workqueue_thd", timeout, NULL);
+            continue;
+        }
+
+        TAILQ_REMOVE(&wq->pending, work, entry);
+        work->state = WORK_IDLE;
+        self->running = work;
+        ++wq->busy;
+        irq_restore(old);
+
+        /* The work may well be gone after this, so don't touch it again. */
+        work->func(work);
+
+        old = irq_disable();
+        self->running = NULL;
+        --wq->busy;
+
+        if(wq->waiters)
+            genwait_wake_all(&wq->waiters);
+    }
+
+    irq_restore(old);
+    return NULL;
+}
+
+/* Take everything off the queue without running it. */
+static void workqueue_drop(workqueue_t *wq) {
+    work_t *work;
+
+    while((work = TAILQ_FIRST(&wq->pending))) {
+        TAILQ_REMOVE(&wq->pending, work, entry);
+        work->state = WORK_IDLE;
+    }
+
+    while((work = TAILQ_FIRST(&wq->delayed))) {
+        TAILQ_REMOVE(&wq->delayed, work, entry);
+        work->state = WORK_IDLE;
+    }
+}
+
+workqueue_t *workqueue_create(int workers, const kthread_attr_t *attr) {
+    kthread_attr_t real_attr = { 0, 0, NULL, 0, NULL };
+    workqueue_t *wq;
+    int i;
+
+    if(workers < 1) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    wq = (workqueue_t *)malloc(sizeof(workqueue_t) +
+                               workers * sizeof(struct worker));
+
+    if(!wq) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    memset(wq, 0, sizeof(workqueue_t) + workers * sizeof(struct worker));
+    TAILQ_INIT(&wq->pending);
+    TAILQ_INIT(&wq->delayed);
+
+    if(attr)
+        real_attr = *attr;
+
+    real_attr.create_detached = 0;
+    real_attr.stack_ptr = NULL;
+
+    if(!real_attr.label)
+        real_attr.label = "[workqueue]";
+
+    for(i = 0; i < workers; i++) {
+        wq->workers[i].wq = wq;
+        wq->workers[i].thd = thd_create_ex(&real_attr, workqueue_thd,
+                                           &wq->workers[i]);
+
+        if(!wq->workers[i].thd) {
+            wq->count = i;
+            workqueue_destroy(wq);
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
+
+    wq->count = workers;
+
+    return wq;
+}
+
+void workqueue_destroy(workqueue_t *wq) {
+    int old, i;
+
+    old = irq_disable();
+    wq->stop = 1;
+    workqueue_drop(wq);
+    genwait_wake_all(&wq->pending);
+    genwait_wake_all(&wq->waiters);
+    irq_restore(old);
+
+    /* Let the workers finish up what they're doing, if we can... Otherwise,
+       punt. */
+    for(i = 0; i < wq->count; i++) {
+        if(!irq_inside_int())
+            thd_join(wq->workers[i].thd, NULL);
+        else
+            thd_destroy(wq->workers[i].thd);
+    }
+
+    /* Anything they queued on their way out won't be run either. */
+    old = irq_disable();
+    workqueue_drop(wq);
+    irq_restore(old);
+
+    free(wq);
+}
+
+int workqueue_flush(workqueue_t *wq) {
+    int old;
+
+    if(irq_inside_int()) {
+        errno = EPERM;
+        return -1;
+    }
+
+    if(workqueue_is_worker(wq)) {
+        errno = EDEADLK;
+        return -1;
+    }
+
+    old = irq_disable();
+
+    while(!TAILQ_EMPTY(&wq->pending) || wq->busy) {
+        ++wq->waiters;
+        genwait_wait(&wq->waiters, "workqueue_flush", 0, NULL);
+        --wq->waiters;
+    }
+
+    irq_restore(old);
+
+    return 0;
+}
+
+int workqueue_is_worker(workqueue_t *wq) {
+    int i;
+
+    for(i = 0; i < wq->count; i++) {
+        if(wq->workers[i].thd == thd_current)
+            return 1;
+    }
+
+    return 0;
+}
+
+void work_init(work_t *work, void (*func)(work_t *work), void *data, int prio) {
+    memset(work, 0, sizeof(work_t));
+    work->func = func;
+    work->data = data;
+    work->prio = prio;
+}
+
+int work_queue(workqueue_t *wq, work_t *work) {
+    int old, rv = 1;
+
+    old = irq_disable();
+
+    if(work->state == WORK_IDLE) {
+        work->wq = wq;
+        work_insert(wq, work);
+        genwait_wake_one(&wq->pending);
+        rv = 0;
+    }
+
+    irq_restore(old);
+
+    return rv;
+}
+
+int work_queue_delayed(workqueue_t *wq, work_t *work, unsigned int delay) {
+    work_t *i;
+    int old, rv = 1;
+
+    old = irq_disable();
+
+    if(work->state == WORK_IDLE) {
+        work->wq = wq;
+        work->when = timer_ms_gettime64() + delay;
+        work->state = WORK_DELAYED;
+
+        TAILQ_FOREACH(i, &wq->delayed, entry) {
+            if(i->when > work->when)
+                break;
+        }
+
+        if(i)
+            TAILQ_INSERT_BEFORE(i, work, entry);
+        else
+            TAILQ_INSERT_TAIL(&wq->delayed, work, entry);
+
+        /* If it's the first due now, an idle worker has to cut its sleep
+           short to keep an eye on it. */
+        if(TAILQ_FIRST(&wq->delayed) == work)
+            genwait_wake_one(&wq->pending);
+
+        rv = 0;
+    }
+
+    irq_restore(old);
+
+    return rv;
+}
+
+int work_cancel(work_t *work) {
+    workqueue_t *wq = work->wq;
+    int old, rv = 0;
+
+    old = irq_disable();
+
+    if(work->state == WORK_PENDING) {
+        TAILQ_REMOVE(&wq->pending, work, entry);
+        rv = 1;
+    }
+    else if(work->state == WORK_DELAYED) {
+        TAILQ_REMOVE(&wq->delayed, work, entry);
+        rv = 1;
+    }
+
+    work->state = WORK_IDLE;
+
+    if(rv && wq->waiters)
+        genwait_wake_all(&wq->waiters);
+
+    irq_restore(old);
+
+    return rv;
+}
+
+int work_wait(work_t *work) {
+    workqueue_t *wq = work->wq;
+    struct worker *w;
+    int old, rv = 0;
+
+    if(irq_inside_int()) {
+        errno = EPERM;
+        return -1;
+    }
+
+    /* If it's never been queued, there's nothing to wait for. */
+    if(!wq)
+        return 0;
+
+    old = irq_disable();
+
+    for(;;) {
+        w = work_worker(wq, work);
+
+        if(w && w->thd == thd_current) {
+            errno = EDEADLK;
+            rv = -1;
+            break;
+        }
+
+        if(!w && work->state == WORK_IDLE)
+            break;
+
+        ++wq->waiters;
+        genwait_wait(&wq->waiters, "work_wait", 0, NULL);
+        --wq->waiters;
+    }
+
+    irq_restore(old);
+
+    return rv;
+}
@@ -0,0 +1,375 @@
+/* KallistiOS ##version##
+
+   arenatest.c
+   Copyright (C) 2026 KallistiOS Team
+
+   Arena allocator tests and benchmark. This builds the kernel's own arena.c
+   on a PC, with malloc() and free() counted so the tests can see when the
+   arena goes to the heap, and the thread-specific data it keeps frame
+   arenas in faked for a single thread.
+
+   The tests run first, and stop at the first failure. The benchmark then
+   builds a frame's worth of small allocations, like strings and vertex
+   arrays, over and over, comparing throwing them away with free() against
+   resetting an arena.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Count what arena.c gets from the heap */
+static int heap_blocks, heap_calls;
+
+static void *test_malloc(size_t size) {
+    void *p = malloc(size);
+
+    if(p) {
+        ++heap_blocks;
+        ++heap_calls;
+    }
+
+    return p;
+}
+
+static void test_free(void *p) {
+    if(p)
+        --heap_blocks;
+
+    free(p);
+}
+
+#define malloc  test_malloc
+#define free    test_free
+#include "arena.c"
+#undef malloc
+#undef free
+
+/* Thread-specific data for the one thread there is */
+static void *tsd_value;
+static void (*tsd_destructor)(void *);
+
+int kthread_key_create(kthread_key_t *key, void (*destructor)(void *)) {
+    *key = 1;
+    tsd_destructor = destructor;
+    return 0;
+}
+
+void *kthread_getspecific(kthread_key_t key) {
+    return key == 1 ? tsd_value : NULL;
+}
+
+int kthread_setspecific(kthread_key_t key, const void *value) {
+    if(key != 1) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    tsd_value = (void *)value;
+    return 0;
+}
+
+int kthread_once(kthread_once_t *once_control, void (*init_routine)(void)) {
+    if(!*once_control) {
+        *once_control = 1;
+        init_routine();
+    }
+
+    return 0;
+}
+
+/* As the thread library does when a thread exits */
+static void thread_exit(void) {
+    void *value = tsd_value;
+
+    tsd_value = NULL;
+
+    if(value && tsd_destructor)
+        tsd_destructor(value);
+}
+
+static int failed;
+
+#define CHECK(cond) do { \
+        if(!(cond)) { \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            failed = 1; \
+            return; \
+        } \
+    } while(0)
+
+static int aligned(void *p, size_t align) {
+    return !((uintptr_t)p & (align - 1));
+}
+
+static void test_init(void) {
+    static char buf[256];
+    arena_t arena;
+
+    CHECK(arena_init(&arena, buf, 4, 0) < 0 && errno == EINVAL);
+    CHECK(arena_init(&arena, NULL, 256, 0) < 0 && errno == EINVAL);
+    CHECK(arena_init(&arena, buf + 1, sizeof(buf) - 1, 0) == 0);
+    CHECK(aligned(arena_alloc(&arena, 1), ARENA_ALIGN));
+    arena_destroy(&arena);
+}
+
+/* A fixed arena hands out separate, aligned pieces of its block, and fails
+   once it's full without going near the heap. */
+static void test_fixed(void) {
+    static char buf[4096];
+    unsigned char *p[512];
+    arena_t arena;
+    int i, j, n;
+
+    CHECK(arena_init(&arena, buf, sizeof(buf), 0) == 0);
+
+    for(n = 0; n < 512; n++) {
+        if(!(p[n] = arena_alloc(&arena, 24)))
+            break;
+
+        CHECK(aligned(p[n], ARENA_ALIGN));
+        CHECK(p[n] >= (unsigned char *)buf &&
+              p[n] + 24 <= (unsigned char *)buf + sizeof(buf));
+        memset(p[n], n, 24);
+    }
+
+    CHECK(n > 100 && n < 512);
+    CHECK(errno == ENOMEM);
+    CHECK(heap_calls == 0);
+
+    for(i = 0; i < n; i++)
+        for(j = 0; j < 24; j++)
+            CHECK(p[i][j] == (unsigned char)i);
+
+    arena_destroy(&arena);
+}
+
+static void test_aligned(void) {
+    static char buf[16384];
+    arena_t arena;
+    size_t align;
+    void *p;
+
+    CHECK(arena_init(&arena, buf, sizeof(buf), 0) == 0);
+
+    for(align = 1; align <= 4096; align <<= 1) {
+        arena_alloc(&arena, 1);
+        CHECK((p = arena_alloc_aligned(&arena, 3, align)));
+        CHECK(aligned(p, align));
+    }
+
+    CHECK(!arena_alloc_aligned(&arena, 8, 0) && errno == EINVAL);
+    CHECK(!arena_alloc_aligned(&arena, 8, 24) && errno == EINVAL);
+    CHECK(!arena_alloc(&arena, (size_t)-1) && errno == ENOMEM);
+    arena_destroy(&arena);
+}
+
+/* Rewinding gives back everything since the mark, and nothing before it */
+static void test_rewind(void) {
+    static char buf[1024];
+    arena_mark_t outer, inner;
+    arena_t arena;
+    char *a, *b, *c;
+
+    CHECK(arena_init(&arena, buf, sizeof(buf), 0) == 0);
+
+    a = arena_alloc(&arena, 16);
+    outer = arena_mark(&arena);
+    b = arena_alloc(&arena, 16);
+    inner = arena_mark(&arena);
+    c = arena_alloc(&arena, 100);
+    CHECK(a && b && c && a < b && b < c);
+
+    arena_rewind(&arena, inner);
+    CHECK(arena_alloc(&arena, 100) == c);
+
+    arena_rewind(&arena, outer);
+    CHECK(arena_alloc(&arena, 16) == b);
+
+    /* The same mark can be used again */
+    arena_rewind(&arena, outer);
+    CHECK(arena_alloc(&arena, 16) == b);
+
+    arena_reset(&arena);
+    CHECK(arena_alloc(&arena, 16) == a);
+    arena_destroy(&arena);
+}
+
+/* Growing chains on blocks from the heap, which rewinding and resetting
+   keep for next time, apart from oversized ones. */
+static void test_grow(void) {
+    static char buf[256];
+    arena_mark_t mark;
+    arena_t arena;
+    char *p[64], *big;
+    int i, calls;
+
+    heap_calls = heap_blocks = 0;
+    CHECK(arena_init(&arena, buf, sizeof(buf), 1024) == 0);
+
+    for(i = 0; i < 64; i++) {
+        CHECK((p[i] = arena_alloc(&arena, 100)));
+        memset(p[i], i, 100);
+    }
+
+    /* 64 * 100 bytes takes the first block and at least 7 more */
+    CHECK(heap_blocks >= 7);
+
+    for(i = 0; i < 64; i++)
+        CHECK(p[i][0] == i && p[i][99] == i);
+
+    /* Resetting keeps the blocks as spares, which get used again in the
+       same order */
+    calls = heap_calls;
+    arena_reset(&arena);
+    CHECK(heap_blocks == calls);
+
+    for(i = 0; i < 64; i++)
+        CHECK(arena_alloc(&arena, 100) == p[i]);
+
+    CHECK(heap_calls == calls);
+
+    /* A big allocation gets a block of its own, which is freed afterwards */
+    mark = arena_mark(&arena);
+    CHECK((big = arena_alloc(&arena, 5000)));
+    memset(big, 0xaa, 5000);
+    CHECK(heap_calls == calls + 1);
+    arena_rewind(&arena, mark);
+    CHECK(heap_blocks == calls);
+
+    /* Trimming frees the spares; destroying frees the rest */
+    arena_reset(&arena);
+    arena_trim(&arena);
+    CHECK(heap_blocks == 0);
+
+    arena_alloc(&arena, 2000);
+    arena_destroy(&arena);
+    CHECK(heap_blocks == 0);
+}
+
+static void test_create(void) {
+    arena_t *arena;
+    void *p;
+
+    heap_calls = heap_blocks = 0;
+    CHECK((arena = arena_create(1000, 0)));
+    CHECK(heap_blocks == 1);
+    CHECK((p = arena_alloc(arena, 1000)));
+    CHECK(!arena_alloc(arena, 1));
+    arena_destroy(arena);
+    CHECK(heap_blocks == 0);
+}
+
+static void test_frame(void) {
+    arena_t *arena;
+    void *p, *q;
+    int i;
+
+    heap_calls = heap_blocks = 0;
+    arena_frame_reset();
+    CHECK(heap_calls == 0);
+
+    CHECK((arena = arena_frame()));
+    CHECK(arena_frame() == arena);
+    CHECK((p = arena_frame_alloc(100)));
+
+    /* Go over a block's worth, and check a reset brings it all back */
+    for(i = 0; i < ARENA_FRAME_SIZE / 1000 * 3; i++)
+        CHECK(arena_frame_alloc(1000));
+
+    arena_frame_reset();
+    CHECK((q = arena_frame_alloc(100)) == p);
+
+    thread_exit();
+    CHECK(heap_blocks == 0);
+}
+
+/* Benchmark: a frame is a run of small allocations of assorted sizes, all
+   thrown away at the end. */
+#define FRAMES      2000
+#define PER_FRAME   2000
+
+static uint32_t rnd_state = 2463534242u;
+
+static uint32_t rnd(void) {
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void bench(void) {
+    static size_t sizes[PER_FRAME];
+    static void *ptrs[PER_FRAME];
+    double start, t_malloc, t_arena;
+    arena_t *arena;
+    int f, i;
+
+    for(i = 0; i < PER_FRAME; i++)
+        sizes[i] = 8 + rnd() % (rnd() % 8 ? 64 : 1024);
+
+    start = now_ns();
+
+    for(f = 0; f < FRAMES; f++) {
+        for(i = 0; i < PER_FRAME; i++) {
+            ptrs[i] = malloc(sizes[i]);
+            *(char *)ptrs[i] = i;
+        }
+
+        for(i = 0; i < PER_FRAME; i++)
+            free(ptrs[i]);
+    }
+
+    t_malloc = now_ns() - start;
+
+    arena = arena_frame();
+    start = now_ns();
+
+    for(f = 0; f < FRAMES; f++) {
+        for(i = 0; i < PER_FRAME; i++) {
+            ptrs[i] = arena_alloc(arena, sizes[i]);
+            *(char *)ptrs[i] = i;
+        }
+
+        arena_frame_reset();
+    }
+
+    t_arena = now_ns() - start;
+    thread_exit();
+
+    printf("%d frames of %d allocations:\n", FRAMES, PER_FRAME);
+    printf("  malloc/free:  %6.1f ns per allocation\n",
+           t_malloc / ((double)FRAMES * PER_FRAME));
+    printf("  arena/reset:  %6.1f ns per allocation\n",
+           t_arena / ((double)FRAMES * PER_FRAME));
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+
+    test_init();
+    test_fixed();
+    test_aligned();
+    test_rewind();
+    test_grow();
+    test_create();
+    test_frame();
+
+    if(failed)
+        return 1;
+
+    printf("All tests passed\n\n");
+    bench();
+
+    return 0;
+}
@@ -0,0 +1,397 @@
+/* KallistiOS ##version##
+
+   utils/common/batch.c
+
+   Batch conversion for the texture tools. A list of images is built from a
+   directory or a manifest and handed out to a pool of worker threads, each
+   running the tool's own encode function on one image at a time.
+
+   Outputs can be kept in a cache directory under a hash of the source file
+   contents, the tool and its options. An image whose hash is already in the
+   cache is not decoded or converted at all; the cached output is just copied
+   into place. vqenc, kmgenc and dcbumpgen all build this file from here.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "batch.h"
+
+typedef struct batch_t {
+    const batch_tool_t *tool;
+    const char *cache_dir;
+
+    char **files;
+    int count;
+    int alloc;
+
+    pthread_mutex_t lock;
+    int next;
+    int done;
+    int encoded;
+    int cached;
+    int failed;
+} batch_t;
+
+/********************************************************************/
+/* Building the file list */
+
+static int add_file(batch_t *b, const char *fn) {
+    char **tmp;
+
+    if(b->count == b->alloc) {
+        b->alloc = b->alloc ? b->alloc * 2 : 64;
+        tmp = (char **)realloc(b->files, b->alloc * sizeof(char *));
+
+        if(tmp == NULL)
+            return -ENOMEM;
+
+        b->files = tmp;
+    }
+
+    if((b->files[b->count] = strdup(fn)) == NULL)
+        return -ENOMEM;
+
+    b->count++;
+    return 0;
+}
+
+/* same extensions as get_image() accepts */
+static int is_image(const char *fn) {
+    int len = strlen(fn);
+
+    return len > 4 && (!strcmp(fn + len - 4, ".png") ||
+                       !strcmp(fn + len - 4, ".jpg"));
+}
+
+static int scan_dir(batch_t *b, const char *path) {
+    DIR *dir;
+    struct dirent *de;
+    struct stat st;
+    char fn[4096];
+    int rv = 0;
+
+    if((dir = opendir(path)) == NULL) {
+        fprintf(stderr, "can't open directory %s\n", path);
+        return -errno;
+    }
+
+    while(rv >= 0 && (de = readdir(dir)) != NULL) {
+        if(de->d_name[0] == '.')
+            continue;
+
+        snprintf(fn, sizeof(fn), "%s/%s", path, de->d_name);
+
+        if(stat(fn, &st) < 0)
+            continue;
+
+        if(S_ISDIR(st.st_mode))
+            rv = scan_dir(b, fn);
+        else if(is_image(fn))
+            rv = add_file(b, fn);
+    }
+
+    closedir(dir);
+    return rv;
+}
+
+static int read_manifest(batch_t *b, const char *path) {
+    FILE *fp;
+    char line[4096], fn[8192], base[4096];
+    char *p, *slash;
+    int len, rv = 0;
+
+    if((fp = fopen(path, "r")) == NULL) {
+        fprintf(stderr, "can't open manifest %s\n", path);
+        return -errno;
+    }
+
+    /* entries are relative to the manifest's own directory */
+    strncpy(base, path, sizeof(base) - 1);
+    base[sizeof(base) - 1] = '\0';
+
+    if((slash = strrchr(base, '/')) != NULL)
+        slash[1] = '\0';
+    else
+        base[0] = '\0';
+
+    while(rv >= 0 && fgets(line, sizeof(line), fp) != NULL) {
+        p = line;
+
+        while(*p == ' ' || *p == '\t')
+            p++;
+
+        len = strlen(p);
+
+        while(len > 0 && (p[len - 1] == '\n' || p[len - 1] == '\r' ||
+                          p[len - 1] == ' ' || p[len - 1] == '\t'))
+            p[--len] = '\0';
+
+        if(len == 0 || *p == '#')
+            continue;
+
+        if(*p == '/')
+            rv = add_file(b, p);
+        else {
+            snprintf(fn, sizeof(fn), "%s%s", base, p);
+            rv = add_file(b, fn);
+        }
+    }
+
+    fclose(fp);
+    return rv;
+}
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/********************************************************************/
+/* Cache */
+
+static void *read_file(const char *fn, long *size) {
+    FILE *fp;
+    void *data;
+
+    if((fp = fopen(fn, "rb")) == NULL)
+        return NULL;
+
+    fseek(fp, 0, SEEK_END);
+    *size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    /* one extra byte so empty files still get a buffer */
+    if((data = malloc(*size + 1)) == NULL) {
+        fclose(fp);
+        return NULL;
+    }
+
+    if(*size > 0 && fread(data, *size, 1, fp) != 1) {
+        free(data);
+        data = NULL;
+    }
+
+    fclose(fp);
+    return data;
+}
+
+/* 64-bit FNV-1a */
+static unsigned long long hash_bytes(unsigned long long h, const void *data,
+                                     long size) {
+    const unsigned char *p = (const unsigned char *)data;
+
+    while(size-- > 0) {
+        h ^= *p++;
+        h *= 0x100000001b3ULL;
+    }
+
+    return h;
+}
+
+static int cache_name(batch_t *b, const char *infile, char *out, int outlen) {
+    unsigned long long h;
+    void *data;
+    long size;
+
+    if((data = read_file(infile, &size)) == NULL)
+        return -1;
+
+    h = 0xcbf29ce484222325ULL;
+    h = hash_bytes(h, b->tool->name, strlen(b->tool->name) + 1);
+    h = hash_bytes(h, &b->tool->revision, sizeof(b->tool->revision));
+    h = hash_bytes(h, b->tool->options, strlen(b->tool->options) + 1);
+    h = hash_bytes(h, data, size);
+    free(data);
+
+    snprintf(out, outlen, "%s/%016llx-%ld", b->cache_dir, h, size);
+    return 0;
+}
+
+/* copy through a temporary file so readers never see half a file, even with
+   two workers storing the same cache entry */
+static int copy_file(const char *src, const char *dst, int seq) {
+    char tmp[4096];
+    void *data;
+    long size;
+    FILE *fp;
+    int ok;
+
+    if((data = read_file(src, &size)) == NULL)
+        return -1;
+
+    snprintf(tmp, sizeof(tmp), "%s.%ld.%d.tmp", dst, (long)getpid(), seq);
+
+    if((fp = fopen(tmp, "wb")) == NULL) {
+        free(data);
+        return -1;
+    }
+
+    ok = size == 0 || fwrite(data, size, 1, fp) == 1;
+    ok = (fclose(fp) == 0) && ok;
+    free(data);
+
+    if(!ok || rename(tmp, dst) < 0) {
+        unlink(tmp);
+        return -1;
+    }
+
+    return 0;
+}
+
+/********************************************************************/
+/* Workers */
+
+static void convert(batch_t *b, int idx) {
+    const char *infile = b->files[idx];
+    const char *outfile;
+    const char *status;
+    char cached[4096];
+    int have_key = 0, from_cache = 0, ok = 0;
+
+    outfile = b->tool->output_name(infile);
+
+    if(outfile == NULL) {
+        status = "FAILED (out of memory)";
+        goto done;
+    }
+
+    if(b->cache_dir) {
+        have_key = cache_name(b, infile, cached, sizeof(cached)) == 0;
+
+        if(!have_key) {
+            status = "FAILED (can't read)";
+            goto done;
+        }
+
+        if(access(cached, R_OK) == 0 && copy_file(cached, outfile, idx) == 0)
+            from_cache = 1;
+    }
+
+    if(from_cache) {
+        status = "cached";
+        ok = 1;
+    }
+    else if(b->tool->encode(infile) < 0) {
+        status = "FAILED";
+    }
+    else {
+        status = "encoded";
+        ok = 1;
+
+        if(have_key && copy_file(outfile, cached, idx) < 0)
+            status = "encoded (not cached)";
+    }
+
+done:
+    pthread_mutex_lock(&b->lock);
+
+    b->done++;
+
+    if(!ok)
+        b->failed++;
+    else if(from_cache)
+        b->cached++;
+    else
+        b->encoded++;
+
+    printf("[%d/%d] %s: %s\n", b->done, b->count, infile, status);
+    pthread_mutex_unlock(&b->lock);
+
+    free((void *)outfile);
+}
+
+static void *worker(void *arg) {
+    batch_t *b = (batch_t *)arg;
+    int idx;
+
+    for(;;) {
+        pthread_mutex_lock(&b->lock);
+        idx = b->next++;
+        pthread_mutex_unlock(&b->lock);
+
+        if(idx >= b->count)
+            break;
+
+        convert(b, idx);
+    }
+
+    return NULL;
+}
+
+int batch_run(const batch_tool_t *tool, const char *list,
+              const char *cache_dir, int jobs) {
+    batch_t b;
+    pthread_t *threads;
+    struct stat st;
+    int i, started, rv;
+
+    memset(&b, 0, sizeof(b));
+    b.tool = tool;
+    b.cache_dir = cache_dir;
+    pthread_mutex_init(&b.lock, NULL);
+
+    if(stat(list, &st) < 0) {
+        fprintf(stderr, "can't find %s\n", list);
+        return -errno;
+    }
+
+    if(S_ISDIR(st.st_mode))
+        rv = scan_dir(&b, list);
+    else
+        rv = read_manifest(&b, list);
+
+    if(rv < 0)
+        goto out;
+
+    qsort(b.files, b.count, sizeof(char *), compare_names);
+
+    if(cache_dir && mkdir(cache_dir, 0755) < 0 && errno != EEXIST) {
+        fprintf(stderr, "can't create cache directory %s\n", cache_dir);
+        rv = -errno;
+        goto out;
+    }
+
+    if(jobs < 1)
+        jobs = 1;
+
+    if(jobs > b.count)
+        jobs = b.count;
+
+    threads = (pthread_t *)malloc(sizeof(pthread_t) * (jobs + 1));
+
+    if(threads == NULL) {
+        rv = -ENOMEM;
+        goto out;
+    }
+
+    for(started = 1; started < jobs; started++) {
+        if(pthread_create(&threads[started], NULL, worker, &b) != 0)
+            break;
+    }
+
+    worker(&b);
+
+    for(i = 1; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    free(threads);
+
+    printf("%s: %d encoded, %d cached, %d failed\n", tool->name,
+           b.encoded, b.cached, b.failed);
+    rv = b.failed;
+
+out:
+
+    for(i = 0; i < b.count; i++)
+        free(b.files[i]);
+
+    free(b.files);
+    pthread_mutex_destroy(&b.lock);
+    return rv;
+}
@@ -0,0 +1,43 @@
+/* KallistiOS ##version##
+
+   utils/common/batch.h
+
+   Parallel, cached batch conversion shared by the texture tools.
+*/
+
+#ifndef __BATCH_H
+#define __BATCH_H
+
+typedef struct batch_tool_t {
+    /* tool name and output revision; bump the revision whenever the output
+       for the same input and options changes, so stale cache entries are
+       never reused */
+    const char *name;
+    int revision;
+
+    /* the options in effect, as a string; part of the cache key */
+    const char *options;
+
+    /* convert one image, returning < 0 on failure; must be safe to call
+       from several threads at once */
+    int (*encode)(const char *infile);
+
+    /* output file that encode() writes for infile, in a malloc'd string */
+    const char *(*output_name)(const char *infile);
+} batch_tool_t;
+
+/* Convert every image named by list, which is either a directory (searched
+   recursively for .png and .jpg files) or a manifest with one image per line.
+   Relative manifest entries are taken relative to the manifest itself; blank
+   lines and lines starting with '#' are skipped.
+
+   With a cache_dir, the output for each image is also stored there, keyed by
+   a hash of the source bytes, the tool name and the options, and later runs
+   copy it from there instead of converting again.
+
+   Returns the number of images that failed, or < 0 if the list could not
+   be read. */
+int batch_run(const batch_tool_t *tool, const char *list,
+              const char *cache_dir, int jobs);
+
+#endif
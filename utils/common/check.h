@@ -0,0 +1,32 @@
+/* KallistiOS ##version##
+
+   utils/common/check.h
+
+   The little bit of harness the host tests for the tools share: a CHECK()
+   that reports a failure and carries on, and the summary at the end. Only
+   for single-file test programs; include it from the one with main().
+*/
+
+#ifndef __CHECK_H
+#define __CHECK_H
+
+#include <stdio.h>
+
+static int check_failures;
+
+/* report a failure, printf style, if cond is false */
+#define CHECK(cond, ...) do { \
+        if(!(cond)) { \
+            printf("FAIL: " __VA_ARGS__); \
+            printf("\n"); \
+            check_failures++; \
+        } \
+    } while(0)
+
+/* print the summary; returns the exit status for main() */
+static inline int check_done(void) {
+    printf("%s\n", check_failures ? "FAILED" : "all tests passed");
+    return check_failures ? 1 : 0;
+}
+
+#endif  /* __CHECK_H */
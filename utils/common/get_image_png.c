@@ -55,6 +55,7 @@ int get_image_png(const char * filename, image_t * image) {
     uint32  channels;   /* 3 for RGB 4 for RGBA */
 
     FILE    *infile;    /* source file */
+    readpng_t rp;       /* decoder state */
 
     assert(image != NULL);
 
@@ -64,7 +65,7 @@ int get_image_png(const char * filename, image_t * image) {
     }
 
     /* Step 1: Initialize loader */
-    if(readpng_init(infile)) {
+    if(readpng_init(&rp, infile)) {
         fclose(infile);
         return -2;
     }
@@ -73,7 +74,7 @@ int get_image_png(const char * filename, image_t * image) {
     /* rv = (kos_img_t *)malloc(sizeof(kos_img_t)); */
 
     /* Step 2: Read file */
-    buffer = readpng_get_image(&channels, &row_stride, &image->w, &image->h);
+    buffer = readpng_get_image(&rp, &channels, &row_stride, &image->w, &image->h);
     temp_tex = (uint8 *)malloc(sizeof(uint8) * 4 * image->w * image->h);
     image->data = (unsigned char *)temp_tex;
     image->bpp = 4;
@@ -85,7 +86,7 @@ int get_image_png(const char * filename, image_t * image) {
 
     /* Step 3: Finish decompression */
     free(buffer);
-    readpng_cleanup();
+    readpng_cleanup(&rp);
 
     fclose(infile);
 
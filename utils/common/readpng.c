@@ -14,9 +14,6 @@
 #include <zlib.h>
 #include "readpng.h"    /* typedefs, common macros, public prototypes */
 
-static png_structp png_ptr = NULL;
-static png_infop info_ptr = NULL;
-
 void readpng_version_info(void) {
     fprintf(stderr, "   Compiled with libpng %s; using libpng %s.\n",
             PNG_LIBPNG_VER_STRING, png_libpng_ver);
@@ -27,8 +24,13 @@ void readpng_version_info(void) {
 
 /* return value = 0 for success, 1 for bad sig, 2 for bad IHDR, 3 for io, 4 for no mem */
 
-uint32 readpng_init(FILE *infile) {
+uint32 readpng_init(readpng_t *rp, FILE *infile) {
     uint8 sig[8];
+    png_structp png_ptr;
+    png_infop info_ptr;
+
+    rp->png_ptr = NULL;
+    rp->info_ptr = NULL;
 
     /* first do a quick check that the file really is a PNG image; could
      * have used slightly more general png_sig_cmp() function instead */
@@ -59,12 +61,17 @@ uint32 readpng_init(FILE *infile) {
 
     png_read_info(png_ptr, info_ptr);  /* read all PNG info up to image data */
 
+    rp->png_ptr = png_ptr;
+    rp->info_ptr = info_ptr;
+
     /* OK, that's all we need for now; return happy */
 
     return 0;
 }
 
-uint8 *readpng_get_image(uint32 *pChannels, uint32 *pRowbytes, int *pWidth, int *pHeight) {
+uint8 *readpng_get_image(readpng_t *rp, uint32 *pChannels, uint32 *pRowbytes, int *pWidth, int *pHeight) {
+    png_structp png_ptr = rp->png_ptr;
+    png_infop info_ptr = rp->info_ptr;
     png_uint_32  width, height;
     int  bit_depth, color_type;
     uint8  *image_data = NULL;
@@ -111,12 +118,12 @@ uint8 *readpng_get_image(uint32 *pChannels, uint32 *pRowbytes, int *pWidth, int
     *pChannels = (int)png_get_channels(png_ptr, info_ptr);
 
     if((image_data = (uint8 *)malloc(rowbytes * height)) == NULL) {
-        png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+        readpng_cleanup(rp);
         return NULL;
     }
 
     if((row_pointers = (png_bytepp)malloc(height * sizeof(png_bytep))) == NULL) {
-        png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+        readpng_cleanup(rp);
         free(image_data);
         image_data = NULL;
         return NULL;
@@ -143,10 +150,10 @@ uint8 *readpng_get_image(uint32 *pChannels, uint32 *pRowbytes, int *pWidth, int
 }
 
 
-void readpng_cleanup(void) {
-    if(png_ptr && info_ptr) {
-        png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
-        png_ptr = NULL;
-        info_ptr = NULL;
+void readpng_cleanup(readpng_t *rp) {
+    if(rp->png_ptr && rp->info_ptr) {
+        png_destroy_read_struct(&rp->png_ptr, &rp->info_ptr, NULL);
+        rp->png_ptr = NULL;
+        rp->info_ptr = NULL;
     }
 }
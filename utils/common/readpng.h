@@ -24,9 +24,15 @@ typedef unsigned char uint8; */
 #  define Trace(x)  ;
 #endif
 
+/* decoder state for one image; each thread decoding needs its own */
+typedef struct readpng_t {
+    png_structp png_ptr;
+    png_infop info_ptr;
+} readpng_t;
+
 void readpng_version_info(void);
 
-uint32 readpng_init(FILE *infile);
+uint32 readpng_init(readpng_t *rp, FILE *infile);
 
 /* pNumChannels will be 3 for RGB images, and 4 for RGBA images
  * pRowBytes is the number of bytes necessary to hold one row
@@ -34,7 +40,7 @@ uint32 readpng_init(FILE *infile);
  * starts at a multiple of pRowBytes
  * The caller is responsible for freeing the memory
  */
-uint8 *readpng_get_image(uint32 *pNumChannels,
+uint8 *readpng_get_image(readpng_t *rp, uint32 *pNumChannels,
                          uint32 *pRowBytes, int *pWidth, int *pHeight);
 
-void readpng_cleanup(void);
+void readpng_cleanup(readpng_t *rp);
@@ -20,10 +20,16 @@
 
    3. This notice may not be removed or altered from any source 
       distribution.
+
+   Altered by the KallistiOS team to work in tiles on several threads
+   with table lookups, and to add mipmaps and batch conversion.
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <unistd.h>
+#include <pthread.h>
 
 /* TODO:
  * With this utility included, there are now three utilities
@@ -34,11 +40,37 @@
  * executable.
  */
 #include "get_image.h"
+#include "batch.h"
+
+/* bump whenever the output for a given input and options changes */
+#define DCBUMPGEN_REVISION 1
+
+/* Images are worked on in square tiles of this size (or the size of the
+ * image, if that's smaller), handed out to the threads one at a time. A
+ * tile that size is also one contiguous run of the twiddled output.
+ */
+#define TILE 64
+
+/* the PVR puts 16-bit mipmaps after 6 bytes of padding, smallest first */
+#define MIP_PAD         6
+#define MIP_OFFSET(lv)  (MIP_PAD + 2 * ((1 << (2 * (lv))) - 1) / 3)
+
+static int useMipmap = 0;
+static int useJobs = 0;
+static const char *batchList = 0;
+static const char *batchCache = 0;
 
 static void printUsage() {
-	printf("dcbumpgen - Dreamcast bumpmap generator v0.1\n");
+	printf("dcbumpgen - Dreamcast bumpmap generator v0.2\n");
 	printf("Copyright (c) 2005 Fredrik Ehnbom\n");
-	printf("usage: dcbumpgen <infile.png/.jpg> <outfile.raw>\n");
+	printf("usage: dcbumpgen [options] <infile.png/.jpg> <outfile.raw>\n");
+	printf("       dcbumpgen [options] --batch <dir/manifest> [--cache <dir>]\n");
+	printf("options:\n");
+	printf("  -m, --mipmap    add mipmaps (square images only)\n");
+	printf("  -j, --jobs N    use N threads (default: one per CPU)\n");
+	printf("  --batch LIST    convert every image in a directory or manifest,\n");
+	printf("                  writing <image>.raw next to each one\n");
+	printf("  --cache DIR     reuse outputs of unchanged images in batch mode\n");
 }
 
 static int isPowerOfTwo(unsigned x)
@@ -46,99 +78,462 @@ static int isPowerOfTwo(unsigned x)
 	return x && !(x & (x-1));
 }
 
-/* twiddling stuff copied from kmgenc.c */
-#define TWIDTAB(x) ( (x&1)|((x&2)<<1)|((x&4)<<2)|((x&8)<<3)|((x&16)<<4)| \
-	((x&32)<<5)|((x&64)<<6)|((x&128)<<7)|((x&256)<<8)|((x&512)<<9) )
-#define TWIDOUT(x, y) ( TWIDTAB((y)) | (TWIDTAB((x)) << 1) )
+static int log2i(int x)
+{
+	int l = 0;
+
+	while (x > 1) {
+		x >>= 1;
+		l++;
+	}
+
+	return l;
+}
+
+/* Twiddling, as in kmgenc.c, with the bits of each coordinate spread out
+ * through a table instead of a macro.
+ */
+static unsigned twiddleBits(unsigned x)
+{
+	unsigned out = 0;
+	int i;
+
+	for (i = 0; x >> i; i++)
+		out |= ((x >> i) & 1) << (2 * i);
+
+	return out;
+}
+
+#define TWIDOUT(x, y) ( twidTab[(y)] | (twidTab[(x)] << 1) )
 #define MIN(a, b) ( (a)<(b)? (a):(b) )
+#define MAX(a, b) ( (a)>(b)? (a):(b) )
 
 #define ERROR(...) { ret = 1; fprintf(stderr, __VA_ARGS__); goto cleanup; }
 
-int main(int argc, char **argv) {
+static unsigned twidTab[1024];
+
+/* Every pixel's gradient is a pair of differences between 8-bit heights,
+ * so there are only 511 x 511 different ones. Their rotation and
+ * elevation are worked out once, with exactly the arithmetic that used to
+ * be done for every pixel, and looked up from then on.
+ */
+#define DIFFS 511
+
+static unsigned char (*polarTable)[2];
+
+static void polarOf(int dx, int dy, unsigned char *out)
+{
+	double diffy = dy / 255.0;
+	double diffx = dx / 255.0;
+
+	/* Rotation = R
+	   0 -> almost 360 degrees */
+	double rot = atan2(diffy, diffx);
+	int rotation = (int) ((rot / (2 * 3.1415927)) * 255);
+
+	/* Elevation = S
+	   0 -> almost 90 degrees */
+	int elevation = (int) (255 * (1 - fabs(diffx) - fabs(diffy)));
+	if (elevation < 0) elevation = 0;
+
+	out[0] = rotation;
+	out[1] = elevation;
+}
+
+/* For mipmaps, the texels of the full size level are turned back into
+ * unit normals, which are averaged and renormalized for each level down.
+ * The rotation is stored as a signed angle, and there are only 64K
+ * texels, so they get a table too.
+ */
+static float (*normalTable)[3];
+
+static void normalOf(int rotation, int elevation, float *n)
+{
+	double rot, elev;
+
+	if (rotation > 127) rotation -= 256;
+	rot = rotation / 255.0 * 2 * M_PI;
+	elev = elevation / 255.0 * M_PI / 2;
+
+	n[0] = cos(elev) * cos(rot);
+	n[1] = cos(elev) * sin(rot);
+	n[2] = sin(elev);
+}
+
+static void texelOf(const float *n, unsigned char *out)
+{
+	double rot = atan2(n[1], n[0]);
+	double elev = atan2(n[2], sqrt(n[0] * n[0] + n[1] * n[1]));
+	int elevation = (int) lrint(elev / (M_PI / 2) * 255);
+
+	if (elevation < 0) elevation = 0;
+	if (elevation > 255) elevation = 255;
+
+	out[0] = (int) lrint(rot / (2 * M_PI) * 255);
+	out[1] = elevation;
+}
+
+static int buildTables(void)
+{
+	int i, j;
+
+	for (i = 0; i < 1024; i++)
+		twidTab[i] = twiddleBits(i);
+
+	polarTable = malloc(DIFFS * DIFFS * sizeof(*polarTable));
+	normalTable = malloc(65536 * sizeof(*normalTable));
+	if (!polarTable || !normalTable)
+		return -1;
+
+	for (i = 0; i < DIFFS; i++)
+		for (j = 0; j < DIFFS; j++)
+			polarOf(j - 255, i - 255, polarTable[i * DIFFS + j]);
+
+	for (i = 0; i < 256; i++)
+		for (j = 0; j < 256; j++)
+			normalOf(i, j, normalTable[j << 8 | i]);
+
+	return 0;
+}
+
+/* Tiled engine */
+
+typedef void (*tileFunc)(void *arg, int x0, int y0, int tw, int th);
+
+typedef struct tileJob {
+	tileFunc fn;
+	void *arg;
+	int w, h, tile, tilesX, count;
+	int next;
+	pthread_mutex_t lock;
+} tileJob;
+
+static void *tileWorker(void *p)
+{
+	tileJob *job = p;
+	int t, x0, y0;
+
+	for (;;) {
+		pthread_mutex_lock(&job->lock);
+		t = job->next++;
+		pthread_mutex_unlock(&job->lock);
+
+		if (t >= job->count)
+			break;
+
+		x0 = (t % job->tilesX) * job->tile;
+		y0 = (t / job->tilesX) * job->tile;
+		job->fn(job->arg, x0, y0, MIN(job->tile, job->w - x0),
+			MIN(job->tile, job->h - y0));
+	}
+
+	return NULL;
+}
+
+/* Run fn over a w x h area, tile by tile, on up to threads threads. */
+static void runTiles(tileFunc fn, void *arg, int w, int h, int threads)
+{
+	pthread_t tid[64];
+	tileJob job;
+	int i, started;
+
+	job.fn = fn;
+	job.arg = arg;
+	job.w = w;
+	job.h = h;
+	job.tile = MIN(TILE, MIN(w, h));
+	job.tilesX = (w + job.tile - 1) / job.tile;
+	job.count = job.tilesX * ((h + job.tile - 1) / job.tile);
+	job.next = 0;
+	pthread_mutex_init(&job.lock, NULL);
+
+	if (threads > 64) threads = 64;
+	if (threads > job.count) threads = job.count;
+
+	/* this thread is one of the workers */
+	for (started = 1; started < threads; started++)
+		if (pthread_create(&tid[started], NULL, tileWorker, &job))
+			break;
+
+	tileWorker(&job);
+
+	for (i = 1; i < started; i++)
+		pthread_join(tid[i], NULL);
+
+	pthread_mutex_destroy(&job.lock);
+}
+
+/* Level 0: gradients of the height (the red channel, after the alpha) */
+
+typedef struct bumpLevel {
+	const image_t *img;
+	unsigned char *out;     /* twiddled texels of this level */
+	float *normals;         /* unit normals of this level, or NULL */
+	const float *above;     /* normals of the level above, for mipmaps */
+	int w, h;
+} bumpLevel;
+
+static void bumpTile(void *arg, int x0, int y0, int tw, int th)
+{
+	const bumpLevel *lv = arg;
+	const image_t *img = lv->img;
+	int min = MIN(lv->w, lv->h), mask = min - 1;
+	int dx[TILE], dy[TILE], idx[TILE];
+	int x, y, i;
+
+	for (y = y0; y < y0 + th; y++) {
+		const unsigned char *cur = img->data + y * img->stride + x0 * 4 + 1;
+		const unsigned char *up = cur - img->stride;
+
+		/* the top row and left column have no gradient */
+		if (y == 0) {
+			for (i = 0; i < tw; i++)
+				dx[i] = dy[i] = 0;
+		}
+		else {
+			for (i = 0; i < tw; i++) {
+				dy[i] = up[i * 4] - cur[i * 4];
+				dx[i] = cur[i * 4 - 4] - cur[i * 4];
+			}
+
+			if (x0 == 0)
+				dx[0] = dy[0] = 0;
+		}
+
+		for (i = 0; i < tw; i++)
+			idx[i] = (dy[i] + 255) * DIFFS + dx[i] + 255;
+
+		for (i = 0; i < tw; i++) {
+			unsigned char *t;
+
+			x = x0 + i;
+			t = lv->out + 2 * (TWIDOUT(x & mask, y & mask) +
+				(x / min + y / min) * min * min);
+			t[0] = polarTable[idx[i]][0];
+			t[1] = polarTable[idx[i]][1];
+
+			if (lv->normals)
+				memcpy(lv->normals + 3 * (y * lv->w + x),
+				       normalTable[t[1] << 8 | t[0]], 3 * sizeof(float));
+		}
+	}
+}
+/* Mipmap levels: each normal is the renormalized sum of the four below it */
+static void mipTile(void *arg, int x0, int y0, int tw, int th)
+{
+	const bumpLevel *lv = arg;
+	int x, y, aw = lv->w * 2;
+
+	for (y = y0; y < y0 + th; y++) {
+		for (x = x0; x < x0 + tw; x++) {
+			const float *a = lv->above + 3 * (2 * y * aw + 2 * x);
+			const float *b = a + 3 * aw;
+			float *n = lv->normals + 3 * (y * lv->w + x);
+			float len;
+
+			n[0] = a[0] + a[3] + b[0] + b[3];
+			n[1] = a[1] + a[4] + b[1] + b[4];
+			n[2] = a[2] + a[5] + b[2] + b[5];
+			len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+			/* normals that cancel out are taken as flat */
+			if (len < 1e-6f) {
+				n[0] = n[1] = 0;
+				n[2] = 1;
+			}
+			else {
+				n[0] /= len;
+				n[1] /= len;
+				n[2] /= len;
+			}
+
+			texelOf(n, lv->out + 2 * TWIDOUT(x, y));
+		}
+	}
+}
+
+/* Make the bump map of img in a new buffer of *size bytes. */
+static unsigned char *makeBumpMap(const image_t *img, int threads, int *size)
+{
+	unsigned char *out;
+	float *normals = 0, *above;
+	bumpLevel lv;
+	int levels = log2i(img->w);
+
+	*size = useMipmap ? MIP_OFFSET(levels + 1) : 2 * img->w * img->h;
+	out = calloc(1, *size);
+	if (!out)
+		return 0;
+
+	/* room for the normals of all the levels, a third more than the first */
+	if (useMipmap) {
+		normals = malloc(3 * sizeof(float) * ((4 * img->w * img->h + 2) / 3));
+		if (!normals) {
+			free(out);
+			return 0;
+		}
+	}
+
+	lv.img = img;
+	lv.out = out + (useMipmap ? MIP_OFFSET(levels) : 0);
+	lv.normals = normals;
+	lv.above = 0;
+	lv.w = img->w;
+	lv.h = img->h;
+	runTiles(bumpTile, &lv, lv.w, lv.h, threads);
+
+	/* each level's normals go right after the ones they're made from */
+	while (useMipmap && levels-- > 0) {
+		above = lv.normals;
+		lv.above = above;
+		lv.normals = above + 3 * lv.w * lv.h;
+		lv.w /= 2;
+		lv.h /= 2;
+		lv.out = out + MIP_OFFSET(levels);
+		runTiles(mipTile, &lv, lv.w, lv.h, threads);
+	}
+
+	free(normals);
+	return out;
+}
+
+static int convert(const char *infile, const char *outfile, int threads)
+{
 	int ret = 0;
-	int y, x;
-	int imgpos, dest;
+	int size;
 	image_t img = {0};
 	FILE *fp = 0;
 	unsigned char *buffer = 0;
-	short * twidbuffer    = 0;
 
-	if (argc != 3) {
-		printUsage();
-		return 0;
+	if (get_image(infile, &img) < 0) {
+		ERROR("Cannot open %s\n", infile);
 	}
 
-	if (get_image(argv[1], &img) < 0) {
-		ERROR("Cannot open %s\n", argv[1]);
+	if(!isPowerOfTwo(img.w) || !isPowerOfTwo(img.h) || img.w > 1024 ||
+	   img.h > 1024) {
+		ERROR("Image dimensions %ux%u are not a power of two up to 1024!\n",
+		      img.w, img.h);
 	}
 
-	fp = fopen(argv[2], "wb");
-	if(!fp) {
-		ERROR("Cannot open file %s!\n", argv[2]);
+	if (useMipmap && img.w != img.h) {
+		ERROR("Mipmapped bump maps must be square!\n");
 	}
 
-	buffer = malloc(2 * img.w * img.h);
+	buffer = makeBumpMap(&img, threads, &size);
 	if(!buffer) {
 		ERROR("Cannot allocate memory for image data!\n");
 	}
 
-	twidbuffer = malloc(2 * img.w * img.h);
-	if(!buffer) {
-		ERROR("Cannot allocate memory for twiddle buffer!\n");
+	fp = fopen(outfile, "wb");
+	if(!fp) {
+		ERROR("Cannot open file %s!\n", outfile);
 	}
 
-	if(!isPowerOfTwo(img.w) || !isPowerOfTwo(img.h)) {
-		ERROR("Image dimensions %ux%u are not a power of two!\n", img.w, img.h);
+	if(fwrite(buffer, size, 1, fp) != 1) {
+		ERROR("Cannot write twiddle buffer!\n");
 	}
 
-	imgpos = 1; /* 1 to skip the alpha-channel */
-	dest = 0;
-	for (y = 0; y < img.h; y++) {
-		for (x = 0; x < img.w; x++, imgpos += 4) {
-			double diffy = 0;
-			double diffx = 0;
-			if (y > 0 && x > 0) {
-				diffy = (img.data[imgpos - img.stride] - img.data[imgpos]) / 255.0;
-				diffx = (img.data[imgpos - 4] - img.data[imgpos]) / 255.0;
-			}
+cleanup:
+	if(fp && fclose(fp) && !ret) {
+		fprintf(stderr, "Cannot write twiddle buffer!\n");
+		ret = 1;
+	}
+	if(buffer) free(buffer);
+	if(img.data) free(img.data);
+
+	return ret ? -1 : 0;
+}
+
+/* Batch mode: the images are spread over the threads instead of the tiles */
+
+static const char *outputName(const char *infile)
+{
+	const char *ext = strrchr(infile, '.');
+	int len = ext && !strchr(ext, '/') ? ext - infile : strlen(infile);
+	char *out = malloc(len + 5);
+
+	if (out)
+		sprintf(out, "%.*s.raw", len, infile);
+
+	return out;
+}
+
+static int convertOne(const char *infile)
+{
+	const char *outfile = outputName(infile);
+	int ret;
+
+	if (!outfile)
+		return -1;
+
+	ret = convert(infile, outfile, 1);
+	free((void *)outfile);
+	return ret;
+}
 
-			/* Rotation = R
-			   0 -> almost 360 degrees */
-			double rot = atan2(diffy, diffx);
-			int rotation = (int) ((rot / (2 * 3.1415927)) * 255);
+static int convertBatch(void)
+{
+	batch_tool_t tool;
+	char options[16];
 
-			/* Elevation = S
-			   0 -> almost 90 degrees */
-			int elevation = (int) (255 * (1 - fabs(diffx) - fabs(diffy)));
-			if (elevation < 0) elevation = 0;
+	snprintf(options, sizeof(options), "m%d", useMipmap);
 
-			buffer[dest] = rotation; dest++;
-			buffer[dest] = elevation; dest++;
+	tool.name = "dcbumpgen";
+	tool.revision = DCBUMPGEN_REVISION;
+	tool.options = options;
+	tool.encode = convertOne;
+	tool.output_name = outputName;
+
+	return batch_run(&tool, batchList, batchCache, useJobs) == 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+	int arg;
+	char *end;
+
+	for (arg = 1; arg < argc && argv[arg][0] == '-'; arg++) {
+		if (!strcmp(argv[arg], "-m") || !strcmp(argv[arg], "--mipmap")) {
+			useMipmap = 1;
+			continue;
+		}
+
+		if (arg + 1 >= argc) {
+			printUsage();
+			return 1;
 		}
-	}
 
-	/* twiddle code based on code from kmgenc.c */
-	int min = MIN(img.w, img.h);
-	int mask = min-1;
-	short *sbuffer = (short*) buffer;
-	for (y=0; y<img.h; y++) {
-		int yout = y;
-		for (x=0; x<img.w; x++) {
-			twidbuffer[TWIDOUT(x&mask, yout&mask) +
-				(x/min + yout/min)*min*min] = sbuffer[y*img.w+x];
+		if (!strcmp(argv[arg], "-j") || !strcmp(argv[arg], "--jobs")) {
+			useJobs = strtol(argv[++arg], &end, 10);
+			if (*end || useJobs < 1) {
+				fprintf(stderr, "%s requires a positive number\n", argv[arg - 1]);
+				return 1;
+			}
+		}
+		else if (!strcmp(argv[arg], "--batch"))
+			batchList = argv[++arg];
+		else if (!strcmp(argv[arg], "--cache"))
+			batchCache = argv[++arg];
+		else {
+			printUsage();
+			return 1;
 		}
 	}
 
-	if(fwrite(twidbuffer, 2* img.w * img.h, 1, fp) != 1) {
-		ERROR("Cannot write twiddle buffer!\n");
+	if (!useJobs)
+		useJobs = MAX(1, (int) sysconf(_SC_NPROCESSORS_ONLN));
+
+	if (batchList ? arg != argc : (batchCache || argc - arg != 2)) {
+		printUsage();
+		return 0;
 	}
 
-cleanup:
-	if(fp) fclose(fp);
-	if(buffer) free(buffer);
-	if(twidbuffer) free(twidbuffer);
-	if(img.data) free(img.data);
+	if (buildTables() < 0) {
+		fprintf(stderr, "Cannot allocate memory for tables!\n");
+		return 1;
+	}
 
-	return ret;
-}
+	if (batchList)
+		return convertBatch();
 
+	return convert(argv[arg], argv[arg + 1], useJobs) ? 1 : 0;
+}
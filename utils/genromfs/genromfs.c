@@ -20,6 +20,8 @@
  *                      (Florian Schulze, Brian Peek)
  *     13 Aug 2020              Mingw build fixes
  *                      (Hayden Kowalchuk)
+ *     16 Oct 2026              Sorted entries, merging of identical
+ *                              files, directory indexes
  */
 
 /*
@@ -56,6 +58,12 @@
  * -A N,/name force named file(s) (shell globbing applied against the filenames)
  *       to be aligned on N bytes boundary
  * In both cases, N must be a power of two.
+ * -i    write a hash index into every directory (see dumpindex())
+ * -D    don't merge files with identical contents
+ *
+ * Directory entries are always written sorted by name, so the same tree
+ * always gives the same image.  Files whose contents are the same as a file
+ * written earlier become hard links to it, unless -D is given.
  */
 
 /*
@@ -68,6 +76,7 @@
 #endif
 
 #include <stdio.h>  /* Userland pieces of the ANSI C standard I/O package  */
+#include <ctype.h>
 #include <stdlib.h> /* Userland prototypes of the ANSI C std lib functions */
 #include <stdint.h>
 #include <string.h> /* Userland prototypes of the string handling funcs    */
@@ -138,6 +147,8 @@ struct filenode {
     unsigned int offset;
     unsigned int size;
     unsigned int pad;
+    unsigned int isindex;   /* this "." entry carries its directory's index */
+    uint64_t hash;          /* contents hash of regular files */
 };
 
 struct aligns {
@@ -201,6 +212,12 @@ static int align = 16;
 struct aligns *alignlist = NULL;
 struct excludes *excludelist = NULL;
 int realbase;
+static int makeindex = 0;
+static int mergefiles = 1;
+
+/* regular files written so far, to find identical ones */
+static struct filenode **regfiles = NULL;
+static int nregfiles = 0;
 
 /* helper function to match an exclusion or align pattern */
 
@@ -328,6 +345,99 @@ void dumpri(struct romfh *ri, struct filenode *n, FILE *f) {
 #endif
 }
 
+/* Directory index
+ *
+ * With -i, the "." entry of every directory carries a hash table of all
+ * the directory's entries, itself included, as its data, so a reader can find a name without
+ * walking the whole directory.  Everything is big endian, like the rest of
+ * romfs:
+ *
+ *   0   magic "KIDX"
+ *   4   number of buckets (a power of two)
+ *   8   number of entries
+ *  12   zero
+ *  16   bucket start table, buckets + 1 longwords; the entries of bucket b
+ *       are entries start[b] to start[b + 1] - 1
+ *  xx   entries, two longwords each: the name hash and the offset of the
+ *       entry's file header
+ *
+ * The hash is 32-bit FNV-1a over the name folded to lower case, since
+ * lookups in KOS ignore case.
+ */
+
+#define INDEX_MAGIC 0x4b494458
+
+static unsigned int namehash(const char *name) {
+    uint32_t h = 0x811c9dc5;
+
+    while(*name) {
+        h ^= (unsigned char)tolower((unsigned char)*name++);
+        h *= 0x01000193;
+    }
+
+    return h;
+}
+
+static int indexbuckets(int entries) {
+    int buckets = 1;
+
+    while(buckets < entries)
+        buckets <<= 1;
+
+    return buckets;
+}
+
+static int indexsize(int entries) {
+    return 16 + 4 * (indexbuckets(entries) + 1) + 8 * entries;
+}
+
+int dumpindex(struct filenode *node, FILE *f) {
+    struct filenode *p;
+    uint32_t *buf, *start, *ent;
+    int n, b, buckets, *fill;
+
+    for(n = 0, p = node; p->next; p = p->next)
+        n++;
+
+    buckets = indexbuckets(n);
+    buf = calloc(1, indexsize(n));
+    fill = calloc(buckets + 1, sizeof(int));
+
+    if(!buf || !fill) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    start = buf + 4;
+    ent = start + buckets + 1;
+
+    /* counting sort of the entries by bucket */
+    for(p = node; p->next; p = p->next)
+        fill[(namehash(p->name) & (buckets - 1)) + 1]++;
+
+    for(b = 0; b < buckets; b++)
+        fill[b + 1] += fill[b];
+
+    for(b = 0; b <= buckets; b++)
+        start[b] = htonl(fill[b]);
+
+    for(p = node; p->next; p = p->next) {
+        b = namehash(p->name) & (buckets - 1);
+        ent[fill[b] * 2] = htonl(namehash(p->name));
+        ent[fill[b] * 2 + 1] = htonl(p->offset);
+        fill[b]++;
+    }
+
+    buf[0] = htonl(INDEX_MAGIC);
+    buf[1] = htonl(buckets);
+    buf[2] = htonl(n);
+    dumpdataa(buf, indexsize(n), f);
+
+    free(buf);
+    free(fill);
+    return 0;
+}
+
 int dumpnode(struct filenode *node, FILE *f) {
     struct romfh ri;
     struct filenode *p;
@@ -435,6 +545,9 @@ int dumpnode(struct filenode *node, FILE *f) {
     }
 #endif
 
+    if(node->isindex)
+        dumpindex(node, f);
+
     p = node->dirlist.head;
 
     while(p->next) {
@@ -542,6 +655,8 @@ struct filenode *newnode(const char *base, const char *name, int curroffset) {
     node->orig_link = NULL;
     node->offset = curroffset;
     node->pad = 0;
+    node->isindex = 0;
+    node->hash = 0;
 
     return node;
 }
@@ -592,41 +707,149 @@ int alignnode(struct filenode *node, int curroffset, int extraspace) {
     return curroffset;
 }
 
-int processdir(int level, const char *base, const char *dirname, struct stat *sb,
-               struct filenode *dir, struct filenode *root, int curroffset) {
-    DIR *dirfd;
-    struct dirent *dp;
-    struct filenode *n, *link;
-    struct excludes *pe;
+/* Merging of identical files */
 
-    if(level <= 1) {
-        /* Ok, to make sure . and .. are handled correctly
-         * we add them first.  Note also that we alloc them
-         * first to get to know the real name
-         */
-        link = newnode(base, ".", curroffset);
+static uint64_t filehash(struct filenode *node) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    int fd, len, i;
 
-        if(!lstat(link->realname, sb)) {
-            setnode(link, sb->st_dev, sb->st_ino, sb->st_mode);
-            append(&dir->dirlist, link);
+    fd = open(node->realname, O_RDONLY
+#ifdef O_BINARY
+              | O_BINARY
+#endif
+             );
 
-            /* special case for root node - '..'s in subdirs should link to
-             *   '.' of root node, not root node itself.
-             */
-            dir->dirlist.owner = link;
+    if(fd < 0)
+        return h;
 
-            curroffset = alignnode(link, curroffset, 0) + spaceneeded(link);
-            n = newnode(base, "..", curroffset);
+    while((len = read(fd, bigbuf, sizeof(bigbuf))) > 0) {
+        for(i = 0; i < len; i++) {
+            h ^= (unsigned char)bigbuf[i];
+            h *= 0x100000001b3ULL;
+        }
+    }
 
-            if(!lstat(n->realname, sb)) {
-                setnode(n, sb->st_dev, sb->st_ino, sb->st_mode);
-                append(&dir->dirlist, n);
-                n->orig_link = link;
-                curroffset = alignnode(n, curroffset, 0) + spaceneeded(n);
-            }
+    close(fd);
+    return h;
+}
+
+static int samecontents(struct filenode *a, struct filenode *b) {
+    static char other[4096];
+    int fa, fb, len, same = 0;
+
+    fa = open(a->realname, O_RDONLY
+#ifdef O_BINARY
+              | O_BINARY
+#endif
+             );
+    fb = open(b->realname, O_RDONLY
+#ifdef O_BINARY
+              | O_BINARY
+#endif
+             );
+
+    if(fa >= 0 && fb >= 0) {
+        do {
+            len = read(fa, bigbuf, sizeof(bigbuf));
+
+            if(len < 0 || read(fb, other, sizeof(other)) != len ||
+                    memcmp(bigbuf, other, len))
+                break;
+        } while(len);
+
+        same = !len;
+    }
+
+    if(fa >= 0)
+        close(fa);
+
+    if(fb >= 0)
+        close(fb);
+
+    return same;
+}
+
+/* Find an earlier regular file with the same contents as node, which must
+   not need a stricter alignment or have different execute permissions */
+struct filenode *findsame(struct filenode *node) {
+    struct filenode *p;
+    int i;
+
+    node->hash = filehash(node);
+
+    for(i = 0; i < nregfiles; i++) {
+        p = regfiles[i];
+
+        if(p->size == node->size && p->hash == node->hash &&
+                !(p->modes & 0111) == !(node->modes & 0111) &&
+                findalign(node) <= findalign(p) && samecontents(p, node))
+            return p;
+    }
+
+    return NULL;
+}
+
+void addregfile(struct filenode *node) {
+    if(!(nregfiles & 255)) {
+        regfiles = realloc(regfiles, (nregfiles + 256) * sizeof(*regfiles));
+
+        if(!regfiles) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
         }
     }
 
+    regfiles[nregfiles++] = node;
+}
+
+/* A directory entry read by processdir() that has not been placed yet */
+struct entry {
+    struct filenode *node;
+    struct stat sb;
+};
+
+/* "." and ".." first, then by name ignoring case, then exactly */
+static int entryrank(const char *name) {
+    if(!strcmp(name, "."))
+        return 0;
+
+    if(!strcmp(name, ".."))
+        return 1;
+
+    return 2;
+}
+
+static int compareentries(const void *a, const void *b) {
+    const char *na = ((const struct entry *)a)->node->name;
+    const char *nb = ((const struct entry *)b)->node->name;
+    const char *pa, *pb;
+    int d;
+
+    if((d = entryrank(na) - entryrank(nb)))
+        return d;
+
+    for(pa = na, pb = nb; *pa && tolower((unsigned char)*pa) ==
+            tolower((unsigned char)*pb); pa++, pb++)
+        ;
+
+    if((d = tolower((unsigned char)*pa) - tolower((unsigned char)*pb)))
+        return d;
+
+    return strcmp(na, nb);
+}
+
+int processdir(int level, const char *base, const char *dirname, struct stat *sb,
+               struct filenode *dir, struct filenode *root, int curroffset) {
+    DIR *dirfd;
+    struct dirent *dp;
+    struct filenode *n, *link;
+    struct excludes *pe;
+    struct entry *entries = NULL;
+    int count = 0, i;
+
+    /* Read the whole directory first, so the entries can be sorted and
+     * the size of the index known before anything gets an offset.
+     */
     dirfd = opendir(dir->realname);
 
     while((dp = readdir(dirfd))) {
@@ -721,10 +944,72 @@ int processdir(int level, const char *base, const char *dirname, struct stat *sb
         }
 #endif
 
+        if(!(count & 63)) {
+            entries = realloc(entries, (count + 64) * sizeof(*entries));
+
+            if(!entries) {
+                fprintf(stderr, "out of memory\n");
+                exit(1);
+            }
+        }
+
+        entries[count].node = n;
+        entries[count].sb = *sb;
+        count++;
+    }
+
+    closedir(dirfd);
+
+    if(count)
+        qsort(entries, count, sizeof(*entries), compareentries);
+
+    if(level <= 1) {
+        /* Ok, to make sure . and .. are handled correctly
+         * we add them first.  Note also that we alloc them
+         * first to get to know the real name
+         */
+        link = newnode(base, ".", curroffset);
+
+        if(!lstat(link->realname, sb)) {
+            setnode(link, sb->st_dev, sb->st_ino, sb->st_mode);
+            append(&dir->dirlist, link);
+
+            /* special case for root node - '..'s in subdirs should link to
+             *   '.' of root node, not root node itself.
+             */
+            dir->dirlist.owner = link;
+
+            if(makeindex) {
+                link->isindex = 1;
+                link->size = indexsize(count + 2);
+            }
+
+            curroffset = alignnode(link, curroffset, 0) + spaceneeded(link);
+            n = newnode(base, "..", curroffset);
+
+            if(!lstat(n->realname, sb)) {
+                setnode(n, sb->st_dev, sb->st_ino, sb->st_mode);
+                append(&dir->dirlist, n);
+                n->orig_link = link;
+                curroffset = alignnode(n, curroffset, 0) + spaceneeded(n);
+            }
+        }
+    }
+
+    for(i = 0; i < count; i++) {
+        n = entries[i].node;
+        *sb = entries[i].sb;
+        n->offset = curroffset;
+
         /* Look up old links */
         if(strcmp(n->name, ".") == 0) {
             append(&dir->dirlist, n);
             link = n->parent;
+
+            if(makeindex) {
+                n->isindex = 1;
+                n->size = indexsize(count - i);
+            }
         }
         else if(strcmp(n->name, "..") == 0) {
             append(&dir->dirlist, n);
@@ -735,8 +1020,19 @@ int processdir(int level, const char *base, const char *dirname, struct stat *sb
             append(&dir->dirlist, n);
         }
 
+        if(!link && S_ISREG(sb->st_mode) && mergefiles) {
+            n->size = sb->st_size;
+
+            if(!(link = findsame(n)))
+                n->size = 0;
+        }
+
         if(link) {
             n->orig_link = link;
+
+            if(!n->isindex)
+                n->size = 0;
+
             curroffset = alignnode(n, curroffset, 0) + spaceneeded(n);
             continue;
         }
@@ -744,6 +1040,7 @@ int processdir(int level, const char *base, const char *dirname, struct stat *sb
         if(S_ISREG(sb->st_mode)) {
             curroffset = alignnode(n, curroffset, spaceneeded(n));
             n->size = sb->st_size;
+            addregfile(n);
         }
         else
             curroffset = alignnode(n, curroffset, 0);
@@ -762,11 +1059,11 @@ int processdir(int level, const char *base, const char *dirname, struct stat *sb
 
         if(S_ISDIR(sb->st_mode)) {
             if(!strcmp(n->name, "..")) {
-                curroffset = processdir(level + 1, dir->realname, dp->d_name,
+                curroffset = processdir(level + 1, dir->realname, n->name,
                                         sb, dir, root, curroffset);
             }
             else {
-                curroffset = processdir(level + 1, n->realname, dp->d_name,
+                curroffset = processdir(level + 1, n->realname, n->name,
                                         sb, n, root, curroffset);
             }
 
@@ -775,7 +1072,7 @@ int processdir(int level, const char *base, const char *dirname, struct stat *sb
         }
     }
 
-    closedir(dirfd);
+    free(entries);
     return curroffset;
 }
 
@@ -791,6 +1088,8 @@ void showhelp(const char *argv0) {
     printf("  -a ALIGN               Align regular file data to ALIGN bytes\n");
     printf("  -A ALIGN,PATTERN       Align all objects matching pattern to at least ALIGN bytes\n");
     printf("  -x PATTERN             Exclude all objects matching pattern\n");
+    printf("  -i                     Add a name index to every directory\n");
+    printf("  -D                     Don't merge files with identical contents\n");
     printf("  -h                     Show this help\n");
     printf("\n");
     printf("Report bugs to chexum@shadow.banki.hu\n");
@@ -812,7 +1111,7 @@ int main(int argc, char *argv[]) {
     struct excludes *pe, *pe2;
     FILE *f;
 
-    while((c = getopt(argc, argv, "V:vd:f:ha:A:x:")) != EOF) {
+    while((c = getopt(argc, argv, "V:vd:f:ha:A:x:iD")) != EOF) {
         switch(c) {
             case 'd':
                 dir = optarg;
@@ -881,6 +1180,12 @@ int main(int argc, char *argv[]) {
                     pe2->next = pe;
                 }
 
+                break;
+            case 'i':
+                makeindex = 1;
+                break;
+            case 'D':
+                mergefiles = 0;
                 break;
             default:
                 exit(1);
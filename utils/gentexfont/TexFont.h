@@ -29,6 +29,33 @@ typedef struct {
     short y;
 } TexGlyphInfo;
 
+/* Glyph table written by gentexfont -table, for building quads straight
+   from it: a header, then num_glyphs TexGlyphQuads sorted by character.
+   Both are in the byte order of the machine that wrote them, which the
+   endianness field (0x12345678) shows, like in a TXF file. */
+typedef struct {
+    char magic[4];              /* "\377tgt" */
+    int endianness;
+    unsigned short tex_width;
+    unsigned short tex_height;
+    unsigned short num_glyphs;
+    unsigned short size;        /* Pixel size the metrics are for */
+    short max_ascent;
+    short max_descent;
+    unsigned short sdf_spread;  /* Distance field range in texels, 0 if none */
+    unsigned short pad;
+} TexGlyphTableHeader;
+
+typedef struct {
+    unsigned int c;
+    short x0, y0;               /* Bottom left corner, from the pen, y up */
+    short x1, y1;               /* Top right corner */
+    short advance;
+    short pad;
+    float u0, v0;               /* Texture coordinates of (x0, y0) */
+    float u1, v1;               /* and of (x1, y1) */
+} TexGlyphQuad;
+
 typedef struct {
     GLfloat t0[2];
     GLshort v0[2];
@@ -1,4 +1,3 @@
-
 /* Copyright (c) Mark J. Kilgard, 1997. */
 
 /* This program is freely distributable without licensing fees  and is
@@ -7,15 +6,27 @@
 
 /* X compile line: cc -o gentexfont gentexfont.c -lX11 */
 
+/* Altered by the KallistiOS team: glyphs can also be rasterized with
+   FreeType from any font file it reads (TrueType, OpenType, BDF, PCF...),
+   which needs no X server, and optionally turned into a signed distance
+   field. Glyphs are packed with a skyline packer instead of row by row, and
+   a glyph table for building quads directly can be written alongside the
+   TXF file. Build with NO_X11 defined to leave the X server code out. */
+
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#ifndef NO_X11
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
+#endif
 #include <math.h>
 
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
 #include "TexFont.h"
 
 typedef struct {
@@ -32,10 +43,13 @@ typedef struct {
     int max_char;
     int max_ascent;
     int max_descent;
+    int depth;              /* 1: bitmaps are bit spans, 8: bytes */
     PerGlyphInfo glyph[1];
 } FontInfo, *FontInfoPtr;
 
+#ifndef NO_X11
 Display *dpy;
+#endif
 FontInfoPtr fontinfo;
 int format = TXF_FORMAT_BITMAP;
 int gap = 1;
@@ -52,6 +66,7 @@ int gap = 1;
 #define MAX_GLYPHS_PER_GRAB 512  /* this is big enough for 2^9 glyph
 character sets */
 
+#ifndef NO_X11
 static FontInfoPtr SuckGlyphsFromServer(Display * dpy, Font font) {
     Pixmap offscreen;
     XFontStruct *fontinfo;
@@ -93,6 +108,7 @@ static FontInfoPtr SuckGlyphsFromServer(Display * dpy, Font font) {
     myfontinfo->max_char = fontinfo->max_char_or_byte2;
     myfontinfo->max_ascent = fontinfo->max_bounds.ascent;
     myfontinfo->max_descent = fontinfo->max_bounds.descent;
+    myfontinfo->depth = 1;
 
     width = fontinfo->max_bounds.rbearing - fontinfo->min_bounds.lbearing;
     height = fontinfo->max_bounds.ascent + fontinfo->max_bounds.descent;
@@ -247,6 +263,274 @@ FreeFontAndReturn:
     return NULL;
 }
 
+#endif /* NO_X11 */
+
+/* Signed distance fields. A glyph is rasterized "upscale" times larger
+   than it will end up, the exact Euclidean distance from every pixel to the
+   nearest pixel of the other colour is worked out (Felzenszwalb and
+   Huttenlocher's linear time transform, once down the columns and once
+   along the rows), and the distance is then sampled at the middle of each
+   output texel. 128 is the outline, and the value changes by 128 over
+   "spread" texels either side of it. */
+
+#define EDT_INF 1e20f
+
+static void edt1d(const float *f, int n, float *d, int *v, float *z) {
+    int q, k = 0;
+    float s;
+
+    v[0] = 0;
+    z[0] = -EDT_INF;
+    z[1] = EDT_INF;
+
+    for(q = 1; q < n; q++) {
+        s = ((f[q] + (float)q * q) - (f[v[k]] + (float)v[k] * v[k])) /
+            (2 * q - 2 * v[k]);
+
+        /* z[0] is far enough out that this always stops at k = 0 */
+        while(s <= z[k]) {
+            k--;
+            s = ((f[q] + (float)q * q) - (f[v[k]] + (float)v[k] * v[k])) /
+                (2 * q - 2 * v[k]);
+        }
+
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = EDT_INF;
+    }
+
+    for(q = 0, k = 0; q < n; q++) {
+        while(z[k + 1] < q)
+            k++;
+
+        d[q] = (float)(q - v[k]) * (q - v[k]) + f[v[k]];
+    }
+}
+
+/* Squared distance transform of grid, in place */
+static void edt2d(float *grid, int w, int h) {
+    int n = w > h ? w : h;
+    float *f = calloc(n, sizeof(float));
+    float *d = malloc(n * sizeof(float));
+    float *z = malloc((n + 1) * sizeof(float));
+    int *v = malloc(n * sizeof(int));
+    int x, y;
+
+    for(x = 0; x < w; x++) {
+        for(y = 0; y < h; y++)
+            f[y] = grid[y * w + x];
+
+        edt1d(f, h, d, v, z);
+
+        for(y = 0; y < h; y++)
+            grid[y * w + x] = d[y];
+    }
+
+    for(y = 0; y < h; y++) {
+        edt1d(grid + y * w, w, d, v, z);
+        memcpy(grid + y * w, d, w * sizeof(float));
+    }
+
+    free(f);
+    free(d);
+    free(z);
+    free(v);
+}
+
+static int floorDiv(int a, int b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+/* Turn a coverage bitmap (rows top down, "left" and "top" placing it
+   against the pen position as FreeType does) into a distance field glyph
+   with "spread" texels of margin all round. */
+static void makeDistanceGlyph(PerGlyphInfoPtr glyph, const unsigned char *cover,
+                              int pitch, int w, int rows, int left, int top,
+                              int upscale, int spread) {
+    int lx0, lx1, ly0, ly1, W, H, hw, hh;
+    int x, y, bx, br, i;
+    float *in, *out, dist, range;
+    unsigned char *sdf;
+
+    /* Output texels covering the glyph, in output pixels with y up */
+    lx0 = floorDiv(left, upscale) - spread;
+    lx1 = -floorDiv(-(left + w), upscale) + spread;
+    ly0 = floorDiv(top - rows, upscale) - spread;
+    ly1 = -floorDiv(-top, upscale) + spread;
+    W = lx1 - lx0;
+    H = ly1 - ly0;
+    hw = W * upscale;
+    hh = H * upscale;
+
+    in = malloc(hw * hh * sizeof(float));
+    out = malloc(hw * hh * sizeof(float));
+
+    /* in: distance to the nearest pixel inside, out: to the nearest one
+       outside; the grid has y going up from the bottom edge */
+    for(y = 0; y < hh; y++) {
+        br = top - 1 - (y + ly0 * upscale);
+
+        for(x = 0; x < hw; x++) {
+            bx = x + lx0 * upscale - left;
+            i = y * hw + x;
+
+            if(br >= 0 && br < rows && bx >= 0 && bx < w &&
+                    cover[br * pitch + bx] >= 128) {
+                in[i] = 0;
+                out[i] = EDT_INF;
+            }
+            else {
+                in[i] = EDT_INF;
+                out[i] = 0;
+            }
+        }
+    }
+
+    edt2d(in, hw, hh);
+    edt2d(out, hw, hh);
+
+    sdf = malloc(W * H);
+    range = (float)(spread > 0 ? spread : 1) * upscale;
+
+    for(y = 0; y < H; y++) {
+        for(x = 0; x < W; x++) {
+            i = (y * upscale + upscale / 2) * hw + x * upscale + upscale / 2;
+
+            /* The outline runs half a pixel beyond the last pixel of
+               either colour */
+            dist = (in[i] > 0 ? sqrtf(in[i]) - 0.5f : 0) -
+                   (out[i] > 0 ? sqrtf(out[i]) - 0.5f : 0);
+            dist = 128.0f - dist / range * 128.0f;
+            sdf[y * W + x] = dist < 0 ? 0 : dist > 255 ? 255 : (int)(dist + 0.5f);
+        }
+    }
+
+    free(in);
+    free(out);
+
+    glyph->width = W;
+    glyph->height = H;
+    glyph->xoffset = lx0;
+    glyph->yoffset = ly0;
+    glyph->bitmap = sdf;
+}
+
+/* Load the glyphs in glist from a font file with FreeType. Scalable fonts
+   are rendered at "size" pixels; for bitmap fonts the strike closest to it
+   is used. With spread > 0, the glyphs become distance fields. */
+static FontInfoPtr LoadGlyphsFromFile(const char *fontfile, int size,
+                                      int spread, int upscale,
+                                      const unsigned char *glist) {
+    FT_Library library;
+    FT_Face face;
+    FT_Bitmap *bm;
+    FontInfoPtr myfontinfo;
+    PerGlyphInfoPtr glyph;
+    unsigned char *cover;
+    int minc = 255, maxc = 0, numchars;
+    int i, x, y, c, best;
+
+    for(i = 0; glist[i]; i++) {
+        if(glist[i] < minc) minc = glist[i];
+        if(glist[i] > maxc) maxc = glist[i];
+    }
+
+    if(maxc < minc)
+        return NULL;
+
+    if(FT_Init_FreeType(&library))
+        return NULL;
+
+    if(FT_New_Face(library, fontfile, 0, &face)) {
+        printf("could not load font file: %s\n", fontfile);
+        FT_Done_FreeType(library);
+        return NULL;
+    }
+
+    if(FT_IS_SCALABLE(face)) {
+        if(!spread)
+            upscale = 1;
+
+        FT_Set_Pixel_Sizes(face, 0, size * upscale);
+    }
+    else {
+        for(i = 1, best = 0; i < face->num_fixed_sizes; i++) {
+            if(abs(face->available_sizes[i].height - size) <
+                    abs(face->available_sizes[best].height - size))
+                best = i;
+        }
+
+        FT_Select_Size(face, best);
+        upscale = 1;
+    }
+
+    numchars = maxc - minc + 1;
+    myfontinfo = (FontInfoPtr) calloc(1, sizeof(FontInfo) + (numchars - 1) * sizeof(PerGlyphInfo));
+
+    if(!myfontinfo)
+        return NULL;
+
+    myfontinfo->min_char = minc;
+    myfontinfo->max_char = maxc;
+    myfontinfo->max_ascent = -floorDiv(-(int)(face->size->metrics.ascender >> 6), upscale);
+    myfontinfo->max_descent = -floorDiv((int)(face->size->metrics.descender >> 6), upscale);
+    myfontinfo->depth = 8;
+
+    for(i = 0; glist[i]; i++) {
+        c = glist[i];
+        glyph = &myfontinfo->glyph[c - minc];
+
+        if(FT_Load_Char(face, c, FT_LOAD_RENDER)) {
+            printf("no glyph for '%c', leaving it empty\n", c);
+            continue;
+        }
+
+        glyph->advance = (face->glyph->advance.x + 32 * upscale) / (64 * upscale);
+        bm = &face->glyph->bitmap;
+
+        if(!bm->width || !bm->rows)
+            continue;
+
+        /* One byte of coverage per pixel, whatever FreeType gave us */
+        cover = malloc(bm->width * bm->rows);
+
+        for(y = 0; y < (int)bm->rows; y++) {
+            for(x = 0; x < (int)bm->width; x++) {
+                if(bm->pixel_mode == FT_PIXEL_MODE_MONO)
+                    cover[y * bm->width + x] =
+                        bm->buffer[y * bm->pitch + x / 8] & (0x80 >> (x & 7)) ? 255 : 0;
+                else
+                    cover[y * bm->width + x] = bm->buffer[y * bm->pitch + x];
+            }
+        }
+
+        if(spread) {
+            makeDistanceGlyph(glyph, cover, bm->width, bm->width, bm->rows,
+                              face->glyph->bitmap_left, face->glyph->bitmap_top,
+                              upscale, spread);
+            free(cover);
+        }
+        else {
+            /* Keep the coverage, flipped to bottom up like the X glyphs */
+            glyph->width = bm->width;
+            glyph->height = bm->rows;
+            glyph->xoffset = face->glyph->bitmap_left;
+            glyph->yoffset = face->glyph->bitmap_top - (int)bm->rows;
+            glyph->bitmap = malloc(bm->width * bm->rows);
+
+            for(y = 0; y < (int)bm->rows; y++)
+                memcpy(glyph->bitmap + y * bm->width,
+                       cover + (bm->rows - 1 - y) * bm->width, bm->width);
+
+            free(cover);
+        }
+    }
+
+    FT_Done_Face(face);
+    FT_Done_FreeType(library);
+    return myfontinfo;
+}
 
 #if 0
 static void printGlyph(FontInfoPtr font, int c) {
@@ -328,7 +612,13 @@ static int glyphCompare(const void *a, const void *b) {
 
     getMetric(fontinfo, *c1, &tgi1);
     getMetric(fontinfo, *c2, &tgi2);
-    return tgi2.height - tgi1.height;
+
+    /* Tallest first, then widest, which is the order the skyline packer
+       does best with. */
+    if(tgi2.height != tgi1.height)
+        return tgi2.height - tgi1.height;
+
+    return tgi2.width - tgi1.width;
 }
 
 static int getFontel(unsigned char *bitmapData, int spanLength, int i, int j) {
@@ -356,8 +646,11 @@ static void placeGlyph(FontInfoPtr font, int c, unsigned char *texarea, int stri
 
         for(i = 0; i < height; i++) {
             for(j = 0; j < width; j++) {
-                texarea[stride * (y + i) + x + j] =
-                    getFontel(bitmapData, spanLength, i, j);
+                if(font->depth == 8)
+                    texarea[stride * (y + i) + x + j] = bitmapData[i * width + j];
+                else
+                    texarea[stride * (y + i) + x + j] =
+                        getFontel(bitmapData, spanLength, i, j);
             }
         }
     }
@@ -382,18 +675,211 @@ static char * nodupstring(char *s) {
     return new;
 }
 
+
+/* Skyline bottom-left packer. The skyline is the top edge of everything
+   placed so far, kept as a list of horizontal segments from left to right.
+   Each rectangle goes where its top edge ends up lowest, leftmost on a tie,
+   which keeps the free space in one piece above the skyline. */
+typedef struct {
+    int x, y, w;
+} SkylineNode;
+
+/* Where a w wide rectangle sitting on the skyline from node i would rest,
+   or -1 if it runs off the right edge */
+static int skylineFit(SkylineNode *sky, int nodes, int i, int w, int texw) {
+    int y = 0, left = w;
+
+    if(sky[i].x + w > texw)
+        return -1;
+
+    for(; left > 0 && i < nodes; i++) {
+        if(sky[i].y > y)
+            y = sky[i].y;
+
+        left -= sky[i].w;
+    }
+
+    return y;
+}
+
+/* Place n rectangles, in the order given, in a texw by texh area. Returns
+   0 if they all fit. */
+static int skylinePack(const int *ws, const int *hs, int n, int texw, int texh,
+                       int *xs, int *ys) {
+    SkylineNode *sky = malloc((n + 2) * sizeof(SkylineNode));
+    int nodes = 1, r, i, y, best, bestY, bestX, shrink;
+
+    sky[0].x = 0;
+    sky[0].y = 0;
+    sky[0].w = texw;
+
+    for(r = 0; r < n; r++) {
+        xs[r] = ys[r] = -1;
+
+        if(ws[r] <= 0 || hs[r] <= 0)
+            continue;
+
+        best = -1;
+        bestY = bestX = 0;
+
+        for(i = 0; i < nodes; i++) {
+            y = skylineFit(sky, nodes, i, ws[r], texw);
+
+            if(y < 0 || y + hs[r] > texh)
+                continue;
+
+            if(best < 0 || y + hs[r] < bestY || (y + hs[r] == bestY && sky[i].x < bestX)) {
+                best = i;
+                bestY = y + hs[r];
+                bestX = sky[i].x;
+            }
+        }
+
+        if(best < 0) {
+            free(sky);
+            return -1;
+        }
+
+        xs[r] = bestX;
+        ys[r] = bestY - hs[r];
+
+        /* New segment for the rectangle's top edge... */
+        memmove(sky + best + 1, sky + best, (nodes - best) * sizeof(SkylineNode));
+        sky[best].x = bestX;
+        sky[best].y = bestY;
+        sky[best].w = ws[r];
+        nodes++;
+
+        /* ...which hides whatever was under it */
+        for(i = best + 1; i < nodes; ) {
+            shrink = sky[best].x + sky[best].w - sky[i].x;
+
+            if(shrink <= 0)
+                break;
+
+            if(shrink < sky[i].w) {
+                sky[i].x += shrink;
+                sky[i].w -= shrink;
+                break;
+            }
+
+            memmove(sky + i, sky + i + 1, (nodes - i - 1) * sizeof(SkylineNode));
+            nodes--;
+        }
+
+        /* Merge neighbours at the same height */
+        for(i = 0; i < nodes - 1; ) {
+            if(sky[i].y == sky[i + 1].y) {
+                sky[i].w += sky[i + 1].w;
+                memmove(sky + i + 1, sky + i + 2, (nodes - i - 2) * sizeof(SkylineNode));
+                nodes--;
+            }
+            else {
+                i++;
+            }
+        }
+    }
+
+    free(sky);
+    return 0;
+}
+
+/* Pack the glyphs with "gap" texels between them and round the edges */
+static int packGlyphs(TexGlyphInfo *tgi, int len, int texw, int texh) {
+    int *ws = malloc(len * 4 * sizeof(int));
+    int *hs = ws + len, *xs = ws + 2 * len, *ys = ws + 3 * len;
+    int i, rv;
+
+    for(i = 0; i < len; i++) {
+        ws[i] = tgi[i].width ? tgi[i].width + gap : 0;
+        hs[i] = tgi[i].height ? tgi[i].height + gap : 0;
+    }
+
+    rv = skylinePack(ws, hs, len, texw - gap, texh - gap, xs, ys);
+
+    for(i = 0; i < len; i++) {
+        tgi[i].x = xs[i] < 0 ? -1 : xs[i] + gap;
+        tgi[i].y = ys[i] < 0 ? -1 : ys[i] + gap;
+    }
+
+    free(ws);
+    return rv;
+}
+
+static int quadCompare(const void *a, const void *b) {
+    const TexGlyphQuad *q1 = (const TexGlyphQuad *) a;
+    const TexGlyphQuad *q2 = (const TexGlyphQuad *) b;
+
+    return (int)q1->c - (int)q2->c;
+}
+
+/* Write the glyph table: for each glyph, the corners of its quad relative
+   to the pen position on the baseline (y up) and the texture coordinates
+   that go with them, sorted by character code. */
+static void writeGlyphTable(const char *filename, TexGlyphInfo *tgi, int len,
+                            int texw, int texh, int size, int spread) {
+    TexGlyphTableHeader hdr;
+    TexGlyphQuad *quads;
+    FILE *file;
+    int i;
+
+    assert(sizeof(hdr) == 24 && sizeof(TexGlyphQuad) == 32);  /* Ensure external file format size. */
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, "\377tgt", 4);
+    hdr.endianness = 0x12345678;
+    hdr.tex_width = texw;
+    hdr.tex_height = texh;
+    hdr.num_glyphs = len;
+    hdr.size = size;
+    hdr.max_ascent = fontinfo->max_ascent;
+    hdr.max_descent = fontinfo->max_descent;
+    hdr.sdf_spread = spread;
+
+    quads = calloc(len, sizeof(TexGlyphQuad));
+
+    for(i = 0; i < len; i++) {
+        quads[i].c = tgi[i].c;
+        quads[i].advance = tgi[i].advance;
+
+        if(tgi[i].x < 0)
+            continue;
+
+        quads[i].x0 = tgi[i].xoffset;
+        quads[i].y0 = tgi[i].yoffset;
+        quads[i].x1 = tgi[i].xoffset + tgi[i].width;
+        quads[i].y1 = tgi[i].yoffset + tgi[i].height;
+        quads[i].u0 = (float)tgi[i].x / texw;
+        quads[i].v0 = (float)tgi[i].y / texh;
+        quads[i].u1 = (float)(tgi[i].x + tgi[i].width) / texw;
+        quads[i].v1 = (float)(tgi[i].y + tgi[i].height) / texh;
+    }
+
+    qsort(quads, len, sizeof(TexGlyphQuad), quadCompare);
+
+    file = fopen(filename, "wb");
+
+    if(!file) {
+        printf("could not open %s\n", filename);
+        exit(1);
+    }
+
+    fwrite(&hdr, sizeof(hdr), 1, file);
+    fwrite(quads, sizeof(TexGlyphQuad), len, file);
+    fclose(file);
+    free(quads);
+}
+
 int main(int argc, char *argv[]) {
     int texw, texh;
     unsigned char *texarea, *texbitmap;
     FILE *file;
     int len, stride;
     char *glist;
-    int width, height;
-    int px, py, maxheight;
-    TexGlyphInfo tgi;
+    TexGlyphInfo *tgi;
     int usageError = 0;
-    char *fontname, *filename;
-    XFontStruct *xfont;
+    char *fontname, *filename, *fontfile, *tablename;
+    int size, spread, upscale, fit;
     int endianness;
     int i, j;
 
@@ -401,6 +887,12 @@ int main(int argc, char *argv[]) {
     glist = " ABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890abcdefghijmklmnopqrstuvwxyz?.;,!*:\"/+@#$%^&()#-=\\|_<>";
     fontname = "-adobe-courier-bold-r-normal--46-*-100-100-m-*-iso8859-1";
     filename = "default.txf";
+    fontfile = NULL;
+    tablename = NULL;
+    size = 46;
+    spread = 0;
+    upscale = 8;
+    fit = 0;
 
     for(i = 1; i < argc; i++) {
         if(!strcmp(argv[i], "-w")) {
@@ -417,7 +909,6 @@ int main(int argc, char *argv[]) {
         }
         else if(!strcmp(argv[i], "-byte")) {
             format = TXF_FORMAT_BYTE;
-            break;
         }
         else if(!strcmp(argv[i], "-bitmap")) {
             format = TXF_FORMAT_BITMAP;
@@ -434,46 +925,94 @@ int main(int argc, char *argv[]) {
             i++;
             filename = argv[i];
         }
+        else if(!strcmp(argv[i], "-font")) {
+            i++;
+            fontfile = argv[i];
+        }
+        else if(!strcmp(argv[i], "-size")) {
+            i++;
+            size = atoi(argv[i]);
+        }
+        else if(!strcmp(argv[i], "-sdf")) {
+            i++;
+            spread = atoi(argv[i]);
+        }
+        else if(!strcmp(argv[i], "-upscale")) {
+            i++;
+            upscale = atoi(argv[i]);
+        }
+        else if(!strcmp(argv[i], "-fit")) {
+            fit = 1;
+        }
+        else if(!strcmp(argv[i], "-table")) {
+            i++;
+            tablename = argv[i];
+        }
         else {
             usageError = 1;
         }
     }
 
+    if(size < 1 || spread < 0 || upscale < 1 || (spread && !fontfile))
+        usageError = 1;
+
     if(usageError) {
         putchar('\n');
         printf("usage: texfontgen [options] txf-file\n");
         printf(" -w #          textureWidth (def=%d)\n", texw);
         printf(" -h #          textureHeight (def=%d)\n", texh);
+        printf(" -fit          use the smallest texture the glyphs fit in\n");
         printf(" -gap #        gap between glyphs (def=%d)\n", gap);
         printf(" -bitmap       use a bitmap encoding (default)\n");
         printf(" -byte         use a byte encoding (less compact)\n");
         printf(" -glist ABC    glyph list (def=%s)\n", glist);
         printf(" -fn name      X font name (def=%s)\n", fontname);
-        printf(" -file name    output file for textured font (def=%s)\n", fontname);
+        printf(" -font file    font file to rasterize with FreeType instead of X\n");
+        printf(" -size #       pixel size for -font (def=%d)\n", size);
+        printf(" -sdf #        make a distance field spreading # texels (needs -font)\n");
+        printf(" -upscale #    oversampling for -sdf (def=%d)\n", upscale);
+        printf(" -file name    output file for textured font (def=%s)\n", filename);
+        printf(" -table name   also write a glyph table for building quads\n");
         putchar('\n');
         exit(1);
     }
 
-    texarea = calloc(texw * texh, sizeof(unsigned char));
     glist = nodupstring((char *) glist);
 
-    dpy = XOpenDisplay(NULL);
+    if(fontfile) {
+        fontinfo = LoadGlyphsFromFile(fontfile, size, spread, upscale,
+                                      (unsigned char *) glist);
 
-    if(!dpy) {
-        printf("could not open display\n");
-        exit(1);
+        /* Distance fields are no use as bitmaps */
+        if(spread)
+            format = TXF_FORMAT_BYTE;
     }
+    else {
+#ifndef NO_X11
+        XFontStruct *xfont;
 
-    /* find an OpenGL-capable RGB visual with depth buffer */
-    xfont = XLoadQueryFont(dpy, fontname);
+        dpy = XOpenDisplay(NULL);
+
+        if(!dpy) {
+            printf("could not open display\n");
+            exit(1);
+        }
+
+        /* find an OpenGL-capable RGB visual with depth buffer */
+        xfont = XLoadQueryFont(dpy, fontname);
+
+        if(!xfont) {
+            printf("could not get load X font: %s\n", fontname);
+            exit(1);
+        }
 
-    if(!xfont) {
-        printf("could not get load X font: %s\n", fontname);
+        fontinfo = SuckGlyphsFromServer(dpy, xfont->fid);
+#else
+        printf("built without X11 support, use -font\n");
         exit(1);
+#endif
     }
 
-    fontinfo = SuckGlyphsFromServer(dpy, xfont->fid);
-
     if(!fontinfo) {
         printf("could not get font glyphs\n");
         exit(1);
@@ -482,102 +1021,78 @@ int main(int argc, char *argv[]) {
     len = strlen((char *) glist);
     qsort(glist, len, sizeof(unsigned char), glyphCompare);
 
-    file = fopen(filename, "wb");
-    fwrite("\377txf", 1, 4, file);
-    endianness = 0x12345678;
-    assert(sizeof(int) == 4);  /* Ensure external file format size. */
-    fwrite(&endianness, sizeof(int), 1, file);
-    fwrite(&format, sizeof(int), 1, file);
-    fwrite(&texw, sizeof(int), 1, file);
-    fwrite(&texh, sizeof(int), 1, file);
-    fwrite(&fontinfo->max_ascent, sizeof(int), 1, file);
-    fwrite(&fontinfo->max_descent, sizeof(int), 1, file);
-    fwrite(&len, sizeof(int), 1, file);
-
-    px = gap;
-    py = gap;
-    maxheight = 0;
+    tgi = calloc(len, sizeof(TexGlyphInfo));
 
     for(i = 0; i < len; i++) {
-        if(glist[i] != 0) {   /* If not already processed... */
+        PerGlyphInfoPtr glyph;
+        int c = (unsigned char) glist[i];
 
-            /* Try to find a character from the glist that will fit on the
-               remaining space on the current row. */
+        getMetric(fontinfo, c, &tgi[i]);
 
-            int foundWidthFit = 0;
-            int c = 0;
+        if(c >= fontinfo->min_char && c <= fontinfo->max_char) {
+            glyph = &fontinfo->glyph[c - fontinfo->min_char];
 
-            getMetric(fontinfo, glist[i], &tgi);
-            width = tgi.width;
-            height = tgi.height;
-
-            if(height > 0 && width > 0) {
-                for(j = i; j < len;) {
-                    if(height > 0 && width > 0) {
-                        if(px + width + gap < texw) {
-                            foundWidthFit = 1;
+            if(glyph->width > 255 || glyph->height > 255 ||
+                    glyph->xoffset < -128 || glyph->xoffset > 127 ||
+                    glyph->yoffset < -128 || glyph->yoffset > 127 ||
+                    glyph->advance > 127) {
+                printf("glyph '%c' is too big for a TXF file\n", c);
+                exit(1);
+            }
+        }
+    }
 
-                            if(j != i) {
-                                i--;  /* Step back so i loop increment leaves us at same character. */
-                            }
+    if(fit) {
+        /* Try sizes smallest first, squarer first for the same area */
+        int area, bestw = 0;
 
-                            break;
-                        }
-                    }
+        for(area = 64 * 64; area <= 1024 * 1024 && !bestw; area *= 2) {
+            for(texw = 1024; texw >= 8 && !bestw; texw /= 2) {
+                texh = area / texw;
 
-                    j++;
-                    getMetric(fontinfo, glist[j], &tgi);
-                    width = tgi.width;
-                    height = tgi.height;
-                }
+                if(texh < 8 || texh > 1024 || texh > texw * 2 || texw > texh * 2)
+                    continue;
 
-                /* If a fit was found, use that character; otherwise, advance a line
-                   in  the texture. */
-                if(foundWidthFit) {
-                    if(height > maxheight) {
-                        maxheight = height;
-                    }
-
-                    c = j;
-                }
-                else {
-                    getMetric(fontinfo, glist[i], &tgi);
-                    width = tgi.width;
-                    height = tgi.height;
-
-                    py += maxheight + gap;
-                    px = gap;
-                    maxheight = height;
+                if(!packGlyphs(tgi, len, texw, texh))
+                    bestw = texw;
+            }
+        }
 
-                    if(py + height + gap >= texh) {
-                        printf("Overflowed texture space.\n");
-                        exit(1);
-                    }
+        if(!bestw) {
+            printf("Overflowed texture space.\n");
+            exit(1);
+        }
 
-                    c = i;
-                }
+        texw = bestw;
+        printf("using a %dx%d texture\n", texw, texh);
+    }
+    else if(packGlyphs(tgi, len, texw, texh)) {
+        printf("Overflowed texture space.\n");
+        exit(1);
+    }
 
-                /* Place the glyph in the texture image. */
-                placeGlyph(fontinfo, glist[c], texarea, texw, px, py);
+    texarea = calloc(texw * texh, sizeof(unsigned char));
 
-                /* Assign glyph's texture coordinate. */
-                tgi.x = px;
-                tgi.y = py;
+    /* Place the glyphs in the texture image. */
+    for(i = 0; i < len; i++) {
+        if(tgi[i].x >= 0)
+            placeGlyph(fontinfo, tgi[i].c, texarea, texw, tgi[i].x, tgi[i].y);
+    }
 
-                /* Advance by glyph width, remaining in the current line. */
-                px += width + gap;
-            }
-            else {
-                /* No texture image; assign invalid bogus texture coordinates. */
-                tgi.x = -1;
-                tgi.y = -1;
-            }
+    file = fopen(filename, "wb");
+    fwrite("\377txf", 1, 4, file);
+    endianness = 0x12345678;
+    assert(sizeof(int) == 4);  /* Ensure external file format size. */
+    fwrite(&endianness, sizeof(int), 1, file);
+    fwrite(&format, sizeof(int), 1, file);
+    fwrite(&texw, sizeof(int), 1, file);
+    fwrite(&texh, sizeof(int), 1, file);
+    fwrite(&fontinfo->max_ascent, sizeof(int), 1, file);
+    fwrite(&fontinfo->max_descent, sizeof(int), 1, file);
+    fwrite(&len, sizeof(int), 1, file);
 
-            glist[c] = 0;     /* Mark processed; don't process again. */
-            assert(sizeof(tgi) == 12);  /* Ensure external file format size. */
-            fwrite(&tgi, sizeof(tgi), 1, file);
-        }
-    }
+    assert(sizeof(TexGlyphInfo) == 12);  /* Ensure external file format size. */
+    fwrite(tgi, sizeof(TexGlyphInfo), len, file);
 
     switch(format) {
         case TXF_FORMAT_BYTE:
@@ -603,6 +1118,14 @@ int main(int argc, char *argv[]) {
             exit(1);
     }
 
-    free(texarea);
     fclose(file);
+
+    if(tablename)
+        writeGlyphTable(tablename, tgi, len, texw, texh,
+                        fontfile ? size : fontinfo->max_ascent + fontinfo->max_descent,
+                        spread);
+
+    free(tgi);
+    free(texarea);
+    return 0;
 }
@@ -0,0 +1,22 @@
+/* KallistiOS ##version##
+
+   arch/types.h
+   Host stand-in for the KOS header of the same name, so that isotest can
+   build kernel/arch/dreamcast/fs/fs_iso9660.c on a PC.
+*/
+
+#ifndef __ARCH_TYPES_H
+#define __ARCH_TYPES_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+typedef uint8_t uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+typedef int8_t int8;
+typedef int16_t int16;
+typedef int32_t int32;
+
+#endif  /* __ARCH_TYPES_H */
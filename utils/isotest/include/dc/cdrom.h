@@ -0,0 +1,32 @@
+/* KallistiOS ##version##
+
+   dc/cdrom.h
+   Host stand-in for the KOS header of the same name, so that isotest can
+   build kernel/arch/dreamcast/fs/fs_iso9660.c on a PC. The functions are
+   implemented in isotest.c on top of a disc image.
+*/
+
+#ifndef __DC_CDROM_H
+#define __DC_CDROM_H
+
+#include <arch/types.h>
+
+#define ERR_NO_DISC     1
+#define ERR_DISC_CHG    2
+
+#define CD_STATUS_OPEN      6
+#define CD_STATUS_NO_DISC   7
+
+typedef struct {
+    uint32  entry[99];
+    uint32  first, last;
+    uint32  leadout_sector;
+} CDROM_TOC;
+
+int cdrom_get_status(int *status, int *disc_type);
+int cdrom_reinit(void);
+int cdrom_read_toc(CDROM_TOC *toc_buffer, int session);
+int cdrom_read_sectors(void *buffer, int sector, int cnt);
+uint32 cdrom_locate_data_track(CDROM_TOC *toc);
+
+#endif  /* __DC_CDROM_H */
@@ -0,0 +1,20 @@
+/* KallistiOS ##version##
+
+   dc/fs_iso9660.h
+   Host stand-in for the KOS header of the same name, so that isotest can
+   build kernel/arch/dreamcast/fs/fs_iso9660.c on a PC.
+*/
+
+#ifndef __DC_FS_ISO9660_H
+#define __DC_FS_ISO9660_H
+
+#include <arch/types.h>
+#include <kos/fs.h>
+
+#define FS_CD_MAX_FILES 8
+
+int iso_reset(void);
+int fs_iso9660_init(void);
+int fs_iso9660_shutdown(void);
+
+#endif  /* __DC_FS_ISO9660_H */
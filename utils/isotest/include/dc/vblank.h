@@ -0,0 +1,26 @@
+/* KallistiOS ##version##
+
+   dc/vblank.h
+   Host stand-in for the KOS header of the same name, so that isotest can
+   build kernel/arch/dreamcast/fs/fs_iso9660.c on a PC. There is no vblank
+   on the host, so handlers are never called.
+*/
+
+#ifndef __DC_VBLANK_H
+#define __DC_VBLANK_H
+
+#include <arch/types.h>
+
+typedef void (*vblank_handler_t)(uint32 evt);
+
+static inline int vblank_handler_add(vblank_handler_t hnd) {
+    (void)hnd;
+    return 1;
+}
+
+static inline int vblank_handler_remove(int handle) {
+    (void)handle;
+    return 0;
+}
+
+#endif  /* __DC_VBLANK_H */
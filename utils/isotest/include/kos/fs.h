@@ -0,0 +1,79 @@
+/* KallistiOS ##version##
+
+   kos/fs.h
+   Host stand-in for the KOS header of the same name, so that isotest can
+   build kernel/arch/dreamcast/fs/fs_iso9660.c on a PC. Only what the
+   iso9660 code uses is here; isotest calls the handler functions directly
+   instead of going through a VFS.
+*/
+
+#ifndef __KOS_FS_H
+#define __KOS_FS_H
+
+#include <arch/types.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+/* Wide enough to round-trip through the void * handles on a 64-bit host */
+typedef intptr_t file_t;
+
+typedef struct kos_dirent {
+    int size;
+    char name[NAME_MAX];
+    time_t time;
+    uint32 attr;
+} dirent_t;
+
+#define O_MODE_MASK 0x0f
+#define O_DIR       0x1000
+
+/* Name manager entry, without the list linkage */
+typedef struct {
+    char    pathname[NAME_MAX];
+    int     pid;
+    uint32  version;
+    uint32  flags;
+    uint32  type;
+    void    *list_ent;
+} nmmgr_handler_t;
+
+#define NMMGR_TYPE_VFS  0x0010
+#define NMMGR_LIST_INIT NULL
+
+static inline int nmmgr_handler_add(nmmgr_handler_t *hnd) {
+    (void)hnd;
+    return 0;
+}
+
+static inline int nmmgr_handler_remove(nmmgr_handler_t *hnd) {
+    (void)hnd;
+    return 0;
+}
+
+/* The handler table is never called through, so its entries are untyped */
+typedef struct vfs_handler {
+    nmmgr_handler_t nmmgr;
+    int     cache;
+    void    *privdata;
+    void    *open, *close, *read, *write, *seek, *tell, *total, *readdir;
+    void    *ioctl, *rename, *unlink, *mmap, *complete, *stat, *mkdir;
+    void    *rmdir, *fcntl, *poll, *link, *symlink, *seek64, *tell64;
+    void    *total64, *readlink, *rewinddir, *fstat;
+} vfs_handler_t;
+
+/* Log levels, and a dbglog that prints to stderr up to dbglog_level, which
+   isotest.c defines */
+#define DBG_ERROR   3
+#define DBG_NOTICE  5
+
+extern int dbglog_level;
+
+#define dbglog(level, ...) \
+    ((level) <= dbglog_level ? (void)fprintf(stderr, __VA_ARGS__) : (void)0)
+
+#endif  /* __KOS_FS_H */
@@ -0,0 +1,38 @@
+/* KallistiOS ##version##
+
+   kos/mutex.h
+   Host stand-in for the KOS header of the same name, so that isotest can
+   build kernel/arch/dreamcast/fs/fs_iso9660.c on a PC. isotest only runs
+   one thread, so the mutexes do nothing.
+*/
+
+#ifndef __KOS_MUTEX_H
+#define __KOS_MUTEX_H
+
+typedef struct {
+    int type;
+} mutex_t;
+
+#define MUTEX_TYPE_NORMAL   1
+
+static inline int mutex_init(mutex_t *m, int mtype) {
+    m->type = mtype;
+    return 0;
+}
+
+static inline int mutex_destroy(mutex_t *m) {
+    (void)m;
+    return 0;
+}
+
+static inline int mutex_lock(mutex_t *m) {
+    (void)m;
+    return 0;
+}
+
+static inline int mutex_unlock(mutex_t *m) {
+    (void)m;
+    return 0;
+}
+
+#endif  /* __KOS_MUTEX_H */
@@ -0,0 +1,11 @@
+/* KallistiOS ##version##
+
+   kos/opts.h
+   Host stand-in for the KOS header of the same name, so that isotest can
+   build kernel/arch/dreamcast/fs/fs_iso9660.c on a PC.
+*/
+
+#ifndef __KOS_OPTS_H
+#define __KOS_OPTS_H
+
+#endif  /* __KOS_OPTS_H */
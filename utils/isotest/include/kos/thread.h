@@ -0,0 +1,14 @@
+/* KallistiOS ##version##
+
+   kos/thread.h
+   Host stand-in for the KOS header of the same name, so that isotest can
+   build kernel/arch/dreamcast/fs/fs_iso9660.c on a PC. isotest only runs
+   one thread, so there is nothing in here.
+*/
+
+#ifndef __KOS_THREAD_H
+#define __KOS_THREAD_H
+
+#include <arch/types.h>
+
+#endif  /* __KOS_THREAD_H */
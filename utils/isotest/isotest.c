@@ -3,8 +3,10 @@
    isotest.c
    (c)2000 Megan Potter
 
-   Test ISO filesystem reader. This is a functional duplicate of fs_iso9660, but
-   designed to run on a PC for testing.
+   ISO9660 cache benchmark. This builds the kernel's own fs_iso9660.c on a
+   PC, with the CD drive replaced by a disc image, and replays traces of
+   file accesses through it to see how well its block caches do with
+   different sizes and replacement policies.
 
 */
 
@@ -13,749 +15,455 @@ Various notes
 
 In Linux, accessing the /dev device on a single-session CD puts the
 "bootstrap" zone at offset 0x8000, and the begin of the CD data itself at
-0x8800.
+0x8800. That is the same layout as an .iso image, so either can be used as
+the disc here.
 
-*/
+The drive model is only meant to rank cache configurations against each
+other: a read that doesn't carry on from where the last one stopped costs
+a seek, which gets dearer the further the head has to travel, and every
+sector costs the time it takes to stream it at the GD-ROM's 12x.
 
-/****************************** LINUX SPECIFIC CODE ***********************************/
+*/
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
+#include <unistd.h>
 
-typedef unsigned char uint8;
-typedef unsigned short uint16;
-typedef unsigned long uint32;
-typedef signed char int8;
-typedef signed short int16;
-typedef signed long int32;
+#include <dc/cdrom.h>
+#include <kos/fs.h>
 
-/* Low-level sector read (for Linux to emulate hardware/cd.c) */
-static int cdrom_read_sectors(void *buffer, uint32 sector, uint32 cnt) {
-    FILE *f;
+#define SEEK_MIN_MS     30.0            /* short hop */
+#define SEEK_FULL_MS    200.0           /* across the whole disc */
+#define SECTOR_MS       (1000.0 / (75 * 12))
+
+/* The disc */
+static FILE *image;
+static uint32 image_sectors;
+
+/* What the drive was asked to do */
+static struct {
+    uint32  reads;          /* read commands */
+    uint32  sectors;        /* sectors read */
+    uint32  seeks;          /* reads that needed a seek */
+    double  seek_ms;        /* time spent seeking */
+    uint32  head;           /* sector after the last one read */
+} drive;
+
+int dbglog_level = DBG_ERROR;
+
+/****************************** LINUX SPECIFIC CODE ***********************************/
+
+/* Low-level sector read (for Linux to emulate hardware/cdrom.c) */
+int cdrom_read_sectors(void *buffer, int sector, int cnt) {
+    uint32 dist;
 
     /* Subtract out DC's LBA offset */
     sector -= 150;
 
-    f = fopen("/dev/scd0", "r");
-
-    if(!f) return -1;
+    if(sector < 0 || (uint32)(sector + cnt) > image_sectors)
+        return -1;
 
-    fseek(f, sector * 2048, SEEK_SET);
-    if(fread(buffer, cnt * 2048, 1, f) != 1) {
-        fclose(f);
-        return 1;
+    if((uint32)sector != drive.head) {
+        dist = (uint32)sector > drive.head ? sector - drive.head :
+               drive.head - sector;
+        drive.seeks++;
+        drive.seek_ms += SEEK_MIN_MS +
+                         (SEEK_FULL_MS - SEEK_MIN_MS) * dist / image_sectors;
     }
 
-    fclose(f);
-    return 0;
-}
+    drive.reads++;
+    drive.sectors += cnt;
+    drive.head = sector + cnt;
 
-/* Linux emulation of various other KOS CD prims */
-typedef int CDROM_TOC;
+    fseek(image, (long)sector * 2048, SEEK_SET);
 
-static int cdrom_reinit() {
-    return 0;
-}
+    if(fread(buffer, 2048, cnt, image) != (size_t)cnt)
+        return -1;
 
-static int cdrom_read_toc(CDROM_TOC *toc, int session) {
     return 0;
 }
 
-static uint32 cdrom_locate_data_track(CDROM_TOC *toc) {
-    return 150;
+/* Linux emulation of various other KOS CD prims */
+int cdrom_get_status(int *status, int *disc_type) {
+    *status = 0;
+    *disc_type = 0;
+    return 0;
 }
 
-/* KOS VFS prims */
-#define O_RDONLY 0
-#define O_MODE_MASK 0xfff
-#define O_DIR 0x1000
-#define MAX_FN_LEN 256
-typedef struct {
-    int     size;
-    char    name[MAX_FN_LEN];
-    uint32  time;
-    uint32  attr;
-} dirent_t;
-
-typedef void *vfs_handler[];
-
-static int fs_handler_add(char *fn, void *p) {
+int cdrom_reinit(void) {
     return 0;
 }
 
-static int fs_handler_remove(void *p) {
+int cdrom_read_toc(CDROM_TOC *toc, int session) {
+    (void)session;
+    memset(toc, 0, sizeof(CDROM_TOC));
     return 0;
 }
 
-/* Thread prims */
-typedef int thd_mutex_t;
-
-static void thd_mutex_reset(int *p) { }
-static void thd_mutex_lock(int *p) { }
-static void thd_mutex_unlock(int *p) { }
-
-/* iso9660 defines */
-#define MAX_ISO_FILES 8
+uint32 cdrom_locate_data_track(CDROM_TOC *toc) {
+    (void)toc;
+    return 150;
+}
 
 /****************************** END LINUX SPECIFIC CODE ***********************************/
 
-/* Cut here to insert into KallistiOS fs_iso9660.c */
-
-
-/* #include <kallisti/stdtypes.h> */
-#include <stdlib.h>
-#include <string.h>
+/* The file system itself, exactly as the kernel builds it */
+#include "fs_iso9660.c"
 
 /********************************************************************************/
-/* Low-level ISO utils */
+/* Traces */
 
-/* ISO Directory entry */
-typedef struct {
-    uint8   length;         /* 711 */
-    uint8   ext_attr_length;    /* 711 */
-    uint8   extent[8];      /* 733 */
-    uint8   size[8];        /* 733 */
-    uint8   date[7];        /* 7x711 */
-    uint8   flags;
-    uint8   file_unit_size;     /* 711 */
-    uint8   interleave;     /* 711 */
-    uint8   vol_sequence[4];    /* 723 */
-    uint8   name_len;       /* 711 */
-    char    name[1];
-} iso_dirent_t;
-
-#if 0
-/* Util function to reverse the byte order of a uint32 */
-static uint32 ntohl_32(void *data) {
-    uint8 *d = (uint8*)data;
-    return (d[0] << 24) | (d[1] << 16) | (d[2] << 8) | (d[3] << 0);
-}
-#endif
+/* A trace is a text file with one file system call per line:
 
-/* This seems kinda silly, but it's important since it allows us
-   to do unaligned accesses on a buffer */
-static uint32 htohl_32(void *data) {
-    uint8 *d = (uint8*)data;
-    return (d[0] << 0) | (d[1] << 8) | (d[2] << 16) | (d[3] << 24);
-}
+       open <h> <path>          open a file
+       opendir <h> <path>       open a directory
+       read <h> <bytes>         read from a file
+       seek <h> <offset> <set|cur|end>
+       readdir <h> [<count>]    read directory entries (all by default)
+       close <h>
 
-#if 0
-/* Read red-book section 7.1.1 number (8 bit) */
-static uint8 iso_711(uint8 *from) {
-    return (*from & 0xff);
-}
-#endif
+   where <h> is a small number naming the handle, chosen by whoever wrote
+   the trace. Blank lines and lines starting with # are skipped. */
 
-/* Read red-book section 7.3.3 number (32 bit LE / 32 bit BE) */
-static uint32 iso_733(uint8 *from) {
-    return htohl_32(from);
-}
+#define MAX_HANDLES 64
 
+enum { OP_OPEN, OP_OPENDIR, OP_READ, OP_SEEK, OP_READDIR, OP_CLOSE };
 
-/********************************************************************************/
-/* Low-level block caching routines. This implements a simple queue-based
-   LRU/MRU caching system. Whenever a block is requested, it will be placed
-   on the MRU end of the queue. As more blocks are loaded than can fit in
-   the cache, blocks are deleted from the LRU end. */
-
-/* Holds the data for one cache block, and a pointer to the next one.
-   As sectors are read from the disc, they are added to the front of
-   this cache. As the cache fills up, sectors are removed from the end
-   of it. */
 typedef struct {
-    int32   sector;         /* CD sector */
-    uint8   data[2048];     /* Sector data */
-} cache_block_t;
-
-/* List of cache blocks (ordered least recently used to most recently) */
-#define NUM_CACHE_BLOCKS 8
-static cache_block_t *cache[NUM_CACHE_BLOCKS];
-
-/* Cache modification mutex */
-static thd_mutex_t cache_mutex;
-
-/* Clears all cache blocks */
-static void bclear() {
-    int i;
+    int     op;
+    int     h;
+    long    arg;            /* byte count, offset or entry count */
+    int     whence;
+    char    *path;
+    int     line;
+} trace_op_t;
 
-    thd_mutex_lock(&cache_mutex);
+typedef struct {
+    const char  *name;
+    trace_op_t  *ops;
+    int         count;
+} trace_t;
 
-    for(i = 0; i < NUM_CACHE_BLOCKS; i++)
-        cache[i]->sector = -1;
+static int load_trace(trace_t *t, const char *fn) {
+    FILE *f;
+    char buf[1024], cmd[16], arg1[PATH_MAX], arg2[16];
+    int line = 0, size = 0, n, h;
+    trace_op_t *op;
 
-    thd_mutex_unlock(&cache_mutex);
-}
+    if(!(f = fopen(fn, "r"))) {
+        perror(fn);
+        return -1;
+    }
 
-/* Graduate a block from its current position to the MRU end of the cache */
-static void bgrad(int block) {
-    int     i;
-    cache_block_t   *tmp;
+    t->name = fn;
+    t->ops = NULL;
+    t->count = 0;
 
-    /* Don't try it with the end block */
-    if(block < 0 || block >= (NUM_CACHE_BLOCKS - 1)) return;
+    while(fgets(buf, sizeof(buf), f)) {
+        line++;
+        n = sscanf(buf, "%15s %d %4095s %15s", cmd, &h, arg1, arg2);
 
-    /* Make a copy and scoot everything down */
-    tmp = cache[block];
+        if(n < 1 || cmd[0] == '#')
+            continue;
 
-    for(i = block; i < (NUM_CACHE_BLOCKS - 1); i++)
-        cache[i] = cache[i + 1];
+        if(t->count == size) {
+            size = size ? size * 2 : 256;
+            t->ops = realloc(t->ops, size * sizeof(trace_op_t));
+        }
 
-    cache[NUM_CACHE_BLOCKS - 1] = tmp;
-}
+        op = t->ops + t->count;
+        memset(op, 0, sizeof(trace_op_t));
+        op->h = h;
+        op->line = line;
 
-/* Pulls the requested sector into a cache block and returns the cache
-   block index. Note that the sector in question may already be in the
-   cache, in which case it just returns the containing block. */
-static int bread(int32 sector) {
-    int i, rv = -1;
+        if(n < 2 || h < 0 || h >= MAX_HANDLES)
+            goto bad;
 
-    thd_mutex_lock(&cache_mutex);
+        if(!strcmp(cmd, "open") || !strcmp(cmd, "opendir")) {
+            if(n < 3)
+                goto bad;
 
-    /* Look for a pre-existing cache block */
-    for(i = NUM_CACHE_BLOCKS - 1; i >= 0; i--) {
-        if(cache[i]->sector == sector) {
-            bgrad(i);
-            rv = NUM_CACHE_BLOCKS - 1;
-            goto bread_exit;
+            op->op = cmd[4] ? OP_OPENDIR : OP_OPEN;
+            op->path = strdup(arg1);
         }
-    }
-
-    /* If not, look for an open cache slot; if we find one, use it */
-    for(i = 0; i < NUM_CACHE_BLOCKS; i++) {
-        if(cache[i]->sector == -1) break;
-    }
+        else if(!strcmp(cmd, "read")) {
+            if(n < 3)
+                goto bad;
 
-    /* If we didn't find one, kick an LRU block out of cache */
-    if(i >= NUM_CACHE_BLOCKS) {
-        i = 0;
-    }
+            op->op = OP_READ;
+            op->arg = strtol(arg1, NULL, 0);
+        }
+        else if(!strcmp(cmd, "seek")) {
+            if(n < 4)
+                goto bad;
+
+            op->op = OP_SEEK;
+            op->arg = strtol(arg1, NULL, 0);
+
+            if(!strcmp(arg2, "set"))
+                op->whence = SEEK_SET;
+            else if(!strcmp(arg2, "cur"))
+                op->whence = SEEK_CUR;
+            else if(!strcmp(arg2, "end"))
+                op->whence = SEEK_END;
+            else
+                goto bad;
+        }
+        else if(!strcmp(cmd, "readdir")) {
+            op->op = OP_READDIR;
+            op->arg = n >= 3 ? strtol(arg1, NULL, 0) : -1;
+        }
+        else if(!strcmp(cmd, "close")) {
+            op->op = OP_CLOSE;
+        }
+        else {
+            goto bad;
+        }
 
-    /* Load the requested block */
-    if(cdrom_read_sectors(cache[i]->data, sector + 150, 1) < 0) {
-        rv = -1;
-        goto bread_exit;
+        t->count++;
     }
 
-    cache[i]->sector = sector;
-
-    /* Move it to the most-recently-used position */
-    bgrad(i);
-    rv = NUM_CACHE_BLOCKS - 1;
+    fclose(f);
+    return 0;
 
-    /* Return the new cache block index */
-bread_exit:
-    thd_mutex_unlock(&cache_mutex);
-    return rv;
+bad:
+    fprintf(stderr, "%s:%d: can't parse '%s'\n", fn, line, strtok(buf, "\n"));
+    fclose(f);
+    return -1;
 }
 
-
 /********************************************************************************/
-/* Higher-level ISO9660 primitives */
-
-/* Root FS session location (in sectors) */
-static int32 session_base = 0;
+/* Replay */
 
-/* Root directory extent and size in bytes */
-static int32 root_extent = 0, root_size = 0;
-
-/* Root dirent */
-static iso_dirent_t root_dirent;
-
-
-/* Per-disc initialization; this is done every time it's discovered that
-   a new CD has been inserted. */
-static int init_percd() {
-    int     i;
-    CDROM_TOC   toc;
-
-    /* Start off with no cached blocks */
-    bclear();
-
-    /* Locate the root session */
-    if((i = cdrom_reinit()) != 0)
-        return i;
-
-    if((i = cdrom_read_toc(&toc, 0)) != 0)
-        return i;
-
-    if(!(session_base = cdrom_locate_data_track(&toc)))
-        return -1;
-
-    /* Grab and check the volume descriptor */
-    i = bread(session_base + 16 - 150);
-
-    if(i < 0) return i;
-
-    if(memcmp((char*)cache[i]->data, "\01CD001", 6)) {
-        printf("fs_iso9660: disc is not iso9660\r\n");
-        return -1;
-    }
-
-    /* Locate the root directory */
-    memcpy(&root_dirent, cache[i]->data + 156, sizeof(iso_dirent_t));
-    root_extent = iso_733(root_dirent.extent);
-    root_size = iso_733(root_dirent.size);
-
-    return 0;
-}
-
-/* Compare an ISO9660 filename against a normal filename. This takes into
-   account the version code on the end and is not case sensitive. */
-static int fncompare(const char *isofn, int isosize, const char *normalfn) {
+typedef struct {
+    int     blocks;
+    int     policy;
+    cache_stats_t   istats, dstats;
+    uint32  reads, sectors, seeks;
+    double  seek_ms;
+    int     errors;
+} result_t;
+
+static const char *policy_names[] = { "lru", "fifo", "lip" };
+
+static void replay(const trace_t *t, result_t *r) {
+    void *hnd[MAX_HANDLES] = { NULL };
+    char buf[16384];
+    const trace_op_t *op;
+    long left, n;
     int i;
 
-    for(i = 0; i < isosize; i++) {
-        if(isofn[i] == ';') return 0;
+    cache_blocks = r->blocks;
+    cache_policy = r->policy;
+    fs_iso9660_init();
 
-        if(tolower(isofn[i]) != tolower(normalfn[i]))
-            return -1;
-    }
+    memset(&drive, 0, sizeof(drive));
+    memset(&istats, 0, sizeof(istats));
+    memset(&dstats, 0, sizeof(dstats));
+    r->errors = 0;
 
-    return 0;
-}
+    for(i = 0; i < t->count; i++) {
+        op = t->ops + i;
 
-/* Locate an ISO9660 object in the given directory; this can be a directory or
-   a file, it works fine for either one. Pass in:
+        switch(op->op) {
+            case OP_OPEN:
+            case OP_OPENDIR:
+                if(hnd[op->h])
+                    iso_close(hnd[op->h]);
 
-   fn:      object filename (relative to the passed directory)
-   dir:     0 if looking for a file, 1 if looking for a dir
-   dir_extent:  directory extent to start with
-   dir_size:    directory size (in bytes)
+                hnd[op->h] = iso_open(NULL, op->path,
+                                      O_RDONLY | (op->op == OP_OPENDIR ? O_DIR : 0));
 
-   It will return a pointer to a transient dirent buffer (i.e., don't
-   expect this buffer to stay around much longer than the call itself).
- */
-static iso_dirent_t *find_object(const char *fn, int dir,
-                                 int32 dir_extent, int32 dir_size) {
-    int32         i;
-    iso_dirent_t * de;
+                if(!hnd[op->h])
+                    goto fail;
 
-    while(dir_size > 0) {
-        int c = bread(dir_extent);
+                break;
 
-        if(c < 0) return NULL;
+            case OP_READ:
+                if(!hnd[op->h])
+                    goto fail;
 
-        for(i = 0; i < 2048 && i < dir_size;) {
-            /* Locate the current dirent */
-            de = (iso_dirent_t *)(cache[c]->data + i);
+                for(left = op->arg, n = 0; left > 0; left -= n) {
+                    n = left < (long)sizeof(buf) ? left : (long)sizeof(buf);
+                    n = iso_read(hnd[op->h], buf, n);
 
-            if(!de->length) break;
+                    if(n <= 0)
+                        break;
+                }
 
-            /* Check the filename against the requested one */
-            if(!fncompare(de->name, de->name_len, fn)) {
-                if(!((dir << 1) ^ de->flags))
-                    return de;
-            }
+                if(n < 0)
+                    goto fail;
 
-            i += de->length;
-        }
+                break;
 
-        dir_extent++;
-        dir_size -= 2048;
-    }
+            case OP_SEEK:
+                if(!hnd[op->h] || iso_seek(hnd[op->h], op->arg, op->whence) < 0)
+                    goto fail;
 
-    return NULL;
-}
+                break;
 
-/* Locate an ISO9660 object anywhere on the disc, starting at the root,
-   and expecting a fully qualified path name. This is analogous to find_object
-   but it searches with the path in mind.
-
-   fn:      object filename (relative to the passed directory)
-   dir:     0 if looking for a file, 1 if looking for a dir
-   dir_extent:  directory extent to start with
-   dir_size:    directory size (in bytes)
-
-   It will return a pointer to a transient dirent buffer (i.e., don't
-   expect this buffer to stay around much longer than the call itself).
- */
-static iso_dirent_t *find_object_path(const char *fn, int dir, iso_dirent_t *start) {
-    char        *cur;
-
-    /* If the object is in a sub-tree, traverse the trees looking
-       for the right directory */
-    while((cur = strchr(fn, '/'))) {
-        if(cur != fn) {
-            /* Note: trailing path parts don't matter since find_object
-               only compares based on the FN length on the disc. */
-            start = find_object(fn, 1, iso_733(start->extent), iso_733(start->size));
-
-            if(start == NULL) return NULL;
-        }
+            case OP_READDIR:
+                if(!hnd[op->h])
+                    goto fail;
 
-        fn = cur + 1;
-    }
+                for(n = op->arg; n && iso_readdir(hnd[op->h]); n--)
+                    ;
 
-    /* Locate the file in the resulting directory */
-    if(*fn) {
-        start = find_object(fn, dir, iso_733(start->extent), iso_733(start->size));
-        return start;
-    }
-    else {
-        if(!dir)
-            return NULL;
-        else
-            return start;
-    }
-}
+                break;
 
-/********************************************************************************/
-/* File primitives */
+            case OP_CLOSE:
+                if(!hnd[op->h])
+                    goto fail;
 
-/* File handles.. I could probably do this with a linked list, but I'm just
-   too lazy right now. =) */
-static struct {
-    int32      first_extent;   /* First sector */
-    int     dir;        /* >0 if a directory */
-    int32      ptr;        /* Current read position in bytes */
-    int32      size;       /* Length of file in bytes */
-    dirent_t    dirent;     /* A static dirent to pass back to clients */
-} fh[MAX_ISO_FILES];
-
-/* Mutex for file handles */
-static thd_mutex_t fh_mutex;
-
-/* Open a file or directory */
-static int32 iso_open(const char *fn, int mode) {
-    int32      fd;
-    iso_dirent_t    *de;
-
-    /* Make sure they don't want to open things as writeable */
-    if((mode & O_MODE_MASK) != O_RDONLY)
-        return 0;
-
-    /* Find a free file handle */
-    thd_mutex_lock(&fh_mutex);
-
-    for(fd = 0; fd < MAX_ISO_FILES; fd++)
-        if(fh[fd].first_extent == 0) {
-            fh[fd].first_extent = -1;
-            break;
+                iso_close(hnd[op->h]);
+                hnd[op->h] = NULL;
+                break;
         }
 
-    thd_mutex_unlock(&fh_mutex);
-
-    if(fd >= MAX_ISO_FILES)
-        return 0;
+        continue;
 
-    /* For now we always do this, but it should eventually be set
-       up to detect the CD tray having been opened. */
-    if(init_percd() < 0)
-        return 0;
+    fail:
+        /* Only complain once, not once per configuration */
+        if(r->blocks == NUM_CACHE_BLOCKS && r->policy == CACHE_LRU)
+            fprintf(stderr, "%s:%d: operation failed\n", t->name, op->line);
 
-    /* Find the file we want */
-    de = find_object_path(fn, (mode & O_DIR) ? 1 : 0, &root_dirent);
-
-    if(!de) return 0;
-
-    /* Fill in the file handle and return the fd */
-    fh[fd].first_extent = iso_733(de->extent);
-    fh[fd].dir = (mode & O_DIR) ? 1 : 0;
-    fh[fd].ptr = 0;
-    fh[fd].size = iso_733(de->size);
-
-    return fd;
-}
-
-/* Close a file or directory */
-static void iso_close(uint32 fd) {
-    /* Check that the fd is valid */
-    if(fd < MAX_ISO_FILES) {
-        /* No need to lock the mutex: this is an atomic op */
-        fh[fd].first_extent = 0;
+        r->errors++;
     }
-}
-
-/* Read from a file */
-static ssize_t iso_read(uint32 fd, char *buf, size_t bytes) {
-    int rv = 0, c;
-    size_t toread, thissect;
-
-    /* Check that the fd is valid */
-    if(fd >= MAX_ISO_FILES || fh[fd].first_extent == 0)
-        return -1;
-
-    /* Read zero or more sectors into the buffer from the current pos */
-    while(bytes > 0) {
-        /* Figure out how much we still need to read */
-        toread = (bytes > (size_t)(fh[fd].size - fh[fd].ptr)) ?
-                 (size_t)(fh[fd].size - fh[fd].ptr) : bytes;
-
-        if(toread == 0) break;
-
-        /* How much more can we read in the current sector? */
-        thissect = 2048 - (fh[fd].ptr % 2048);
-        toread = (toread > thissect) ? thissect : toread;
 
-        /* Do the read */
-        c = bread(fh[fd].first_extent + fh[fd].ptr / 2048);
+    for(i = 0; i < MAX_HANDLES; i++)
+        if(hnd[i])
+            iso_close(hnd[i]);
 
-        if(c < 0) return -1;
+    r->istats = istats;
+    r->dstats = dstats;
+    r->reads = drive.reads;
+    r->sectors = drive.sectors;
+    r->seeks = drive.seeks;
+    r->seek_ms = drive.seek_ms;
 
-        memcpy(buf, cache[c]->data + (fh[fd].ptr % 2048), toread);
-
-        /* Adjust pointers */
-        buf += toread;
-        fh[fd].ptr += toread;
-        bytes -= toread;
-        rv += toread;
-    }
-
-    return rv;
+    fs_iso9660_shutdown();
 }
 
-/* Seek elsewhere in a file */
-static off_t iso_seek(uint32 fd, off_t offset, int whence) {
-    /* Check that the fd is valid */
-    if(fd >= MAX_ISO_FILES || fh[fd].first_extent == 0)
-        return -1;
-
-    /* Update current position according to arguments */
-    switch(whence) {
-        case SEEK_SET:
-            fh[fd].ptr = offset;
-        case SEEK_CUR:
-            fh[fd].ptr += offset;
-        case SEEK_END:
-            fh[fd].ptr = fh[fd].size + offset;
-        default:
-            return -1;
-    }
-
-    /* Check bounds */
-    if(fh[fd].ptr > fh[fd].size) fh[fd].ptr = fh[fd].size;
+static double hit_rate(const cache_stats_t *s) {
+    uint32 total = s->hits + s->misses;
 
-    return fh[fd].ptr;
+    return total ? 100.0 * s->hits / total : 0.0;
 }
 
-/* Tell where in the file we are */
-static off_t iso_tell(uint32 fd) {
-    if(fd >= MAX_ISO_FILES || fh[fd].first_extent == 0)
-        return -1;
-
-    return fh[fd].ptr;
-}
+static void report(const result_t *r) {
+    printf("%c%-5s %6d %7.1f%% %7.1f%% %8u %8u %10.0f %10.0f",
+           r->blocks == NUM_CACHE_BLOCKS && r->policy == CACHE_LRU ? '*' : ' ',
+           policy_names[r->policy], r->blocks,
+           hit_rate(&r->istats), hit_rate(&r->dstats), r->sectors, r->seeks,
+           r->seek_ms, r->seek_ms + r->sectors * SECTOR_MS);
 
-/* Tell how big the file is */
-static size_t iso_total(uint32 fd) {
-    if(fd >= MAX_ISO_FILES || fh[fd].first_extent == 0)
-        return -1;
+    if(r->errors)
+        printf("  (%d failed)", r->errors);
 
-    return fh[fd].size;
+    printf("\n");
 }
 
-/* Helper function for readdir: post-processes an ISO filename to make
-   it a bit prettier. */
-static void fn_postprocess(char *fn) {
-    while(*fn && *fn != ';') {
-        *fn = tolower(*fn);
-        fn++;
-    }
+/********************************************************************************/
 
-    *fn = 0;
+static void usage(void) {
+    printf("usage: isotest [-b blocks,...] [-p policy,...] [-v] image trace...\n"
+           "  -b  cache sizes to try, in blocks per cache (default 4,8,16,32,64)\n"
+           "  -p  replacement policies to try: lru, fifo, lip (default all)\n"
+           "  -v  show the file system's debug messages\n");
 }
 
-/* Read a directory entry */
-static dirent_t *iso_readdir(uint32 fd) {
-    int     c;
-    iso_dirent_t    *de;
-
-    if(fd >= MAX_ISO_FILES || fh[fd].first_extent == 0 || !fh[fd].dir)
-        return NULL;
-
-    /* Scan forwards until we find the next valid entry, an
-       end-of-entry mark, or run out of dir size. */
-    while(fh[fd].ptr < fh[fd].size) {
-        /* Get the current dirent block */
-        c = bread(fh[fd].first_extent + fh[fd].ptr / 2048);
-
-        if(c < 0) return NULL;
-
-        de = (iso_dirent_t *)(cache[c]->data + (fh[fd].ptr % 2048));
-
-        if(de->length) break;
-
-        /* Skip to the next sector */
-        fh[fd].ptr += 2048 - (fh[fd].ptr % 2048);
+int main(int argc, char **argv) {
+    char blocklist[256] = "4,8,16,32,64", policylist[256] = "lru,fifo,lip";
+    int blocks[32], policies[3], nblocks = 0, npolicies = 0;
+    trace_t *traces;
+    result_t r;
+    char *tok;
+    long size;
+    int i, j, k, c;
+
+    while((c = getopt(argc, argv, "b:p:vh")) != -1) {
+        switch(c) {
+            case 'b':
+                strncpy(blocklist, optarg, sizeof(blocklist) - 1);
+                break;
+            case 'p':
+                strncpy(policylist, optarg, sizeof(policylist) - 1);
+                break;
+            case 'v':
+                dbglog_level = DBG_NOTICE;
+                break;
+            default:
+                usage();
+                return c == 'h' ? 0 : 1;
+        }
     }
 
-    if(fh[fd].ptr >= fh[fd].size) return NULL;
-
-    /* If we're at the first, skip the two blank entries */
-    if(!de->name[0]) {
-        fh[fd].ptr += de->length;
-        de = (iso_dirent_t *)(cache[c]->data + (fh[fd].ptr % 2048));
-        fh[fd].ptr += de->length;
-        de = (iso_dirent_t *)(cache[c]->data + (fh[fd].ptr % 2048));
-
-        if(!de->length) return NULL;
+    if(argc - optind < 2) {
+        usage();
+        return 1;
     }
 
-    /* Fill out the VFS dirent */
-    strncpy(fh[fd].dirent.name, de->name, de->name_len);
-    fh[fd].dirent.name[de->name_len] = 0;
-    fn_postprocess(fh[fd].dirent.name);
-
-    if(de->flags & 2)
-        fh[fd].dirent.size = -1;
-    else
-        fh[fd].dirent.size = iso_733(de->size);
-
-    fh[fd].ptr += de->length;
-
-    return &fh[fd].dirent;
-}
-
-/* Put everything together */
-static vfs_handler vh = {
-    0, 0,       /* In-kernel, no caching */
-    iso_open,
-    iso_close,
-    iso_read,
-    NULL,
-    iso_seek,
-    iso_tell,
-    iso_total,
-    iso_readdir,
-    NULL,
-    NULL
-};
-
-/* Initialize the file system */
-static int fs_iso9660_init() {
-    int i;
-
-    /* Reset fd's */
-    memset(fh, 0, sizeof(fh));
-
-    /* Mark the first as active so we can have an error FD of zero */
-    fh[0].first_extent = -1;
-
-    /* Init thread mutexes */
-    thd_mutex_reset(&cache_mutex);
-    thd_mutex_reset(&fh_mutex);
-
-    /* Allocate cache block space */
-    for(i = 0; i < NUM_CACHE_BLOCKS; i++) {
-        cache[i] = malloc(sizeof(cache_block_t));
-        cache[i]->sector = -1;
+    for(tok = strtok(blocklist, ","); tok && nblocks < 32;
+        tok = strtok(NULL, ",")) {
+        if((blocks[nblocks++] = atoi(tok)) < 1) {
+            fprintf(stderr, "isotest: bad cache size '%s'\n", tok);
+            return 1;
+        }
     }
 
-    /* Register with VFS */
-    return fs_handler_add("/cd", &vh);
-}
-
-/* De-init the file system */
-static int fs_iso9660_shutdown() {
-    int i;
-
-    /* Dealloc cache block space */
-    for(i = 0; i < NUM_CACHE_BLOCKS; i++)
-        free(cache[i]);
-
-    return fs_handler_remove(&vh);
-}
-
-
-
-/* Cut here to insert into KallistiOS fs_iso9660.c */
-
-/********************************************************************************/
-
-#if 0
-static void read_dir(uint32 extent, uint32 size) {
-    int     i;
-    iso_dirent_t    *de;
-    char        fn[32];
-
-    while(size > 0) {
-        int c = bread(extent);
-
-        if(c < 0) return;
-
-        for(i = 0; i < 2048 && i < size;) {
-            de = (iso_dirent_t*)(cache[c]->data + i);
-
-            if(!de->length) break;
+    for(tok = strtok(policylist, ","); tok && npolicies < 3;
+        tok = strtok(NULL, ",")) {
+        for(k = 0; k < 3 && strcasecmp(tok, policy_names[k]); k++)
+            ;
 
-            strncpy(fn, de->name, de->name_len);
-            fn[de->name_len] = 0;
-
-            if(de->flags & 2)
-                printf("%s\t\t<DIR>\n", fn);
-            else
-                printf("%s\t\t%d\n", fn, iso_733(de->size));
-
-            i += de->length;
+        if(k == 3) {
+            fprintf(stderr, "isotest: unknown policy '%s'\n", tok);
+            return 1;
         }
 
-        extent++;
-        size -= 2048;
+        policies[npolicies++] = k;
     }
-}
-#endif
-
 
-int main() {
-    fs_iso9660_init();
+    if(!(image = fopen(argv[optind], "rb"))) {
+        perror(argv[optind]);
+        return 1;
+    }
 
-    /*
-    {
-    uint32  fd, size, t;
-    char    buf[667];
+    fseek(image, 0, SEEK_END);
+    size = ftell(image);
+    image_sectors = size / 2048;
 
-    printf("Opening file /escape.txt\n");
-    fd = iso_open("/escape.txt", O_RDONLY);
-    if (fd == 0) {
-        printf("Couldn't open file\n");
+    if(image_sectors < 17) {
+        fprintf(stderr, "isotest: %s is too small to be a disc\n",
+                argv[optind]);
         return 1;
     }
-    size = iso_total(fd);
-    printf("fd is %d, size is %08lx\n", fd, size);
-
-    while (size > 0) {
-        int r;
-        r = iso_read(fd, buf, 666);
-        if (r < 0) {
-            printf("Read error\n");
-            return 1;
-        }
-        buf[r] = 0;
-        printf("%s", buf);
-        if (strstr(buf, "Let the party")) {
-            t = 0;
-        }
-        size -= r;
-    }
-    printf("\nFile read is done\n");
-    iso_close(fd); */
-
-    {
-        uint32      fd;
-        dirent_t    *de;
 
-        printf("Opening /demos");
-        fd = iso_open("/music/mc2/entries/rookie", O_RDONLY | O_DIR);
+    traces = calloc(argc - optind - 1, sizeof(trace_t));
 
-        if(fd == 0) {
-            printf("Couldn't open file\n");
+    for(i = optind + 1; i < argc; i++)
+        if(load_trace(traces + i - optind - 1, argv[i]) < 0)
             return 1;
-        }
 
-        printf("Scanning dir:\n");
+    for(i = 0; i < argc - optind - 1; i++) {
+        printf("%s: %d operations\n", traces[i].name, traces[i].count);
+        printf(" policy blocks  inode%%   data%%  sectors    seeks    seek ms   total ms\n");
 
-        while((de = iso_readdir(fd))) {
-            printf("%s\t%d\n", de->name, de->size);
-
-            if(!strcmp(de->name, "R_WAR.ZIP")) {
-                /* what's this test for? */
+        for(j = 0; j < npolicies; j++) {
+            for(k = 0; k < nblocks; k++) {
+                r.blocks = blocks[k];
+                r.policy = policies[j];
+                replay(traces + i, &r);
+                report(&r);
             }
         }
 
-        iso_close(fd);
+        printf("\n");
     }
 
-    fs_iso9660_shutdown();
+    fclose(image);
 
     return 0;
 }
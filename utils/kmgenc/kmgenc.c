@@ -14,6 +14,8 @@
    - Twiddling (or no)
    - Mipmaps (or no)
    - VQ encoding (or no)
+   - Version 2 KMGs, which are LZ4 compressed and carry a table of where
+     each mipmap level is
 
    Any combination of these attributes may be selected for the final
    output file. Note that input textures must be a power of 2 on each
@@ -39,11 +41,21 @@
 */
 
 #include "kmgenc.h"
+#include "batch.h"
+#include <kmg/kmg2write.h>
 
 int use_twiddle = 1;
+int use_mipmap = 0;
+int use_v2 = 0;
 int use_verbose = 1;
 int use_debug = 1;
 int use_alpha = 0;
+int use_jobs = 1;
+const char *batch_list = NULL;
+const char *batch_cache = NULL;
+
+/* bump whenever the output for a given input and options changes */
+#define KMGENC_REVISION 1
 
 /* Linear/iterative twiddling algorithm from Marcus' tatest */
 #define TWIDTAB(x) ( (x&1)|((x&2)<<1)|((x&4)<<2)|((x&8)<<3)|((x&16)<<4)| \
@@ -102,11 +114,107 @@ static void convert_to_16(image_t * img) {
     img->data = (uint8 *)out;
 }
 
+/* the PVR puts 16-bit mipmaps after 6 bytes of padding, smallest first */
+#define MIP_PAD         6
+#define MIP_OFFSET(lv)  (MIP_PAD + 2 * ((1 << (2 * (lv))) - 1) / 3)
+
+static int log2i(int x) {
+    int l = 0;
+
+    while(x > 1) {
+        x >>= 1;
+        l++;
+    }
+
+    return l;
+}
+
+/* halve an image with a box filter; works on any number of bytes per pixel */
+static int downscale(image_t *src, image_t *dst) {
+    int x, y, c, bpp = src->bpp, sum;
+    uint8 *s, *d;
+
+    dst->w = src->w / 2;
+    dst->h = src->h / 2;
+    dst->bpp = bpp;
+    dst->stride = dst->w * bpp;
+    dst->data = malloc(dst->w * dst->h * bpp);
+
+    if(dst->data == NULL)
+        return -1;
+
+    for(y = 0; y < dst->h; y++) {
+        d = dst->data + y * dst->stride;
+        s = src->data + 2 * y * src->w * bpp;
+
+        for(x = 0; x < dst->w; x++, s += 2 * bpp) {
+            for(c = 0; c < bpp; c++) {
+                sum = s[c] + s[bpp + c] + s[src->w * bpp + c] +
+                      s[src->w * bpp + bpp + c];
+                *d++ = (sum + 2) / 4;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* Build the texture data as it goes into texture memory, filling in the
+   section table of hdr. With mipmaps, every level down to 1x1 is made from
+   the one above it. The image is consumed. */
+static uint8 *build_texture(image_t *img, kmg2_header_t *hdr, int *count) {
+    image_t half;
+    uint8 *out;
+    int lv, off, size;
+
+    lv = log2i(img->w);
+    *count = use_mipmap ? MIP_OFFSET(lv + 1) : img->w * img->h * 2;
+
+    if((out = calloc(1, *count)) == NULL)
+        return NULL;
+
+    for(;;) {
+        memset(&half, 0, sizeof(half));
+
+        if(use_mipmap && lv > 0 && downscale(img, &half) < 0)
+            goto loser;
+
+        convert_to_16(img);
+        size = img->w * img->h * 2;
+        off = use_mipmap ? MIP_OFFSET(lv) : 0;
+
+        if(use_twiddle)
+            twiddle(img, (uint16 *)(out + off));
+        else
+            memcpy(out + off, img->data, size);
+
+        kmg2_add_section(hdr, KMG2_SECT_LEVEL, lv, off, size);
+        free(img->data);
+        img->data = half.data;
+
+        if(half.data == NULL)
+            break;
+
+        img->w = half.w;
+        img->h = half.h;
+        img->bpp = half.bpp;
+        img->stride = half.stride;
+        lv--;
+    }
+
+    return out;
+
+loser:
+    free(out);
+    return NULL;
+}
+
 static int save(const char *filename, image_t *img) {
     FILE    *fp;
     kmg_header_t    hdr;
-    uint16      * tmp = NULL;
-    int     fmt, cnt;
+    kmg2_header_t   hdr2;
+    uint8       * tmp = NULL;
+    int     fmt, cnt, w, h;
 
     fp = fopen(filename, "wb");
 
@@ -115,11 +223,6 @@ static int save(const char *filename, image_t *img) {
         return -errno;
     }
 
-    memset(&hdr, 0, sizeof(hdr));
-    hdr.magic = le32(KMG_MAGIC);
-    hdr.version = le32(KMG_VERSION);
-    hdr.platform = le32(KMG_PLAT_DC);
-
     switch(use_alpha) {
         case 0:
             fmt = KMG_DCFMT_RGB565;
@@ -137,10 +240,44 @@ static int save(const char *filename, image_t *img) {
     if(use_twiddle)
         fmt |= KMG_DCFMT_TWIDDLED;
 
+    if(use_mipmap)
+        fmt |= KMG_DCFMT_MIPMAP;
+
+    /* Convert and twiddle the image (and its mipmaps) into a temp buffer */
+    w = img->w;
+    h = img->h;
+    memset(&hdr2, 0, sizeof(hdr2));
+    tmp = build_texture(img, &hdr2, &cnt);
+
+    if(tmp == NULL) {
+        fprintf(stderr, "FATAL: out of memory converting %s\n", filename);
+        goto loser;
+    }
+
+    if(use_v2) {
+        hdr2.platform = KMG_PLAT_DC;
+        hdr2.format = fmt;
+        hdr2.width = w;
+        hdr2.height = h;
+        hdr2.byte_count = cnt;
+
+        if(kmg2_write(fp, &hdr2, tmp, 1) < 0) {
+            fprintf(stderr, "FATAL: can't write KMG to %s\n", filename);
+            goto loser;
+        }
+
+        free(tmp);
+        fclose(fp);
+        return 0;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = le32(KMG_MAGIC);
+    hdr.version = le32(KMG_VERSION);
+    hdr.platform = le32(KMG_PLAT_DC);
     hdr.format = le32(fmt);
-    hdr.width = le32(img->w);
-    hdr.height = le32(img->h);
-    cnt = img->w * img->h * 2;
+    hdr.width = le32(w);
+    hdr.height = le32(h);
     hdr.byte_count = le32(cnt);
 
     if(fwrite(&hdr, sizeof(hdr), 1, fp) != 1) {
@@ -148,10 +285,6 @@ static int save(const char *filename, image_t *img) {
         goto loser;
     }
 
-    /* Twiddle the image into a temp buffer */
-    tmp = malloc(cnt);
-    twiddle(img, tmp);
-
     /* Write it out */
     if(fwrite(tmp, cnt, 1, fp) != 1) {
         fprintf(stderr, "FATAL: can't write KMG data to %s\n", filename);
@@ -178,12 +311,16 @@ static void banner(const char *progname) {
     printf("\n");
     printf("Options:\n");
     /* printf("\t-t, --twiddle\tcreate twiddled textures\n"); */
-    /* printf("\t-m, --mipmap\tcreate mipmapped textures (EXPERIMENTAL)\n"); */
+    printf("\t-m, --mipmap\tcreate mipmapped textures (square only)\n");
     printf("\t-v, --verbose\tverbose\n");
     printf("\t-d, --debug\tshow debug information\n");
     /* printf("\t-q, --highq\thigher quality (much slower)\n"); */
     printf("\t-a4, --argb4444\tuse alpha channel (and output ARGB4444)\n");
     printf("\t-a1, --argb1555\tuse alpha channel (and output ARGB1555)\n");
+    printf("\t-2, --v2\twrite a compressed version 2 KMG\n");
+    printf("\t-j, --jobs N\tencode N images at once with --batch\n");
+    printf("\t--batch LIST\tencode every image in a directory or manifest\n");
+    printf("\t--cache DIR\treuse outputs of unchanged images in batch mode\n");
 }
 
 static int valid_size(int x) {
@@ -239,6 +376,10 @@ static void destroy_image(image_t *image) {
     }
 }
 
+static const char *output_name(const char *infile) {
+    return figure_outfilename(infile, "kmg");
+}
+
 static int encode(const char *infile) {
     int     ok;
     image_t     image;
@@ -259,31 +400,54 @@ static int encode(const char *infile) {
         return -EINVAL;
     }
 
-    outfile = figure_outfilename(infile, "kmg");
+    outfile = output_name(infile);
 
     if(outfile == NULL) {
         fprintf(stderr, "memory allocation failed for %s\n", infile);
         return -ENOMEM;
     }
 
-    /* Convert the input image to a 16-bit image according to parameters */
-    convert_to_16(&image);
+    if(use_mipmap && image.w != image.h) {
+        fprintf(stderr, "mipmapped textures must be square: %s\n", infile);
+        destroy_image(&image);
+        free((void *)outfile);
+        return -EINVAL;
+    }
 
-    /* Save it */
+    /* Convert to 16-bit according to parameters and save it */
     ok = save(outfile, &image);
 
     destroy_image(&image);
+    free((void *)outfile);
 
     printf("\n");
     return ok;
 }
 
+static int encode_batch(void) {
+    batch_tool_t tool;
+    char options[32];
+
+    snprintf(options, sizeof(options), "t%d a%d m%d v%d", use_twiddle,
+             use_alpha, use_mipmap, use_v2 ? 2 : 1);
+
+    tool.name = "kmgenc";
+    tool.revision = KMGENC_REVISION;
+    tool.options = options;
+    tool.encode = encode;
+    tool.output_name = output_name;
+
+    return batch_run(&tool, batch_list, batch_cache, use_jobs) == 0 ? 0 : -1;
+}
+
 static int process_long_options(char *arg) {
-    /* if (! strcmp(arg, "mipmap"))
+    if(! strcmp(arg, "mipmap"))
         use_mipmap = 1;
-    else if (! strcmp(arg, "twiddle"))
-        use_twiddle = 1;
-    else */ if(! strcmp(arg, "debug"))
+    /* else if (! strcmp(arg, "twiddle"))
+        use_twiddle = 1; */
+    else if(! strcmp(arg, "v2"))
+        use_v2 = 1;
+    else if(! strcmp(arg, "debug"))
         use_debug = 1;
     else if(! strcmp(arg, "verbose"))
         use_verbose = 1;
@@ -303,9 +467,13 @@ static int process_option(char *arg) {
 
     switch(*arg) {
 
-            /* case 'm':
-                use_mipmap = 1;
-                return 0; */
+        case 'm':
+            use_mipmap = 1;
+            return 0;
+
+        case '2':
+            use_v2 = 1;
+            return 0;
 
             /* case 't':
                 use_twiddle = 1;
@@ -342,12 +510,52 @@ static int process_option(char *arg) {
     return -EINVAL;
 }
 
+/* options that take a value from the next argument; returns -EINVAL for a
+   bad value, 0 if arg isn't one of them, or 1 if it was handled */
+static int process_arg_option(const char *arg, const char *value) {
+    char *end;
+
+    if(strcmp(arg, "-j") && strcmp(arg, "--jobs") &&
+       strcmp(arg, "--batch") && strcmp(arg, "--cache"))
+        return 0;
+
+    if(value == NULL) {
+        fprintf(stderr, "%s requires a value\n", arg);
+        return -EINVAL;
+    }
+
+    if(arg[1] == 'j' || arg[2] == 'j') {
+        use_jobs = strtol(value, &end, 10);
+
+        if(*end != '\0' || use_jobs < 1) {
+            fprintf(stderr, "%s requires a positive job count\n", arg);
+            return -EINVAL;
+        }
+    }
+    else if(arg[2] == 'b')
+        batch_list = value;
+    else
+        batch_cache = value;
+
+    return 1;
+}
+
 static int process(int argc, char *argv[]) {
-    int arg;
+    int arg, rv;
 
     arg = 1;
 
     while(arg < argc) {
+        rv = process_arg_option(argv[arg], arg + 1 < argc ? argv[arg + 1] : NULL);
+
+        if(rv < 0)
+            return rv;
+
+        if(rv > 0) {
+            arg += 2;
+            continue;
+        }
+
         if(argv[arg][0] == '-') {
             if(process_option(argv[arg]) < 0) {
                 fprintf(stderr, "invalid option %s\n", argv[arg]);
@@ -362,6 +570,20 @@ static int process(int argc, char *argv[]) {
         break;
     }
 
+    if(batch_list) {
+        if(arg < argc) {
+            fprintf(stderr, "can't mix --batch with image files\n");
+            return -EINVAL;
+        }
+
+        return encode_batch();
+    }
+
+    if(batch_cache) {
+        fprintf(stderr, "--cache only works with --batch\n");
+        return -EINVAL;
+    }
+
     if(arg >= argc) {
         fprintf(stderr, "no files to encode\n");
         return -EINVAL;
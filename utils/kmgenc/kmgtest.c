@@ -0,0 +1,184 @@
+/* KallistiOS ##version##
+
+   kmgtest.c
+
+   Host tests for the version 2 KMG writer and the libkoskmg decoder.
+
+   With no arguments, LZ4 blocks of zeros, noise and text are compressed and
+   then decoded both into a separate buffer and in place, the way
+   kmg2_to_img() does it, and damaged blocks are checked to be rejected. Any KMG files on
+   the command line are decoded and their section tables checked; if two
+   files are given, they must hold the same texture data (say, the version 1
+   and version 2 output for the same image).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <kmg/kmg2write.h>
+#include "check.h"
+
+#define MAX_LEN 300000
+
+/* Inputs for the LZ4 coder, MAX_LEN bytes each: nothing to compress, nothing
+   but matches, and text that repeats every few bytes. Blocks are taken from
+   the start of them. */
+static unsigned char zeros[MAX_LEN], noise[MAX_LEN], text[MAX_LEN];
+
+static void make_inputs(void) {
+    int i;
+
+    srand(1);
+
+    for(i = 0; i < MAX_LEN; i++) {
+        noise[i] = (unsigned char)(rand() >> 7);
+        text[i] = "KallistiOS"[i % 10];
+    }
+}
+
+static void test_block(const char *what, const unsigned char *src, int len) {
+    unsigned char *comp, *out;
+    int clen, margin, base;
+
+    comp = malloc(KMG2_LZ4_BOUND(len));
+
+    clen = kmg2_lz4_compress(src, len, comp, &margin);
+    CHECK(clen > 0 && clen <= KMG2_LZ4_BOUND(len), "compress %d bytes of %s",
+          len, what);
+
+    out = malloc(len + margin + clen + 1);
+
+    CHECK(kmg2_lz4_decode(comp, clen, out, len) == 0 && !memcmp(out, src, len),
+          "decode %d bytes of %s", len, what);
+
+    /* in place: compressed data at the very end of the output buffer */
+    base = len + margin - clen;
+
+    if(base >= 0) {
+        memcpy(out + base, comp, clen);
+        CHECK(kmg2_lz4_decode(out + base, clen, out, len) == 0 &&
+              !memcmp(out, src, len), "in place %d bytes of %s", len, what);
+    }
+
+    /* the wrong output size must be noticed */
+    if(len > 0)
+        CHECK(kmg2_lz4_decode(comp, clen, out, len - 1) < 0,
+              "short output, %d bytes of %s", len, what);
+
+    CHECK(kmg2_lz4_decode(comp, clen - 1, out, len) < 0,
+          "truncated, %d bytes of %s", len, what);
+
+    free(comp);
+    free(out);
+}
+
+/* flip every byte of a block in turn; decoding must never overrun */
+static void test_damage(void) {
+    unsigned char comp[KMG2_LZ4_BOUND(600)], out[600];
+    int clen, margin, i;
+
+    clen = kmg2_lz4_compress(text, sizeof(out), comp, &margin);
+
+    for(i = 0; i < clen; i++) {
+        comp[i] ^= 0x5a;
+        kmg2_lz4_decode(comp, clen, out, sizeof(out));
+        comp[i] ^= 0x5a;
+    }
+}
+
+static unsigned char *load(const char *fn, kmg2_header_t *hdr) {
+    unsigned char *buf, *out;
+    FILE *fp;
+    long size;
+
+    if((fp = fopen(fn, "rb")) == NULL) {
+        CHECK(0, "can't open %s", fn);
+        return NULL;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    buf = malloc(size);
+
+    if(fread(buf, size, 1, fp) != 1 || kmg2_parse_header(buf, size, hdr) < 0 ||
+       kmg2_parse_sections(buf, size, hdr) < 0 ||
+       hdr->data_offset + hdr->stored_size != (unsigned long)size) {
+        CHECK(0, "%s: bad header", fn);
+        free(buf);
+        fclose(fp);
+        return NULL;
+    }
+
+    fclose(fp);
+    out = malloc(hdr->byte_count);
+
+    if(kmg2_decode(hdr, buf + hdr->data_offset, out) < 0) {
+        CHECK(0, "%s: bad data", fn);
+        free(out);
+        out = NULL;
+    }
+
+    free(buf);
+    return out;
+}
+
+static unsigned char *test_file(const char *fn, kmg2_header_t *hdr) {
+    unsigned char *data;
+    unsigned int i;
+
+    if((data = load(fn, hdr)) == NULL)
+        return NULL;
+
+    printf("%s: version %u, %ux%u, %u bytes stored as %u, %u sections\n", fn,
+           hdr->version, hdr->width, hdr->height, hdr->byte_count,
+           hdr->stored_size, hdr->section_count);
+
+    for(i = 0; i < hdr->section_count; i++) {
+        if(hdr->sections[i].type == KMG2_SECT_LEVEL)
+            CHECK(kmg2_find_section(hdr, KMG2_SECT_LEVEL,
+                                    hdr->sections[i].level) ==
+                  &hdr->sections[i], "%s: duplicate level %d", fn,
+                  hdr->sections[i].level);
+    }
+
+    return data;
+}
+
+int main(int argc, char *argv[]) {
+    static const int sizes[] = { 0, 1, 4, 12, 13, 17, 64, 255, 256, 1000,
+                                 4096, 65536, 70000, 300000 };
+    kmg2_header_t h1, h2;
+    unsigned char *d1, *d2;
+    unsigned int i;
+
+    if(argc < 2) {
+        make_inputs();
+
+        for(i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            test_block("zeros", zeros, sizes[i]);
+            test_block("noise", noise, sizes[i]);
+            test_block("text", text, sizes[i]);
+        }
+
+        test_damage();
+    }
+    else {
+        d1 = test_file(argv[1], &h1);
+
+        if(argc > 2) {
+            d2 = test_file(argv[2], &h2);
+
+            if(d1 && d2)
+                CHECK(h1.byte_count == h2.byte_count && h1.format == h2.format &&
+                      !memcmp(d1, d2, h1.byte_count),
+                      "%s and %s differ", argv[1], argv[2]);
+
+            free(d2);
+        }
+
+        free(d1);
+    }
+
+    return check_done();
+}
@@ -0,0 +1,23 @@
+/* KallistiOS ##version##
+
+   arch/arch.h
+   Host stand-in for the KOS header of the same name, so that mallocbench
+   can build kernel/libc/koslib/malloc.c on a PC.
+*/
+
+#ifndef __ARCH_ARCH_H
+#define __ARCH_ARCH_H
+
+#include <stdio.h>
+#include <arch/types.h>
+
+#define PAGESIZE        4096
+
+#define DBG_CRITICAL    2
+#define dbglog(level, ...)  ((void)(level), fprintf(stderr, __VA_ARGS__))
+
+/* The benchmark's heap, which sbrk() hands out in place of RAM */
+extern unsigned long bench_heap_start, bench_heap_end;
+void *bench_sbrk(ptrdiff_t incr);
+
+#endif  /* __ARCH_ARCH_H */
@@ -0,0 +1,20 @@
+/* KallistiOS ##version##
+
+   arch/spinlock.h
+   Host stand-in for the KOS header of the same name, so that mallocbench
+   can build kernel/libc/koslib/malloc.c on a PC. The benchmark only has
+   one thread, so the lock just keeps track of whether it's held.
+*/
+
+#ifndef __ARCH_SPINLOCK_H
+#define __ARCH_SPINLOCK_H
+
+typedef volatile int spinlock_t;
+
+#define SPINLOCK_INITIALIZER    0
+
+#define spinlock_lock(lock)         (*(lock) = 1)
+#define spinlock_unlock(lock)       (*(lock) = 0)
+#define spinlock_is_locked(lock)    (*(lock) != 0)
+
+#endif  /* __ARCH_SPINLOCK_H */
@@ -0,0 +1,18 @@
+/* KallistiOS ##version##
+
+   kos/opts.h
+   Host stand-in for the KOS header of the same name, so that mallocbench
+   can build kernel/libc/koslib/malloc.c on a PC. It points malloc at the
+   benchmark's heap, and gives its functions their own names so they don't
+   get mixed up with the C library's.
+*/
+
+#ifndef __KOS_OPTS_H
+#define __KOS_OPTS_H
+
+#define USE_DL_PREFIX
+#define MORECORE            bench_sbrk
+#define SLAB_HEAP_START     bench_heap_start
+#define SLAB_HEAP_END       bench_heap_end
+
+#endif  /* __KOS_OPTS_H */
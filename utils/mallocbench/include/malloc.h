@@ -0,0 +1,53 @@
+/* KallistiOS ##version##
+
+   malloc.h
+   Host stand-in for the KOS header of the same name, so that mallocbench
+   can build kernel/libc/koslib/malloc.c on a PC. The KOS one declares the
+   C library's functions, which malloc.c defines as dlmalloc() and so on
+   here, so this just has what's left.
+*/
+
+#ifndef __MALLOC_H
+#define __MALLOC_H
+
+#include <stddef.h>
+
+struct mallinfo {
+    int arena;
+    int ordblks;
+    int smblks;
+    int hblks;
+    int hblkhd;
+    int usmblks;
+    int fsmblks;
+    int uordblks;
+    int fordblks;
+    int keepcost;
+};
+
+#define M_MXFAST 1
+#define DEFAULT_MXFAST 64
+#define M_TRIM_THRESHOLD -1
+#define DEFAULT_TRIM_THRESHOLD (256*1024)
+#define M_TOP_PAD -2
+#define DEFAULT_TOP_PAD 0
+#define M_MMAP_THRESHOLD -3
+#define DEFAULT_MMAP_THRESHOLD (256*1024)
+#define M_MMAP_MAX -4
+#define DEFAULT_MMAP_MAX 65536
+
+struct malloc_slab_info {
+    size_t size;
+    size_t slabs;
+    size_t inuse;
+    size_t free;
+    unsigned long allocs;
+    unsigned long frees;
+};
+
+int malloc_slab_info(struct malloc_slab_info *info, int count);
+int malloc_irq_safe(void);
+int mem_check_block(void *p);
+int mem_check_all(void);
+
+#endif  /* __MALLOC_H */
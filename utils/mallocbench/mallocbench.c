@@ -0,0 +1,312 @@
+/* KallistiOS ##version##
+
+   mallocbench.c
+   Copyright (C) 2026 KallistiOS Team
+
+   Allocation benchmark. This builds the kernel's own malloc.c on a PC, with
+   sbrk() handing out a fixed block of memory the size of the Dreamcast's
+   RAM, and runs two tests through it:
+
+   - throughput: batches of same-sized allocations, freed in a random order,
+     timed per malloc()/free() pair;
+   - fragmentation: a mix of sizes like the network stack's, from ARP
+     entries up to full frames, each kept for a random time, with a few kept
+     for good. The heap's size is compared with how much is really in use;
+   - separate heaps: a subsystem that leaks, given a heap of its own, runs
+     out of memory without the main heap noticing, and is then torn down
+     all at once rather than a block at a time.
+
+   Build it with and without MALLOC_SLAB to compare the slab front end with
+   plain dlmalloc; the Makefile does both.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "malloc.c"
+
+#define HEAP_SIZE       (16 * 1024 * 1024)
+
+#define BATCH           1024
+#define ROUNDS          2000
+
+#define STEPS           2000000
+#define LIFE_MAX        4096
+#define MAX_LIVE        (LIFE_MAX * 2)
+
+/* The benchmark's heap, handed out by bench_sbrk() */
+static char heap[HEAP_SIZE] __attribute__((aligned(4096)));
+static unsigned long brk_top, brk_peak;
+unsigned long bench_heap_start, bench_heap_end;
+
+void *bench_sbrk(ptrdiff_t incr) {
+    unsigned long old = brk_top;
+
+    if(incr > 0 && brk_top + incr > bench_heap_end)
+        return (void *)-1;
+
+    if(incr < 0 && brk_top + incr < bench_heap_start)
+        return (void *)-1;
+
+    brk_top += incr;
+
+    if(brk_top > brk_peak)
+        brk_peak = brk_top;
+
+    return (void *)old;
+}
+
+/* Same numbers every run, so the two builds see the same workload */
+static uint32_t rnd_state = 2463534242u;
+
+static uint32_t rnd(void) {
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void throughput(size_t size) {
+    static void *ptrs[BATCH];
+    double start, total;
+    int i, j, k;
+    void *t;
+
+    start = now_ns();
+
+    for(i = 0; i < ROUNDS; i++) {
+        for(j = 0; j < BATCH; j++) {
+            if(!(ptrs[j] = dlmalloc(size))) {
+                printf("out of memory\n");
+                exit(1);
+            }
+
+            *(char *)ptrs[j] = j;
+        }
+
+        /* Free them in a random order, as they'd come back in real life */
+        for(j = BATCH - 1; j > 0; j--) {
+            k = rnd() % (j + 1);
+            t = ptrs[j];
+            ptrs[j] = ptrs[k];
+            ptrs[k] = t;
+        }
+
+        for(j = 0; j < BATCH; j++)
+            dlfree(ptrs[j]);
+    }
+
+    total = now_ns() - start;
+    printf("  %4d bytes: %6.1f ns per malloc/free\n", (int)size,
+           total / ((double)ROUNDS * BATCH));
+}
+
+/* Something like what the network stack asks for */
+static size_t packet_size(void) {
+    uint32_t r = rnd() % 100;
+
+    if(r < 35)
+        return 16 + rnd() % 48;         /* list nodes, ARP entries */
+    else if(r < 65)
+        return 64 + rnd() % 192;        /* small packets, sockets */
+    else if(r < 90)
+        return 256 + rnd() % 256;       /* larger packets */
+    else
+        return 512 + rnd() % 1024;      /* full frames */
+}
+
+typedef struct {
+    void *ptr;
+    size_t size;
+    int next;
+} object_t;
+
+static void fragmentation(void) {
+    static object_t objs[MAX_LIVE];
+    static int wheel[LIFE_MAX];
+    int free_list, i, n, next;
+    size_t live = 0, live_peak = 0, forever = 0;
+    unsigned long heap_peak = 0;
+    struct mallinfo mi;
+    double start;
+
+    for(i = 0; i < MAX_LIVE; i++)
+        objs[i].next = i + 1;
+
+    objs[MAX_LIVE - 1].next = -1;
+    free_list = 0;
+
+    for(i = 0; i < LIFE_MAX; i++)
+        wheel[i] = -1;
+
+    start = now_ns();
+
+    for(i = 0; i < STEPS; i++) {
+        /* Free everything that's reached the end of its life */
+        for(n = wheel[i % LIFE_MAX]; n >= 0; n = next) {
+            next = objs[n].next;
+            live -= objs[n].size;
+            dlfree(objs[n].ptr);
+            objs[n].next = free_list;
+            free_list = n;
+        }
+
+        wheel[i % LIFE_MAX] = -1;
+
+        if(free_list < 0)
+            continue;
+
+        n = free_list;
+        free_list = objs[n].next;
+        objs[n].size = packet_size();
+
+        if(!(objs[n].ptr = dlmalloc(objs[n].size))) {
+            printf("out of memory\n");
+            exit(1);
+        }
+
+        memset(objs[n].ptr, 0, objs[n].size);
+        live += objs[n].size;
+
+        /* One in a thousand lives for good, the rest for a while */
+        if(rnd() % 1000 == 0) {
+            forever += objs[n].size;
+            continue;
+        }
+
+        next = (i + 1 + rnd() % (LIFE_MAX - 1)) % LIFE_MAX;
+        objs[n].next = wheel[next];
+        wheel[next] = n;
+
+        if(live > live_peak)
+            live_peak = live;
+    }
+
+    printf("  %d steps in %.1f ms\n", STEPS, (now_ns() - start) / 1e6);
+
+    mi = dlmallinfo();
+    heap_peak = brk_peak - bench_heap_start;
+
+    printf("  peak live: %8lu bytes, peak heap: %8lu bytes (%.2fx)\n",
+           (unsigned long)live_peak, heap_peak, (double)heap_peak / live_peak);
+    printf("  now live:  %8lu bytes, in use:    %8d bytes, free: %d bytes\n",
+           (unsigned long)live, mi.uordblks, mi.fordblks);
+    printf("  kept for good: %lu bytes\n", (unsigned long)forever);
+}
+
+/* A subsystem that leaks one block in ten, in a heap of its own */
+static void heaps(void) {
+    static char region[HEAP_SIZE / 16];
+    static void *ptrs[8192];
+    struct mallinfo mi, main_before, main_after;
+    kos_heap_t *heap;
+    int i, n, leaked = 0;
+    void *p;
+    double start;
+
+    main_before = dlmallinfo();
+
+    if(!(heap = kos_heap_create(region, sizeof(region)))) {
+        printf("kos_heap_create failed\n");
+        exit(1);
+    }
+
+    for(n = 0; ; n++) {
+        if(!(p = kos_heap_malloc(heap, packet_size())))
+            break;
+
+        if(n % 10 == 0)
+            ++leaked;
+        else
+            kos_heap_free(heap, p);
+    }
+
+    mi = kos_heap_mallinfo(heap);
+    printf("  %lu byte heap full after %d allocations, %d leaked\n",
+           (unsigned long)sizeof(region), n, leaked);
+    printf("  heap in use: %d bytes, free: %d bytes\n", mi.uordblks,
+           mi.fordblks);
+
+    /* The main heap carries on regardless */
+    main_after = dlmallinfo();
+    p = dlmalloc(64 * 1024);
+    printf("  main heap in use: %d bytes before, %d after, %s\n",
+           main_before.uordblks, main_after.uordblks,
+           p ? "still allocating" : "out of memory too");
+    dlfree(p);
+
+    /* Freeing a block at a time, against throwing the heap away */
+    kos_heap_destroy(heap);
+    heap = kos_heap_create(region, sizeof(region));
+
+    for(n = 0; n < 8192 && (ptrs[n] = kos_heap_malloc(heap, 64)); n++)
+        ;
+
+    start = now_ns();
+
+    for(i = 0; i < n; i++)
+        dlfree(ptrs[i]);
+
+    printf("  freeing %d blocks one at a time: %.1f us\n", n,
+           (now_ns() - start) / 1e3);
+
+    for(i = 0; i < n; i++)
+        ptrs[i] = kos_heap_malloc(heap, 64);
+
+    start = now_ns();
+    kos_heap_destroy(heap);
+    printf("  destroying the heap instead:   %.1f us\n",
+           (now_ns() - start) / 1e3);
+}
+
+int main(int argc, char **argv) {
+    static const size_t sizes[] = { 16, 64, 256, 512 };
+    struct malloc_slab_info info[32];
+    int i, n;
+
+    (void)argc;
+    (void)argv;
+
+    bench_heap_start = brk_top = brk_peak = (unsigned long)heap;
+    bench_heap_end = bench_heap_start + HEAP_SIZE;
+
+    n = malloc_slab_info(info, 32);
+    printf("kernel malloc, %s\n\n", n ? "with slabs" : "without slabs");
+
+    printf("Throughput:\n");
+
+    for(i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++)
+        throughput(sizes[i]);
+
+    printf("\nFragmentation:\n");
+    fragmentation();
+
+    printf("\nSeparate heaps:\n");
+    heaps();
+
+    n = malloc_slab_info(info, 32);
+
+    if(n) {
+        printf("\nSlabs:\n");
+        printf("  %5s %6s %8s %8s %10s %10s\n", "size", "slabs", "in use",
+               "free", "allocs", "frees");
+
+        for(i = 0; i < n; i++)
+            printf("  %5lu %6lu %8lu %8lu %10lu %10lu\n",
+                   (unsigned long)info[i].size, (unsigned long)info[i].slabs,
+                   (unsigned long)info[i].inuse, (unsigned long)info[i].free,
+                   info[i].allocs, info[i].frees);
+    }
+
+    return 0;
+}
@@ -63,6 +63,44 @@ static void INLINE div_quad(fquad_t *q, float v) {
     }
 }
 
+static void INLINE clear_dquad(dquad_t *q) {
+    memset(q, '\0', sizeof(*q));
+}
+
+static void INLINE accum_quad(dquad_t *out, fquad_t *in) {
+    int i;
+
+    for(i = 0; i < 4; i++) {
+        out->p[i].a += in->p[i].a;
+        out->p[i].r += in->p[i].r;
+        out->p[i].g += in->p[i].g;
+        out->p[i].b += in->p[i].b;
+    }
+}
+
+static void INLINE add_dquad(dquad_t *out, dquad_t *in) {
+    int i;
+
+    for(i = 0; i < 4; i++) {
+        out->p[i].a += in->p[i].a;
+        out->p[i].r += in->p[i].r;
+        out->p[i].g += in->p[i].g;
+        out->p[i].b += in->p[i].b;
+    }
+}
+
+/* average of an accumulated sum, rounded back down to float precision */
+static void INLINE avg_dquad(fquad_t *out, dquad_t *in, int count) {
+    int i;
+
+    for(i = 0; i < 4; i++) {
+        out->p[i].a = (float)(in->p[i].a / count);
+        out->p[i].r = (float)(in->p[i].r / count);
+        out->p[i].g = (float)(in->p[i].g / count);
+        out->p[i].b = (float)(in->p[i].b / count);
+    }
+}
+
 static void INLINE copy_quad(fquad_t *out, fquad_t *in) {
     *out = *in;
 }
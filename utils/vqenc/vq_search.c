@@ -0,0 +1,317 @@
+/* KallistiOS ##version##
+
+   vq_search.c
+
+   Nearest codebook entry search for vqenc. Instead of measuring every quad
+   against every code, the codes are sorted by their projection onto the
+   principal axis of the codebook. The difference of two projections is never
+   larger than the distance between the quads themselves, so the search starts
+   at the codes whose projection is closest to the quad's and walks outwards
+   until the projections alone rule out anything closer than the best match.
+
+   Distances are squared and summed in float, one component at a time, so
+   the SIMD kernels and the plain C one produce bit-identical results.
+*/
+
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "vq_search.h"
+
+#if defined(__SSE__) || defined(__x86_64__)
+#include <xmmintrin.h>
+#define VQ_HAVE_SSE 1
+#endif
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define VQ_HAVE_AVX 1
+#endif
+
+/* component value of unused entries in the last block; far enough away to
+   never be picked, small enough that the squared sum stays finite */
+#define PAD_VALUE 1.0e18f
+
+typedef void (*dist_block_t)(const vq_search_t *s, int base, const float *q,
+                             float *out);
+
+static dist_block_t dist_block = NULL;
+
+static void dist_block_c(const vq_search_t *s, int base, const float *q,
+                         float *out) {
+    int i, k;
+    float acc, d;
+
+    for(i = 0; i < VQ_SEARCH_BLOCK; i++) {
+        acc = 0.0f;
+
+        for(k = 0; k < 16; k++) {
+            d = s->soa[k][base + i] - q[k];
+            acc += d * d;
+        }
+
+        out[i] = acc;
+    }
+}
+
+#ifdef VQ_HAVE_SSE
+static void dist_block_sse(const vq_search_t *s, int base, const float *q,
+                           float *out) {
+    __m128 acc0, acc1, qk, d0, d1;
+    int k;
+
+    acc0 = _mm_setzero_ps();
+    acc1 = _mm_setzero_ps();
+
+    for(k = 0; k < 16; k++) {
+        qk = _mm_set1_ps(q[k]);
+        d0 = _mm_sub_ps(_mm_loadu_ps(&s->soa[k][base]), qk);
+        d1 = _mm_sub_ps(_mm_loadu_ps(&s->soa[k][base + 4]), qk);
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(d0, d0));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(d1, d1));
+    }
+
+    _mm_storeu_ps(out, acc0);
+    _mm_storeu_ps(out + 4, acc1);
+}
+#endif
+
+#ifdef VQ_HAVE_AVX
+__attribute__((target("avx")))
+static void dist_block_avx(const vq_search_t *s, int base, const float *q,
+                           float *out) {
+    __m256 acc, d;
+    int k;
+
+    acc = _mm256_setzero_ps();
+
+    for(k = 0; k < 16; k++) {
+        d = _mm256_sub_ps(_mm256_loadu_ps(&s->soa[k][base]),
+                          _mm256_set1_ps(q[k]));
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(d, d));
+    }
+
+    _mm256_storeu_ps(out, acc);
+}
+#endif
+
+static void pick_kernel(void) {
+    dist_block = dist_block_c;
+
+#ifdef VQ_HAVE_SSE
+    dist_block = dist_block_sse;
+#endif
+
+#ifdef VQ_HAVE_AVX
+    __builtin_cpu_init();
+
+    if(__builtin_cpu_supports("avx"))
+        dist_block = dist_block_avx;
+#endif
+}
+
+static float project(const float *axis, const float *v) {
+    int k;
+    float p;
+
+    p = 0.0f;
+
+    for(k = 0; k < 16; k++)
+        p += axis[k] * v[k];
+
+    return p;
+}
+
+/* principal axis of the code values by power iteration on their covariance */
+static void find_axis(const code_t *codes, int count, float *axis) {
+    double mean[16], cov[16][16], v[16], w[16], len;
+    const float *c;
+    int i, j, k, iter;
+
+    memset(mean, 0, sizeof(mean));
+    memset(cov, 0, sizeof(cov));
+
+    for(i = 0; i < count; i++) {
+        c = (const float *)codes[i].value.p;
+
+        for(k = 0; k < 16; k++)
+            mean[k] += c[k];
+    }
+
+    for(k = 0; k < 16; k++)
+        mean[k] /= count;
+
+    for(i = 0; i < count; i++) {
+        c = (const float *)codes[i].value.p;
+
+        for(j = 0; j < 16; j++)
+            for(k = 0; k < 16; k++)
+                cov[j][k] += (c[j] - mean[j]) * (c[k] - mean[k]);
+    }
+
+    for(k = 0; k < 16; k++)
+        v[k] = 0.25;
+
+    for(iter = 0; iter < 32; iter++) {
+        len = 0.0;
+
+        for(j = 0; j < 16; j++) {
+            w[j] = 0.0;
+
+            for(k = 0; k < 16; k++)
+                w[j] += cov[j][k] * v[k];
+
+            len += w[j] * w[j];
+        }
+
+        /* all codes identical; any unit axis will do */
+        if(len < 1e-12)
+            break;
+
+        len = sqrt(len);
+
+        for(k = 0; k < 16; k++)
+            v[k] = w[k] / len;
+    }
+
+    for(k = 0; k < 16; k++)
+        axis[k] = (float)v[k];
+}
+
+void vq_search_build(vq_search_t *s, const code_t *codes, int count) {
+    const float *c;
+    float p;
+    int i, j, k, code;
+
+    if(dist_block == NULL)
+        pick_kernel();
+
+    s->count = count;
+    s->padded = (count + VQ_SEARCH_BLOCK - 1) & ~(VQ_SEARCH_BLOCK - 1);
+
+    find_axis(codes, count, s->axis);
+
+    /* insertion sort by projection; the codebook is at most 256 entries */
+    for(i = 0; i < count; i++) {
+        p = project(s->axis, (const float *)codes[i].value.p);
+
+        for(j = i; j > 0 && s->proj[j - 1] > p; j--) {
+            s->proj[j] = s->proj[j - 1];
+            s->code[j] = s->code[j - 1];
+        }
+
+        s->proj[j] = p;
+        s->code[j] = i;
+    }
+
+    for(i = 0; i < count; i++) {
+        code = s->code[i];
+        c = (const float *)codes[code].value.p;
+
+        for(k = 0; k < 16; k++)
+            s->soa[k][i] = c[k];
+    }
+
+    for(; i < s->padded; i++) {
+        s->proj[i] = FLT_MAX;
+        s->code[i] = -1;
+
+        for(k = 0; k < 16; k++)
+            s->soa[k][i] = PAD_VALUE;
+    }
+}
+
+/* margin on the best distance so float rounding can't prune the real winner */
+static float prune_bound(float best) {
+    return sqrtf(best) * 1.0001f + 0.01f;
+}
+
+int vq_search_find(const vq_search_t *s, const fquad_t *q) {
+    const float *v = (const float *)q->p;
+    float d[VQ_SEARCH_BLOCK];
+    float xp, best, bound;
+    int lo, hi, mid, base, i, best_code, up;
+
+    xp = project(s->axis, v);
+
+    /* first entry projecting at or above the quad */
+    lo = 0;
+    hi = s->count;
+
+    while(lo < hi) {
+        mid = (lo + hi) / 2;
+
+        if(s->proj[mid] < xp)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    hi = lo & ~(VQ_SEARCH_BLOCK - 1);
+
+    if(hi >= s->padded)
+        hi = s->padded - VQ_SEARCH_BLOCK;
+
+    lo = hi - VQ_SEARCH_BLOCK;
+
+    best = FLT_MAX;
+    bound = FLT_MAX;
+    best_code = s->count;
+    up = 1;
+
+    while(lo >= 0 || hi < s->padded) {
+        /* alternate directions while both are still open */
+        if(hi >= s->padded)
+            up = 0;
+        else if(lo < 0)
+            up = 1;
+
+        if(up) {
+            base = hi;
+            hi += VQ_SEARCH_BLOCK;
+
+            if(s->proj[base] - xp > bound) {
+                hi = s->padded;
+                continue;
+            }
+        }
+        else {
+            base = lo;
+            lo -= VQ_SEARCH_BLOCK;
+
+            if(xp - s->proj[base + VQ_SEARCH_BLOCK - 1] > bound) {
+                lo = -1;
+                continue;
+            }
+        }
+
+        up = !up;
+        dist_block(s, base, v, d);
+
+        for(i = 0; i < VQ_SEARCH_BLOCK && base + i < s->count; i++) {
+            if(d[i] < best || (d[i] == best && s->code[base + i] < best_code)) {
+                best = d[i];
+                best_code = s->code[base + i];
+                bound = prune_bound(best);
+            }
+        }
+    }
+
+    return best_code;
+}
+
+float vq_dist2(const fquad_t *a, const fquad_t *b) {
+    const float *va = (const float *)a->p;
+    const float *vb = (const float *)b->p;
+    float acc, d;
+    int k;
+
+    acc = 0.0f;
+
+    for(k = 0; k < 16; k++) {
+        d = va[k] - vb[k];
+        acc += d * d;
+    }
+
+    return acc;
+}
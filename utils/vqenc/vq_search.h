@@ -0,0 +1,26 @@
+/* KallistiOS ##version##
+
+   vq_search.h
+
+   Nearest codebook entry search for vqenc.
+*/
+
+#ifndef __VQ_SEARCH_H
+#define __VQ_SEARCH_H
+
+#include "vq_types.h"
+
+/* index the current values of the codebook for searching */
+void vq_search_build(vq_search_t *s, const code_t *codes, int count);
+
+/* returns the position in the codebook of the entry with the smallest
+ * squared distance to q; ties go to the lowest position.
+ */
+int vq_search_find(const vq_search_t *s, const fquad_t *q);
+
+/* squared distance between two quads, summed in the same order and
+ * precision as the search kernels.
+ */
+float vq_dist2(const fquad_t *a, const fquad_t *b);
+
+#endif
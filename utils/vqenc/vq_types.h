@@ -24,18 +24,39 @@ typedef struct fquad_t {
     fcolor_t p[4];
 } fquad_t;
 
+/* double precision accumulator for quad sums; input quads are all multiples
+ * of 2^-18 below 256, so sums of up to 2^27 quads are exact in a double and
+ * thus independent of the order in which they were added.
+ */
+typedef struct dcolor_t {
+    double r;
+    double g;
+    double b;
+    double a;
+} dcolor_t;
+
+typedef struct dquad_t {
+    dcolor_t p[4];
+} dquad_t;
+
 typedef struct mipmap_t {
     /* each map represents quads of a different resolution */
     fquad_t *map[MAX_MIPMAP];
 } mipmap_t;
 
-typedef struct code_t {
+typedef struct code_stats_t {
     /* sum of quads using this code */
-    fquad_t pos_sum;
+    dquad_t pos_sum;
     int pos_count;
 
+    /* squared distance of the furthest quad placed on this code */
     float max_dist;
     fquad_t max_dist_vec;
+} code_stats_t;
+
+typedef struct code_t {
+    /* placement statistics from the last pass */
+    code_stats_t st;
 
     /* position in codebook index */
     uint8 index;
@@ -44,9 +65,27 @@ typedef struct code_t {
     fquad_t value;
 } code_t;
 
+/* number of codes compared at once by the distance kernels */
+#define VQ_SEARCH_BLOCK 8
+#define VQ_SEARCH_MAX   256
+
+/* nearest-code search index, rebuilt whenever the code values change. codes
+ * are sorted by their projection on the principal axis of the codebook and
+ * stored component-major so a block of codes can be compared at once.
+ */
+typedef struct vq_search_t {
+    int count;
+    int padded;
+    float axis[16];
+    float proj[VQ_SEARCH_MAX];
+    int code[VQ_SEARCH_MAX];
+    float soa[16][VQ_SEARCH_MAX];
+} vq_search_t;
+
 typedef struct context_t {
     int in_use;
     code_t codes[256];
+    vq_search_t search;
 } context_t;
 
 #endif
@@ -0,0 +1,207 @@
+/* KallistiOS ##version##
+
+   vqbench.c
+
+   Measures how many quads per second the vqenc nearest-code search gets
+   through, compared with the plain linear scan it replaced. Quads are taken
+   from an image if one is given, otherwise from a synthetic gradient, and
+   the codebook is a spread of 256 of those quads.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "get_image.h"
+#include "vq_internal.h"
+#include "vq_types.h"
+#include "vq_search.h"
+
+#define BENCH_SECONDS 1.0
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* the search vqenc used before vq_search, kept as the baseline */
+static double delta_e(fquad_t *a, fquad_t *b) {
+    int i;
+    fquad_t sub;
+    double total;
+
+    total = 0.0;
+    sub_quad(&sub, a, b);
+
+    for(i = 0; i < 4; i++) {
+        total += (sub.p[i].a * sub.p[i].a);
+        total += (sub.p[i].r * sub.p[i].r);
+        total += (sub.p[i].g * sub.p[i].g);
+        total += (sub.p[i].b * sub.p[i].b);
+    }
+
+    return sqrt(total);
+}
+
+static int find_linear(context_t *cb, fquad_t *q) {
+    int code, close_entry;
+    double close_dist, d;
+
+    close_entry = 0;
+    close_dist = delta_e(&cb->codes[0].value, q);
+
+    for(code = 1; code < cb->in_use; code++) {
+        d = delta_e(&cb->codes[code].value, q);
+
+        if(d < close_dist) {
+            close_entry = code;
+            close_dist = d;
+
+            if(d < 0.0001)
+                return close_entry;
+        }
+    }
+
+    return close_entry;
+}
+
+/* exhaustive squared-distance argmin; what vq_search_find must agree with */
+static int find_exact(context_t *cb, fquad_t *q) {
+    int code, best;
+    float d, best_dist;
+
+    best = 0;
+    best_dist = vq_dist2(&cb->codes[0].value, q);
+
+    for(code = 1; code < cb->in_use; code++) {
+        d = vq_dist2(&cb->codes[code].value, q);
+
+        if(d < best_dist) {
+            best = code;
+            best_dist = d;
+        }
+    }
+
+    return best;
+}
+
+static fquad_t *load_quads(const char *fn, int *count) {
+    image_t img;
+    fquad_t *q, *qt;
+    int x, y, w;
+
+    if(fn) {
+        if(get_image(fn, &img) < 0)
+            return NULL;
+    }
+    else {
+        img.w = img.h = 512;
+        img.stride = img.w * 4;
+        img.data = (unsigned char *)malloc(img.stride * img.h);
+
+        if(img.data == NULL)
+            return NULL;
+
+        for(y = 0; y < img.h; y++) {
+            for(x = 0; x < img.w; x++) {
+                unsigned char *p = img.data + y * img.stride + x * 4;
+                p[0] = 255;
+                p[1] = (unsigned char)(128 + 127 * sin(x * 0.05) * cos(y * 0.03));
+                p[2] = (unsigned char)((x * 3 + y) ^ (rand() & 7));
+                p[3] = (unsigned char)((x ^ y) + (rand() & 15));
+            }
+        }
+    }
+
+    w = img.w & ~1;
+    *count = (w / 2) * (img.h / 2);
+    q = (fquad_t *)malloc(*count * sizeof(fquad_t));
+
+    if(q == NULL) {
+        free(img.data);
+        return NULL;
+    }
+
+    qt = q;
+
+    for(y = 0; y + 1 < img.h; y += 2) {
+        for(x = 0; x < w; x += 2) {
+            get_color(&qt->p[0], img.data + (y * img.stride) + (x * 4));
+            get_color(&qt->p[1], img.data + (y * img.stride) + ((x + 1) * 4));
+            get_color(&qt->p[2], img.data + ((y + 1) * img.stride) + (x * 4));
+            get_color(&qt->p[3], img.data + ((y + 1) * img.stride) + ((x + 1) * 4));
+            qt++;
+        }
+    }
+
+    free(img.data);
+    return q;
+}
+
+static double run(const char *name, context_t *cb, fquad_t *quads, int nquads,
+                  int (*fn)(context_t *, fquad_t *)) {
+    double start, elapsed;
+    long done;
+    int i, sink;
+
+    done = 0;
+    sink = 0;
+    start = now();
+
+    do {
+        for(i = 0; i < nquads; i++)
+            sink += fn(cb, &quads[i]);
+
+        done += nquads;
+        elapsed = now() - start;
+    } while(elapsed < BENCH_SECONDS);
+
+    printf("%-8s %12.0f quads/sec  (%d)\n", name, done / elapsed, sink & 1);
+    return done / elapsed;
+}
+
+static int find_search(context_t *cb, fquad_t *q) {
+    return vq_search_find(&cb->search, q);
+}
+
+int main(int argc, char *argv[]) {
+    static context_t cb;
+    fquad_t *quads;
+    int nquads, i, bad;
+    double before, after;
+
+    quads = load_quads(argc > 1 ? argv[1] : NULL, &nquads);
+
+    if(quads == NULL || nquads < 256) {
+        fprintf(stderr, "need an image of at least 32x32 pixels\n");
+        return 1;
+    }
+
+    cb.in_use = 256;
+
+    for(i = 0; i < 256; i++) {
+        copy_quad(&cb.codes[i].value, &quads[(long)i * nquads / 256]);
+        cb.codes[i].index = i;
+    }
+
+    vq_search_build(&cb.search, cb.codes, cb.in_use);
+
+    bad = 0;
+
+    for(i = 0; i < nquads; i++) {
+        if(vq_search_find(&cb.search, &quads[i]) != find_exact(&cb, &quads[i]))
+            bad++;
+    }
+
+    printf("%d quads, %d codes, %d mismatches\n", nquads, cb.in_use, bad);
+
+    before = run("linear", &cb, quads, nquads, find_linear);
+    after = run("search", &cb, quads, nquads, find_search);
+    printf("speedup  %12.2fx\n", after / before);
+
+    free(quads);
+    return bad ? 1 : 0;
+}
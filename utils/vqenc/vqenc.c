@@ -18,9 +18,14 @@
 #include <math.h>
 #include <unistd.h>
 #include <errno.h>
+#include <pthread.h>
 #include "get_image.h"
 #include "vq_internal.h"
 #include "vq_types.h"
+#include "vq_search.h"
+#include "batch.h"
+#include <kmg/kmg2write.h>
+#include <vqv/vqv.h>
 
 /* For outputting KMG files */
 #include "kmg.h"
@@ -31,17 +36,36 @@ static int use_verbose = 0;
 static int use_debug = 0;
 static int use_hq = 0;
 static int use_kmg = 0;
+static int use_v2 = 0;
 static int use_alpha = 0;
+static int use_jobs = 1;
+static const char *batch_list = NULL;
+static const char *batch_cache = NULL;
+static const char *video_out = NULL;
+static int video_fps_num = 30;
+static int video_fps_den = 1;
+static int video_keyint = 30;
+
+/* bump whenever the output for a given input and options changes */
+#define VQENC_REVISION 2
+
+/* maps smaller than this are placed on the calling thread only */
+#define MIN_QUADS_PER_JOB 1024
+#define MAX_JOBS 64
 
 #define PACK1555(a, r, g, b) ( (a ? 0x8000 : 0) | ((r>>3)<<10) | ((g>>3)<<5) | ((b >>3)))
 #define PACK4444(a, r, g, b) ( ((a>>4) << 12) | ((r>>4)<<8) | ((g>>4)<<4) | ((b>>4)) )
 #define PACK565(r, g, b) (((r>>3)<<11) | ((g>>2)<<5) | ((b>>3)))
 #define LIMIT(x,low,high) (x) < low ? low : (x) > high ? high : (x);
 
+static void reset_stats(code_stats_t *st) {
+    clear_dquad(&st->pos_sum);
+    st->pos_count = 0;
+    st->max_dist = 0.0;
+}
+
 static void reset_code(code_t *c) {
-    clear_quad(&c->pos_sum);
-    c->pos_count = 0;
-    c->max_dist = 0.0;
+    reset_stats(&c->st);
 }
 
 static void reset_codebook(context_t *cb) {
@@ -87,58 +111,25 @@ static int quads_in_map(int res) {
     return (across * across) >> 2;
 }
 
-static double delta_e(fquad_t *a, fquad_t *b) {
-    int i;
-    fquad_t sub;
-    double total;
-
-    total = 0.0;
-    sub_quad(&sub, a, b);
-
-    for(i = 0; i < 4; i++) {
-        total += (sub.p[i].a * sub.p[i].a);
-        total += (sub.p[i].r * sub.p[i].r);
-        total += (sub.p[i].g * sub.p[i].g);
-        total += (sub.p[i].b * sub.p[i].b);
-    }
-
-    return sqrt(total);
-}
-
-/* returns the closest (most similar) codebook entry to the given quad */
+/* returns the closest (most similar) codebook entry to the given quad; the
+ * search index must be rebuilt with update_search() after codes change.
+ */
 static int find(context_t *cb, fquad_t *q) {
-    int code, close_entry;
-    double close_dist;
-
-    close_entry = 0;
-    close_dist = delta_e(&cb->codes[0].value, q);
-
-    for(code = 1; code < cb->in_use; code++) {
-
-        /* hope not to get sued for this variable's name */
-        double d;
-
-        d = delta_e(&cb->codes[code].value, q);
-
-        if(d < close_dist) {
-            close_entry = code;
-            close_dist = d;
-
-            if(d < 0.0001) {
-                /* close enough */
-                return close_entry;
-            }
-        }
-
-    }
+    return vq_search_find(&cb->search, q);
+}
 
-    return close_entry;
+static void update_search(context_t *cb) {
+    vq_search_build(&cb->search, cb->codes, cb->in_use);
 }
 
-static void place(context_t *cb, fquad_t *quads, int nquads) {
+/* accumulate placement statistics for a run of quads into st, which is
+ * indexed like cb->codes.
+ */
+static void place_range(context_t *cb, code_stats_t *st, fquad_t *quads,
+                        int nquads) {
     int i, idx;
-    code_t *e;
-    double dist;
+    code_stats_t *e;
+    float dist;
     fquad_t *that;
 
     that = quads;
@@ -146,13 +137,14 @@ static void place(context_t *cb, fquad_t *quads, int nquads) {
     for(i = 0; i < nquads; i++) {
         /* find averages of all codebook entries */
         idx = find(cb, that);
-        e = &cb->codes[idx];
+        e = &st[idx];
 
-        add_quad(&e->pos_sum, that);
+        accum_quad(&e->pos_sum, that);
         e->pos_count++;
 
-        /* see if we have something better in hand */
-        dist = delta_e(&e->value, that);
+        /* see if we have something better in hand; only ever compared,
+         * so the squared distance will do */
+        dist = vq_dist2(&cb->codes[idx].value, that);
 
         if(dist > e->max_dist) {
             e->max_dist = dist;
@@ -163,6 +155,100 @@ static void place(context_t *cb, fquad_t *quads, int nquads) {
     }
 }
 
+/* fold the statistics of a later run of quads into the codebook. sums are
+ * exact, and max_dist keeps the earliest quad on ties, so the result does not
+ * depend on how the quads were split up.
+ */
+static void merge_stats(context_t *cb, code_stats_t *st) {
+    int i;
+    code_t *e;
+
+    e = cb->codes;
+
+    for(i = 0; i < cb->in_use; i++, e++, st++) {
+        if(st->pos_count == 0)
+            continue;
+
+        add_dquad(&e->st.pos_sum, &st->pos_sum);
+        e->st.pos_count += st->pos_count;
+
+        if(st->max_dist > e->st.max_dist) {
+            e->st.max_dist = st->max_dist;
+            copy_quad(&e->st.max_dist_vec, &st->max_dist_vec);
+        }
+    }
+}
+
+typedef struct place_job_t {
+    pthread_t thread;
+    context_t *cb;
+    fquad_t *quads;
+    int nquads;
+    code_stats_t st[256];
+} place_job_t;
+
+static void *place_thread(void *arg) {
+    place_job_t *job = (place_job_t *)arg;
+    int i;
+
+    for(i = 0; i < job->cb->in_use; i++)
+        reset_stats(&job->st[i]);
+
+    place_range(job->cb, job->st, job->quads, job->nquads);
+    return NULL;
+}
+
+static void place(context_t *cb, fquad_t *quads, int nquads) {
+    place_job_t *jobs;
+    int i, njobs, chunk, started;
+
+    njobs = use_jobs;
+
+    if(njobs > nquads / MIN_QUADS_PER_JOB)
+        njobs = nquads / MIN_QUADS_PER_JOB;
+
+    if(njobs < 1)
+        njobs = 1;
+
+    /* per call rather than static, since batch mode runs several encodes
+       side by side */
+    jobs = (place_job_t *)malloc(sizeof(place_job_t) * njobs);
+
+    if(jobs == NULL) {
+        fprintf(stderr, "FATAL: out of memory placing quads\n");
+        exit(-1);
+    }
+
+    /* the first job runs on this thread once the others are started */
+    chunk = (nquads + njobs - 1) / njobs;
+
+    for(i = 0; i < njobs; i++) {
+        jobs[i].cb = cb;
+        jobs[i].quads = quads + i * chunk;
+        jobs[i].nquads = (i == njobs - 1) ? nquads - i * chunk : chunk;
+    }
+
+    for(started = 1; started < njobs; started++) {
+        if(pthread_create(&jobs[started].thread, NULL, place_thread,
+                          &jobs[started]) != 0)
+            break;
+    }
+
+    place_thread(&jobs[0]);
+
+    /* anything that failed to start is done here instead */
+    for(i = started; i < njobs; i++)
+        place_thread(&jobs[i]);
+
+    for(i = 1; i < started; i++)
+        pthread_join(jobs[i].thread, NULL);
+
+    for(i = 0; i < njobs; i++)
+        merge_stats(cb, jobs[i].st);
+
+    free(jobs);
+}
+
 static void clean_codebook(context_t *cb) {
     int i;
     code_t * e;
@@ -170,10 +256,9 @@ static void clean_codebook(context_t *cb) {
     e = cb->codes;
 
     for(i = 0; i < cb->in_use; i++) {
-        if(e->pos_count > 0) {
+        if(e->st.pos_count > 0) {
             /* code has been used */
-            div_quad(&e->pos_sum, (float)e->pos_count);
-            copy_quad(&e->value, &e->pos_sum);
+            avg_dquad(&e->value, &e->st.pos_sum, e->st.pos_count);
             e++;
         }
         else {
@@ -210,12 +295,12 @@ static void split(context_t *cb) {
     elements = cb->in_use;
 
     for(i = 0; i < elements; i++) {
-        if(e->pos_count > 1) {
+        if(e->st.pos_count > 1) {
 
             fquad_t diff;
             float len;
 
-            sub_quad(&diff, &e->max_dist_vec, &e->value);
+            sub_quad(&diff, &e->st.max_dist_vec, &e->value);
             len = quad_length(&diff) * 256.0f;
             div_quad(&diff, len);
 
@@ -279,7 +364,8 @@ static int INLINE le16(int x) {
         return ((x << 8) & 0xff00) | ((x >> 8) & 0x00ff);
 }
 
-static void copy_codebook(context_t *cb, uint16 *codebook) {
+/* packed codebook in host byte order */
+static void pack_codebook(context_t *cb, uint16 *codebook) {
     int     i;
     code_t  *e;
 
@@ -287,10 +373,10 @@ static void copy_codebook(context_t *cb, uint16 *codebook) {
 
     for(i = 0; i < cb->in_use; i++) {
         /* even the codebook is twiddled! */
-        *codebook++ = le16(pack(&e->value.p[0]));
-        *codebook++ = le16(pack(&e->value.p[2]));
-        *codebook++ = le16(pack(&e->value.p[1]));
-        *codebook++ = le16(pack(&e->value.p[3]));
+        *codebook++ = pack(&e->value.p[0]);
+        *codebook++ = pack(&e->value.p[2]);
+        *codebook++ = pack(&e->value.p[1]);
+        *codebook++ = pack(&e->value.p[3]);
         e++;
     }
 
@@ -304,6 +390,15 @@ static void copy_codebook(context_t *cb, uint16 *codebook) {
     }
 }
 
+static void copy_codebook(context_t *cb, uint16 *codebook) {
+    int i;
+
+    pack_codebook(cb, codebook);
+
+    for(i = 0; i < 256 * 4; i++)
+        codebook[i] = le16(codebook[i]);
+}
+
 static int divide(int *ptr, int stride, int x, int y, int blocksize, int seq) {
     int before;
 
@@ -338,22 +433,16 @@ static int *twiddle_twiddle(int length) {
     return ptr;
 }
 
-static int write_linear(FILE *out, context_t *cb, mipmap_t *m, int res) {
+static void pack_linear(uint8 *out, context_t *cb, mipmap_t *m, int res) {
     int i, nquads;
 
     nquads = quads_in_map(res);
 
-    for(i = 0; i < nquads; i++) {
-        uint8 c = find(cb, &m->map[res][i]);
-
-        if(fputc(c, out) == EOF)
-            return -1;
-    }
-
-    return 0;
+    for(i = 0; i < nquads; i++)
+        *out++ = find(cb, &m->map[res][i]);
 }
 
-static int write_twiddled(FILE *out, context_t *cb, mipmap_t *m, int res) {
+static int pack_twiddled(uint8 *out, context_t *cb, mipmap_t *m, int res) {
     int *twididx, *twiddled;
     int i, width, nquads;
     fquad_t *map;
@@ -362,36 +451,92 @@ static int write_twiddled(FILE *out, context_t *cb, mipmap_t *m, int res) {
     nquads = quads_in_map(res);
 
     twiddled = twiddle_twiddle(width / 2);
+
+    if(twiddled == NULL)
+        return -1;
+
     twididx = twiddled;
     map = m->map[res];
 
-    for(i = 0; i < nquads; i++) {
-        uint8 c = find(cb, &map[*twididx++]);
-
-        if(fputc(c, out) == EOF)
-            return -1;
-    }
+    for(i = 0; i < nquads; i++)
+        *out++ = find(cb, &map[*twididx++]);
 
     free(twiddled);
     return 0;
 }
 
-static int save_codebook(FILE *out, context_t *cb) {
-    uint16 codebook[256 * 4];
+static int log2i(int x) {
+    int l = 0;
 
-    copy_codebook(cb, codebook);
+    while(x > 1) {
+        x >>= 1;
+        l++;
+    }
 
-    if(fwrite(codebook, sizeof(codebook), 1, out) != 1) {
-        /* bummer */
-        return -errno;
+    return l;
+}
+
+/* Lay out the texture as it goes into texture memory: the codebook, then
+ * the index data of every map, smallest first. The section table of hdr gets
+ * an entry for each of them.
+ */
+static uint8 *build_texture(context_t *cb, mipmap_t *m, kmg2_header_t *hdr,
+                            int *count) {
+    uint8 *out;
+    int res, off;
+
+    *count = 2048 + (use_mipmap ? 1 : 0);
+
+    for(res = 0; res < MAX_MIPMAP; res++) {
+        if(m->map[res] != NULL)
+            *count += quads_in_map(res);
     }
 
-    return 0;
+    if((out = (uint8 *)malloc(*count)) == NULL)
+        return NULL;
+
+    copy_codebook(cb, (uint16 *)out);
+    kmg2_add_section(hdr, KMG2_SECT_CODEBOOK, 0, 0, 2048);
+    update_search(cb);
+    off = 2048;
+
+    /* dummy byte (0) must be included in square mipmaps; it's the index
+     * of the 1x1 level
+     */
+    if(use_mipmap) {
+        out[off] = 0;
+        kmg2_add_section(hdr, KMG2_SECT_LEVEL, 0, off, 1);
+        off++;
+    }
+
+    for(res = 0; res < MAX_MIPMAP; res++) {
+        /* write each valid map down, if output is required
+         * as twiddled, mess it up first
+         */
+        if(m->map[res] != NULL) {
+            if(use_twiddle) {
+                if(pack_twiddled(out + off, cb, m, res) < 0) {
+                    free(out);
+                    return NULL;
+                }
+            }
+            else
+                pack_linear(out + off, cb, m, res);
+
+            kmg2_add_section(hdr, KMG2_SECT_LEVEL, log2i(map_width(res)), off,
+                             quads_in_map(res));
+            off += quads_in_map(res);
+        }
+    }
+
+    return out;
 }
 
 static int save(const char *filename, context_t *cb, mipmap_t *m, image_t *img) {
-    int ok, res;
     FILE    *fp;
+    kmg2_header_t hdr2;
+    uint8   *data;
+    int     count, format;
 
     fp = fopen(filename, "wb");
 
@@ -400,77 +545,70 @@ static int save(const char *filename, context_t *cb, mipmap_t *m, image_t *img)
         return -errno;
     }
 
-    if(use_kmg) {
-        kmg_header_t    hdr;
+    memset(&hdr2, 0, sizeof(hdr2));
+    data = build_texture(cb, m, &hdr2, &count);
 
-        memset(&hdr, 0, sizeof(hdr));
-        hdr.magic = KMG_MAGIC;
-        hdr.version = KMG_VERSION;
-        hdr.platform = KMG_PLAT_DC;
-
-        if(use_alpha == 1)
-            hdr.format = KMG_DCFMT_ARGB4444 | KMG_DCFMT_VQ;
-        else if(use_alpha == 2)
-            hdr.format = KMG_DCFMT_ARGB1555 | KMG_DCFMT_VQ;
-        else
-            hdr.format = KMG_DCFMT_RGB565 | KMG_DCFMT_VQ;
+    if(data == NULL) {
+        fprintf(stderr, "FATAL: out of memory writing %s\n", filename);
+        goto loser;
+    }
 
-        if(use_twiddle)
-            hdr.format |= KMG_DCFMT_TWIDDLED;
+    if(use_alpha == 1)
+        format = KMG_DCFMT_ARGB4444 | KMG_DCFMT_VQ;
+    else if(use_alpha == 2)
+        format = KMG_DCFMT_ARGB1555 | KMG_DCFMT_VQ;
+    else
+        format = KMG_DCFMT_RGB565 | KMG_DCFMT_VQ;
 
-        if(use_mipmap)
-            hdr.format |= KMG_DCFMT_MIPMAP;
+    if(use_twiddle)
+        format |= KMG_DCFMT_TWIDDLED;
 
-        hdr.width = img->w;
-        hdr.height = img->h;
-        hdr.byte_count = 2048 + (use_mipmap ? 1 : 0);
+    if(use_mipmap)
+        format |= KMG_DCFMT_MIPMAP;
 
-        for(res = 0; res < MAX_MIPMAP; res++) {
-            if(m->map[res] != NULL) {
-                hdr.byte_count += quads_in_map(res);
-            }
-        }
+    if(use_v2) {
+        hdr2.platform = KMG_PLAT_DC;
+        hdr2.format = format;
+        hdr2.width = img->w;
+        hdr2.height = img->h;
+        hdr2.byte_count = count;
 
-        if(fwrite(&hdr, sizeof(hdr), 1, fp) != 1) {
-            fprintf(stderr, "FATAL: can't write KMG header to %s\n", filename);
+        if(kmg2_write(fp, &hdr2, data, 1) < 0) {
+            fprintf(stderr, "FATAL: can't write KMG to %s\n", filename);
             goto loser;
         }
     }
+    else {
+        if(use_kmg) {
+            kmg_header_t    hdr;
+
+            memset(&hdr, 0, sizeof(hdr));
+            hdr.magic = KMG_MAGIC;
+            hdr.version = KMG_VERSION;
+            hdr.platform = KMG_PLAT_DC;
+            hdr.format = format;
+            hdr.width = img->w;
+            hdr.height = img->h;
+            hdr.byte_count = count;
+
+            if(fwrite(&hdr, sizeof(hdr), 1, fp) != 1) {
+                fprintf(stderr, "FATAL: can't write KMG header to %s\n", filename);
+                goto loser;
+            }
+        }
 
-    if(save_codebook(fp, cb) < 0) {
-        fprintf(stderr, "FATAL: failed writing codebook to %s\n", filename);
-        goto loser;
-    }
-
-    /* dummy byte (0) must be included in square mipmaps */
-    if(use_mipmap) {
-        if(fputc('\0', fp) == EOF) {
+        if(fwrite(data, count, 1, fp) != 1) {
             fprintf(stderr, "FATAL: error writing %s\n", filename);
             goto loser;
         }
     }
 
-    for(res = 0; res < MAX_MIPMAP; res++) {
-        /* write each valid map down, if output is required
-         * as twiddled, mess it up before saving to disk
-         */
-        if(m->map[res] != NULL) {
-            if(use_twiddle)
-                ok = write_twiddled(fp, cb, m, res);
-            else
-                ok = write_linear(fp, cb, m, res);
-
-            if(ok < 0) {
-                fprintf(stderr, "FATAL: error writing index data to %s\n", filename);
-                goto loser;
-            }
-        }
-    }
-
+    free(data);
     fclose(fp);
     return 0;
 
 loser:
+    free(data);
     fclose(fp);
     unlink(filename);
     return -1;
@@ -487,8 +625,19 @@ static void banner(const char *progname) {
     printf("\t-d, --debug\tshow debug information\n");
     printf("\t-q, --highq\thigher quality (much slower)\n");
     printf("\t-k, --kmg\twrite a KMG for output\n");
+    printf("\t-2, --v2\twrite a compressed version 2 KMG\n");
     printf("\t-a, --alpha\tuse alpha channel (and output ARGB4444)\n");
     printf("\t-b, --amask\tuse 1-bit alpha mask (and output ARGB1555)\n");
+    printf("\t-j, --jobs N\ttrain the codebook with N threads, or encode\n");
+    printf("\t\t\tN images at once with --batch\n");
+    printf("\t--batch LIST\tencode every image in a directory or manifest\n");
+    printf("\t--cache DIR\treuse outputs of unchanged images in batch mode\n");
+    printf("\t--video OUT\tencode the images as the frames of a VQV video\n");
+    printf("\t--fps N[/D]\tvideo frame rate (default 30)\n");
+    printf("\t--keyint N\tvideo key frame at least every N frames (default 30)\n");
+    printf("\n");
+    printf("Output does not depend on -j, but differs slightly from vqenc\n");
+    printf("versions before -j was added; see vqenc(1).\n");
 }
 
 static int mipmap_index(int s) {
@@ -665,6 +814,7 @@ static void place_quads(context_t *cb, mipmap_t *m) {
      */
 
     reset_codebook(cb);
+    update_search(cb);
 
     for(j = 0; j < (use_hq ? 3 : 1); j++) {
         for(i = 0; i < MAX_MIPMAP; i++) {
@@ -683,6 +833,28 @@ static void place_quads(context_t *cb, mipmap_t *m) {
 }
 
 
+/* build a codebook for the mipmap from scratch */
+static void train_codebook(context_t *cb, mipmap_t *m) {
+    int i;
+
+    new_context(cb);
+
+    /* feed all quads (all resolutions) */
+    place_quads(cb, m);
+
+    /* starting with one codebook entry, split 7 times */
+    for(i = 1; i <= 7; i++) {
+        if(use_verbose) {
+            printf("o");
+        }
+
+        split(cb);
+        place_quads(cb, m);
+    }
+
+    split(cb);
+}
+
 static const char *figure_outfilename(const char *f, const char *newext) {
     char *newname;
     char *ext;
@@ -719,8 +891,12 @@ static void destroy_image(image_t *image) {
     }
 }
 
+static const char *output_name(const char *infile) {
+    return figure_outfilename(infile, use_kmg ? "kmg" : "vq");
+}
+
 static int encode(const char *infile) {
-    int     i, ok;
+    int     ok;
     image_t     image;
     mipmap_t    mipmap;
     context_t   context;
@@ -753,33 +929,15 @@ static int encode(const char *infile) {
         return -EINVAL;
     }
 
-    if(use_kmg)
-        outfile = figure_outfilename(infile, "kmg");
-    else
-        outfile = figure_outfilename(infile, "vq");
+    outfile = output_name(infile);
 
     if(outfile == NULL) {
         fprintf(stderr, "memory allocation failed for %s\n", infile);
         return -ENOMEM;
     }
 
-    new_context(&context);
     build_mipmap(&mipmap, &image);
-
-    /* feed all quads (all resolutions) */
-    place_quads(&context, &mipmap);
-
-    /* starting with one codebook entry, split 7 times */
-    for(i = 1; i <= 7; i++) {
-        if(use_verbose) {
-            printf("o");
-        }
-
-        split(&context);
-        place_quads(&context, &mipmap);
-    }
-
-    split(&context);
+    train_codebook(&context, &mipmap);
 
     if(use_verbose) {
         printf("\n");
@@ -789,9 +947,373 @@ static int encode(const char *infile) {
 
     destroy_mipmap(&mipmap);
     destroy_image(&image);
+    free((void *)outfile);
     return ok;
 }
 
+static int encode_batch(void) {
+    batch_tool_t tool;
+    char options[64];
+    int workers;
+
+    snprintf(options, sizeof(options), "m%d t%d q%d k%d a%d v%d", use_mipmap,
+             use_twiddle, use_hq, use_kmg, use_alpha, use_v2 ? 2 : 1);
+
+    tool.name = "vqenc";
+    tool.revision = VQENC_REVISION;
+    tool.options = options;
+    tool.encode = encode;
+    tool.output_name = output_name;
+
+    /* whole images are spread over the jobs instead of codebook training */
+    workers = use_jobs;
+    use_jobs = 1;
+
+    return batch_run(&tool, batch_list, batch_cache, workers) == 0 ? 0 : -1;
+}
+
+/********************************************************************/
+/* VQ video */
+
+/* at most this many codebook entries change in a delta frame */
+#define VIDEO_UPDATES   96
+
+/* smallest move (squared) worth sending for a code used only once */
+#define VIDEO_MIN_MOVE  16.0f
+
+/* a delta frame coded this many times worse than the frame before it is
+   taken for a scene cut and made a key frame itself */
+#define VIDEO_CUT_RATIO 2.0
+
+/* adapt the codebook to the next frame without moving any entry, so only
+ * the entries that really changed have to be sent.  every code follows the
+ * quads it was picked for, but only the VIDEO_UPDATES moves that help the
+ * most are kept; unused codes are moved onto the worst fitting quads.
+ */
+static void refine_codebook(context_t *cb, mipmap_t *m) {
+    float gain[256];
+    fquad_t next[256];
+    int i, j, best, worst, moved;
+    code_t *e;
+
+    for(i = cb->in_use; i < 256; i++) {
+        reset_code(&cb->codes[i]);
+        clear_quad(&cb->codes[i].value);
+        cb->codes[i].index = i;
+    }
+
+    cb->in_use = 256;
+    reset_codebook(cb);
+    update_search(cb);
+
+    for(i = 0; i < MAX_MIPMAP; i++) {
+        if(m->map[i] != NULL)
+            place(cb, m->map[i], quads_in_map(i));
+    }
+
+    for(i = 0, e = cb->codes; i < 256; i++, e++) {
+        gain[i] = 0.0f;
+
+        if(e->st.pos_count > 0) {
+            avg_dquad(&next[i], &e->st.pos_sum, e->st.pos_count);
+            gain[i] = vq_dist2(&e->value, &next[i]) * e->st.pos_count;
+        }
+    }
+
+    for(moved = 0; moved < VIDEO_UPDATES; moved++) {
+        best = -1;
+
+        for(i = 0; i < 256; i++) {
+            if(gain[i] >= VIDEO_MIN_MOVE && (best < 0 || gain[i] > gain[best]))
+                best = i;
+        }
+
+        if(best < 0)
+            break;
+
+        copy_quad(&cb->codes[best].value, &next[best]);
+        gain[best] = 0.0f;
+    }
+
+    for(i = 0; i < 256 && moved < VIDEO_UPDATES; i++) {
+        if(cb->codes[i].st.pos_count > 0)
+            continue;
+
+        worst = -1;
+
+        for(j = 0, e = cb->codes; j < 256; j++, e++) {
+            if(e->st.pos_count > 1 && (worst < 0 ||
+                    e->st.max_dist > cb->codes[worst].st.max_dist))
+                worst = j;
+        }
+
+        if(worst < 0 || cb->codes[worst].st.max_dist < VIDEO_MIN_MOVE)
+            break;
+
+        copy_quad(&cb->codes[i].value, &cb->codes[worst].st.max_dist_vec);
+        cb->codes[worst].st.max_dist = 0.0f;
+        moved++;
+    }
+}
+
+/* mean squared error of a frame coded with the current codebook */
+static double frame_error(context_t *cb, mipmap_t *m, int res) {
+    double total = 0.0;
+    int i, nquads;
+
+    nquads = quads_in_map(res);
+
+    for(i = 0; i < nquads; i++)
+        total += vq_dist2(&m->map[res][i], &cb->codes[find(cb, &m->map[res][i])].value);
+
+    return total / nquads;
+}
+
+static void put_le16(uint8 *p, uint16 v) {
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+
+/* lay out one frame as a chunk in buf, which must hold a key chunk */
+static int build_chunk(uint8 *buf, context_t *cb, mipmap_t *m, int res,
+                       int frame, int key, uint16 *prev, uint16 *cur) {
+    vqv_chunk_t chunk;
+    uint8 *p;
+    int *twiddled;
+    int i, j, nquads;
+
+    memset(buf, 0, VQV_CHUNK_HDR_SIZE + VQV_CODEBOOK_SIZE);
+    p = buf + VQV_CHUNK_HDR_SIZE;
+    chunk.updates = 0;
+
+    for(i = 0; i < 256; i++) {
+        if(!key && !memcmp(&prev[i * 4], &cur[i * 4], 4 * sizeof(uint16)))
+            continue;
+
+        if(!key) {
+            put_le16(p, i);
+            p += 2;
+        }
+
+        for(j = 0; j < 4; j++, p += 2)
+            put_le16(p, cur[i * 4 + j]);
+
+        chunk.updates++;
+    }
+
+    nquads = quads_in_map(res);
+    twiddled = twiddle_twiddle(map_width(res) / 2);
+
+    if(twiddled == NULL)
+        return -ENOMEM;
+
+    chunk.frame = frame;
+    chunk.flags = key ? VQV_CHUNK_KEY : 0;
+    chunk.index_offset = ((p - buf) + 31) & ~31;
+    chunk.index_size = nquads;
+    chunk.size = (chunk.index_offset + nquads + VQV_SECTOR - 1) &
+                 ~(VQV_SECTOR - 1);
+
+    memset(p, 0, buf + chunk.size - p);
+
+    for(i = 0; i < nquads; i++)
+        buf[chunk.index_offset + i] = find(cb, &m->map[res][twiddled[i]]);
+
+    free(twiddled);
+    vqv_write_chunk(&chunk, buf);
+    return chunk.size;
+}
+
+/* read the file back through the container code the player uses */
+static int verify_video(const char *outfile, int nframes) {
+    vqv_header_t hdr;
+    vqv_state_t *st;
+    vqv_chunk_t chunk;
+    uint8 *buf;
+    FILE *fp;
+    int i, rv = -1;
+
+    if((fp = fopen(outfile, "rb")) == NULL)
+        return -1;
+
+    buf = (uint8 *)malloc(VQV_SECTOR);
+    st = (vqv_state_t *)malloc(sizeof(vqv_state_t));
+
+    if(buf == NULL || st == NULL || fread(buf, VQV_SECTOR, 1, fp) != 1 ||
+       vqv_parse_header(buf, VQV_SECTOR, &hdr) < 0 ||
+       (int)hdr.frame_count != nframes)
+        goto out;
+
+    free(buf);
+
+    if((buf = (uint8 *)malloc(hdr.max_chunk)) == NULL)
+        goto out;
+
+    vqv_init(st, &hdr);
+
+    for(i = 0; i < nframes; i++) {
+        if(fread(buf, VQV_SECTOR, 1, fp) != 1 ||
+           vqv_parse_chunk(&hdr, buf, &chunk) < 0 ||
+           (chunk.size > VQV_SECTOR &&
+            fread(buf + VQV_SECTOR, chunk.size - VQV_SECTOR, 1, fp) != 1) ||
+           vqv_decode_chunk(st, buf, chunk.size) < 0 ||
+           (int)st->frame != i)
+            goto out;
+    }
+
+    rv = fgetc(fp) == EOF ? 0 : -1;
+
+out:
+    free(buf);
+    free(st);
+    fclose(fp);
+    return rv;
+}
+
+static int load_frame(const char *infile, image_t *image, int size) {
+    if(get_image(infile, image) < 0) {
+        fprintf(stderr, "failed reading %s\n", infile);
+        return -EINVAL;
+    }
+
+    if(image->w != image->h || valid_size(image->w) == 0 || image->w < 8 ||
+       (size && image->w != size)) {
+        fprintf(stderr, "%s: frames must be square, all the same size, and "
+                "a power of two from 8 to 1024\n", infile);
+        destroy_image(image);
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+static int encode_video(int nframes, char *frames[]) {
+    static context_t context;
+    static vqv_state_t check;
+    vqv_header_t hdr;
+    image_t image;
+    mipmap_t mipmap;
+    uint16 prev[256 * 4], cur[256 * 4];
+    uint8 *buf = NULL;
+    FILE *fp;
+    double err, last_err = 0.0;
+    int f, key, res, size, updates, i;
+
+    if((fp = fopen(video_out, "wb")) == NULL) {
+        fprintf(stderr, "FATAL: cannot create %s\n", video_out);
+        return -errno;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    memset(prev, 0, sizeof(prev));
+    hdr.format = use_alpha == 1 ? VQV_FMT_ARGB4444 :
+                 use_alpha == 2 ? VQV_FMT_ARGB1555 : VQV_FMT_RGB565;
+    hdr.frame_count = nframes;
+    hdr.fps_num = video_fps_num;
+    hdr.fps_den = video_fps_den;
+    hdr.key_interval = video_keyint;
+
+    for(f = 0; f < nframes; f++) {
+        if(use_verbose)
+            printf("frame %d: %s.. ", f, frames[f]);
+
+        if(load_frame(frames[f], &image, hdr.width) < 0)
+            goto loser;
+
+        if(f == 0) {
+            hdr.width = hdr.height = image.w;
+
+            /* delta chunks are never bigger than key chunks */
+            size = VQV_CHUNK_HDR_SIZE + VQV_CODEBOOK_SIZE + image.w * image.h / 4;
+            hdr.max_chunk = (size + VQV_SECTOR - 1) & ~(VQV_SECTOR - 1);
+            buf = (uint8 *)malloc(hdr.max_chunk);
+
+            if(buf == NULL) {
+                destroy_image(&image);
+                goto loser;
+            }
+
+            vqv_write_header(&hdr, buf);
+
+            if(fwrite(buf, VQV_SECTOR, 1, fp) != 1) {
+                destroy_image(&image);
+                goto loser;
+            }
+
+            vqv_init(&check, &hdr);
+        }
+
+        build_mipmap(&mipmap, &image);
+        res = mipmap_index(image.w);
+        destroy_image(&image);
+
+        key = (f % video_keyint) == 0;
+
+        if(key)
+            train_codebook(&context, &mipmap);
+        else
+            refine_codebook(&context, &mipmap);
+
+        update_search(&context);
+        err = frame_error(&context, &mipmap, res);
+
+        /* a codebook that fits this badly means a scene cut, so start over */
+        if(!key && err > last_err * VIDEO_CUT_RATIO + VIDEO_MIN_MOVE) {
+            key = 1;
+            train_codebook(&context, &mipmap);
+            update_search(&context);
+            err = frame_error(&context, &mipmap, res);
+        }
+
+        last_err = err;
+        pack_codebook(&context, cur);
+
+        for(i = updates = 0; i < 256; i++)
+            updates += !!memcmp(&prev[i * 4], &cur[i * 4], 4 * sizeof(uint16));
+
+        size = build_chunk(buf, &context, &mipmap, res, f, key, prev, cur);
+        destroy_mipmap(&mipmap);
+
+        if(size < 0)
+            goto loser;
+
+        /* the decoder must end up with exactly the codebook we used */
+        if(vqv_decode_chunk(&check, buf, size) < 0 ||
+           memcmp(check.codebook, cur, sizeof(cur))) {
+            fprintf(stderr, "FATAL: frame %d doesn't decode\n", f);
+            goto loser;
+        }
+
+        if(fwrite(buf, size, 1, fp) != 1) {
+            fprintf(stderr, "FATAL: error writing %s\n", video_out);
+            goto loser;
+        }
+
+        memcpy(prev, cur, sizeof(cur));
+
+        if(use_verbose)
+            printf("%s, %d bytes, error %.5f\n",
+                   key ? "key" : updates ? "delta" : "indices", size, err);
+    }
+
+    free(buf);
+    fclose(fp);
+
+    if(verify_video(video_out, nframes) < 0) {
+        fprintf(stderr, "FATAL: %s doesn't read back correctly\n", video_out);
+        unlink(video_out);
+        return -1;
+    }
+
+    return 0;
+
+loser:
+    free(buf);
+    fclose(fp);
+    unlink(video_out);
+    return -1;
+}
+
 static int process_long_options(char *arg) {
     if(! strcmp(arg, "mipmap"))
         use_mipmap = 1;
@@ -805,6 +1327,8 @@ static int process_long_options(char *arg) {
         use_hq = 1;
     else if(! strcmp(arg, "kmg"))
         use_kmg = 1;
+    else if(! strcmp(arg, "v2"))
+        use_v2 = 1;
     else if(! strcmp(arg, "alpha"))
         use_alpha = 1;
     else if(! strcmp(arg, "amask"))
@@ -845,6 +1369,10 @@ static int process_option(char *arg) {
             use_kmg = 1;
             return 0;
 
+        case '2':
+            use_v2 = 1;
+            return 0;
+
         case 'a':
             use_alpha = 1;
             return 0;
@@ -860,12 +1388,104 @@ static int process_option(char *arg) {
     return -EINVAL;
 }
 
+static int process_fps(const char *arg) {
+    char *end;
+    long num, den = 1;
+
+    if(arg == NULL)
+        return -EINVAL;
+
+    num = strtol(arg, &end, 10);
+
+    if(*end == '/')
+        den = strtol(end + 1, &end, 10);
+
+    if(*end != '\0' || num < 1 || den < 1)
+        return -EINVAL;
+
+    video_fps_num = num;
+    video_fps_den = den;
+    return 0;
+}
+
+static int process_jobs(const char *arg) {
+    char *end;
+    long n;
+
+    if(arg == NULL)
+        return -EINVAL;
+
+    n = strtol(arg, &end, 10);
+
+    if(*end != '\0' || n < 1)
+        return -EINVAL;
+
+    use_jobs = n > MAX_JOBS ? MAX_JOBS : (int)n;
+    return 0;
+}
+
+/* options that take a value from the next argument; returns -EINVAL for a
+   bad value, 0 if arg isn't one of them, or 1 if it was handled */
+static int process_arg_option(const char *arg, const char *value) {
+    if(!strcmp(arg, "-j") || !strcmp(arg, "--jobs")) {
+        if(process_jobs(value) < 0) {
+            fprintf(stderr, "%s requires a positive job count\n", arg);
+            return -EINVAL;
+        }
+    }
+    else if(!strcmp(arg, "--fps")) {
+        if(process_fps(value) < 0) {
+            fprintf(stderr, "--fps requires a rate like 30 or 30000/1001\n");
+            return -EINVAL;
+        }
+    }
+    else if(!strcmp(arg, "--keyint")) {
+        if(value == NULL || (video_keyint = atoi(value)) < 1) {
+            fprintf(stderr, "--keyint requires a positive frame count\n");
+            return -EINVAL;
+        }
+    }
+    else if(!strcmp(arg, "--video")) {
+        if(value == NULL) {
+            fprintf(stderr, "--video requires a path\n");
+            return -EINVAL;
+        }
+
+        video_out = value;
+    }
+    else if(!strcmp(arg, "--batch") || !strcmp(arg, "--cache")) {
+        if(value == NULL) {
+            fprintf(stderr, "%s requires a path\n", arg);
+            return -EINVAL;
+        }
+
+        if(arg[2] == 'b')
+            batch_list = value;
+        else
+            batch_cache = value;
+    }
+    else
+        return 0;
+
+    return 1;
+}
+
 static int process(int argc, char *argv[]) {
-    int arg;
+    int arg, rv;
 
     arg = 1;
 
     while(arg < argc) {
+        rv = process_arg_option(argv[arg], arg + 1 < argc ? argv[arg + 1] : NULL);
+
+        if(rv < 0)
+            return rv;
+
+        if(rv > 0) {
+            arg += 2;
+            continue;
+        }
+
         if(argv[arg][0] == '-') {
             if(process_option(argv[arg]) < 0) {
                 fprintf(stderr, "invalid option %s\n", argv[arg]);
@@ -880,6 +1500,38 @@ static int process(int argc, char *argv[]) {
         break;
     }
 
+    /* version 2 is a KMG too */
+    if(use_v2)
+        use_kmg = 1;
+
+    if(batch_list) {
+        if(arg < argc) {
+            fprintf(stderr, "can't mix --batch with image files\n");
+            return -EINVAL;
+        }
+
+        return encode_batch();
+    }
+
+    if(video_out) {
+        if(arg >= argc) {
+            fprintf(stderr, "no frames to encode\n");
+            return -EINVAL;
+        }
+
+        if(use_mipmap || use_kmg) {
+            fprintf(stderr, "--video can't be used with -m or -k\n");
+            return -EINVAL;
+        }
+
+        return encode_video(argc - arg, argv + arg);
+    }
+
+    if(batch_cache) {
+        fprintf(stderr, "--cache only works with --batch\n");
+        return -EINVAL;
+    }
+
     if(arg >= argc) {
         fprintf(stderr, "no files to encode\n");
         return -EINVAL;
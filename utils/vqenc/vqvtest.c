@@ -0,0 +1,173 @@
+/* KallistiOS ##version##
+
+   vqvtest.c
+
+   Host tests for the libkosvqv container code. A key chunk and a delta chunk
+   are built and decoded, then chunk headers are damaged one field at a time
+   and must be rejected, including ones whose index data would only fit if
+   the offset arithmetic wrapped around.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vqv/vqv.h>
+#include "check.h"
+
+#define SIZE        64
+#define INDEX_SIZE  (SIZE * SIZE / 4)
+
+static uint8_t key[VQV_SECTOR * 2], delta[VQV_SECTOR];
+
+static void setup(vqv_header_t *hdr) {
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->format = VQV_FMT_RGB565;
+    hdr->width = SIZE;
+    hdr->height = SIZE;
+    hdr->frame_count = 2;
+    hdr->fps_num = 30;
+    hdr->fps_den = 1;
+    hdr->max_chunk = sizeof(key);
+    hdr->key_interval = 30;
+}
+
+/* a key chunk carrying the codebook 0, 1, 2... and a delta chunk that sets
+   entry 5 to 0xbeef */
+static void build(vqv_chunk_t *kc, vqv_chunk_t *dc) {
+    uint8_t *p;
+    int i;
+
+    memset(key, 0, sizeof(key));
+    memset(delta, 0, sizeof(delta));
+
+    kc->size = sizeof(key);
+    kc->frame = 0;
+    kc->flags = VQV_CHUNK_KEY;
+    kc->updates = VQV_CODES;
+    kc->index_offset = (VQV_CHUNK_HDR_SIZE + VQV_CODEBOOK_SIZE + 31) & ~31;
+    kc->index_size = INDEX_SIZE;
+
+    for(i = 0; i < VQV_CODES * 4; i++) {
+        key[VQV_CHUNK_HDR_SIZE + i * 2] = i & 0xff;
+        key[VQV_CHUNK_HDR_SIZE + i * 2 + 1] = i >> 8;
+    }
+
+    dc->size = sizeof(delta);
+    dc->frame = 1;
+    dc->flags = 0;
+    dc->updates = 1;
+    dc->index_offset = 64;
+    dc->index_size = INDEX_SIZE;
+
+    p = delta + VQV_CHUNK_HDR_SIZE;
+    p[0] = 5;
+
+    for(i = 0; i < 4; i++) {
+        p[2 + i * 2] = 0xef;
+        p[3 + i * 2] = 0xbe;
+    }
+
+    vqv_write_chunk(kc, key);
+    vqv_write_chunk(dc, delta);
+}
+
+static void test_decode(const vqv_header_t *hdr) {
+    vqv_chunk_t kc, dc;
+    vqv_state_t st;
+
+    build(&kc, &dc);
+    vqv_init(&st, hdr);
+
+    CHECK(vqv_decode_chunk(&st, delta, sizeof(delta)) < 0,
+          "delta chunk decoded before a key chunk");
+
+    CHECK(vqv_decode_chunk(&st, key, sizeof(key)) == 0, "key chunk rejected");
+    CHECK(st.codebook[21] == 21 && st.indices == key + kc.index_offset &&
+          st.index_size == INDEX_SIZE, "key chunk decoded wrongly");
+
+    CHECK(vqv_decode_chunk(&st, key, sizeof(key) - 1) < 0,
+          "truncated key chunk decoded");
+
+    CHECK(vqv_decode_chunk(&st, delta, sizeof(delta)) == 0,
+          "delta chunk rejected");
+    CHECK(st.frame == 1 && st.codebook[20] == 0xbeef &&
+          st.codebook[23] == 0xbeef && st.codebook[24] == 24 &&
+          st.indices == delta + dc.index_offset, "delta chunk decoded wrongly");
+
+    /* an update for an entry that doesn't exist leaves the codebook alone */
+    delta[VQV_CHUNK_HDR_SIZE + 1] = 1;
+    CHECK(vqv_decode_chunk(&st, delta, sizeof(delta)) < 0,
+          "update to entry 261 accepted");
+    CHECK(st.codebook[20] == 0xbeef, "rejected update changed the codebook");
+}
+
+/* write a damaged copy of chunk c and check the header is rejected */
+static void expect_bad(const vqv_header_t *hdr, vqv_chunk_t c,
+                       const char *what) {
+    uint8_t buf[VQV_CHUNK_HDR_SIZE];
+    vqv_chunk_t out;
+
+    vqv_write_chunk(&c, buf);
+    CHECK(vqv_parse_chunk(hdr, buf, &out) < 0, "%s accepted", what);
+}
+
+static void test_malformed(const vqv_header_t *hdr) {
+    vqv_chunk_t kc, dc, c;
+    uint8_t buf[VQV_CHUNK_HDR_SIZE];
+
+    build(&kc, &dc);
+
+    vqv_write_chunk(&kc, buf);
+    CHECK(vqv_parse_chunk(hdr, buf, &c) == 0, "good key header rejected");
+
+    c = kc;
+    buf[0] ^= 1;
+    CHECK(vqv_parse_chunk(hdr, buf, &c) < 0, "bad magic accepted");
+
+    c = kc; c.size = VQV_SECTOR * 3;
+    expect_bad(hdr, c, "chunk over max_chunk");
+
+    c = kc; c.size = VQV_SECTOR + 1;
+    expect_bad(hdr, c, "unaligned chunk size");
+
+    c = kc; c.updates = VQV_CODES - 1;
+    expect_bad(hdr, c, "short key codebook");
+
+    c = dc; c.updates = VQV_CODES + 1;
+    expect_bad(hdr, c, "too many updates");
+
+    c = kc; c.index_offset += 4;
+    expect_bad(hdr, c, "unaligned index data");
+
+    c = kc; c.index_offset = VQV_CHUNK_HDR_SIZE;
+    expect_bad(hdr, c, "index data over the codebook");
+
+    c = kc; c.index_size = INDEX_SIZE / 2;
+    expect_bad(hdr, c, "wrong index size");
+
+    c = kc; c.index_offset = kc.size - INDEX_SIZE + 32;
+    expect_bad(hdr, c, "index data past the chunk");
+
+    c = kc; c.index_offset = kc.size + 32;
+    expect_bad(hdr, c, "index offset past the chunk");
+
+    /* offset + size wraps to something inside the chunk */
+    c = kc; c.index_offset = 0xffffffe0;
+    expect_bad(hdr, c, "wrapping index offset");
+
+    c = kc; c.index_offset = 0u - INDEX_SIZE;
+    expect_bad(hdr, c, "index offset wrapping to 0");
+}
+
+int main(int argc, char *argv[]) {
+    vqv_header_t hdr;
+
+    (void)argc;
+    (void)argv;
+
+    setup(&hdr);
+    test_decode(&hdr);
+    test_malformed(&hdr);
+
+    return check_done();
+}
@@ -0,0 +1,149 @@
+/*
+    aica adpcm coder;
+
+    (c) 2002 BERO <bero@geocities.co.jp>
+    under GPL or notify me
+
+    aica adpcm seems same as YMZ280B adpcm
+    adpcm->pcm algorithm can found MAME/src/sound/ymz280b.c by Aaron Giles
+
+    Split out of wav2adpcm.c and reworked to code a block at a time, with
+    the per-sample division and clamping branches taken out of the encoder.
+    The output is the same as that of the original code.
+*/
+
+#include "adpcm.h"
+
+static const int diff_lookup[16] = {
+    1, 3, 5, 7, 9, 11, 13, 15,
+    -1, -3, -5, -7, -9, -11, -13, -15,
+};
+
+static const int index_scale[16] = {
+    0x0e6, 0x0e6, 0x0e6, 0x0e6, 0x133, 0x199, 0x200, 0x266,
+    0x0e6, 0x0e6, 0x0e6, 0x0e6, 0x133, 0x199, 0x200, 0x266 /* same value for speedup */
+};
+
+/* written so it comes out as conditional moves rather than branches */
+static inline int limit(int val, int min, int max) {
+    val = val < min ? min : val;
+    return val > max ? max : val;
+}
+
+static inline void update(adpcm_state_t *st, int val) {
+    st->signal = limit(st->signal + (st->step * diff_lookup[val]) / 8,
+                       -32768, 32767);
+    st->step = limit((st->step * index_scale[val]) >> 8, 0x7f, 0x6000);
+}
+
+/* The original encoder worked out each code as
+
+       diff = ((sample - signal) * 8) / step;
+       val = min(abs(diff) / 2, 7) + (diff < 0 ? 8 : 0);
+
+   abs(diff) / 2 is floor(4 * |sample - signal| / step), which is just how
+   many of step, 2 * step, ... 7 * step fit in 4 * |sample - signal|, and
+   diff is only negative if the difference is and |diff| is at least 1. The
+   compares are independent of each other, unlike a division. */
+static inline int encode_sample(adpcm_state_t *st, int sample) {
+    int d = sample - st->signal;
+    int mag = d < 0 ? -d : d;
+    int q = mag * 4, s = st->step;
+    int val;
+
+    val = (q >= s) + (q >= 2 * s) + (q >= 3 * s) + (q >= 4 * s) +
+          (q >= 5 * s) + (q >= 6 * s) + (q >= 7 * s);
+    val |= ((d < 0) & (mag * 8 >= s)) << 3;
+
+    update(st, val);
+    return val;
+}
+
+void adpcm_init(adpcm_state_t *st) {
+    st->signal = 0;
+    st->step = 0x7f;
+}
+
+void adpcm_encode(adpcm_state_t *st, unsigned char *dst, const short *src,
+                  size_t len) {
+    adpcm_state_t s = *st;
+    int data;
+
+    for(len /= 2; len; len--, src += 2) {
+        data = encode_sample(&s, src[0]);
+        data |= encode_sample(&s, src[1]) << 4;
+        *dst++ = data;
+    }
+
+    *st = s;
+}
+
+/* The two channels don't depend on each other, so coding them in the same
+   loop gives the CPU two chains of work to overlap instead of one. */
+void adpcm_encode_stereo(adpcm_state_t *st, unsigned char *left,
+                         unsigned char *right, const short *src,
+                         size_t frames) {
+    adpcm_state_t l = st[0], r = st[1];
+    int ldata, rdata;
+
+    for(frames /= 2; frames; frames--, src += 4) {
+        ldata = encode_sample(&l, src[0]);
+        rdata = encode_sample(&r, src[1]);
+        ldata |= encode_sample(&l, src[2]) << 4;
+        rdata |= encode_sample(&r, src[3]) << 4;
+        *left++ = ldata;
+        *right++ = rdata;
+    }
+
+    st[0] = l;
+    st[1] = r;
+}
+
+void adpcm_decode(adpcm_state_t *st, short *dst, const unsigned char *src,
+                  size_t len) {
+    adpcm_state_t s = *st;
+
+    for(; len; len--, src++) {
+        /* low nibble first */
+        update(&s, *src & 15);
+        *dst++ = s.signal;
+        update(&s, *src >> 4);
+        *dst++ = s.signal;
+    }
+
+    *st = s;
+}
+
+void adpcm_decode_stereo(adpcm_state_t *st, short *dst,
+                         const unsigned char *left,
+                         const unsigned char *right, size_t len) {
+    adpcm_state_t l = st[0], r = st[1];
+
+    for(; len; len--, left++, right++, dst += 4) {
+        update(&l, *left & 15);
+        update(&r, *right & 15);
+        dst[0] = l.signal;
+        dst[1] = r.signal;
+        update(&l, *left >> 4);
+        update(&r, *right >> 4);
+        dst[2] = l.signal;
+        dst[3] = r.signal;
+    }
+
+    st[0] = l;
+    st[1] = r;
+}
+
+void pcm2adpcm(unsigned char *dst, const short *src, size_t length) {
+    adpcm_state_t st;
+
+    adpcm_init(&st);
+    adpcm_encode(&st, dst, src, length / 4 * 2);
+}
+
+void adpcm2pcm(short *dst, const unsigned char *src, size_t length) {
+    adpcm_state_t st;
+
+    adpcm_init(&st);
+    adpcm_decode(&st, dst, src, length);
+}
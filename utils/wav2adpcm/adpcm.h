@@ -0,0 +1,51 @@
+/* KallistiOS ##version##
+
+   adpcm.h
+
+   AICA ADPCM coder for wav2adpcm. The coder keeps its state per channel, so
+   a long stream can be coded a block at a time and give exactly the same
+   result as coding it in one go.
+*/
+
+#ifndef __ADPCM_H
+#define __ADPCM_H
+
+#include <stddef.h>
+
+/* state of one channel, carried from one block to the next */
+typedef struct adpcm_state_t {
+    int signal;
+    int step;
+} adpcm_state_t;
+
+/* set a channel up for the start of a stream */
+void adpcm_init(adpcm_state_t *st);
+
+/* code len samples (len must be even) into len / 2 bytes, the first sample
+   of each pair in the low nibble */
+void adpcm_encode(adpcm_state_t *st, unsigned char *dst, const short *src,
+                  size_t len);
+
+/* code frames interleaved stereo frames (frames must be even) into separate
+   left and right streams of frames / 2 bytes each; st points to the left
+   and right channel state */
+void adpcm_encode_stereo(adpcm_state_t *st, unsigned char *left,
+                         unsigned char *right, const short *src,
+                         size_t frames);
+
+/* decode len bytes into 2 * len samples */
+void adpcm_decode(adpcm_state_t *st, short *dst, const unsigned char *src,
+                  size_t len);
+
+/* decode len bytes of each channel into 2 * len interleaved stereo frames */
+void adpcm_decode_stereo(adpcm_state_t *st, short *dst,
+                         const unsigned char *left,
+                         const unsigned char *right, size_t len);
+
+/* whole-buffer versions: pcm2adpcm codes length bytes of samples into
+   length / 4 bytes, and adpcm2pcm decodes length bytes into 2 * length
+   samples */
+void pcm2adpcm(unsigned char *dst, const short *src, size_t length);
+void adpcm2pcm(short *dst, const unsigned char *src, size_t length);
+
+#endif
@@ -0,0 +1,461 @@
+/* KallistiOS ##version##
+
+   adpcmtest.c
+
+   Host tests for the ADPCM coder in adpcm.c.
+
+   The original wav2adpcm coder is kept below as a reference. Signals of all
+   sorts are coded by both, and the output must be the same bit for bit, as
+   must the samples decoded from it, whether the data is coded in one go, a
+   block at a time or both stereo channels together.
+
+   Given the path of a wav2adpcm binary, whole files are also converted to
+   ADPCM and back with it, singly and with --batch, and checked against the
+   reference.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "adpcm.h"
+#include "check.h"
+
+/* The coder as it was in wav2adpcm.c */
+
+static int diff_lookup[16] = {
+    1, 3, 5, 7, 9, 11, 13, 15,
+    -1, -3, -5, -7, -9, -11, -13, -15,
+};
+
+static int index_scale[16] = {
+    0x0e6, 0x0e6, 0x0e6, 0x0e6, 0x133, 0x199, 0x200, 0x266,
+    0x0e6, 0x0e6, 0x0e6, 0x0e6, 0x133, 0x199, 0x200, 0x266
+};
+
+static inline int limit(int val, int min, int max) {
+    if(val < min) return min;
+    else if(val > max) return max;
+    else return val;
+}
+
+static void ref_pcm2adpcm(unsigned char *dst, const short *src, size_t length) {
+    int signal, step, i, data, val, diff;
+
+    signal = 0;
+    step = 0x7f;
+    length = (length + 3) / 4;
+
+    do {
+        data = 0;
+
+        for(i = 0; i < 2; i++) {
+            diff = *src++ - signal;
+            diff = (diff * 8) / step;
+
+            val = abs(diff) / 2;
+
+            if(val > 7) val = 7;
+
+            if(diff < 0) val += 8;
+
+            signal += (step * diff_lookup[val]) / 8;
+            signal = limit(signal, -32768, 32767);
+
+            step = (step * index_scale[val]) >> 8;
+            step = limit(step, 0x7f, 0x6000);
+
+            data |= val << (i * 4);
+        }
+
+        *dst++ = data;
+    }
+    while(--length);
+}
+
+static void ref_adpcm2pcm(short *dst, const unsigned char *src, size_t length) {
+    int signal, step, i, val;
+
+    signal = 0;
+    step = 0x7f;
+
+    do {
+        for(i = 0; i < 2; i++) {
+            val = (*src >> (i * 4)) & 15;
+
+            signal += (step * diff_lookup[val]) / 8;
+            signal = limit(signal, -32768, 32767);
+
+            step = (step * index_scale[val & 7]) >> 8;
+            step = limit(step, 0x7f, 0x6000);
+
+            *dst++ = signal;
+        }
+
+        src++;
+    }
+    while(--length);
+}
+
+/* Test signals. Each gives sample i of n; the random ones use rand(), which
+   fill() seeds so a signal comes out the same every time. */
+
+typedef struct signal {
+    const char *name;
+    short (*sample)(int i, int n);
+} signal_t;
+
+static short silence(int i, int n) {
+    (void)i;
+    (void)n;
+    return 0;
+}
+
+/* a sine sweeping up in pitch and loudness */
+static short sweep(int i, int n) {
+    return (short)(32767.0 * i / n * sin(i * (0.001 + 0.5 * i / n)));
+}
+
+static short noise(int i, int n) {
+    (void)i;
+    (void)n;
+    return (short)(rand() ^ (rand() << 15));
+}
+
+/* full scale, so the step size is pushed to its limits */
+static short square(int i, int n) {
+    (void)n;
+    return (i / 37) & 1 ? 32767 : -32768;
+}
+
+/* jumps between the extremes and zero */
+static short extremes(int i, int n) {
+    static const short levels[3] = { -32768, 32767, 0 };
+
+    (void)i;
+    (void)n;
+    return levels[rand() % 3];
+}
+
+/* a couple of tones with a little noise */
+static short music(int i, int n) {
+    (void)n;
+    return (short)(9000.0 * sin(i * 0.031) + 6000.0 * sin(i * 0.0071) +
+                   rand() % 512);
+}
+
+static const signal_t signals[] = {
+    { "silence", silence },
+    { "sweep", sweep },
+    { "noise", noise },
+    { "square", square },
+    { "extremes", extremes },
+    { "music", music },
+};
+
+#define SIGNALS (int)(sizeof(signals) / sizeof(signals[0]))
+
+static void fill(short *buf, int n, short (*sample)(int i, int n),
+                 unsigned int seed) {
+    int i;
+
+    srand(seed);
+
+    for(i = 0; i < n; i++)
+        buf[i] = sample(i, n);
+}
+
+static void test_mono(int len, const signal_t *sig) {
+    short *pcm, *ref_out, *out;
+    unsigned char *ref, *enc;
+    adpcm_state_t st;
+    int block, done, n;
+
+    pcm = malloc(len * sizeof(short));
+    ref_out = malloc(len * sizeof(short));
+    out = malloc(len * sizeof(short));
+    ref = malloc(len / 2);
+    enc = malloc(len / 2);
+    fill(pcm, len, sig->sample, len);
+
+    ref_pcm2adpcm(ref, pcm, len * 2);
+    ref_adpcm2pcm(ref_out, ref, len / 2);
+
+    pcm2adpcm(enc, pcm, len * 2);
+    CHECK(!memcmp(ref, enc, len / 2), "pcm2adpcm %s, %d samples",
+          sig->name, len);
+
+    adpcm2pcm(out, ref, len / 2);
+    CHECK(!memcmp(ref_out, out, len * sizeof(short)),
+          "adpcm2pcm %s, %d samples", sig->name, len);
+
+    /* odd sized blocks, so the coder state is carried over everywhere */
+    for(block = 2; block <= len; block = block * 7 + 2) {
+        memset(enc, 0, len / 2);
+        adpcm_init(&st);
+
+        for(done = 0; done < len; done += n) {
+            n = len - done < block ? len - done : block;
+            adpcm_encode(&st, enc + done / 2, pcm + done, n);
+        }
+
+        CHECK(!memcmp(ref, enc, len / 2), "encode %s, %d samples in %d",
+              sig->name, len, block);
+
+        memset(out, 0, len * sizeof(short));
+        adpcm_init(&st);
+
+        for(done = 0; done < len; done += n) {
+            n = len - done < block ? len - done : block;
+            adpcm_decode(&st, out + done, ref + done / 2, n / 2);
+        }
+
+        CHECK(!memcmp(ref_out, out, len * sizeof(short)),
+              "decode %s, %d samples in %d", sig->name, len, block);
+    }
+
+    free(pcm);
+    free(ref_out);
+    free(out);
+    free(ref);
+    free(enc);
+}
+
+static void test_stereo(int frames, const signal_t *lsig,
+                        const signal_t *rsig) {
+    short *l, *r, *pcm, *ref_l, *ref_r, *out;
+    unsigned char *ref, *enc;
+    adpcm_state_t st[2];
+    int i, ok = 1;
+
+    l = malloc(frames * sizeof(short));
+    r = malloc(frames * sizeof(short));
+    ref_l = malloc(frames * sizeof(short));
+    ref_r = malloc(frames * sizeof(short));
+    pcm = malloc(frames * 2 * sizeof(short));
+    out = malloc(frames * 2 * sizeof(short));
+    ref = malloc(frames);
+    enc = malloc(frames);
+    fill(l, frames, lsig->sample, 1);
+    fill(r, frames, rsig->sample, 2);
+
+    for(i = 0; i < frames; i++) {
+        pcm[i * 2] = l[i];
+        pcm[i * 2 + 1] = r[i];
+    }
+
+    ref_pcm2adpcm(ref, l, frames * 2);
+    ref_pcm2adpcm(ref + frames / 2, r, frames * 2);
+    ref_adpcm2pcm(ref_l, ref, frames / 2);
+    ref_adpcm2pcm(ref_r, ref + frames / 2, frames / 2);
+
+    adpcm_init(&st[0]);
+    adpcm_init(&st[1]);
+    adpcm_encode_stereo(st, enc, enc + frames / 2, pcm, frames);
+    CHECK(!memcmp(ref, enc, frames), "stereo encode %s/%s",
+          lsig->name, rsig->name);
+
+    adpcm_init(&st[0]);
+    adpcm_init(&st[1]);
+    adpcm_decode_stereo(st, out, ref, ref + frames / 2, frames / 2);
+
+    for(i = 0; i < frames; i++)
+        ok &= out[i * 2] == ref_l[i] && out[i * 2 + 1] == ref_r[i];
+
+    CHECK(ok, "stereo decode %s/%s", lsig->name, rsig->name);
+
+    free(l);
+    free(r);
+    free(ref_l);
+    free(ref_r);
+    free(pcm);
+    free(out);
+    free(ref);
+    free(enc);
+}
+
+/* Whole files through the wav2adpcm binary */
+
+static void put32(unsigned char *p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static void put16(unsigned char *p, uint16_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+/* a 16-bit WAV with a LIST chunk before the data, which has to be skipped */
+static int write_wav(const char *fn, const short *pcm, int frames,
+                     int channels) {
+    unsigned char hdr[56];
+    FILE *fp;
+    int size = frames * channels * 2, ok;
+
+    memcpy(hdr, "RIFF", 4);
+    put32(hdr + 4, size + sizeof(hdr) - 8);
+    memcpy(hdr + 8, "WAVEfmt ", 8);
+    put32(hdr + 16, 16);
+    put16(hdr + 20, 1);
+    put16(hdr + 22, channels);
+    put32(hdr + 24, 44100);
+    put32(hdr + 28, 44100 * channels * 2);
+    put16(hdr + 32, channels * 2);
+    put16(hdr + 34, 16);
+    memcpy(hdr + 36, "LIST", 4);
+    put32(hdr + 40, 4);
+    memcpy(hdr + 44, "INFO", 4);
+    memcpy(hdr + 48, "data", 4);
+    put32(hdr + 52, size);
+
+    if(!(fp = fopen(fn, "wb")))
+        return -1;
+
+    ok = fwrite(hdr, sizeof(hdr), 1, fp) == 1 &&
+         fwrite(pcm, size, 1, fp) == 1;
+    return fclose(fp) == 0 && ok ? 0 : -1;
+}
+
+/* the data of a converted file, which has a plain 44 byte header */
+static unsigned char *read_data(const char *fn, long *size) {
+    unsigned char *buf;
+    FILE *fp;
+
+    if(!(fp = fopen(fn, "rb")))
+        return NULL;
+
+    fseek(fp, 0, SEEK_END);
+    *size = ftell(fp) - 44;
+    fseek(fp, 44, SEEK_SET);
+
+    if(*size < 0 || !(buf = malloc(*size + 1)) ||
+       fread(buf, *size, 1, fp) != 1) {
+        fclose(fp);
+        return NULL;
+    }
+
+    fclose(fp);
+    return buf;
+}
+
+static int run(const char *tool, const char *args) {
+    char cmd[1024];
+
+    snprintf(cmd, sizeof(cmd), "%s %s", tool, args);
+    return system(cmd);
+}
+
+static void check_file(const char *name, const char *adpcm, const char *wav,
+                       const unsigned char *ref, long refsize,
+                       const short *ref_pcm, long pcmsize) {
+    unsigned char *data;
+    long size;
+
+    data = read_data(adpcm, &size);
+    CHECK(data && size == refsize && !memcmp(data, ref, size),
+          "%s: ADPCM data of %s", name, adpcm);
+    free(data);
+
+    data = read_data(wav, &size);
+    CHECK(data && size == pcmsize && !memcmp(data, ref_pcm, size),
+          "%s: samples of %s", name, wav);
+    free(data);
+}
+
+static void test_files(const char *tool) {
+    /* more than one of wav2adpcm's blocks, and an odd number of frames */
+    const int frames = 200001;
+    short *l, *r, *pcm, *ref_pcm, *ref_l, *ref_r;
+    unsigned char *ref;
+    int i, half = frames / 2;
+
+    l = malloc(frames * sizeof(short));
+    r = malloc(frames * sizeof(short));
+    pcm = malloc(frames * 2 * sizeof(short));
+    ref_pcm = malloc(frames * 2 * sizeof(short));
+    ref_l = malloc(frames * sizeof(short));
+    ref_r = malloc(frames * sizeof(short));
+    ref = malloc(frames);
+    fill(l, frames, music, 3);
+    fill(r, frames, sweep, 4);
+
+    for(i = 0; i < frames; i++) {
+        pcm[i * 2] = l[i];
+        pcm[i * 2 + 1] = r[i];
+    }
+
+    if(system("mkdir -p adpcmtest.tmp/out adpcmtest.tmp/back") ||
+       write_wav("adpcmtest.tmp/mono.wav", l, frames, 1) ||
+       write_wav("adpcmtest.tmp/stereo.wav", pcm, frames, 2)) {
+        CHECK(0, "can't write test files");
+        return;
+    }
+
+    /* the final odd sample of each channel is dropped */
+    ref_pcm2adpcm(ref, l, half * 4);
+    ref_adpcm2pcm(ref_pcm, ref, half);
+
+    CHECK(!run(tool, "-t adpcmtest.tmp/mono.wav adpcmtest.tmp/mono.adpcm") &&
+          !run(tool, "-f adpcmtest.tmp/mono.adpcm adpcmtest.tmp/mono.out"),
+          "mono conversion failed");
+    check_file("mono", "adpcmtest.tmp/mono.adpcm", "adpcmtest.tmp/mono.out",
+               ref, half, ref_pcm, half * 4);
+
+    CHECK(!run(tool, "-t -j 2 --batch adpcmtest.tmp/out "
+               "adpcmtest.tmp/mono.wav adpcmtest.tmp/stereo.wav") &&
+          !run(tool, "-f --batch adpcmtest.tmp/back "
+               "adpcmtest.tmp/out/mono.wav"),
+          "batch conversion failed");
+    check_file("batch", "adpcmtest.tmp/out/mono.wav",
+               "adpcmtest.tmp/back/mono.wav", ref, half, ref_pcm, half * 4);
+
+    ref_pcm2adpcm(ref, l, half * 4);
+    ref_pcm2adpcm(ref + half, r, half * 4);
+    ref_adpcm2pcm(ref_l, ref, half);
+    ref_adpcm2pcm(ref_r, ref + half, half);
+
+    for(i = 0; i < half * 2; i++) {
+        ref_pcm[i * 2] = ref_l[i];
+        ref_pcm[i * 2 + 1] = ref_r[i];
+    }
+
+    CHECK(!run(tool, "-t adpcmtest.tmp/stereo.wav adpcmtest.tmp/stereo.adpcm") &&
+          !run(tool, "-f adpcmtest.tmp/stereo.adpcm adpcmtest.tmp/stereo.out"),
+          "stereo conversion failed");
+    check_file("stereo", "adpcmtest.tmp/stereo.adpcm",
+               "adpcmtest.tmp/stereo.out", ref, half * 2, ref_pcm, half * 8);
+    check_file("batch", "adpcmtest.tmp/out/stereo.wav",
+               "adpcmtest.tmp/stereo.out", ref, half * 2, ref_pcm, half * 8);
+
+    if(system("rm -rf adpcmtest.tmp"))
+        CHECK(0, "can't remove test files");
+
+    free(l);
+    free(r);
+    free(pcm);
+    free(ref_pcm);
+    free(ref_l);
+    free(ref_r);
+    free(ref);
+}
+
+int main(int argc, char *argv[]) {
+    static const int lengths[] = { 2, 8, 1000, 65536, 250002 };
+    int i, k;
+
+    for(i = 0; i < (int)(sizeof(lengths) / sizeof(lengths[0])); i++)
+        for(k = 0; k < SIGNALS; k++)
+            test_mono(lengths[i], &signals[k]);
+
+    for(k = 0; k < SIGNALS; k++)
+        test_stereo(100000, &signals[k], &signals[(k + 2) % SIGNALS]);
+
+    if(argc > 1)
+        test_files(argv[1]);
+
+    return check_done();
+}
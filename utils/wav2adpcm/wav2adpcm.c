@@ -13,157 +13,21 @@
     handle stereo (though the stereo is very likely KOS specific
     since we make no effort to interleave it). Please see README.GPL
     in the KOS docs dir for more info on the GPL license.
+
+    The coder itself now lives in adpcm.c. Files are converted a block at a
+    time, and --batch converts many files on several threads.
 */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <pthread.h>
+#include "adpcm.h"
 
-static int diff_lookup[16] = {
-    1, 3, 5, 7, 9, 11, 13, 15,
-    -1, -3, -5, -7, -9, -11, -13, -15,
-};
-
-static int index_scale[16] = {
-    0x0e6, 0x0e6, 0x0e6, 0x0e6, 0x133, 0x199, 0x200, 0x266,
-    0x0e6, 0x0e6, 0x0e6, 0x0e6, 0x133, 0x199, 0x200, 0x266 /* same value for speedup */
-};
-
-static inline int limit(int val, int min, int max) {
-    if(val < min) return min;
-    else if(val > max) return max;
-    else return val;
-}
-
-void pcm2adpcm(unsigned char *dst, const short *src, size_t length) {
-    int signal, step;
-    signal = 0;
-    step = 0x7f;
-
-    /* length /= 4; */
-    length = (length + 3) / 4;
-
-    do {
-        int data, val, diff;
-
-        /* hign nibble */
-        diff = *src++ - signal;
-        diff = (diff * 8) / step;
-
-        val = abs(diff) / 2;
-
-        if(val > 7) val = 7;
-
-        if(diff < 0) val += 8;
-
-        signal += (step * diff_lookup[val]) / 8;
-        signal = limit(signal, -32768, 32767);
-
-        step = (step * index_scale[val]) >> 8;
-        step = limit(step, 0x7f, 0x6000);
-
-        data = val;
-
-        /* low nibble */
-        diff = *src++ - signal;
-        diff = (diff * 8) / step;
-
-        val = (abs(diff)) / 2;
-
-        if(val > 7) val = 7;
-
-        if(diff < 0) val += 8;
-
-        signal += (step * diff_lookup[val]) / 8;
-        signal = limit(signal, -32768, 32767);
-
-        step = (step * index_scale[val]) >> 8;
-        step = limit(step, 0x7f, 0x6000);
-
-        data |= val << 4;
-
-        *dst++ = data;
-
-    }
-    while(--length);
-}
-
-void adpcm2pcm(short *dst, const unsigned char *src, size_t length) {
-    int signal, step;
-    signal = 0;
-    step = 0x7f;
-
-    do {
-        int data, val;
-
-        data = *src++;
-
-        /* low nibble */
-        val = data & 15;
-
-        signal += (step * diff_lookup[val]) / 8;
-        signal = limit(signal, -32768, 32767);
-
-        step = (step * index_scale[val & 7]) >> 8;
-        step = limit(step, 0x7f, 0x6000);
-
-        *dst++ = signal;
-
-        /* high nibble */
-        val = (data >> 4) & 15;
-
-        signal += (step * diff_lookup[val]) / 8;
-        signal = limit(signal, -32768, 32767);
-
-        step = (step * index_scale[val & 7]) >> 8;
-        step = limit(step, 0x7f, 0x6000);
-
-        *dst++ = signal;
-
-    }
-    while(--length);
-}
-
-void deinterleave(void *buffer, size_t size) {
-    short * buf;
-    short * buf1, * buf2;
-    int i;
-
-    buf = (short *)buffer;
-    buf1 = malloc(size / 2);
-    buf2 = malloc(size / 2);
-
-    for(i = 0; i < size / 4; i++) {
-        buf1[i] = buf[i * 2 + 0];
-        buf2[i] = buf[i * 2 + 1];
-    }
-
-    memcpy(buf, buf1, size / 2);
-    memcpy(buf + size / 4, buf2, size / 2);
-
-    free(buf1);
-    free(buf2);
-}
-
-void interleave(void *buffer, size_t size) {
-    short * buf;
-    short * buf1, * buf2;
-    int i;
-
-    buf = malloc(size);
-    buf1 = (short *)buffer;
-    buf2 = buf1 + size / 4;
-
-    for(i = 0; i < size / 4; i++) {
-        buf[i * 2 + 0] = buf1[i];
-        buf[i * 2 + 1] = buf2[i];
-    }
-
-    memcpy(buffer, buf, size);
-
-    free(buf);
-}
+/* Sample frames coded at a time. Memory use stays at about 6 bytes a frame
+   per channel, whatever the size of the file. Must be even. */
+#define BLOCK_FRAMES 65536
 
 typedef struct wavhdr_t {
     char hdr1[4];
@@ -249,14 +113,17 @@ int validate_wav_header(wavhdr_t *wavhdr, int format, int bits, FILE *in) {
 int wav2adpcm(const char *infile, const char *outfile) {
     wavhdr_t wavhdr;
     FILE *in, *out;
-    size_t pcmsize, adpcmsize;
+    size_t chbytes, done, n;
     short *pcmbuf;
     unsigned char *adpcmbuf;
+    adpcm_state_t st[2];
+    long data;
+    int channels, rv = -1;
 
     in = fopen(infile, "rb");
 
     if(!in)  {
-        printf("can't open %s\n", infile);
+        fprintf(stderr, "Cannot open %s\n", infile);
         return -1;
     }
 
@@ -271,54 +138,95 @@ int wav2adpcm(const char *infile, const char *outfile) {
         return -1;
     }
 
-    pcmsize = wavhdr.datasize;
+    /* Each channel gets one byte per two sample frames. For stereo, the
+       left channel's data comes first and then the right's. */
+    channels = wavhdr.channels;
+    chbytes = wavhdr.datasize / 4 / channels;
 
-    adpcmsize = pcmsize / 4;
-    pcmbuf = malloc(pcmsize);
-    adpcmbuf = malloc(adpcmsize);
+    out = fopen(outfile, "wb");
 
-    if(fread(pcmbuf, pcmsize, 1, in) != 1) {
-        fprintf(stderr, "Cannot read data.\n");
+    if(!out) {
+        fprintf(stderr, "Cannot open %s\n", outfile);
         fclose(in);
         return -1;
     }
-    fclose(in);
-
-    if(wavhdr.channels == 1) {
-        pcm2adpcm(adpcmbuf, pcmbuf, pcmsize);
-    }
-    else {
-        /* For stereo we just deinterleave the input and store the
-           left and right channel of the ADPCM data separately. */
-        deinterleave(pcmbuf, pcmsize);
-        pcm2adpcm(adpcmbuf, pcmbuf, pcmsize / 2);
-        pcm2adpcm(adpcmbuf + adpcmsize / 2, pcmbuf + pcmsize / 4, pcmsize / 2);
-    }
 
-    wavhdr.datasize = adpcmsize;
+    wavhdr.datasize = chbytes * channels;
     wavhdr.format = 20; /* ITU G.723 ADPCM (Yamaha) */
     wavhdr.bits = 4;
     wavhdr.totalsize = wavhdr.datasize + sizeof(wavhdr) - 8;
 
-    out = fopen(outfile, "wb");
-    if(fwrite(&wavhdr, sizeof(wavhdr), 1, out) != 1 || 
-        fwrite(adpcmbuf, adpcmsize, 1, out) != 1) {
+    pcmbuf = malloc(BLOCK_FRAMES * channels * sizeof(short));
+    adpcmbuf = malloc(BLOCK_FRAMES / 2 * channels);
+    adpcm_init(&st[0]);
+    adpcm_init(&st[1]);
+    data = sizeof(wavhdr);
+
+    if(!pcmbuf || !adpcmbuf) {
+        fprintf(stderr, "Out of memory.\n");
+        goto out;
+    }
+
+    if(fwrite(&wavhdr, sizeof(wavhdr), 1, out) != 1) {
         fprintf(stderr, "Cannot write ADPCM data.\n");
-        fclose(out);
-        return -1;
+        goto out;
     }
-    
-    fclose(out);
 
-    return 0;
+    for(done = 0; done < chbytes; done += n) {
+        n = chbytes - done < BLOCK_FRAMES / 2 ? chbytes - done : BLOCK_FRAMES / 2;
+
+        if(fread(pcmbuf, n * 2 * channels * sizeof(short), 1, in) != 1) {
+            fprintf(stderr, "Cannot read data.\n");
+            goto out;
+        }
+
+        if(channels == 1) {
+            adpcm_encode(&st[0], adpcmbuf, pcmbuf, n * 2);
+
+            if(fwrite(adpcmbuf, n, 1, out) != 1) {
+                fprintf(stderr, "Cannot write ADPCM data.\n");
+                goto out;
+            }
+        }
+        else {
+            /* Code both channels together, and put each block of them in
+               its own half of the output. */
+            adpcm_encode_stereo(st, adpcmbuf, adpcmbuf + n, pcmbuf, n * 2);
+
+            if(fseek(out, data + done, SEEK_SET) ||
+               fwrite(adpcmbuf, n, 1, out) != 1 ||
+               fseek(out, data + chbytes + done, SEEK_SET) ||
+               fwrite(adpcmbuf + n, n, 1, out) != 1) {
+                fprintf(stderr, "Cannot write ADPCM data.\n");
+                goto out;
+            }
+        }
+    }
+
+    rv = 0;
+
+out:
+    free(pcmbuf);
+    free(adpcmbuf);
+    fclose(in);
+
+    if(fclose(out) && !rv) {
+        fprintf(stderr, "Cannot write ADPCM data.\n");
+        rv = -1;
+    }
+
+    return rv;
 }
 
 int adpcm2wav(const char *infile, const char *outfile) {
     wavhdr_t wavhdr;
     FILE *in, *out;
-    size_t pcmsize, adpcmsize;
+    size_t chbytes, done, n;
     short *pcmbuf;
     unsigned char *adpcmbuf;
+    adpcm_state_t st[2];
+    long data;
+    int channels, rv = -1;
 
     in = fopen(infile, "rb");
 
@@ -338,43 +246,182 @@ int adpcm2wav(const char *infile, const char *outfile) {
         return -1;
     }
 
-    adpcmsize = wavhdr.datasize;
-    pcmsize = adpcmsize * 4;
-    adpcmbuf = malloc(adpcmsize);
-    pcmbuf = malloc(pcmsize);
+    channels = wavhdr.channels;
+    chbytes = wavhdr.datasize / channels;
+    data = ftell(in);
 
-    if(fread(adpcmbuf, adpcmsize, 1, in) != 1) {
-        fprintf(stderr, "Cannot read data.\n");
+    out = fopen(outfile, "wb");
+
+    if(!out) {
+        fprintf(stderr, "Cannot open %s\n", outfile);
         fclose(in);
         return -1;
     }
-    fclose(in);
 
-    if(wavhdr.channels == 1) {
-        adpcm2pcm(pcmbuf, adpcmbuf, adpcmsize);
-    }
-    else {
-        adpcm2pcm(pcmbuf, adpcmbuf, adpcmsize / 2);
-        adpcm2pcm(pcmbuf + pcmsize / 4, adpcmbuf + adpcmsize / 2, adpcmsize / 2);
-        interleave(pcmbuf, pcmsize);
-    }
-
-    wavhdr.blocksize = wavhdr.channels * sizeof(short);
+    wavhdr.blocksize = channels * sizeof(short);
     wavhdr.byte_per_sec = wavhdr.freq * wavhdr.blocksize;
-    wavhdr.datasize = pcmsize;
+    wavhdr.datasize = chbytes * 4 * channels;
     wavhdr.totalsize = wavhdr.datasize + sizeof(wavhdr) - 8;
     wavhdr.format = 1;
     wavhdr.bits = 16;
 
-    out = fopen(outfile, "wb");
-    if(fwrite(&wavhdr, sizeof(wavhdr), 1, out) != 1 || 
-       fwrite(pcmbuf, pcmsize, 1, out) != 1) {
+    pcmbuf = malloc(BLOCK_FRAMES * channels * sizeof(short));
+    adpcmbuf = malloc(BLOCK_FRAMES / 2 * channels);
+    adpcm_init(&st[0]);
+    adpcm_init(&st[1]);
+
+    if(!pcmbuf || !adpcmbuf) {
+        fprintf(stderr, "Out of memory.\n");
+        goto out;
+    }
+
+    if(fwrite(&wavhdr, sizeof(wavhdr), 1, out) != 1) {
         fprintf(stderr, "Cannot write WAV data.\n");
-        fclose(out);
+        goto out;
+    }
+
+    for(done = 0; done < chbytes; done += n) {
+        n = chbytes - done < BLOCK_FRAMES / 2 ? chbytes - done : BLOCK_FRAMES / 2;
+
+        if(channels == 1) {
+            if(fread(adpcmbuf, n, 1, in) != 1) {
+                fprintf(stderr, "Cannot read data.\n");
+                goto out;
+            }
+
+            adpcm_decode(&st[0], pcmbuf, adpcmbuf, n);
+        }
+        else {
+            if(fseek(in, data + done, SEEK_SET) ||
+               fread(adpcmbuf, n, 1, in) != 1 ||
+               fseek(in, data + chbytes + done, SEEK_SET) ||
+               fread(adpcmbuf + n, n, 1, in) != 1) {
+                fprintf(stderr, "Cannot read data.\n");
+                goto out;
+            }
+
+            adpcm_decode_stereo(st, pcmbuf, adpcmbuf, adpcmbuf + n, n);
+        }
+
+        if(fwrite(pcmbuf, n * 2 * channels * sizeof(short), 1, out) != 1) {
+            fprintf(stderr, "Cannot write WAV data.\n");
+            goto out;
+        }
+    }
+
+    rv = 0;
+
+out:
+    free(pcmbuf);
+    free(adpcmbuf);
+    fclose(in);
+
+    if(fclose(out) && !rv) {
+        fprintf(stderr, "Cannot write WAV data.\n");
+        rv = -1;
+    }
+
+    return rv;
+}
+
+/* Batch mode: a pool of threads takes the files one at a time. */
+typedef struct batch_t {
+    int (*convert)(const char *infile, const char *outfile);
+    const char *outdir;
+    char **files;
+    int count;
+
+    pthread_mutex_t lock;
+    int next;
+    int failed;
+} batch_t;
+
+static void *batch_thread(void *arg) {
+    batch_t *b = (batch_t *)arg;
+    const char *infile, *base;
+    char *outfile;
+    int i, rv;
+
+    for(;;) {
+        pthread_mutex_lock(&b->lock);
+        i = b->next++;
+        pthread_mutex_unlock(&b->lock);
+
+        if(i >= b->count)
+            break;
+
+        infile = b->files[i];
+        base = strrchr(infile, '/');
+        base = base ? base + 1 : infile;
+        outfile = malloc(strlen(b->outdir) + strlen(base) + 2);
+
+        if(!outfile) {
+            rv = -1;
+        }
+        else {
+            sprintf(outfile, "%s/%s", b->outdir, base);
+            rv = b->convert(infile, outfile);
+        }
+
+        pthread_mutex_lock(&b->lock);
+
+        if(rv < 0) {
+            fprintf(stderr, "%s: conversion failed\n", infile);
+            b->failed++;
+        }
+
+        pthread_mutex_unlock(&b->lock);
+        free(outfile);
+    }
+
+    return NULL;
+}
+
+int batch(int (*convert)(const char *, const char *), const char *outdir,
+          char **files, int count, int jobs) {
+    batch_t b;
+    pthread_t *threads;
+    int i;
+
+    b.convert = convert;
+    b.outdir = outdir;
+    b.files = files;
+    b.count = count;
+    b.next = 0;
+    b.failed = 0;
+    pthread_mutex_init(&b.lock, NULL);
+
+    if(jobs > count)
+        jobs = count;
+
+    threads = malloc(jobs * sizeof(pthread_t));
+
+    if(!threads) {
+        fprintf(stderr, "Out of memory.\n");
         return -1;
     }
 
-    fclose(out);
+    /* if a thread can't be started, the ones that were share the work */
+    for(i = 0; i < jobs; i++) {
+        if(pthread_create(&threads[i], NULL, batch_thread, &b))
+            break;
+    }
+
+    jobs = i;
+
+    if(!jobs)
+        batch_thread(&b);
+
+    for(i = 0; i < jobs; i++)
+        pthread_join(threads[i], NULL);
+
+    free(threads);
+    pthread_mutex_destroy(&b.lock);
+
+    if(b.failed) {
+        fprintf(stderr, "%d of %d files failed\n", b.failed, count);
+        return -1;
+    }
 
     return 0;
 }
@@ -383,6 +430,8 @@ void usage() {
     printf("wav2adpcm: 16bit mono wav to aica adpcm and vice-versa (c)2002 BERO\n"
            " wav2adpcm -t <infile.wav> <outfile.wav>   (To adpcm)\n"
            " wav2adpcm -f <infile.wav> <outfile.wav>   (From adpcm)\n"
+           " wav2adpcm -t|-f [-j <jobs>] --batch <outdir> <infile.wav>...\n"
+           "   (Convert many files, <jobs> at a time, into <outdir>)\n"
            "\n"
            "If you are having trouble with your input wav file you can run it"
            "through ffmpeg first and then run wav2adpcm on output.wav:\n"
@@ -391,20 +440,55 @@ void usage() {
 }
 
 int main(int argc, char **argv) {
-    if(argc == 4) {
-        if(!strcmp(argv[1], "-t")) {
-            return wav2adpcm(argv[2], argv[3]);
-        }
-        else if(!strcmp(argv[1], "-f")) {
-            return adpcm2wav(argv[2], argv[3]);
+    int (*convert)(const char *, const char *);
+    const char *outdir = NULL;
+    int arg = 2, jobs = 1;
+    char *end;
+
+    if(argc < 4) {
+        usage();
+        return -1;
+    }
+
+    if(!strcmp(argv[1], "-t"))
+        convert = wav2adpcm;
+    else if(!strcmp(argv[1], "-f"))
+        convert = adpcm2wav;
+    else {
+        usage();
+        return -1;
+    }
+
+    while(arg + 1 < argc) {
+        if(!strcmp(argv[arg], "-j")) {
+            jobs = strtol(argv[arg + 1], &end, 10);
+
+            if(*end || jobs < 1) {
+                fprintf(stderr, "-j requires a positive job count\n");
+                return -1;
+            }
         }
-        else {
+        else if(!strcmp(argv[arg], "--batch"))
+            outdir = argv[arg + 1];
+        else
+            break;
+
+        arg += 2;
+    }
+
+    if(outdir) {
+        if(arg >= argc) {
             usage();
             return -1;
         }
+
+        return batch(convert, outdir, argv + arg, argc - arg, jobs);
     }
-    else {
+
+    if(argc - arg != 2) {
         usage();
         return -1;
     }
+
+    return convert(argv[arg], argv[arg + 1]);
 }